@@ -0,0 +1,53 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_ADMIN_HPP
+#define UDATA_PACKET_IMPORT_PROXY_ADMIN_HPP
+#include <memory>
+#include <spdlog/spdlog.h>
+namespace UDataPacketImportAPI::V1
+{
+ class PipelineState;
+}
+namespace UDataPacketImportProxy
+{
+ class GRPCOptions;
+}
+namespace UDataPacketImportProxy
+{
+/// @class Admin
+/// @brief An optional gRPC service on its own port that lets operators
+///        inspect the live pipeline - i.e., the connected publishers and
+///        subscribers, the queue depths, the drop counts, and the busiest
+///        streams.  Snapshots are assembled from the process's metrics so
+///        polling this service never contends with the data path.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+class Admin
+{
+public:
+    /// @brief Constructs the admin service.
+    Admin(const GRPCOptions &options, std::shared_ptr<spdlog::logger> logger);
+    /// @brief Starts the admin service.
+    void start();
+    /// @brief Stops the admin service.
+    void stop();
+    /// @result True indicates the admin service is running.
+    [[nodiscard]] bool isRunning() const noexcept;
+    /// @brief Destructor.
+    ~Admin();
+
+    Admin() = delete;
+    Admin(const Admin &) = delete;
+    Admin(Admin &&) noexcept = delete;
+    Admin& operator=(const Admin &) = delete;
+    Admin& operator=(Admin &&) noexcept = delete;
+private:
+    class AdminImpl;
+    std::unique_ptr<AdminImpl> pImpl;
+};
+
+/// @param[in] maximumNumberOfStreams  The maximum number of busiest streams
+///                                    to report.
+/// @result A snapshot of the pipeline's state.
+[[nodiscard]] UDataPacketImportAPI::V1::PipelineState
+    makePipelineState(int maximumNumberOfStreams = 10);
+}
+#endif
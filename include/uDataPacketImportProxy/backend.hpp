@@ -1,13 +1,19 @@
 #ifndef UDATA_PACKET_IMPORT_PROXY_BACKEND_HPP
 #define UDATA_PACKET_IMPORT_PROXY_BACKEND_HPP
+#include <chrono>
 #include <memory>
 namespace UDataPacketImportAPI::V1
 {
  class Packet;
 }
+namespace grpc
+{
+ class Channel;
+}
 namespace UDataPacketImportProxy
 {
  class BackendOptions;
+ class DeliveryReceipt;
 }
 namespace UDataPacketImportProxy
 {
@@ -24,7 +30,23 @@ public:
     /// @result The number of packets overwritten in the outbound queue.
     ///         This should be zero.
     [[nodiscard]] int enqueuePacket(UDataPacketImportAPI::V1::Packet &&packet);
+    /// @brief Enqueues the next packet.
+    /// @param[in] ingestTime  The time the packet arrived at the frontend.
+    ///                        This is used to track end-to-end latency.
+    /// @param[in] deliveryReceipt  An optional receipt copied into every
+    ///                             subscriber's copy of the packet.  It is
+    ///                             released once every subscriber has
+    ///                             written the packet, dropped it, or
+    ///                             disconnected.
+    /// @result The number of packets overwritten in the outbound queue.
+    [[nodiscard]] int enqueuePacket(UDataPacketImportAPI::V1::Packet &&packet,
+                                    const std::chrono::steady_clock::time_point &ingestTime,
+                                    const DeliveryReceipt *deliveryReceipt = nullptr);
     [[nodiscard]] int getNumberOfSubscribers() const;
+    /// @result A channel to the backend's service that bypasses the network.
+    ///         This is for benchmarking the proxy without TCP.
+    /// @throws std::runtime_error if the backend is not started.
+    [[nodiscard]] std::shared_ptr<grpc::Channel> createInProcessChannel() const;
     [[nodiscard]] bool isRunning() const noexcept;
 
     Backend() = delete;
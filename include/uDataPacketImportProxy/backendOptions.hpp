@@ -1,5 +1,6 @@
 #ifndef UDATA_PACKET_IMPORT_PROXY_BACKEND_OPTIONS_HPP
 #define UDATA_PACKET_IMPORT_PROXY_BACKEND_OPTIONS_HPP
+#include <chrono>
 #include <memory>
 namespace UDataPacketImportProxy
 {
@@ -9,6 +10,18 @@ namespace UDataPacketImportProxy
 {
 class BackendOptions
 {
+public:
+    /// @brief Defines what to do when a subscriber cannot keep up.
+    enum class SlowConsumerPolicy
+    {
+        DropOldest,      /*!< Evict the oldest packets from the subscriber's
+                              queue to make room.  This is the default. */
+        LatestPerStream, /*!< Compact the subscriber's queue to the most
+                              recent packet of each stream. */
+        Disconnect       /*!< Terminate the subscription once the subscriber
+                              lags by more than the maximum lag for longer
+                              than the sustained lag duration. */
+    };
 public:
     /// @brief Constructor.
     BackendOptions();
@@ -28,6 +41,32 @@ public:
     /// @result The queue capacity.
     [[nodiscard]] int getQueueCapacity() const noexcept;
 
+    /// @brief Sets the policy for subscribers whose queues overflow or
+    ///        that fall too far behind.
+    void setSlowConsumerPolicy(SlowConsumerPolicy policy) noexcept;
+    /// @result The slow consumer policy.
+    [[nodiscard]] SlowConsumerPolicy getSlowConsumerPolicy() const noexcept;
+
+    /// @brief Sets the maximum lag.  The lag is how long the packet being
+    ///        written to a subscriber waited in the subscriber's queue.
+    ///        Under the Disconnect policy a subscriber lagging by more than
+    ///        this is disconnected.  Under the other policies a warning is
+    ///        logged.
+    /// @throws std::invalid_argument if the lag is not positive.
+    void setMaximumSubscriberLag(const std::chrono::milliseconds &lag);
+    /// @result The maximum subscriber lag.
+    [[nodiscard]] std::chrono::milliseconds getMaximumSubscriberLag() const noexcept;
+
+    /// @brief Sets how long a subscriber must continuously lag by more than
+    ///        the maximum lag before the Disconnect policy terminates its
+    ///        subscription.  This keeps a brief stall, e.g., a garbage
+    ///        collection pause in the subscriber, from costing it the
+    ///        subscription.
+    /// @throws std::invalid_argument if the duration is negative.
+    void setSustainedLagDuration(const std::chrono::milliseconds &duration);
+    /// @result The sustained lag duration.
+    [[nodiscard]] std::chrono::milliseconds getSustainedLagDuration() const noexcept;
+
     /// @brief Destructor.
     ~BackendOptions();
     /// @brief Copy constructor.
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <string>
 #include <memory>
+#include <optional>
 namespace UDataPacketImportAPI::V1
 {
  class Packet;
@@ -77,6 +78,10 @@ public:
     /// @result True indicates the data does not appear to be a duplicate.
     [[nodiscard]] bool operator()(const UDataPacketImportAPI::V1::Packet &packet) const;
 
+    /// @result The number of streams with a circular buffer.  This can be
+    ///         safely read from any thread while packets are being tested.
+    [[nodiscard]] int getNumberOfStreams() const noexcept;
+
     /// @brief Destructor.
     ~DuplicatePacketDetector();
     /// @brief Copy assignment.
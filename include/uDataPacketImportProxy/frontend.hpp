@@ -13,6 +13,10 @@ namespace UDataPacketImportProxy
 {
  class FrontendOptions;
 }
+namespace grpc
+{
+ class Channel;
+}
 namespace UDataPacketImportProxy
 {
 /// @class Frontend frontend.hpp
@@ -40,6 +44,10 @@ public:
 
     /// @result The number of publishers.
     [[nodiscard]] int getNumberOfPublishers() const;
+    /// @result A channel to the frontend's service that bypasses the network.
+    ///         This is for benchmarking the proxy without TCP.
+    /// @throws std::runtime_error if the frontend is not started.
+    [[nodiscard]] std::shared_ptr<grpc::Channel> createInProcessChannel() const;
     /// @result True indicates that the frontend is running.
     [[nodiscard]] bool isRunning() const noexcept;
 
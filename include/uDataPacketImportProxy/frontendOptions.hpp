@@ -36,6 +36,16 @@ public:
     ///         will be popped.
     [[nodiscard]] int getMaximumNumberOfConsecutiveInvalidMessages() const noexcept;
 
+    /// @brief Sets the number of gRPC servers that listen on the frontend's
+    ///        address.  When this exceeds one the servers share the port
+    ///        with SO_REUSEPORT and the kernel spreads new publisher
+    ///        connections across them.
+    /// @throws std::invalid_argument if the number of servers is not positive.
+    void setNumberOfServers(int numberOfServers);
+    /// @result The number of gRPC servers listening on the frontend's address.
+    /// @note By default this is 1.
+    [[nodiscard]] int getNumberOfServers() const noexcept;
+
     /// @brief Destructor.
     ~FrontendOptions();
     /// @brief Copy constructor.
@@ -1,5 +1,6 @@
 #ifndef UDATA_PACKET_IMPORT_PROXY_GRPC_OPTIONS_HPP
 #define UDATA_PACKET_IMPORT_PROXY_GRPC_OPTIONS_HPP
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <filesystem>
@@ -9,6 +10,18 @@ namespace UDataPacketImportProxy
 class GRPCOptions
 {
 public:
+    /// @brief Server tuning for a given workload.
+    enum class ServerPreset
+    {
+        Default,          /*!< gRPC's defaults. */
+        ManySmallStreams, /*!< Many clients that each stream small packets,
+                               e.g., dozens of publishers or subscribers.
+                               This bounds the memory each connection can
+                               claim. */
+        FewLargeStreams   /*!< A few clients with high throughput streams.
+                               This favors large flow-control windows. */
+    };
+
     /// @brief Constructor
     GRPCOptions();
 
@@ -57,6 +70,54 @@ public:
     /// @note The default is false.
     [[nodiscard]] bool reflectionEnabled() const noexcept;
 
+    /// @brief Sets the resource quota, concurrent stream, and HTTP/2 options
+    ///        to the preset's values.  Individual options can be overridden
+    ///        afterwards.
+    /// @note The default preset restores gRPC's defaults.
+    void applyServerPreset(ServerPreset preset) noexcept;
+
+    /// @brief Sets the memory the server's resource quota allows all of its
+    ///        connections to use.
+    /// @throws std::invalid_argument if this is not positive.
+    void setResourceQuotaInBytes(int64_t quota);
+    /// @result The server's resource quota in bytes.  If this is not set
+    ///         then gRPC's default is used.
+    [[nodiscard]] std::optional<int64_t> getResourceQuotaInBytes() const noexcept;
+
+    /// @brief Sets the maximum number of concurrent streams on one
+    ///        connection.
+    /// @throws std::invalid_argument if this is not positive.
+    void setMaximumNumberOfConcurrentStreams(int maxStreams);
+    /// @result The maximum number of concurrent streams on a connection.
+    ///         If this is not set then gRPC's default is used.
+    [[nodiscard]] std::optional<int> getMaximumNumberOfConcurrentStreams() const noexcept;
+
+    /// @brief Sets the HTTP/2 flow-control window of each stream - i.e.,
+    ///        how many bytes a peer can send before it must wait for the
+    ///        receiver to read.
+    /// @throws std::invalid_argument if this is not positive.
+    void setHTTP2StreamWindowSizeInBytes(int windowSize);
+    /// @result The HTTP/2 stream window size.  If this is not set then
+    ///         gRPC's default is used.
+    [[nodiscard]] std::optional<int> getHTTP2StreamWindowSizeInBytes() const noexcept;
+
+    /// @brief Sets the size of the HTTP/2 write buffer.
+    /// @throws std::invalid_argument if this is not positive.
+    void setHTTP2WriteBufferSizeInBytes(int bufferSize);
+    /// @result The HTTP/2 write buffer size.  If this is not set then
+    ///         gRPC's default is used.
+    [[nodiscard]] std::optional<int> getHTTP2WriteBufferSizeInBytes() const noexcept;
+
+    /// @brief Enables the HTTP/2 bandwidth-delay product probe which grows
+    ///        the flow-control windows to match the link.
+    void enableHTTP2BDPProbe() noexcept;
+    /// @brief Disables the HTTP/2 bandwidth-delay product probe so the
+    ///        flow-control windows stay fixed.
+    void disableHTTP2BDPProbe() noexcept;
+    /// @result True indicates the bandwidth-delay product probe is enabled.
+    /// @note The default is true.
+    [[nodiscard]] bool http2BDPProbeEnabled() const noexcept;
+
     /// @brief Destructor
     ~GRPCOptions();
     /// @brief Copy constructor.
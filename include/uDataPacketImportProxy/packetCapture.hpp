@@ -0,0 +1,151 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_PACKET_CAPTURE_HPP
+#define UDATA_PACKET_IMPORT_PROXY_PACKET_CAPTURE_HPP
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+namespace UDataPacketImportAPI::V1
+{
+ class Packet;
+}
+namespace UDataPacketImportProxy
+{
+
+/// @class PacketCaptureOptions packetCapture.hpp
+/// @brief Defines where and how much traffic is captured.
+/// @copyright Ben Baker (University of Utah) distributed under the MIT NO AI
+///            license.
+class PacketCaptureOptions
+{
+public:
+    /// @brief Constructor.
+    PacketCaptureOptions();
+    /// @brief Copy constructor.
+    PacketCaptureOptions(const PacketCaptureOptions &options);
+    /// @brief Move constructor.
+    PacketCaptureOptions(PacketCaptureOptions &&options) noexcept;
+
+    /// @brief Sets the directory to which the capture files are written.
+    /// @throws std::invalid_argument if the directory is empty.
+    void setDirectory(const std::filesystem::path &directory);
+    /// @result The capture directory.
+    /// @throws std::runtime_error if the directory was not set.
+    [[nodiscard]] std::filesystem::path getDirectory() const;
+    /// @result True indicates the capture directory was set.
+    [[nodiscard]] bool haveDirectory() const noexcept;
+
+    /// @brief Once a capture file reaches this size a new file is started.
+    /// @throws std::invalid_argument if this is less than 64 kB.
+    void setMaximumFileSizeInBytes(int64_t maximumFileSize);
+    /// @result The maximum size of a capture file.
+    /// @note By default this is 256 MB.
+    [[nodiscard]] int64_t getMaximumFileSizeInBytes() const noexcept;
+
+    /// @brief Once there are this many capture files the oldest is deleted
+    ///        when a new file is started.
+    /// @throws std::invalid_argument if this is not positive.
+    void setMaximumNumberOfFiles(int maximumNumberOfFiles);
+    /// @result The maximum number of capture files.
+    /// @note By default this is 16.
+    [[nodiscard]] int getMaximumNumberOfFiles() const noexcept;
+
+    /// @brief Destructor.
+    ~PacketCaptureOptions();
+    /// @brief Copy assignment.
+    PacketCaptureOptions& operator=(const PacketCaptureOptions &options);
+    /// @brief Move assignment.
+    PacketCaptureOptions& operator=(PacketCaptureOptions &&options) noexcept;
+private:
+    class PacketCaptureOptionsImpl;
+    std::unique_ptr<PacketCaptureOptionsImpl> pImpl;
+};
+
+/// @class PacketCapture packetCapture.hpp
+/// @brief Records accepted packets along with the time they were received
+///        so that production traffic can be replayed elsewhere.  Each
+///        capture file starts with an 8 byte magic number followed by
+///        records comprising a 4 byte little-endian length, an 8 byte
+///        little-endian receive time in microseconds since the epoch, and
+///        the serialized packet.  The files are rotated by size.
+/// @note This is thread safe.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+class PacketCapture
+{
+public:
+    /// @brief Creates the capture directory, if necessary, and starts a new
+    ///        capture file after any files already in the directory.
+    /// @throws std::invalid_argument if the directory is not set.
+    /// @throws std::runtime_error if the capture file cannot be created.
+    explicit PacketCapture(const PacketCaptureOptions &options);
+
+    /// @brief Records the packet.
+    /// @param[in] packet       The packet.
+    /// @param[in] receiveTime  The time the packet was received in
+    ///                         microseconds since the epoch.
+    /// @throws std::runtime_error if the packet cannot be written.
+    void append(const UDataPacketImportAPI::V1::Packet &packet,
+                const std::chrono::microseconds &receiveTime);
+    /// @brief Writes any buffered records to the current capture file.
+    void flush();
+
+    /// @result The number of packets captured by this instance.
+    [[nodiscard]] int64_t getNumberOfPackets() const noexcept;
+
+    /// @result The capture files in the directory ordered from oldest to
+    ///         newest.
+    [[nodiscard]] static std::vector<std::filesystem::path>
+        getFiles(const std::filesystem::path &directory);
+
+    /// @brief Destructor.  Flushes the buffered records.
+    ~PacketCapture();
+
+    PacketCapture() = delete;
+    PacketCapture(const PacketCapture &) = delete;
+    PacketCapture(PacketCapture &&) noexcept = delete;
+    PacketCapture& operator=(const PacketCapture &) = delete;
+    PacketCapture& operator=(PacketCapture &&) noexcept = delete;
+private:
+    class PacketCaptureImpl;
+    std::unique_ptr<PacketCaptureImpl> pImpl;
+};
+
+/// @class PacketCaptureReader packetCapture.hpp
+/// @brief Reads a capture file through mmap so that replaying a capture is
+///        not bound by I/O.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+class PacketCaptureReader
+{
+public:
+    /// @brief Maps the capture file.
+    /// @throws std::runtime_error if the file cannot be mapped or is not a
+    ///         capture file.
+    explicit PacketCaptureReader(const std::filesystem::path &fileName);
+
+    /// @brief Reads the next packet.
+    /// @param[out] packet       The next packet.
+    /// @param[out] receiveTime  The time the packet was received in
+    ///                          microseconds since the epoch.
+    /// @result False indicates the end of the file, or a truncated final
+    ///         record, was reached.
+    /// @throws std::runtime_error if a record cannot be parsed.
+    [[nodiscard]] bool next(UDataPacketImportAPI::V1::Packet *packet,
+                            std::chrono::microseconds *receiveTime);
+
+    /// @brief Destructor.  Unmaps the file.
+    ~PacketCaptureReader();
+
+    PacketCaptureReader() = delete;
+    PacketCaptureReader(const PacketCaptureReader &) = delete;
+    PacketCaptureReader(PacketCaptureReader &&) noexcept = delete;
+    PacketCaptureReader& operator=(const PacketCaptureReader &) = delete;
+    PacketCaptureReader& operator=(PacketCaptureReader &&) noexcept = delete;
+private:
+    class PacketCaptureReaderImpl;
+    std::unique_ptr<PacketCaptureReaderImpl> pImpl;
+};
+
+}
+#endif
@@ -0,0 +1,124 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_PACKET_COALESCER_HPP
+#define UDATA_PACKET_IMPORT_PROXY_PACKET_COALESCER_HPP
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+namespace UDataPacketImportAPI::V1
+{
+ class Packet;
+}
+namespace UDataPacketImportProxy
+{
+
+/// @class PacketCoalescerOptions packetCoalescer.hpp
+/// @brief Defines how small, time-contiguous packets are merged.
+/// @copyright Ben Baker (University of Utah) distributed under the MIT NO AI
+///            license.
+class PacketCoalescerOptions
+{
+public:
+    /// @brief Constructor.
+    PacketCoalescerOptions();
+    /// @brief Copy constructor.
+    PacketCoalescerOptions(const PacketCoalescerOptions &options);
+    /// @brief Move constructor.
+    PacketCoalescerOptions(PacketCoalescerOptions &&options) noexcept;
+
+    /// @brief Sets the maximum duration of a merged packet.
+    /// @throws std::invalid_argument if this is not positive.
+    void setMaximumDuration(const std::chrono::milliseconds &duration);
+    /// @result The maximum duration of a merged packet.
+    /// @note By default this is 2 seconds.
+    [[nodiscard]] std::chrono::milliseconds getMaximumDuration() const noexcept;
+
+    /// @brief Sets the maximum size of a merged packet's data.
+    /// @throws std::invalid_argument if this is not positive.
+    void setMaximumSizeInBytes(int maximumSize);
+    /// @result The maximum size of a merged packet's data in bytes.
+    /// @note By default this is 16 kB.
+    [[nodiscard]] int getMaximumSizeInBytes() const noexcept;
+
+    /// @brief Sets the maximum time the first packet in a merged packet may
+    ///        wait before the merged packet is emitted.
+    /// @throws std::invalid_argument if this is not positive.
+    void setMaximumLinger(const std::chrono::milliseconds &linger);
+    /// @result The maximum time a packet lingers in the coalescer.
+    /// @note By default this is 250 milliseconds.
+    [[nodiscard]] std::chrono::milliseconds getMaximumLinger() const noexcept;
+
+    /// @brief Destructor.
+    ~PacketCoalescerOptions();
+    /// @brief Copy assignment.
+    PacketCoalescerOptions& operator=(const PacketCoalescerOptions &options);
+    /// @brief Move assignment.
+    PacketCoalescerOptions& operator=(PacketCoalescerOptions &&options) noexcept;
+private:
+    class PacketCoalescerOptionsImpl;
+    std::unique_ptr<PacketCoalescerOptionsImpl> pImpl;
+};
+
+/// @class PacketCoalescer packetCoalescer.hpp
+/// @brief Merges time-contiguous packets from the same stream with the same
+///        data type and sampling rate into larger packets.  A merged packet
+///        is emitted once it reaches the maximum duration or size, once a
+///        non-contiguous packet arrives, or once its first packet has
+///        lingered for the maximum linger time.  Text packets and packets
+///        whose data size is inconsistent with their sample count are
+///        passed through unmodified.
+/// @note This is not thread safe.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+class PacketCoalescer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Constructor.
+    explicit PacketCoalescer(const PacketCoalescerOptions &options);
+
+    /// @brief Adds a packet to the coalescer.
+    /// @param[in,out] packet       The packet to merge.  On exit, packet's
+    ///                             behavior is undefined.
+    /// @param[in] now              The arrival time.
+    /// @param[in] journalSequence  The packet's journal sequence number.  A
+    ///                             merged packet carries the lowest sequence
+    ///                             number of the packets it contains.  0
+    ///                             indicates the packet was not journaled.
+    /// @result Any packets that are ready to be emitted along with their
+    ///         journal sequence numbers.
+    /// @throws std::invalid_argument if the packet has no stream identifier
+    ///         or its sampling rate is not positive.
+    [[nodiscard]] std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> insert(UDataPacketImportAPI::V1::Packet &&packet, Clock::time_point now = Clock::now(), uint64_t journalSequence = 0);
+    /// @result The merged packets whose linger time has elapsed along with
+    ///         their journal sequence numbers.
+    [[nodiscard]] std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> release(Clock::time_point now = Clock::now());
+    /// @result All pending merged packets along with their journal sequence
+    ///         numbers.
+    [[nodiscard]] std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> releaseAll();
+
+    /// @result The number of streams with a pending merged packet.
+    [[nodiscard]] int size() const noexcept;
+    /// @result The smallest journal sequence number of the pending merged
+    ///         packets or std::nullopt if no journaled packet is pending.
+    /// @note This scans the streams so it is meant to be called
+    ///       periodically.
+    [[nodiscard]] std::optional<uint64_t> getLowestJournalSequence() const;
+
+    /// @brief Destructor.
+    ~PacketCoalescer();
+
+    PacketCoalescer() = delete;
+    PacketCoalescer(const PacketCoalescer &) = delete;
+    PacketCoalescer(PacketCoalescer &&) noexcept = delete;
+    PacketCoalescer& operator=(const PacketCoalescer &) = delete;
+    PacketCoalescer& operator=(PacketCoalescer &&) noexcept = delete;
+private:
+    class PacketCoalescerImpl;
+    std::unique_ptr<PacketCoalescerImpl> pImpl;
+};
+
+}
+#endif
@@ -0,0 +1,152 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_PACKET_JOURNAL_HPP
+#define UDATA_PACKET_IMPORT_PROXY_PACKET_JOURNAL_HPP
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <utility>
+#include <vector>
+namespace UDataPacketImportAPI::V1
+{
+ class Packet;
+}
+namespace UDataPacketImportProxy
+{
+
+/// @class PacketJournalOptions packetJournal.hpp
+/// @brief Defines the crash-safe ring journal of recently ingested packets.
+/// @copyright Ben Baker (University of Utah) distributed under the MIT NO AI
+///            license.
+class PacketJournalOptions
+{
+public:
+    /// @brief Constructor.
+    PacketJournalOptions();
+    /// @brief Copy constructor.
+    PacketJournalOptions(const PacketJournalOptions &options);
+    /// @brief Move constructor.
+    PacketJournalOptions(PacketJournalOptions &&options) noexcept;
+
+    /// @brief Sets the journal file.
+    /// @throws std::invalid_argument if the file name is empty.
+    void setFileName(const std::filesystem::path &fileName);
+    /// @result The journal file.
+    /// @throws std::runtime_error if the file name was not set.
+    [[nodiscard]] std::filesystem::path getFileName() const;
+    /// @result True indicates the journal file name was set.
+    [[nodiscard]] bool haveFileName() const noexcept;
+
+    /// @brief Sets the size of the journal's ring.  Committed records are
+    ///        overwritten as the ring wraps.  Uncommitted records are never
+    ///        overwritten; instead, appends are refused until the oldest
+    ///        uncommitted record is committed.
+    /// @throws std::invalid_argument if this is less than 64 kB.
+    void setCapacityInBytes(int64_t capacity);
+    /// @result The ring capacity in bytes.
+    /// @note By default this is 64 MB.
+    [[nodiscard]] int64_t getCapacityInBytes() const noexcept;
+
+    /// @brief The ring is divided into slots of this size and each record
+    ///        occupies one slot.  A packet that, with its 24 byte record
+    ///        header, does not fit in a slot is not journaled.
+    /// @throws std::invalid_argument if this is less than 256 bytes or not
+    ///         a multiple of 8 bytes.
+    void setSlotSizeInBytes(int slotSize);
+    /// @result The size of a slot in bytes.
+    /// @note By default this is 4 kB.
+    [[nodiscard]] int getSlotSizeInBytes() const noexcept;
+
+    /// @brief The journal is asynchronously flushed to disk every this
+    ///        many records.
+    /// @throws std::invalid_argument if this is not positive.
+    void setSynchronizationInterval(int nRecords);
+    /// @result The number of records between flushes.
+    /// @note By default this is 1024.
+    [[nodiscard]] int getSynchronizationInterval() const noexcept;
+
+    /// @brief On startup the proxy waits up to this long for a subscriber
+    ///        to connect before replaying the uncommitted packets.
+    /// @throws std::invalid_argument if this is negative.
+    void setMaximumReplayWait(const std::chrono::milliseconds &wait);
+    /// @result The maximum time to wait for a subscriber prior to replay.
+    /// @note By default this is 10 seconds.
+    [[nodiscard]] std::chrono::milliseconds getMaximumReplayWait() const noexcept;
+
+    /// @brief Destructor.
+    ~PacketJournalOptions();
+    /// @brief Copy assignment.
+    PacketJournalOptions& operator=(const PacketJournalOptions &options);
+    /// @brief Move assignment.
+    PacketJournalOptions& operator=(PacketJournalOptions &&options) noexcept;
+private:
+    class PacketJournalOptionsImpl;
+    std::unique_ptr<PacketJournalOptionsImpl> pImpl;
+};
+
+/// @class PacketJournal packetJournal.hpp
+/// @brief A memory-mapped ring journal.  Each accepted packet is recorded
+///        with a fixed-size header, sequence number, and CRC before it
+///        enters the proxy's pipeline.  A sequence number is committed only
+///        once every subscriber has written the packet (or dropped it
+///        from its queue) and no older packet remains in the reorder
+///        buffer, coalescer, or subscriber queues.  After a crash or restart
+///        the uncommitted tail can be replayed.
+/// @note This is thread safe.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+class PacketJournal
+{
+public:
+    /// @brief Opens or creates the journal.
+    /// @throws std::invalid_argument if the file name is not set.
+    /// @throws std::runtime_error if the journal cannot be mapped.
+    explicit PacketJournal(const PacketJournalOptions &options);
+
+    /// @brief Records the packet in the journal.  The sequence number and
+    ///        slot are reserved atomically and the packet is then copied
+    ///        into its slot without a lock, so concurrent appends may
+    ///        finish out of sequence order.
+    /// @result The packet's sequence number.  This is always positive.
+    /// @throws std::invalid_argument if the packet does not fit in a slot.
+    /// @throws std::runtime_error if writing the packet would overwrite an
+    ///         uncommitted record.  The packet is not recorded and the
+    ///         overflow count is incremented.
+    [[nodiscard]] uint64_t append(const UDataPacketImportAPI::V1::Packet &packet);
+    /// @brief Marks all packets with sequence numbers up to and including
+    ///        this sequence number as delivered to the subscribers.
+    void commit(uint64_t sequence) noexcept;
+    /// @result The packets that were recorded but not committed prior to
+    ///         this journal being opened, ordered by sequence number.  This
+    ///         hands the packets to the caller so subsequent calls return
+    ///         nothing.
+    [[nodiscard]] std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> takeUncommittedPackets();
+
+    /// @result The last committed sequence number.
+    [[nodiscard]] uint64_t getCommittedSequence() const noexcept;
+    /// @result The sequence number that will be assigned to the next packet.
+    [[nodiscard]] uint64_t getNextSequence() const noexcept;
+    /// @result The number of appends refused because the ring was full of
+    ///         uncommitted records.
+    [[nodiscard]] uint64_t getNumberOfOverflows() const noexcept;
+    /// @result The number of slots in the ring.  At most this many packets
+    ///         are uncommitted at any time.
+    [[nodiscard]] uint64_t getNumberOfSlots() const noexcept;
+
+    /// @brief Synchronously flushes the journal to disk.
+    void synchronize();
+
+    /// @brief Destructor.  Flushes the journal to disk.
+    ~PacketJournal();
+
+    PacketJournal() = delete;
+    PacketJournal(const PacketJournal &) = delete;
+    PacketJournal(PacketJournal &&) noexcept = delete;
+    PacketJournal& operator=(const PacketJournal &) = delete;
+    PacketJournal& operator=(PacketJournal &&) noexcept = delete;
+private:
+    class PacketJournalImpl;
+    std::unique_ptr<PacketJournalImpl> pImpl;
+};
+
+}
+#endif
@@ -0,0 +1,117 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_PACKET_REORDER_BUFFER_HPP
+#define UDATA_PACKET_IMPORT_PROXY_PACKET_REORDER_BUFFER_HPP
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+namespace UDataPacketImportAPI::V1
+{
+ class Packet;
+}
+namespace UDataPacketImportProxy
+{
+
+/// @class PacketReorderBufferOptions packetReorderBuffer.hpp
+/// @brief Defines how long packets may be held while waiting for
+///        out-of-order packets to arrive.
+/// @copyright Ben Baker (University of Utah) distributed under the MIT NO AI
+///            license.
+class PacketReorderBufferOptions
+{
+public:
+    /// @brief Constructor.
+    PacketReorderBufferOptions();
+    /// @brief Copy constructor.
+    PacketReorderBufferOptions(const PacketReorderBufferOptions &options);
+    /// @brief Move constructor.
+    PacketReorderBufferOptions(PacketReorderBufferOptions &&options) noexcept;
+
+    /// @brief Sets the maximum time a packet is held in the buffer.
+    /// @throws std::invalid_argument if this is not positive.
+    void setWindow(const std::chrono::milliseconds &window);
+    /// @result The maximum time a packet is held in the buffer.
+    /// @note By default this is 500 milliseconds.
+    [[nodiscard]] std::chrono::milliseconds getWindow() const noexcept;
+
+    /// @brief Sets the maximum number of packets held per stream.  Once
+    ///        exceeded the earliest packet is released immediately.
+    /// @throws std::invalid_argument if this is not positive.
+    void setMaximumNumberOfPacketsPerStream(int maximumNumberOfPackets);
+    /// @result The maximum number of packets held per stream.
+    /// @note By default this is 64.
+    [[nodiscard]] int getMaximumNumberOfPacketsPerStream() const noexcept;
+
+    /// @brief Destructor.
+    ~PacketReorderBufferOptions();
+    /// @brief Copy assignment.
+    PacketReorderBufferOptions& operator=(const PacketReorderBufferOptions &options);
+    /// @brief Move assignment.
+    PacketReorderBufferOptions& operator=(PacketReorderBufferOptions &&options) noexcept;
+private:
+    class PacketReorderBufferOptionsImpl;
+    std::unique_ptr<PacketReorderBufferOptionsImpl> pImpl;
+};
+
+/// @class PacketReorderBuffer packetReorderBuffer.hpp
+/// @brief Holds each stream's packets for up to a fixed window and releases
+///        them in start time order.  Each stream's pending packets are kept
+///        in a small sorted array and stream deadlines are tracked with a
+///        timing wheel.  When any packet's window elapses every pending
+///        packet of that stream starting at or before it is released.
+///        A packet arriving after later packets in its stream were released
+///        is passed through immediately.
+/// @note This is not thread safe.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+class PacketReorderBuffer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief Constructor.
+    explicit PacketReorderBuffer(const PacketReorderBufferOptions &options);
+
+    /// @brief Adds a packet to the buffer.
+    /// @param[in,out] packet       The packet to buffer.  On exit, packet's
+    ///                             behavior is undefined.
+    /// @param[in] now              The arrival time.
+    /// @param[in] journalSequence  The packet's journal sequence number.
+    ///                             This is carried with the packet and
+    ///                             handed back when the packet is released.
+    ///                             0 indicates the packet was not journaled.
+    /// @result Any packets, along with their journal sequence numbers, that
+    ///         must be released immediately because they arrived too late
+    ///         or their stream's buffer is full.
+    /// @throws std::invalid_argument if the packet has no stream identifier.
+    [[nodiscard]] std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> insert(UDataPacketImportAPI::V1::Packet &&packet, Clock::time_point now = Clock::now(), uint64_t journalSequence = 0);
+    /// @result The packets whose windows have elapsed, in start time order
+    ///         for each stream, along with their journal sequence numbers.
+    [[nodiscard]] std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> release(Clock::time_point now = Clock::now());
+    /// @result All buffered packets in start time order for each stream
+    ///         along with their journal sequence numbers.
+    [[nodiscard]] std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> releaseAll();
+
+    /// @result The number of buffered packets.
+    [[nodiscard]] int size() const noexcept;
+    /// @result The smallest journal sequence number of the buffered packets
+    ///         or std::nullopt if no journaled packet is buffered.
+    /// @note This scans the buffer so it is meant to be called periodically.
+    [[nodiscard]] std::optional<uint64_t> getLowestJournalSequence() const;
+
+    /// @brief Destructor.
+    ~PacketReorderBuffer();
+
+    PacketReorderBuffer() = delete;
+    PacketReorderBuffer(const PacketReorderBuffer &) = delete;
+    PacketReorderBuffer(PacketReorderBuffer &&) noexcept = delete;
+    PacketReorderBuffer& operator=(const PacketReorderBuffer &) = delete;
+    PacketReorderBuffer& operator=(PacketReorderBuffer &&) noexcept = delete;
+private:
+    class PacketReorderBufferImpl;
+    std::unique_ptr<PacketReorderBufferImpl> pImpl;
+};
+
+}
+#endif
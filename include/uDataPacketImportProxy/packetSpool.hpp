@@ -0,0 +1,119 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_PACKET_SPOOL_HPP
+#define UDATA_PACKET_IMPORT_PROXY_PACKET_SPOOL_HPP
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+namespace UDataPacketImportAPI::V1
+{
+ class Packet;
+}
+namespace UDataPacketImportProxy
+{
+
+/// @class PacketSpoolOptions packetSpool.hpp
+/// @brief Defines the on-disk overflow spool.
+/// @copyright Ben Baker (University of Utah) distributed under the MIT NO AI
+///            license.
+class PacketSpoolOptions
+{
+public:
+    /// @brief Constructor.
+    PacketSpoolOptions();
+    /// @brief Copy constructor.
+    PacketSpoolOptions(const PacketSpoolOptions &options);
+    /// @brief Move constructor.
+    PacketSpoolOptions(PacketSpoolOptions &&options) noexcept;
+
+    /// @brief Sets the directory to which the spool segments are written.
+    /// @param[in] directory  The spool directory.  This will be created if
+    ///                       it does not exist.
+    /// @throws std::invalid_argument if the directory is empty.
+    void setDirectory(const std::filesystem::path &directory);
+    /// @result The spool directory.
+    /// @throws std::runtime_error if the directory was not set.
+    [[nodiscard]] std::filesystem::path getDirectory() const;
+    /// @result True indicates the directory was set.
+    [[nodiscard]] bool haveDirectory() const noexcept;
+
+    /// @brief Sets the size of an individual segment file.  Once a segment
+    ///        reaches this size a new segment is started.
+    /// @throws std::invalid_argument if this is not positive.
+    void setSegmentSizeInBytes(int64_t segmentSize);
+    /// @result The segment size in bytes.
+    /// @note By default this is 16 MB.
+    [[nodiscard]] int64_t getSegmentSizeInBytes() const noexcept;
+
+    /// @brief Sets the maximum size of the spool on disk.  Packets that
+    ///        would exceed this cap are refused.  The proxy drops a refused
+    ///        packet, rather than letting it overtake the spooled packets,
+    ///        and counts it as a spool overflow.
+    /// @throws std::invalid_argument if this is not positive.
+    void setMaximumSizeInBytes(int64_t maximumSize);
+    /// @result The maximum spool size in bytes.
+    /// @note By default this is 1 GB.
+    [[nodiscard]] int64_t getMaximumSizeInBytes() const noexcept;
+
+    /// @brief Destructor.
+    ~PacketSpoolOptions();
+    /// @brief Copy assignment.
+    PacketSpoolOptions& operator=(const PacketSpoolOptions &options);
+    /// @brief Move assignment.
+    PacketSpoolOptions& operator=(PacketSpoolOptions &&options) noexcept;
+private:
+    class PacketSpoolOptionsImpl;
+    std::unique_ptr<PacketSpoolOptionsImpl> pImpl;
+};
+
+/// @class PacketSpool packetSpool.hpp
+/// @brief An append-only, segmented, on-disk FIFO of packets.  When the
+///        proxy's import queue is full packets are spooled here and drained
+///        by the propagator once it catches up.  Segments are written with
+///        pwrite.  Full segments are read back through mmap while the
+///        segment being written is read in place with pread.  The read
+///        position is persisted next to the segment being read so that
+///        segments left over from a previous run are recovered on
+///        construction without replaying the packets already read.
+/// @note This is thread safe.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+class PacketSpool
+{
+public:
+    /// @brief Opens the spool.
+    /// @throws std::invalid_argument if the spool directory is not set.
+    /// @throws std::runtime_error if the directory cannot be created.
+    explicit PacketSpool(const PacketSpoolOptions &options);
+
+    /// @brief Appends the packet to the spool.
+    /// @result True indicates the packet was spooled.  False indicates the
+    ///         spool is at capacity.
+    /// @throws std::runtime_error if the packet could not be written.
+    [[nodiscard]] bool push(const UDataPacketImportAPI::V1::Packet &packet);
+    /// @result The oldest packet in the spool or std::nullopt if the spool
+    ///         is empty.
+    /// @throws std::runtime_error if a segment could not be mapped.
+    [[nodiscard]] std::optional<UDataPacketImportAPI::V1::Packet> pop();
+
+    /// @result True indicates there are no packets in the spool.
+    [[nodiscard]] bool empty() const noexcept;
+    /// @result The number of packets in the spool.
+    [[nodiscard]] int64_t getNumberOfPackets() const noexcept;
+    /// @result The number of bytes the spool occupies on disk.
+    [[nodiscard]] int64_t getSizeInBytes() const noexcept;
+
+    /// @brief Destructor.  Unread segments remain on disk.
+    ~PacketSpool();
+
+    PacketSpool() = delete;
+    PacketSpool(const PacketSpool &) = delete;
+    PacketSpool(PacketSpool &&) noexcept = delete;
+    PacketSpool& operator=(const PacketSpool &) = delete;
+    PacketSpool& operator=(PacketSpool &&) noexcept = delete;
+private:
+    class PacketSpoolImpl;
+    std::unique_ptr<PacketSpoolImpl> pImpl;
+};
+
+}
+#endif
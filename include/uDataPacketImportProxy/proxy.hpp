@@ -5,6 +5,14 @@
 #include <memory>
 #include <spdlog/spdlog.h>
 import metrics;
+namespace UDataPacketImportAPI::V1
+{
+ class Packet;
+}
+namespace grpc
+{
+ class Channel;
+}
 namespace UDataPacketImportProxy
 {
  class ProxyOptions;
@@ -31,6 +39,20 @@ public:
     [[nodiscard]] int getNumberOfPublishers() const noexcept;
     /// @reuslt The number of backend subscribers. 
     [[nodiscard]] int getNumberOfSubscribers() const noexcept;
+
+    /// @brief Adds a packet to the proxy as if the frontend had read it.
+    ///        This bypasses gRPC and the frontend's validation so the
+    ///        packet's stream identifier must already be normalized.  This
+    ///        is for measuring the cost of the proxy's pipeline.
+    /// @throws std::runtime_error if the proxy was not started.
+    void enqueuePacket(UDataPacketImportAPI::V1::Packet &&packet);
+    /// @result A channel to the frontend that bypasses the network.
+    /// @throws std::runtime_error if the proxy was not started.
+    [[nodiscard]] std::shared_ptr<grpc::Channel> createFrontendInProcessChannel() const;
+    /// @result A channel to the backend that bypasses the network.
+    /// @throws std::runtime_error if the proxy was not started.
+    [[nodiscard]] std::shared_ptr<grpc::Channel> createBackendInProcessChannel() const;
+
     /// @brief Destructor.
     ~Proxy();
 
@@ -7,6 +7,11 @@ namespace UDataPacketImportProxy
  class BackendOptions;
  class FrontendOptions;
  class DuplicatePacketDetectorOptions;
+ class PacketSpoolOptions;
+ class PacketJournalOptions;
+ class PacketReorderBufferOptions;
+ class PacketCoalescerOptions;
+ class PacketCaptureOptions;
 }
 namespace UDataPacketImportProxy
 {
@@ -38,6 +43,42 @@ public:
     /// @result The duplicate packet detector options.
     [[nodiscard]] std::optional<DuplicatePacketDetectorOptions> getDuplicatePacketDetectorOptions() const noexcept;
 
+    /// @brief Sets the overflow spool options.  When the internal queue is
+    ///        full packets are spooled to disk instead of being dropped.
+    /// @throws std::invalid_argument if the spool directory is not set.
+    void setPacketSpoolOptions(const PacketSpoolOptions &options);
+    /// @result The overflow spool options.
+    [[nodiscard]] std::optional<PacketSpoolOptions> getPacketSpoolOptions() const noexcept;
+
+    /// @brief Sets the packet journal options.  Accepted packets are recorded
+    ///        in a memory-mapped journal and any packets not yet forwarded
+    ///        to the backend are replayed after a restart.
+    /// @throws std::invalid_argument if the journal file name is not set.
+    void setPacketJournalOptions(const PacketJournalOptions &options);
+    /// @result The packet journal options.
+    [[nodiscard]] std::optional<PacketJournalOptions> getPacketJournalOptions() const noexcept;
+
+    /// @brief Sets the reorder buffer options.  Packets that pass the
+    ///        duplicate detector are held briefly so that each stream is
+    ///        forwarded to the backend in start time order.
+    void setPacketReorderBufferOptions(const PacketReorderBufferOptions &options);
+    /// @result The reorder buffer options.
+    [[nodiscard]] std::optional<PacketReorderBufferOptions> getPacketReorderBufferOptions() const noexcept;
+
+    /// @brief Sets the coalescer options.  Small, time-contiguous packets
+    ///        are merged into larger packets before they reach the backend.
+    void setPacketCoalescerOptions(const PacketCoalescerOptions &options);
+    /// @result The coalescer options.
+    [[nodiscard]] std::optional<PacketCoalescerOptions> getPacketCoalescerOptions() const noexcept;
+
+    /// @brief Sets the capture options.  Every accepted packet is recorded,
+    ///        along with its receive time, so that the traffic can later be
+    ///        replayed against another proxy.
+    /// @throws std::invalid_argument if the capture directory is not set.
+    void setPacketCaptureOptions(const PacketCaptureOptions &options);
+    /// @result The capture options.
+    [[nodiscard]] std::optional<PacketCaptureOptions> getPacketCaptureOptions() const noexcept;
+
     /// @brief Destructor.
     ~ProxyOptions();
     /// @brief Copy constructor.
@@ -0,0 +1,450 @@
+#!/usr/bin/env python3
+"""
+Runs the proxy's micro-benchmarks and a load generator run against a local
+proxy, compares the throughput and latencies to a baseline, and exits with a
+non-zero status if anything got significantly slower.
+
+Every run uses fixed seeds and is pinned to fixed CPUs.  The proxy and the
+load generator are pinned to disjoint CPUs so they do not compete.  Each
+measurement is repeated and the median is compared.  A change only counts
+as a regression if it exceeds both a minimum tolerance and a multiple of the
+noise measured in the baseline and the current run.
+
+Usage, from the build directory:
+
+    python3 ../scripts/benchmarkGate.py --build-directory . \\
+        --baseline ../testing/benchmarkBaseline.json
+
+After an intentional performance change, or on a new reference machine,
+rewrite the baseline with --update-baseline and commit it.
+
+Exit status:
+    0  No significant regressions, or the baseline has no metrics yet
+       (bootstrap mode; the measurements are printed and nothing is
+       compared).  Pass --require-baseline to fail in that case.
+    1  A significant regression, a baseline metric that was not measured,
+       or an empty baseline with --require-baseline.
+"""
+import argparse
+import json
+import os
+import platform
+import signal
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+import xml.etree.ElementTree as ElementTree
+
+# The settings that must match for two runs to be comparable.  A baseline's
+# configuration is used unless it is overridden on the command line.
+DEFAULT_CONFIGURATION = {
+    "repetitions": 3,
+    "benchmarkSamples": 100,
+    "benchmarkSeed": 23,
+    "loadSeed": 86753,
+    "loadDurationInSeconds": 30,
+    "loadPublishers": 8,
+    "loadStreamsPerPublisher": 100,
+    "loadSubscribers": 2,
+    "loadPacketDurationInSeconds": 0.1,
+}
+
+# Minimum relative changes that count as a regression
+DEFAULT_TOLERANCES = {
+    "micro": 0.10,
+    "throughput": 0.05,
+    "latency": 0.25,
+    # The lost fraction of the published packets may grow by this much
+    "loss": 0.001,
+}
+# Latency changes smaller than this many milliseconds are ignored
+LATENCY_SLACK_MS = 0.1
+# A change must also exceed this many combined noise estimates
+NOISE_MULTIPLIER = 3
+
+
+def get_machine():
+    """Identifies the machine since numbers from different machines are
+    not comparable."""
+    model = platform.processor()
+    try:
+        with open("/proc/cpuinfo", encoding="utf-8") as cpu_info:
+            for line in cpu_info:
+                if line.startswith("model name"):
+                    model = line.split(":", 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    return {
+        "cpu": model,
+        "cpus": os.cpu_count(),
+        "system": platform.system() + " " + platform.release(),
+    }
+
+
+def get_governor():
+    path = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"
+    try:
+        with open(path, encoding="utf-8") as governor:
+            return governor.read().strip()
+    except OSError:
+        return None
+
+
+def split_cpus():
+    """Gives the proxy the first half of the available CPUs and the clients
+    the second half.  With fewer than 4 CPUs nothing is pinned."""
+    cpus = sorted(os.sched_getaffinity(0))
+    if len(cpus) < 4:
+        return None, None
+    half = len(cpus)//2
+    return set(cpus[:half]), set(cpus[half:])
+
+
+def pin(cpus):
+    if cpus is None:
+        return None
+    return lambda: os.sched_setaffinity(0, cpus)
+
+
+def get_free_port():
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def wait_for_port(port, process, time_out=30):
+    deadline = time.monotonic() + time_out
+    while time.monotonic() < deadline:
+        if process.poll() is not None:
+            raise RuntimeError("Proxy exited with status "
+                               + str(process.returncode))
+        try:
+            with socket.create_connection(("127.0.0.1", port), timeout=1):
+                return
+        except OSError:
+            time.sleep(0.1)
+    raise RuntimeError("Proxy did not open port " + str(port))
+
+
+def summarize(values):
+    """@result The median and the relative half-spread of the values"""
+    median = statistics.median(values)
+    if median == 0 or len(values) < 2:
+        return median, 0.0
+    return median, (max(values) - min(values))/(2*abs(median))
+
+
+def run_micro_benchmarks(executable, configuration, cpus, work_directory):
+    """Runs the Catch2 benchmarks.  The XML reporter is used because, unlike
+    the JSON reporter, it records the benchmark results."""
+    runs = {}
+    cpu = None if cpus is None else {min(cpus)}
+    for repetition in range(configuration["repetitions"]):
+        output = os.path.join(work_directory,
+                              f"proxyBenchmarks.{repetition}.xml")
+        subprocess.run([executable,
+                        "--reporter", "XML::out=" + output,
+                        "--rng-seed", str(configuration["benchmarkSeed"]),
+                        "--benchmark-samples",
+                        str(configuration["benchmarkSamples"])],
+                       check=True,
+                       stdout=subprocess.DEVNULL,
+                       preexec_fn=pin(cpu))
+        for name, mean, noise in parse_benchmarks(output):
+            runs.setdefault(name, []).append((mean, noise))
+    metrics = {}
+    for name, results in runs.items():
+        value, spread = summarize([mean for mean, _ in results])
+        confidence = statistics.median([noise for _, noise in results])
+        metrics["micro/" + name] = {
+            "value": value,
+            "noise": max(spread, confidence),
+            "unit": "ns",
+            "kind": "micro",
+            "better": "lower",
+        }
+    return metrics
+
+
+def parse_benchmarks(file_name):
+    """@result The name, mean in nanoseconds, and relative half-width of the
+    mean's confidence interval of each benchmark"""
+    results = []
+    names = set()
+
+    def visit(element, path):
+        if element.tag in ("TestCase", "Section"):
+            path = path + [element.get("name", "")]
+        if element.tag == "BenchmarkResults":
+            mean = element.find("mean")
+            if mean is None:
+                return
+            value = float(mean.get("value"))
+            lower = float(mean.get("lowerBound", value))
+            upper = float(mean.get("upperBound", value))
+            noise = (upper - lower)/(2*value) if value > 0 else 0
+            name = " / ".join(path + [element.get("name", "")])
+            unique_name = name
+            copy = 1
+            while unique_name in names:
+                copy = copy + 1
+                unique_name = f"{name} #{copy}"
+            names.add(unique_name)
+            results.append((unique_name, value, noise))
+            return
+        for child in element:
+            visit(child, path)
+
+    visit(ElementTree.parse(file_name).getroot(), [])
+    return results
+
+
+def run_load(build_directory, configuration, proxy_cpus, client_cpus,
+             work_directory):
+    """Starts a proxy on localhost and runs the load generator against it"""
+    proxy = os.path.join(build_directory, "uDataPacketImportProxy")
+    generator = os.path.join(build_directory, "uDataPacketImportLoadGenerator")
+    runs = []
+    for repetition in range(configuration["repetitions"]):
+        frontend_port = get_free_port()
+        backend_port = get_free_port()
+        ini_file = os.path.join(work_directory, "proxy.ini")
+        with open(ini_file, "w", encoding="utf-8") as ini:
+            ini.write(f"""[General]
+verbosity = 1
+
+[Frontend]
+host = 127.0.0.1
+port = {frontend_port}
+
+[Backend]
+host = 127.0.0.1
+port = {backend_port}
+""")
+        output = os.path.join(work_directory, f"load.{repetition}.json")
+        log_file_name = os.path.join(work_directory,
+                                     f"proxy.{repetition}.log")
+        with open(log_file_name, "w", encoding="utf-8") as log:
+            process = subprocess.Popen([proxy, "--ini", ini_file],
+                                       stdout=log,
+                                       stderr=subprocess.STDOUT,
+                                       preexec_fn=pin(proxy_cpus))
+            try:
+                wait_for_port(frontend_port, process)
+                wait_for_port(backend_port, process)
+                subprocess.run(
+                    [generator,
+                     "--frontend", f"127.0.0.1:{frontend_port}",
+                     "--backend", f"127.0.0.1:{backend_port}",
+                     "--publishers", str(configuration["loadPublishers"]),
+                     "--streams",
+                     str(configuration["loadStreamsPerPublisher"]),
+                     "--subscribers", str(configuration["loadSubscribers"]),
+                     "--duration",
+                     str(configuration["loadDurationInSeconds"]),
+                     "--packet-duration",
+                     str(configuration["loadPacketDurationInSeconds"]),
+                     "--seed", str(configuration["loadSeed"]),
+                     "--output", output],
+                    check=True,
+                    stdout=subprocess.DEVNULL,
+                    preexec_fn=pin(client_cpus))
+            finally:
+                process.send_signal(signal.SIGTERM)
+                try:
+                    process.wait(timeout=30)
+                except subprocess.TimeoutExpired:
+                    process.kill()
+                    process.wait()
+        with open(output, encoding="utf-8") as summary:
+            runs.append(json.load(summary))
+
+    metrics = {}
+    throughput, noise = summarize([run["deliveredPacketsPerSecond"]
+                                   for run in runs])
+    metrics["load/delivered packets per second"] = {
+        "value": throughput, "noise": noise, "unit": "packets/s",
+        "kind": "throughput", "better": "higher"}
+    for percentile in ("p50", "p99"):
+        latency, noise = summarize([run["latencyInMilliSeconds"][percentile]
+                                    for run in runs])
+        metrics[f"load/{percentile} latency"] = {
+            "value": latency, "noise": noise, "unit": "ms",
+            "kind": "latency", "better": "lower"}
+    # A packet or two lost to a scheduling hiccup is not a regression so
+    # the loss is compared as a fraction of the packets published
+    lost, noise = summarize([run["packetsLost"]/max(run["packetsPublished"], 1)
+                             for run in runs])
+    metrics["load/lost packet fraction"] = {
+        "value": lost, "noise": noise, "unit": "",
+        "kind": "loss", "better": "lower"}
+    return metrics
+
+
+def compare(name, baseline, current, tolerances):
+    """@result A description of the change and whether it is a
+    significant regression"""
+    base = baseline["value"]
+    value = current["value"]
+    kind = current["kind"]
+    if kind == "loss":
+        threshold = tolerances.get("loss", DEFAULT_TOLERANCES["loss"])
+        regressed = value - base > threshold
+        return (f"{base:.3g} -> {value:.3g} (threshold +{threshold:g})",
+                regressed)
+    if base == 0:
+        return f"{base:g} -> {value:g}", False
+    change = (value - base)/base
+    worse = -change if current["better"] == "higher" else change
+    noise = (baseline.get("noise", 0.0)**2 + current["noise"]**2)**0.5
+    threshold = max(tolerances[kind], NOISE_MULTIPLIER*noise)
+    regressed = worse > threshold
+    if kind == "latency" and value - base <= LATENCY_SLACK_MS:
+        regressed = False
+    description = (f"{base:.4g} -> {value:.4g} {current['unit']} "
+                   f"({100*change:+.1f}%, threshold {100*threshold:.1f}%)")
+    return description, regressed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0],
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--build-directory", default=".",
+                        help="The directory with the proxy, proxyBenchmarks, "
+                             "and uDataPacketImportLoadGenerator")
+    parser.add_argument("--baseline", required=True,
+                        help="The baseline JSON file")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="Write this run's results to the baseline")
+    parser.add_argument("--output", default="benchmarkGate.json",
+                        help="Where to write this run's results")
+    parser.add_argument("--require-baseline", action="store_true",
+                        help="Fail, rather than only measure, when the "
+                             "baseline has no metrics")
+    parser.add_argument("--skip-micro", action="store_true",
+                        help="Do not run the micro-benchmarks")
+    parser.add_argument("--skip-load", action="store_true",
+                        help="Do not run the load generator")
+    for key, value in DEFAULT_CONFIGURATION.items():
+        parser.add_argument("--" + key, type=type(value), default=None,
+                            help=f"Overrides the baseline's {key} "
+                                 f"(default {value})")
+    arguments = parser.parse_args()
+
+    baseline = {"configuration": {}, "metrics": {}}
+    if os.path.exists(arguments.baseline):
+        with open(arguments.baseline, encoding="utf-8") as baseline_file:
+            baseline = json.load(baseline_file)
+    configuration = dict(DEFAULT_CONFIGURATION)
+    configuration.update(baseline.get("configuration", {}))
+    overridden = False
+    for key in DEFAULT_CONFIGURATION:
+        value = getattr(arguments, key)
+        if value is not None:
+            overridden = overridden or value != configuration[key]
+            configuration[key] = value
+    tolerances = dict(DEFAULT_TOLERANCES)
+    tolerances.update(baseline.get("tolerances", {}))
+    # A gate with nothing to compare against only measures
+    bootstrap = not arguments.update_baseline and not baseline.get("metrics")
+    if bootstrap and arguments.require_baseline:
+        print(f"{arguments.baseline} has no metrics; record them on the "
+              "reference machine with --update-baseline", file=sys.stderr)
+        return 1
+
+    machine = get_machine()
+    if baseline.get("machine") and baseline["machine"] != machine:
+        print("Warning: the baseline was recorded on " +
+              json.dumps(baseline["machine"]) + " not " + json.dumps(machine))
+    if overridden and baseline.get("metrics"):
+        print("Warning: the configuration differs from the baseline's")
+    governor = get_governor()
+    if governor is not None and governor != "performance":
+        print(f"Warning: the CPU frequency governor is {governor}; "
+              "results will be noisier than with performance")
+    proxy_cpus, client_cpus = split_cpus()
+    if proxy_cpus is None:
+        print("Warning: fewer than 4 CPUs so nothing is pinned")
+    else:
+        print(f"Pinning the proxy to CPUs {sorted(proxy_cpus)} and the "
+              f"clients to CPUs {sorted(client_cpus)}")
+
+    metrics = {}
+    with tempfile.TemporaryDirectory(prefix="benchmarkGate.") as work_directory:
+        if not arguments.skip_micro:
+            print("Running the micro-benchmarks")
+            metrics.update(run_micro_benchmarks(
+                os.path.join(arguments.build_directory, "proxyBenchmarks"),
+                configuration, client_cpus, work_directory))
+        if not arguments.skip_load:
+            print("Running the load generator")
+            metrics.update(run_load(arguments.build_directory, configuration,
+                                    proxy_cpus, client_cpus, work_directory))
+
+    results = {"machine": machine,
+               "configuration": configuration,
+               "tolerances": tolerances,
+               "metrics": metrics}
+    with open(arguments.output, "w", encoding="utf-8") as output:
+        json.dump(results, output, indent=2, sort_keys=True)
+        output.write("\n")
+    if arguments.update_baseline:
+        # Keep the baseline's metrics that were skipped this time
+        updated = dict(results)
+        updated["metrics"] = dict(baseline.get("metrics", {}))
+        updated["metrics"].update(metrics)
+        with open(arguments.baseline, "w", encoding="utf-8") as output:
+            json.dump(updated, output, indent=2, sort_keys=True)
+            output.write("\n")
+        print(f"Wrote {len(metrics)} metrics to {arguments.baseline}")
+        return 0
+    if bootstrap:
+        for name in sorted(metrics):
+            print(f"  measured   {name}: {metrics[name]['value']:.4g} "
+                  f"{metrics[name]['unit']}")
+        print(f"Bootstrap: {arguments.baseline} has no metrics so nothing "
+              "was compared.  Record a baseline on the reference machine "
+              "with --update-baseline (make updateBenchmarkBaseline) and "
+              "commit it.")
+        return 0
+
+    regressions = []
+    for name in sorted(metrics):
+        if name not in baseline.get("metrics", {}):
+            print(f"  new        {name}: {metrics[name]['value']:.4g} "
+                  f"{metrics[name]['unit']}")
+            continue
+        description, regressed = compare(name, baseline["metrics"][name],
+                                         metrics[name], tolerances)
+        print(f"  {'REGRESSED' if regressed else 'ok':10} {name}: "
+              f"{description}")
+        if regressed:
+            regressions.append(name)
+    skipped = []
+    if arguments.skip_micro:
+        skipped.append("micro/")
+    if arguments.skip_load:
+        skipped.append("load/")
+    # A benchmark that stops reporting must not pass silently
+    missing = []
+    for name in sorted(set(baseline.get("metrics", {})) - set(metrics)):
+        if not name.startswith(tuple(skipped)):
+            print(f"  MISSING    {name}")
+            missing.append(name)
+    if missing:
+        print(f"{len(missing)} baseline metric(s) were not measured; "
+              "update the baseline if they were removed on purpose")
+    if regressions:
+        print(f"{len(regressions)} significant regression(s)")
+    if regressions or missing:
+        return 1
+    print("No significant regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+"""
+Converts the results of a proxyBenchmarks run from Catch2's XML reporter to
+JSON.  Catch2's JSON reporter does not record benchmark results so the
+benchmarks are run with the XML reporter and converted.
+
+Usage:
+
+    python3 convertBenchmarks.py proxyBenchmarks.xml proxyBenchmarks.json
+"""
+import argparse
+import json
+import sys
+
+from benchmarkGate import parse_benchmarks
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("xml", help="The XML reporter's output")
+    parser.add_argument("json", help="The JSON file to write")
+    arguments = parser.parse_args()
+
+    benchmarks = [{"name": name,
+                   "meanInNanoSeconds": mean,
+                   "relativeNoise": noise}
+                  for name, mean, noise in parse_benchmarks(arguments.xml)]
+    if not benchmarks:
+        print(f"{arguments.xml} has no benchmark results", file=sys.stderr)
+        return 1
+    with open(arguments.json, "w", encoding="utf-8") as output:
+        json.dump({"benchmarks": benchmarks}, output, indent=2)
+        output.write("\n")
+    print(f"Wrote {len(benchmarks)} benchmarks to {arguments.json}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
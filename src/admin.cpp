@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/support/status.h>
+#include <grpcpp/support/status_code_enum.h>
+#include <grpcpp/support/time.h> //NOLINT
+#include <google/protobuf/util/time_util.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/logger.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include "uDataPacketImportProxy/admin.hpp"
+#include "uDataPacketImportProxy/grpcOptions.hpp"
+#include "uDataPacketImportAPI/v1/admin.pb.h"
+#include "uDataPacketImportAPI/v1/admin.grpc.pb.h"
+#include "serverTuning.hpp"
+import metrics;
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+[[nodiscard]]
+bool validateOperator(const grpc::CallbackServerContext *context,
+                      const std::string &accessToken)
+{
+    if (accessToken.empty()){return true;}
+    for (const auto &item : context->client_metadata())
+    {
+        if (item.first == "x-custom-auth-token")
+        {
+            if (item.second == accessToken)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+}
+
+class Admin::AdminImpl :
+    public UDataPacketImportAPI::V1::Admin::CallbackService
+{
+public:
+    AdminImpl(const GRPCOptions &options,
+              std::shared_ptr<spdlog::logger> logger) :
+        mOptions(options),
+        mLogger(std::move(logger))
+    {
+        if (mLogger == nullptr)
+        {
+            mLogger = spdlog::stdout_color_mt("ProxyAdminConsole");
+        }
+    }
+
+    void stop()
+    {
+        mKeepRunning.store(false);
+    }
+
+    void start()
+    {
+        mKeepRunning.store(true);
+        auto address = makeAddress(mOptions);
+        grpc::ServerBuilder builder;
+        applyServerTuning(mOptions, "admin", &builder);
+        if (mOptions.getServerKey() == std::nullopt ||
+            mOptions.getServerCertificate() == std::nullopt)
+        {
+            SPDLOG_LOGGER_INFO(mLogger, "Initiating non-secured proxy admin");
+            builder.AddListeningPort(address,
+                                     grpc::InsecureServerCredentials());
+            builder.RegisterService(this);
+            mSecured = false;
+        }
+        else
+        {
+            SPDLOG_LOGGER_INFO(mLogger, "Initiating secured proxy admin");
+            // NOLINTBEGIN
+            const grpc::SslServerCredentialsOptions::PemKeyCertPair
+            keyCertPair
+            {
+                *mOptions.getServerKey(),        // Private key
+                *mOptions.getServerCertificate() // Public key (cert chain)
+            };
+            // NOLINTEND
+            grpc::SslServerCredentialsOptions sslOptions;
+            sslOptions.pem_key_cert_pairs.emplace_back(keyCertPair);
+            builder.AddListeningPort(address,
+                                     grpc::SslServerCredentials(sslOptions));
+            builder.RegisterService(this);
+            mSecured = true;
+        }
+        SPDLOG_LOGGER_INFO(mLogger, "Admin listening at {}", address);
+        mServer = builder.BuildAndStart();
+    }
+
+    grpc::ServerUnaryReactor *GetPipelineState(
+        grpc::CallbackServerContext *context,
+        const UDataPacketImportAPI::V1::PipelineStateRequest *request,
+        UDataPacketImportAPI::V1::PipelineState *response) override
+    {
+        auto reactor = context->DefaultReactor();
+        auto accessToken = mOptions.getAccessToken();
+        if (mSecured && accessToken != std::nullopt)
+        {
+            if (!::validateOperator(context, *accessToken))
+            {
+                SPDLOG_LOGGER_INFO(mLogger, "Admin rejected {}",
+                                   context->peer());
+                reactor->Finish(
+                    grpc::Status{grpc::StatusCode::UNAUTHENTICATED,
+                   "Operator must provide access token in x-custom-auth-token header field"});
+                return reactor;
+            }
+        }
+        if (!mKeepRunning.load())
+        {
+            reactor->Finish(
+                grpc::Status{grpc::StatusCode::UNAVAILABLE,
+                             "Admin service is shutting down"});
+            return reactor;
+        }
+        constexpr int maximumNumberOfStreams{1000};
+        const auto nStreams
+            = std::clamp(request->maximum_number_of_streams(),
+                         0, maximumNumberOfStreams);
+        *response = makePipelineState(nStreams);
+        reactor->Finish(grpc::Status::OK);
+        return reactor;
+    }
+
+    ~AdminImpl() override
+    {
+        stop();
+        if (mServer)
+        {
+            SPDLOG_LOGGER_INFO(mLogger, "Shutting down admin service");
+            constexpr std::chrono::seconds shutdownDeadline{1};
+            const gpr_timespec deadline // NOLINT
+            {
+                shutdownDeadline.count(),
+                0,
+                GPR_TIMESPAN // NOLINT
+            };
+            mServer->Shutdown(deadline);
+        }
+    }
+
+    GRPCOptions mOptions;
+    std::shared_ptr<spdlog::logger> mLogger{nullptr};
+    std::unique_ptr<grpc::Server> mServer{nullptr};
+    std::atomic<bool> mKeepRunning{false};
+    bool mSecured{false};
+};
+
+/// Constructor
+Admin::Admin(const GRPCOptions &options,
+             std::shared_ptr<spdlog::logger> logger) :
+    pImpl(std::make_unique<AdminImpl> (options, std::move(logger)))
+{
+}
+
+/// Destructor
+Admin::~Admin() = default;
+
+/// Start
+void Admin::start()
+{
+    pImpl->start();
+}
+
+/// Stop
+void Admin::stop()
+{
+    pImpl->stop();
+}
+
+/// Running?
+bool Admin::isRunning() const noexcept
+{
+    return pImpl->mKeepRunning.load();
+}
+
+/// Snapshot of the pipeline.  Everything here is an atomic load except
+/// for copying the publisher and subscriber registries, which are only
+/// modified when an RPC starts or finishes, and sampling the publishers'
+/// rates, which only the admin service does.
+UDataPacketImportAPI::V1::PipelineState
+UDataPacketImportProxy::makePipelineState(const int maximumNumberOfStreams)
+{
+    namespace UMetrics = UDataPacketImportProxy::Metrics;
+    auto &metrics = UMetrics::MetricsSingleton::getInstance();
+    UDataPacketImportAPI::V1::PipelineState state;
+    const auto now = std::chrono::steady_clock::now();
+    *state.mutable_time()
+        = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(
+             std::chrono::duration_cast<std::chrono::microseconds>
+             (std::chrono::system_clock::now().time_since_epoch()).count());
+    state.set_packets_received(metrics.getReceivedPacketsCount());
+    state.set_packets_sent(metrics.getSentPacketsCount());
+
+    for (const auto &statistics : metrics.getPublisherStatistics())
+    {
+        auto publisher = state.add_publishers();
+        const auto connectedSeconds
+            = std::max(0.0,
+                       std::chrono::duration<double>
+                       (now - statistics->getConnectTime()).count());
+        const auto nReceived = statistics->getReceivedPacketsCount();
+        publisher->set_name(statistics->getName());
+        publisher->set_connected_seconds(connectedSeconds);
+        publisher->set_packets_received(static_cast<uint64_t> (nReceived));
+        publisher->set_packets_rejected(
+            static_cast<uint64_t> (statistics->getRejectedPacketsCount()));
+        publisher->set_packets_per_second(
+            statistics->getPacketsPerSecond(now));
+    }
+
+    for (const auto &statistics : metrics.getSubscriberStatistics())
+    {
+        auto subscriber = state.add_subscribers();
+        subscriber->set_name(statistics->getName());
+        subscriber->set_queue_depth(statistics->getQueueDepth());
+        subscriber->set_lag_seconds(statistics->getLag());
+        subscriber->set_packets_sent(statistics->getSentPacketsCount());
+        subscriber->set_packets_dropped(statistics->getDroppedPacketsCount());
+    }
+
+    for (int i = 0; i < UMetrics::NumberOfQueueTypes; ++i)
+    {
+        const auto queueType = static_cast<UMetrics::QueueType> (i);
+        const auto &queueDepth = metrics.getQueueDepth(queueType);
+        auto queue = state.add_queues();
+        queue->set_name(UMetrics::toString(queueType));
+        queue->set_depth(queueDepth.getDepth());
+        queue->set_high_water_mark(queueDepth.getHighWaterMark());
+    }
+
+    for (int i = 0; i < UMetrics::NumberOfDropReasons; ++i)
+    {
+        const auto reason = static_cast<UMetrics::DropReason> (i);
+        auto drop = state.add_drops();
+        drop->set_reason(UMetrics::toString(reason));
+        drop->set_packets_dropped(metrics.getDroppedPacketsCount(reason));
+    }
+
+    state.set_number_of_deduplicated_streams(
+        metrics.getNumberOfDeduplicatedStreams());
+
+    for (auto &[name, nPackets] :
+         metrics.getStreamTable().getBusiestStreams(maximumNumberOfStreams))
+    {
+        auto stream = state.add_busiest_streams();
+        stream->set_name(std::move(name));
+        stream->set_packets_received(nPackets);
+    }
+    return state;
+}
@@ -6,7 +6,6 @@
 #include <chrono>
 #include <algorithm>
 #include <exception>
-#include <map>
 #include <memory>
 #include <utility>
 #include <cmath>
@@ -28,13 +27,18 @@
 #include <spdlog/spdlog.h>
 #include <spdlog/logger.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
-#include <tbb/concurrent_queue.h>
 #include "uDataPacketImportProxy/backend.hpp"
 #include "uDataPacketImportProxy/backendOptions.hpp"
 #include "uDataPacketImportProxy/grpcOptions.hpp"
 #include "uDataPacketImportAPI/v1/packet.pb.h"
 #include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
 #include "uDataPacketImportAPI/v1/backend.grpc.pb.h"
+#include "flightRecorder.hpp"
+#include "pollBackoff.hpp"
+#include "rateLimitedLog.hpp"
+#include "serverTuning.hpp"
+#include "subscriptionManager.hpp"
+#include "tracing.hpp"
 //#include "metrics.hpp"
 import metrics;
 
@@ -61,270 +65,6 @@ bool validateSubscriber(const grpc::CallbackServerContext *context,
     return false;
 }
 
-class PacketStream
-{
-public:
-    PacketStream(const int queueCapacity,
-                 std::shared_ptr<spdlog::logger> logger) :
-        mLogger(std::move(logger))
-    {
-        if (queueCapacity < 1)
-        {
-            throw std::invalid_argument("Queue capacity must be positive");
-        }
-        mQueueCapacity = queueCapacity;
-        mQueue.set_capacity(mQueueCapacity);
-    }
-    [[nodiscard]] int enqueuePacket(const UDataPacketImportAPI::V1::Packet &packet)
-    {
-        UDataPacketImportAPI::V1::Packet copy{packet};
-        return enqueuePacket(std::move(copy));
-    }
-    [[nodiscard]] int enqueuePacket(UDataPacketImportAPI::V1::Packet &&packet)
-    {
-        int packetsLost{0};
-        auto approximateSize = static_cast<int> (mQueue.size());
-        if (approximateSize >= mQueueCapacity)
-        {
-            //SPDLOG_LOGGER_WARN(mLogger, "Overfull outbound queue");
-            while (approximateSize >= mQueueCapacity)
-            {
-                UDataPacketImportAPI::V1::Packet workSpace;
-                if (!mQueue.try_pop(workSpace))
-                {
-                    SPDLOG_LOGGER_WARN(mLogger,
-                                       "Failed to pop element from stream queue");
-                    break;
-                }
-                packetsLost = packetsLost + 1; 
-                approximateSize = static_cast<int> (mQueue.size());
-            }
-        } 
-        // Try to add the packet
-        if (!mQueue.try_push(std::move(packet)))
-        {
-            SPDLOG_LOGGER_ERROR(mLogger,
-                                 "Failed to add packet to stream queue");
-        }
-        return packetsLost;
-    }
-    [[nodiscard]] std::optional<UDataPacketImportAPI::V1::Packet>
-        dequeuePacket()
-    {
-        std::optional<UDataPacketImportAPI::V1::Packet> result{std::nullopt};
-        UDataPacketImportAPI::V1::Packet packet;
-        if (mQueue.try_pop(packet))
-        {
-            result
-               = std::make_optional<UDataPacketImportAPI::V1::Packet>
-                 (std::move(packet));
-        }
-        return result; 
-    }
-    std::shared_ptr<spdlog::logger> mLogger{nullptr};
-    oneapi::tbb::concurrent_bounded_queue<UDataPacketImportAPI::V1::Packet> mQueue;
-    int mQueueCapacity{1024};
-};
-
-class SubscriptionManager
-{
-public:
-    SubscriptionManager(const int queueCapacity,
-                        std::shared_ptr<spdlog::logger> logger) :
-        mLogger(std::move(logger)),
-        mQueueCapacity(queueCapacity)
-    {
-        if (mLogger == nullptr)
-        {
-            mLogger = spdlog::stdout_color_mt("SubscriptionManagerConsole");
-        }
-    }
-
-    ~SubscriptionManager()
-    {
-        unsubscribeAll();
-    }
-
-    // Number of subscribers
-    [[nodiscard]] int getNumberOfSubscribers() const
-    {
-        const std::lock_guard<std::mutex> lock(mMutex);
-        return static_cast<int> (mSubscribers.size());
-    }
-
-    // Unsubscribes all
-    void unsubscribeAll()
-    {
-        mKeepRunning.store(false);
-        auto nSubscribers = getNumberOfSubscribers();
-        {
-        const std::lock_guard<std::mutex> lock(mMutex);
-        mSubscribers.clear();
-        }
-        if (nSubscribers > 0)
-        {
-            SPDLOG_LOGGER_INFO(mLogger,
-                               "Subscription manager purged {} subscribers",
-                               nSubscribers);
-        }
-    }
-
-    // Subscribe
-    void subscribe(uintptr_t contextAddress, const std::string &peer)
-    {
-        if (!mKeepRunning.load()){return;}
-        std::string errorMessage;
-        bool alreadyExists{true};
-        {
-        const std::lock_guard<std::mutex> lock(mMutex);
-        auto idx = mSubscribers.find(contextAddress);
-        // Add it
-        if (idx == mSubscribers.end())
-        {
-            alreadyExists = false;
-            auto packetStream
-                = std::make_unique<::PacketStream> (mQueueCapacity, mLogger);
-            std::pair<uintptr_t, std::unique_ptr<::PacketStream>>
-                newPacketStream{contextAddress, std::move(packetStream)};
-            try
-            {
-                mSubscribers.insert(std::move(newPacketStream));
-            }
-            catch (const std::exception &e)
-            {
-                errorMessage = "Failed to subscribe " + peer
-                             + " because "
-                             + std::string {e.what()}; 
-            }
-        }
-        }
-        if (!alreadyExists)
-        {
-            if (errorMessage.empty())
-            {
-                SPDLOG_LOGGER_INFO(mLogger, "Subscribed {} ({})",
-                                   peer, std::to_string (contextAddress));
-            }
-            else
-            {
-                throw std::runtime_error(errorMessage);
-            } 
-        }
-    }
-
-    // Unsubscribe
-    void unsubscribe(uintptr_t contextAddress, const std::string &peer)
-    {
-        if (!mKeepRunning.load()){return;}
-        const std::string errorMessage;
-        size_t nErased{0};
-        {
-        const std::lock_guard<std::mutex> lock(mMutex);
-        nErased = mSubscribers.erase(contextAddress) == 1 ? true : false;
-        }
-        auto exists = (nErased == 1) ? true : false;
-        if (!exists)
-        { 
-            SPDLOG_LOGGER_WARN(mLogger, "{} ({}) was not subscribed",
-                               peer,
-                               std::to_string(contextAddress));
-        }
-        else
-        {
-            if (!errorMessage.empty())
-            {
-                throw std::runtime_error(errorMessage);
-            }
-        }
-    }
-
-    /// Adds a packet
-    [[nodiscard]] int enqueuePacket(const UDataPacketImportAPI::V1::Packet &packet)
-    {
-        int nPacketsLost{0};
-        std::string errorMessages;
-        if (!mKeepRunning.load()){return nPacketsLost;}
-        {
-        const std::lock_guard<std::mutex> lock(mMutex);
-        for (auto &subscriber : mSubscribers)
-        {
-            try
-            {
-#ifndef NDEBUG
-                assert(subscriber.second != nullptr);
-#endif
-                nPacketsLost = nPacketsLost
-                             + subscriber.second->enqueuePacket(packet);
-            }
-            catch (const std::exception &e)
-            {
-                errorMessages.append(std::string {e.what()});
-                //SPDLOG_LOGGER_ERROR(mLogger,
-                //     "Subscription manager failed to enqueue packet because {}",
-                //     std::string {e.what()}); 
-            } 
-        }
-        }
-        if (!errorMessages.empty())
-        {
-            SPDLOG_LOGGER_ERROR(mLogger,
-               "Subscription manager failed to enqueue packet because {}",
-               errorMessages);
-        }
-        return nPacketsLost;
-    } 
-
-    // Get next batch of packets
-    [[nodiscard]] std::vector<UDataPacketImportAPI::V1::Packet> getNextPackets(
-        grpc::CallbackServerContext *context,
-        const int maxPackets)
-    {
-        std::vector<UDataPacketImportAPI::V1::Packet> result;
-        result.reserve(8);
-        if (!mKeepRunning.load()){return result;}
-        bool exists{false};
-        auto contextMemoryAddress = reinterpret_cast<uintptr_t> (context);
-        {   
-        const std::lock_guard<std::mutex> lock(mMutex);
-        auto idx = mSubscribers.find(contextMemoryAddress);
-        if (idx != mSubscribers.end())
-        {
-            exists = true;
-            for (int i = 0; i < maxPackets; ++i)
-            {
-                auto packet = idx->second->dequeuePacket();
-                if (packet)
-                {
-                    result.push_back(std::move(*packet));
-                }
-                else
-                {
-                    break;
-                }
-            }
-        }
-        else
-        {
-            exists = false;
-        }
-        }
-        if (!exists)
-        {
-            auto errorMessage = context->peer()
-                              + " was not found in subscriber map"; 
-            throw std::runtime_error(errorMessage);
-        }
-        return result;
-    }
-
-    mutable std::mutex mMutex;
-    std::shared_ptr<spdlog::logger> mLogger{nullptr};
-    //oneapi::tbb::concurrent_map<uintptr_t, std::unique_ptr<::PacketStream>> mSubscribers;
-    std::map<uintptr_t, std::unique_ptr<::PacketStream>> mSubscribers;
-    int mQueueCapacity{124};
-    std::atomic<bool> mKeepRunning{true};
-};
-
 class AsynchronousWriter :
     public grpc::ServerWriteReactor<UDataPacketImportAPI::V1::Packet>
 {
@@ -333,7 +73,7 @@ public:
         const BackendOptions &options,
         grpc::CallbackServerContext *context,
         const UDataPacketImportAPI::V1::SubscriptionRequest *request,
-        std::shared_ptr<::SubscriptionManager> subscriptionManager,
+        std::shared_ptr<SubscriptionManager> subscriptionManager,
         std::shared_ptr<spdlog::logger> logger,
         const bool isSecured,
         std::atomic<bool> *keepRunning) :
@@ -360,6 +100,8 @@ public:
             if (!::validateSubscriber(mContext, accessToken))
             {
                 SPDLOG_LOGGER_INFO(mLogger, "Backend rejected {}", mPeer);
+                mMetrics.incrementDroppedPacketsCounter(
+                    UDataPacketImportProxy::Metrics::DropReason::Unauthenticated);
                 const grpc::Status status{grpc::StatusCode::UNAUTHENTICATED,
 R"""(
 Subscriber must provide access token in x-custom-auth-token header field.
@@ -398,9 +140,14 @@ Subscriber must provide access token in x-custom-auth-token header field.
             SPDLOG_LOGGER_INFO(mLogger,
                                "Subscribing {} to all streams",
                                mPeer);
-            mSubscriptionManager->subscribe(mContextAddress, mPeer);
+            mStatistics = mMetrics.registerSubscriber(mPeer);
+            mSubscriptionManager->subscribe(mContextAddress, mPeer,
+                                            mStatistics);
             mSubscribed.store(true);
             auto nSubscribers = mSubscriptionManager->getNumberOfSubscribers();
+            FlightRecorder::record(FlightRecorder::EventType::SubscriberJoined,
+                                   mPeer,
+                                   nSubscribers);
             auto utilization
                 = static_cast<double> (nSubscribers)
                  /std::max(1, maximumNumberOfSubscribers); 
@@ -418,6 +165,11 @@ Subscriber must provide access token in x-custom-auth-token header field.
                                 "Failed to subscribe"));
             return;
         }
+        mMaximumLag = mOptions.getMaximumSubscriberLag();
+        mSustainedLagDuration = mOptions.getSustainedLagDuration();
+        mDisconnectSlowSubscriber
+            = mOptions.getSlowConsumerPolicy()
+           == BackendOptions::SlowConsumerPolicy::Disconnect;
         SPDLOG_LOGGER_DEBUG(mLogger, "Subscribe RPC for {} is starting", mPeer);
         // Start
         pump();
@@ -445,7 +197,10 @@ Subscriber must provide access token in x-custom-auth-token header field.
                                          "Unexpected failure"));
         }
         // Packet is flushed; can now safely purge the element to write
+        mWriteSpan.end();
         mPacketsQueue.pop();
+        mMetrics.getQueueDepth(UDataPacketImportProxy::Metrics::QueueType::Writer)
+                .add(-1);
         // Start next write
         pump();
     }
@@ -455,12 +210,21 @@ Subscriber must provide access token in x-custom-auth-token header field.
     // subscription manager..
     void OnDone() override 
     { 
+        mMetrics.getQueueDepth(UDataPacketImportProxy::Metrics::QueueType::Writer)
+                .add(-static_cast<int64_t> (mPacketsQueue.size()));
+        if (mStatistics){mMetrics.unregisterSubscriber(mStatistics);}
         if (mContext && mSubscribed.exchange(false))
         {
             mSubscriptionManager->unsubscribe(mContextAddress, mPeer);
             //mSubscribed.store(false);
         }
         int nSubscribers = mSubscriptionManager->getNumberOfSubscribers();
+        if (mStatistics)
+        {
+            FlightRecorder::record(FlightRecorder::EventType::SubscriberLeft,
+                                   mPeer,
+                                   nSubscribers);
+        }
         auto maximumNumberOfSubscribers
             = mOptions.getMaximumNumberOfSubscribers();
         auto utilization
@@ -480,7 +244,7 @@ Subscriber must provide access token in x-custom-auth-token header field.
                            mPeer);
         // Nothing to wake here: if a write is in flight it completes with
         // ok=false via OnWriteDone; if the pump is idle the armed alarm
-        // fires at its deadline (ok=true, at most mMaximumPollInterval away).
+        // fires at its deadline (ok=true, at most the maximum poll interval away).
         // Either way the pump sees IsCancelled() and finishes up.
     }
 
@@ -515,17 +279,30 @@ private:
             {
                 auto packetsBuffer
                     = mSubscriptionManager->getNextPackets(
-                        mContext,
+                        mContextAddress,
+                        mPeer,
                         static_cast<int> (mMaximumWriteQueueSize));
                 for (auto &packet : packetsBuffer)
                 {
                     if (mPacketsQueue.size() > mMaximumWriteQueueSize)
                     {
-                        SPDLOG_LOGGER_WARN(mLogger,
-                           "RPC writer queue exceeded - popping element");
                         mPacketsQueue.pop();
+                        mMetrics.getQueueDepth(
+                            UDataPacketImportProxy::Metrics::QueueType::Writer)
+                                .add(-1);
+                        mMetrics.incrementDroppedPacketsCounter(
+                          UDataPacketImportProxy::Metrics::DropReason::WriterOverflow);
+                        FlightRecorder::record(
+                            FlightRecorder::EventType::QueueOverflow,
+                            mPeer,
+                            1,
+                            static_cast<uint16_t> (FlightRecorder::Queue::Writer));
                     }
                     mPacketsQueue.push(std::move(packet));
+                    mMetrics.updateQueueDepth(
+                        UDataPacketImportProxy::Metrics::QueueType::Writer,
+                        1,
+                        static_cast<int64_t> (mPacketsQueue.size()));
                 }
             }
             catch (const std::exception &e)
@@ -540,19 +317,70 @@ private:
         // resumes in OnWriteDone.
         if (!mPacketsQueue.empty())
         {
-            mCurrentPollInterval = mPollInterval; // Data is flowing again
+            mPollBackoff.reset(); // Data is flowing again
+            const auto &outboundPacket = mPacketsQueue.front();
+            const auto now = mSubscriptionManager->getClock().now();
+            const auto lag = now - outboundPacket.enqueueTime;
+            if (lag > mMaximumLag)
+            {
+                if (!mLagging)
+                {
+                    SPDLOG_LOGGER_WARN(mLogger, "{} lags by {} s",
+                        mPeer, std::chrono::duration<double> (lag).count());
+                    mLaggingSince = now;
+                }
+                mLagging = true;
+                // Only a lag that outlasts a brief stall is worth the
+                // subscription
+                if (mDisconnectSlowSubscriber &&
+                    now - mLaggingSince >= mSustainedLagDuration)
+                {
+                    SPDLOG_LOGGER_WARN(mLogger,
+                        "Disconnecting {} because it has lagged by more than {} s for {} s",
+                        mPeer,
+                        std::chrono::duration<double> (mMaximumLag).count(),
+                        std::chrono::duration<double>
+                           (now - mLaggingSince).count());
+                    return finishUp(
+                        grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                                     "Subscriber is too slow"));
+                }
+            }
+            else
+            {
+                mLagging = false;
+            }
             mMetrics.incrementSentPacketsCounter();
-            StartWrite(&mPacketsQueue.front());
+            if (mStatistics)
+            {
+                mStatistics->updateLag(lag);
+                mStatistics->incrementSentPacketsCounter();
+            }
+            mMetrics.recordLatency(
+                UDataPacketImportProxy::Metrics::LatencyStage::SubscriberQueue,
+                lag);
+            mMetrics.recordLatency(
+                UDataPacketImportProxy::Metrics::LatencyStage::EndToEnd,
+                now - outboundPacket.ingestTime);
+            if (outboundPacket.packet.sampling_rate() > 0)
+            {
+                mMetrics.recordDataLatency(
+                    UDataPacketImportProxy::Metrics::DataLatencyStage::Egress,
+                    outboundPacket.packet.stream_identifier().network(),
+                    std::chrono::duration_cast<std::chrono::microseconds>
+                        (now - outboundPacket.lastSampleTime));
+            }
+            mWriteSpan
+                = UDataPacketImportProxy::Tracing::Span{outboundPacket.trace,
+                                                        "write"};
+            StartWrite(&outboundPacket.packet);
             return;
         }
 
         // Idle: hand the thread back; the alarm resumes the pump at the
         // deadline (ok=true).  While the stream stays quiet, back off 
         // towards maximum, which bounds both cancel detection and shutdown lag.
-        const auto interval
-            = std::min(mCurrentPollInterval, mMaximumPollInterval);
-        mCurrentPollInterval = std::min(interval*2, mMaximumPollInterval);
-        mAlarm.Set(std::chrono::system_clock::now() + interval,
+        mAlarm.Set(std::chrono::system_clock::now() + mPollBackoff.next(),
                    [this](bool){pump();});
     }
 
@@ -568,21 +396,27 @@ private:
     BackendOptions mOptions;
     grpc::CallbackServerContext *mContext{nullptr};
     uintptr_t mContextAddress;
-    std::shared_ptr<::SubscriptionManager> mSubscriptionManager{nullptr};
+    std::shared_ptr<SubscriptionManager> mSubscriptionManager{nullptr};
     std::shared_ptr<spdlog::logger> mLogger{nullptr};
     UDataPacketImportProxy::Metrics::MetricsSingleton &mMetrics
     {
         UDataPacketImportProxy::Metrics::MetricsSingleton::getInstance()
     };
     std::atomic<bool> *mKeepRunning{nullptr};
-    std::queue<UDataPacketImportAPI::V1::Packet> mPacketsQueue;
+    std::queue<OutboundPacket> mPacketsQueue;
+    UDataPacketImportProxy::Tracing::Span mWriteSpan;
     grpc::Alarm mAlarm;
     std::string mPeer;
-    std::chrono::milliseconds mPollInterval{10};
-    std::chrono::milliseconds mCurrentPollInterval{mPollInterval};
-    std::chrono::milliseconds mMaximumPollInterval{250};
+    UDataPacketImportProxy::PollBackoff mPollBackoff;
+    std::shared_ptr<UDataPacketImportProxy::Metrics::SubscriberStatistics>
+        mStatistics{nullptr};
+    std::chrono::milliseconds mMaximumLag{30000};
+    std::chrono::milliseconds mSustainedLagDuration{10000};
+    std::chrono::steady_clock::time_point mLaggingSince;
     size_t mMaximumWriteQueueSize{128};
     std::atomic<bool> mSubscribed{false};
+    bool mDisconnectSlowSubscriber{false};
+    bool mLagging{false};
 };
 
 }
@@ -601,8 +435,10 @@ public:
             mLogger = spdlog::stdout_color_mt("ProxyBackendConsole");
         }   
         mSubscriptionManager
-            = std::make_shared<::SubscriptionManager>
-              (mOptions.getQueueCapacity(), mLogger);
+            = std::make_shared<SubscriptionManager>
+              (mOptions.getQueueCapacity(),
+               mOptions.getSlowConsumerPolicy(),
+               mLogger);
     }
 
     void stop()
@@ -618,6 +454,7 @@ public:
         auto grpcOptions = mOptions.getGRPCOptions();
         auto address = makeAddress(grpcOptions);
         grpc::ServerBuilder builder;
+        applyServerTuning(grpcOptions, "backend", &builder);
         if (grpcOptions.getServerKey() == std::nullopt ||
             grpcOptions.getServerCertificate() == std::nullopt)
         {
@@ -699,7 +536,7 @@ public:
     BackendOptions mOptions;
     std::shared_ptr<spdlog::logger> mLogger{nullptr};
     std::unique_ptr<grpc::Server> mServer{nullptr};
-    std::shared_ptr<::SubscriptionManager> mSubscriptionManager{nullptr};
+    std::shared_ptr<SubscriptionManager> mSubscriptionManager{nullptr};
     std::atomic<bool> mKeepRunning{true};
     bool mSecured{false};
 };
@@ -728,9 +565,24 @@ void Backend::stop()
 
 /// Enqueue packet
 int Backend::enqueuePacket(UDataPacketImportAPI::V1::Packet &&packet)
+{
+    return enqueuePacket(std::move(packet), std::chrono::steady_clock::now());
+}
+
+int Backend::enqueuePacket(
+    UDataPacketImportAPI::V1::Packet &&packet,
+    const std::chrono::steady_clock::time_point &ingestTime,
+    const DeliveryReceipt *deliveryReceipt)
 {
     //auto copy = packet;
-    return pImpl->mSubscriptionManager->enqueuePacket(packet); //std::move(packet));;
+    if (deliveryReceipt)
+    {
+        return pImpl->mSubscriptionManager->enqueuePacket(packet,
+                                                          ingestTime,
+                                                          *deliveryReceipt);
+    }
+    return pImpl->mSubscriptionManager->enqueuePacket(packet,
+                                                      ingestTime); //std::move(packet));;
 }
 
 /// Number of subscribers
@@ -739,6 +591,16 @@ int Backend::getNumberOfSubscribers() const
     return std::max(0, pImpl->mSubscriptionManager->getNumberOfSubscribers());
 }
 
+/// In-process channel
+std::shared_ptr<grpc::Channel> Backend::createInProcessChannel() const
+{
+    if (pImpl->mServer == nullptr)
+    {
+        throw std::runtime_error("Backend not started");
+    }
+    return pImpl->mServer->InProcessChannel(grpc::ChannelArguments {});
+}
+
 bool Backend::isRunning() const noexcept
 {
     return pImpl->mKeepRunning.load();
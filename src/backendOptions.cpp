@@ -1,3 +1,4 @@
+#include <chrono>
 #include <memory>
 #include <stdexcept>
 #include <utility>
@@ -11,7 +12,10 @@ class BackendOptions::BackendOptionsImpl
 public:
     GRPCOptions mGRPCOptions;
     int mMaximumNumberOfSubscribers{32};
+    std::chrono::milliseconds mMaximumSubscriberLag{30000};
+    std::chrono::milliseconds mSustainedLagDuration{10000};
     int mQueueCapacity{1024};
+    SlowConsumerPolicy mSlowConsumerPolicy{SlowConsumerPolicy::DropOldest};
 };
 
 /// Constructor
@@ -92,3 +96,51 @@ int BackendOptions::getQueueCapacity() const noexcept
 {
     return pImpl->mQueueCapacity;
 }
+
+/// Slow consumer policy
+void BackendOptions::setSlowConsumerPolicy(
+    const BackendOptions::SlowConsumerPolicy policy) noexcept
+{
+    pImpl->mSlowConsumerPolicy = policy;
+}
+
+BackendOptions::SlowConsumerPolicy
+    BackendOptions::getSlowConsumerPolicy() const noexcept
+{
+    return pImpl->mSlowConsumerPolicy;
+}
+
+/// Maximum subscriber lag
+void BackendOptions::setMaximumSubscriberLag(
+    const std::chrono::milliseconds &lag)
+{
+    if (lag.count() <= 0)
+    {
+        throw std::invalid_argument("Maximum subscriber lag must be positive");
+    }
+    pImpl->mMaximumSubscriberLag = lag;
+}
+
+std::chrono::milliseconds
+    BackendOptions::getMaximumSubscriberLag() const noexcept
+{
+    return pImpl->mMaximumSubscriberLag;
+}
+
+/// Sustained lag duration
+void BackendOptions::setSustainedLagDuration(
+    const std::chrono::milliseconds &duration)
+{
+    if (duration.count() < 0)
+    {
+        throw std::invalid_argument(
+            "Sustained lag duration cannot be negative");
+    }
+    pImpl->mSustainedLagDuration = duration;
+}
+
+std::chrono::milliseconds
+    BackendOptions::getSustainedLagDuration() const noexcept
+{
+    return pImpl->mSustainedLagDuration;
+}
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/chrono.h>
+#include "flightRecorder.hpp"
+
+namespace UFR = UDataPacketImportProxy::FlightRecorder;
+
+/// Renders a flight recorder dump as text with one event per line ordered
+/// by time.
+int main(int argc, char *argv[])
+{
+    if (argc != 2 ||
+        std::string {argv[1]} == "--help" || std::string {argv[1]} == "-h")
+    {
+        std::cerr << "Usage: " << argv[0] << " flightRecorder.pid.time.bin"
+                  << std::endl;
+        return argc == 2 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    UFR::Dump dump;
+    try
+    {
+        dump = UFR::read(argv[1]);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    struct Row
+    {
+        UFR::Event event;
+        size_t thread;
+    };
+    std::vector<Row> rows;
+    for (size_t thread = 0; thread < dump.threads.size(); ++thread)
+    {
+        for (const auto &event : dump.threads[thread])
+        {
+            rows.push_back(Row {event, thread});
+        }
+    }
+    std::stable_sort(rows.begin(), rows.end(),
+                     [](const Row &lhs, const Row &rhs)
+                     {
+                         return lhs.event.time < rhs.event.time;
+                     });
+
+    for (const auto &row : rows)
+    {
+        // Convert the steady clock to UTC using the clocks at dump time
+        const std::chrono::sys_time<std::chrono::nanoseconds> time
+        {
+            std::chrono::nanoseconds
+            {
+                dump.systemTime - (dump.steadyTime - row.event.time)
+            }
+        };
+        const auto seconds = std::chrono::floor<std::chrono::seconds> (time);
+        const auto microSeconds
+            = std::chrono::duration_cast<std::chrono::microseconds>
+              (time - seconds).count();
+        const std::string label(row.event.label.data(),
+                                std::find(row.event.label.begin(),
+                                          row.event.label.end(), '\0'));
+        std::cout << fmt::format("{:%Y-%m-%dT%H:%M:%S}.{:06d}Z thread={} {} {} value={} detail={}",
+                                 seconds,
+                                 microSeconds,
+                                 row.thread,
+                                 UFR::toString(row.event.type),
+                                 label.empty() ? "-" : label,
+                                 row.event.value,
+                                 row.event.detail)
+                  << "\n";
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_DELIVERY_TRACKER_HPP
+#define UDATA_PACKET_IMPORT_PROXY_DELIVERY_TRACKER_HPP
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+namespace UDataPacketImportProxy
+{
+/// @brief A handle on a journaled packet's delivery counter.  Every
+///        subscriber's copy of the packet holds a copy of the receipt and
+///        the packet is delivered once the last copy is destroyed.  Copying
+///        and destroying a receipt are an atomic increment and decrement
+///        so there is no allocation or lock on the per-packet path.
+class DeliveryReceipt
+{
+public:
+    DeliveryReceipt() = default;
+    explicit DeliveryReceipt(std::atomic<int32_t> *outstanding) noexcept :
+        mOutstanding(outstanding)
+    {
+        if (mOutstanding)
+        {
+            mOutstanding->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    DeliveryReceipt(const DeliveryReceipt &receipt) noexcept :
+        DeliveryReceipt(receipt.mOutstanding)
+    {
+    }
+    DeliveryReceipt(DeliveryReceipt &&receipt) noexcept :
+        mOutstanding(std::exchange(receipt.mOutstanding, nullptr))
+    {
+    }
+    DeliveryReceipt& operator=(const DeliveryReceipt &receipt) noexcept
+    {
+        if (&receipt == this){return *this;}
+        DeliveryReceipt copy{receipt};
+        std::swap(mOutstanding, copy.mOutstanding);
+        return *this;
+    }
+    DeliveryReceipt& operator=(DeliveryReceipt &&receipt) noexcept
+    {
+        if (&receipt == this){return *this;}
+        release();
+        mOutstanding = std::exchange(receipt.mOutstanding, nullptr);
+        return *this;
+    }
+    ~DeliveryReceipt()
+    {
+        release();
+    }
+    /// @result True indicates this receipt holds back a journaled packet.
+    [[nodiscard]] explicit operator bool() const noexcept
+    {
+        return mOutstanding != nullptr;
+    }
+private:
+    void release() noexcept
+    {
+        if (mOutstanding)
+        {
+            mOutstanding->fetch_sub(1, std::memory_order_release);
+            mOutstanding = nullptr;
+        }
+    }
+    std::atomic<int32_t> *mOutstanding{nullptr};
+};
+
+/// @brief Tracks which journaled packets have left the proxy.  The tracker
+///        is a ring indexed by journal sequence number with one slot per
+///        journal slot.  A packet is done once it has been taken off (or
+///        evicted from) the import queue and every receipt for it has been
+///        destroyed.  The propagator advances the delivered watermark over
+///        the run of done packets so committing never waits on a lock.
+/// @note Because the journal never holds more than its number of slots of
+///       uncommitted packets, and the journal is never committed past the
+///       delivered watermark, the live sequence numbers never share a slot.
+///       The tracker must outlive every receipt it makes.
+class DeliveryTracker
+{
+public:
+    /// @param[in] nSlots     The number of slots in the journal.
+    /// @param[in] delivered  The journal's committed sequence number.
+    DeliveryTracker(const uint64_t nSlots, const uint64_t delivered) :
+        mSlots(std::make_unique<Slot[]> (nSlots)),
+        mNumberOfSlots(nSlots),
+        mDelivered(delivered)
+    {
+        if (nSlots < 1)
+        {
+            throw std::invalid_argument("Number of slots must be positive");
+        }
+    }
+    /// @brief Marks the packet with this sequence number as having left the
+    ///        import queue.  This can be called from any thread.
+    void markDequeued(const uint64_t sequence) noexcept
+    {
+        getSlot(sequence).dequeued.store(sequence, std::memory_order_release);
+    }
+    /// @result A receipt that, once it and all of its copies are destroyed,
+    ///         marks this sequence number as delivered.
+    /// @note This must be called by the propagator before the next advance.
+    [[nodiscard]] DeliveryReceipt makeReceipt(const uint64_t sequence) noexcept
+    {
+        return DeliveryReceipt{&getSlot(sequence).outstanding};
+    }
+    /// @brief Advances the delivered watermark over the packets that are
+    ///        done, but not beyond the limit.  Packets held back in the
+    ///        propagator (e.g., in the reorder buffer) set the limit.
+    /// @result Every packet up to and including this sequence number is
+    ///         delivered.
+    /// @note Only the propagator may call this.
+    uint64_t advance(const uint64_t limit = UINT64_MAX) noexcept
+    {
+        while (mDelivered < limit)
+        {
+            const auto sequence = mDelivered + 1;
+            const auto &slot = getSlot(sequence);
+            if (slot.dequeued.load(std::memory_order_acquire) != sequence ||
+                slot.outstanding.load(std::memory_order_acquire) != 0)
+            {
+                break;
+            }
+            mDelivered = sequence;
+        }
+        return mDelivered;
+    }
+    /// @result The number of slots in the ring.
+    [[nodiscard]] uint64_t getNumberOfSlots() const noexcept
+    {
+        return mNumberOfSlots;
+    }
+private:
+    /// N.B. Pad each slot to a cache line so subscriber threads releasing
+    /// neighbouring packets do not contend.
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> dequeued{0};
+        std::atomic<int32_t> outstanding{0};
+    };
+    [[nodiscard]] Slot &getSlot(const uint64_t sequence) const noexcept
+    {
+        return mSlots[(sequence - 1)%mNumberOfSlots];
+    }
+    std::unique_ptr<Slot[]> mSlots;
+    uint64_t mNumberOfSlots{1};
+    uint64_t mDelivered{0};
+};
+}
+#endif
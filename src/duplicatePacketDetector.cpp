@@ -1,5 +1,6 @@
 //#include <iostream>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
@@ -20,48 +21,14 @@
 #include "uDataPacketImportProxy/duplicatePacketDetector.hpp"
 #include "uDataPacketImportAPI/v1/packet.pb.h"
 #include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
+#include "packetTime.hpp"
+#include "streamIdentifier.hpp"
 
 using namespace UDataPacketImportProxy;
 
 namespace
 {
 
-[[nodiscard]] std::string toName(
-    const UDataPacketImportAPI::V1::StreamIdentifier &streamIdentifier)
-{
-    auto result = streamIdentifier.network() + "."
-                + streamIdentifier.station() + "."
-                + streamIdentifier.channel() + ".";
-    if (!streamIdentifier.location_code().empty())
-    {
-         result = result + "." + streamIdentifier.location_code();
-    }
-    return result;
-}
-
-[[nodiscard]]
-std::string toName(const UDataPacketImportAPI::V1::Packet &packet)
-{
-    return toName(packet.stream_identifier());
-}
-
-[[nodiscard]] std::chrono::microseconds 
-    getEndTimeInMicroSeconds(const UDataPacketImportAPI::V1::Packet &packet)
-{
-    auto startTimeMuSec
-        = google::protobuf::util::TimeUtil::TimestampToMicroseconds(
-             packet.start_time());
-    auto nSamples = packet.number_of_samples();
-    const double samplingRate = packet.sampling_rate();
-    if (samplingRate <= 0)
-    {   
-        throw std::invalid_argument("Sampling rate not positive");
-    }   
-    auto dtMuSec = static_cast<int64_t> (std::round(1000000/samplingRate));
-    auto endTimeMuSec = startTimeMuSec + dtMuSec*(nSamples - 1); 
-    return std::chrono::microseconds {endTimeMuSec};
-}
-
 
 struct DataPacketHeader
 {
@@ -69,7 +36,7 @@ public:
     explicit DataPacketHeader(
         const UDataPacketImportAPI::V1::Packet &packet)
     {
-        name = ::toName(packet);
+        name = toName(packet.stream_identifier());
 #ifndef NDEBUG
         assert(!name.empty());
 #endif
@@ -78,7 +45,7 @@ public:
             = google::protobuf::util::TimeUtil::TimestampToMicroseconds(
                 packet.start_time());
         startTime = std::chrono::microseconds {startTimeMuS};
-        endTime = ::getEndTimeInMicroSeconds(packet);
+        endTime = getEndTimeInMicroSeconds(packet);
         // Sampling rate (approximate)
         samplingRate
             = static_cast<int> (std::round(packet.sampling_rate()));
@@ -276,6 +243,8 @@ public:
             newCircularBuffer.push_back(header);
             mCircularBuffers.insert(std::pair{header.name,
                                               std::move(newCircularBuffer)});
+            mNumberOfStreams.store(static_cast<int> (mCircularBuffers.size()),
+                                   std::memory_order_relaxed);
             // Can't be a a duplicate because its the first one
             return true;
         }
@@ -373,6 +342,7 @@ public:
         const std::lock_guard<std::mutex> lockGuard(impl.mMutex);
         mCircularBuffers = impl.mCircularBuffers;
         }
+        mNumberOfStreams.store(impl.mNumberOfStreams.load());
         mCircularBufferDuration = impl.mCircularBufferDuration;
         mCircularBufferSize = impl.mCircularBufferSize;
         mEstimateCapacity = impl.mEstimateCapacity;
@@ -382,6 +352,7 @@ public:
     mutable std::mutex mMutex;
     mutable std::map<std::string, boost::circular_buffer<::DataPacketHeader>>
         mCircularBuffers;
+    mutable std::atomic<int> mNumberOfStreams{0};
     std::chrono::seconds mCircularBufferDuration{300};
     int mCircularBufferSize{100}; // ~3s packets 
     bool mEstimateCapacity{false};
@@ -479,6 +450,13 @@ bool DuplicatePacketDetector::allow(
     return pImpl->allow(*header); // Throws
 }
 
+/// Number of streams
+int DuplicatePacketDetector::getNumberOfStreams() const noexcept
+{
+    if (!pImpl){return 0;}
+    return pImpl->mNumberOfStreams.load(std::memory_order_relaxed);
+}
+
 bool DuplicatePacketDetector::operator()(
     const UDataPacketImportAPI::V1::Packet &packet) const
 {
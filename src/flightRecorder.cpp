@@ -0,0 +1,545 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cmath>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "flightRecorder.hpp"
+#include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
+
+using namespace UDataPacketImportProxy::FlightRecorder;
+
+namespace
+{
+
+constexpr std::array<char, 8> magic{'U', 'D', 'P', 'I', 'P', 'F', 'R', '1'};
+constexpr int maximumNumberOfThreads{256};
+constexpr uint32_t maximumEventsPerThread{1U << 24U};
+
+/// A ring with a single writer - i.e., the thread that owns it.  The dump
+/// may read while the owner writes so each slot is a seqlock: the owner
+/// marks the slot odd while writing it and then stamps it with the
+/// event's position in the ring.  A reader keeps the event only if the
+/// stamp is the one it expects both before and after copying the slot.
+/// When its thread exits the ring is retired, and the next thread to
+/// record an event reuses it, so rings are never freed while a crash
+/// handler may be reading them.
+class Ring
+{
+public:
+    static constexpr size_t nWords{sizeof(Event)/sizeof(uint64_t)};
+    static_assert(sizeof(Event) == nWords*sizeof(uint64_t));
+
+    explicit Ring(const size_t capacity) :
+        mSlots(std::make_unique<Slot[]> (capacity)),
+        mMask(capacity - 1)
+    {
+    }
+    [[nodiscard]] size_t getCapacity() const noexcept
+    {
+        return mMask + 1;
+    }
+    /// @result True if the calling thread now owns this retired ring.
+    [[nodiscard]] bool tryAcquire() noexcept
+    {
+        bool owned{false};
+        return mOwned.compare_exchange_strong(owned, true,
+                                              std::memory_order_acquire);
+    }
+    /// Retires the ring when its thread exits
+    void release() noexcept
+    {
+        mOwned.store(false, std::memory_order_release);
+    }
+    void push(const Event &event) noexcept
+    {
+        const auto head = mHead.load(std::memory_order_relaxed);
+        auto &slot = mSlots[head & mMask];
+        slot.sequence.store(2*head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        const auto words = std::bit_cast<std::array<uint64_t, nWords>> (event);
+        for (size_t i = 0; i < nWords; ++i)
+        {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.sequence.store(2*head + 2, std::memory_order_release);
+        mHead.store(head + 1, std::memory_order_release);
+    }
+    /// Calls the function with each event still in the ring from oldest
+    /// to newest.  This neither allocates nor locks so the crash handler
+    /// can use it.
+    template<typename F>
+    void forEach(F &&function) const noexcept
+    {
+        const auto capacity = mMask + 1;
+        const auto head = mHead.load(std::memory_order_acquire);
+        const auto first = head > capacity ? head - capacity : 0;
+        for (auto i = first; i < head; ++i)
+        {
+            const auto &slot = mSlots[i & mMask];
+            const auto expected = 2*i + 2;
+            if (slot.sequence.load(std::memory_order_acquire) != expected)
+            {
+                continue; // Being overwritten
+            }
+            std::array<uint64_t, nWords> words{};
+            for (size_t j = 0; j < nWords; ++j)
+            {
+                words[j] = slot.words[j].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != expected)
+            {
+                continue; // Overwritten while we were copying
+            }
+            function(std::bit_cast<Event> (words));
+        }
+    }
+    [[nodiscard]] std::vector<Event> copy() const
+    {
+        std::vector<Event> events;
+        events.reserve(std::min(mHead.load(std::memory_order_acquire),
+                                mMask + 1));
+        forEach([&events](const Event &event)
+                {
+                    events.push_back(event);
+                });
+        return events;
+    }
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence{0};
+        std::array<std::atomic<uint64_t>, nWords> words{};
+    };
+    std::unique_ptr<Slot[]> mSlots;
+    size_t mMask{0};
+    std::atomic<size_t> mHead{0};
+    std::atomic<bool> mOwned{true};
+};
+
+std::atomic<size_t> eventsPerThread{16384};
+/// Serializes claiming and creating rings.  The rings themselves are
+/// published through atomics so the dump and the crash handler never
+/// take this.
+std::mutex ringsMutex;
+std::array<std::atomic<Ring *>, maximumNumberOfThreads> rings{};
+std::atomic<int> nRings{0};
+
+/// Retires the thread's ring when the thread exits
+struct RingOwner
+{
+    ~RingOwner()
+    {
+        if (ring != nullptr){ring->release();}
+    }
+    Ring *ring{nullptr};
+};
+
+/// @result A retired ring of the current size or a new ring.  This is
+///         null if there are already too many threads.
+[[nodiscard]] Ring *acquireRing()
+{
+    const auto capacity = eventsPerThread.load();
+    const std::lock_guard<std::mutex> lock(ringsMutex);
+    const auto n = nRings.load(std::memory_order_relaxed);
+    for (int i = 0; i < n; ++i)
+    {
+        auto ring = rings[static_cast<size_t> (i)].load(std::memory_order_relaxed);
+        if (ring->getCapacity() == capacity && ring->tryAcquire())
+        {
+            return ring;
+        }
+    }
+    if (n >= maximumNumberOfThreads){return nullptr;}
+    // Rings live for the life of the process
+    auto ring = new Ring(capacity); // NOLINT(cppcoreguidelines-owning-memory)
+    rings[static_cast<size_t> (n)].store(ring, std::memory_order_release);
+    nRings.store(n + 1, std::memory_order_release);
+    return ring;
+}
+
+/// @result The calling thread's ring or null if there are too many threads.
+[[nodiscard]] Ring *getRing() noexcept
+{
+    thread_local Ring *ring{nullptr};
+    thread_local bool registered{false};
+    if (!registered)
+    {
+        registered = true;
+        try
+        {
+            thread_local RingOwner owner;
+            ring = acquireRing();
+            owner.ring = ring;
+        }
+        catch (...)
+        {
+            ring = nullptr;
+        }
+    }
+    return ring;
+}
+
+[[nodiscard]] int64_t toNanoSeconds(const auto &timePoint) noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+           (timePoint.time_since_epoch()).count();
+}
+
+/// Reading the clock dominates the cost of recording an event so, where
+/// available, events are stamped with the (invariant) time-stamp counter
+/// and converted to the steady clock when the rings are dumped.
+[[nodiscard]] int64_t readTicks() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return static_cast<int64_t> (__rdtsc());
+#else
+    return toNanoSeconds(std::chrono::steady_clock::now());
+#endif
+}
+
+struct Calibration
+{
+    int64_t ticks{readTicks()};
+    int64_t steadyTime{toNanoSeconds(std::chrono::steady_clock::now())};
+};
+
+const Calibration startCalibration;
+
+/// Converts ticks to nanoseconds on the steady clock by interpolating
+/// between the calibration at startup and at the time of the dump
+[[nodiscard]] int64_t toSteadyTime(const int64_t ticks,
+                                   const Calibration &end) noexcept
+{
+    const auto elapsedTicks = end.ticks - startCalibration.ticks;
+    if (elapsedTicks <= 0){return end.steadyTime;}
+    const auto nanoSecondsPerTick
+        = static_cast<long double> (end.steadyTime - startCalibration.steadyTime)
+         /static_cast<long double> (elapsedTicks);
+    return startCalibration.steadyTime
+         + static_cast<int64_t> (std::llround(
+              static_cast<long double> (ticks - startCalibration.ticks)
+             *nanoSecondsPerTick));
+}
+
+/// Copies as much of the string as fits after position
+size_t append(std::array<char, 16> &label,
+              size_t position,
+              const std::string_view text) noexcept
+{
+    // Labels are a few characters so a loop beats calling memcpy
+    for (const auto c : text)
+    {
+        if (position == label.size()){break;}
+        label[position++] = c;
+    }
+    return position;
+}
+
+/// The crash dump's file name.  This is fixed when the handlers are
+/// installed since building it in the handler would allocate.
+std::array<char, 4096> crashFileName{};
+std::atomic<bool> crashing{false};
+
+/// Writes all of the bytes with async-signal-safe calls.
+/// @result False if the write failed.
+[[nodiscard]] bool writeFully(const int fd,
+                              const void *data,
+                              size_t nBytes) noexcept
+{
+    const auto *bytes = static_cast<const char *> (data);
+    while (nBytes > 0)
+    {
+        const auto nWritten = ::write(fd, bytes, nBytes);
+        if (nWritten < 0)
+        {
+            if (errno == EINTR){continue;}
+            return false;
+        }
+        bytes = bytes + nWritten;
+        nBytes = nBytes - static_cast<size_t> (nWritten);
+    }
+    return true;
+}
+
+[[nodiscard]] int64_t toNanoSeconds(const timespec &time) noexcept
+{
+    return static_cast<int64_t> (time.tv_sec)*1000000000
+         + static_cast<int64_t> (time.tv_nsec);
+}
+
+/// Writes the rings in the dump format using only async-signal-safe
+/// calls - i.e., no allocation, no locks, and no streams.  Each ring's
+/// event count precedes its events so it is patched in afterward.
+void dumpOnCrash() noexcept
+{
+    const int fd = ::open(crashFileName.data(),
+                          O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          0644);
+    if (fd < 0){return;}
+    timespec steadyClock{};
+    timespec systemClock{};
+    ::clock_gettime(CLOCK_MONOTONIC, &steadyClock);
+    ::clock_gettime(CLOCK_REALTIME, &systemClock);
+    const auto steadyTime = ::toNanoSeconds(steadyClock);
+    const auto systemTime = ::toNanoSeconds(systemClock);
+    const Calibration endCalibration{::readTicks(), steadyTime};
+    const auto nRingsToDump = nRings.load(std::memory_order_acquire);
+    const auto nThreads = static_cast<uint32_t> (nRingsToDump);
+    bool okay = writeFully(fd, magic.data(), magic.size())
+             && writeFully(fd, &steadyTime, sizeof(steadyTime))
+             && writeFully(fd, &systemTime, sizeof(systemTime))
+             && writeFully(fd, &nThreads, sizeof(nThreads));
+    auto offset = static_cast<off_t> (magic.size() + sizeof(steadyTime)
+                                    + sizeof(systemTime) + sizeof(nThreads));
+    std::array<Event, 64> buffer{};
+    for (int i = 0; i < nRingsToDump && okay; ++i)
+    {
+        const auto ring
+            = rings[static_cast<size_t> (i)].load(std::memory_order_acquire);
+        const auto countOffset = offset;
+        uint32_t nEvents{0};
+        okay = writeFully(fd, &nEvents, sizeof(nEvents));
+        offset = offset + static_cast<off_t> (sizeof(nEvents));
+        size_t nBuffered{0};
+        auto flush = [&]()
+        {
+            okay = okay && writeFully(fd, buffer.data(), nBuffered*sizeof(Event));
+            offset = offset + static_cast<off_t> (nBuffered*sizeof(Event));
+            nBuffered = 0;
+        };
+        ring->forEach([&](const Event &event)
+                      {
+                          buffer[nBuffered] = event;
+                          buffer[nBuffered].time
+                              = ::toSteadyTime(event.time, endCalibration);
+                          nBuffered = nBuffered + 1;
+                          nEvents = nEvents + 1;
+                          if (nBuffered == buffer.size()){flush();}
+                      });
+        flush();
+        okay = okay
+            && ::pwrite(fd, &nEvents, sizeof(nEvents), countOffset)
+               == static_cast<ssize_t> (sizeof(nEvents));
+    }
+    ::close(fd);
+}
+
+/// Dumps the rings and then lets the signal take its default action,
+/// which was restored on entry, so the process still dies (and leaves a
+/// core) as it would have.
+void crashHandler(const int signal) noexcept
+{
+    if (!crashing.exchange(true)){dumpOnCrash();}
+    ::raise(signal);
+}
+
+template<typename T>
+void writeValue(std::ofstream &file, const T &value)
+{
+    file.write(reinterpret_cast<const char *> (&value), sizeof(T));
+}
+
+template<typename T>
+void readValue(std::ifstream &file, T &value)
+{
+    if (!file.read(reinterpret_cast<char *> (&value), sizeof(T)))
+    {
+        throw std::runtime_error("Flight recorder file is truncated");
+    }
+}
+
+}
+
+/// Ring size
+void UDataPacketImportProxy::FlightRecorder::setEventsPerThread(
+    const int nEvents)
+{
+    if (nEvents < 1)
+    {
+        throw std::invalid_argument("Events per thread must be positive");
+    }
+    eventsPerThread.store(
+        std::min<size_t> (std::bit_ceil(static_cast<size_t> (nEvents)),
+                          ::maximumEventsPerThread));
+}
+
+/// Crash handlers
+void UDataPacketImportProxy::FlightRecorder::installCrashHandlers(
+    const std::filesystem::path &directory)
+{
+    if (!directory.empty() && !std::filesystem::exists(directory))
+    {
+        std::filesystem::create_directories(directory);
+    }
+    const auto fileName
+        = (directory / ("flightRecorder." + std::to_string(::getpid())
+                      + ".crash.bin")).string();
+    if (fileName.size() >= ::crashFileName.size())
+    {
+        throw std::invalid_argument("Flight recorder directory is too long");
+    }
+    std::fill(::crashFileName.begin(), ::crashFileName.end(), '\0');
+    std::copy(fileName.begin(), fileName.end(), ::crashFileName.begin());
+    struct sigaction action{};
+    action.sa_handler = ::crashHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESETHAND;
+    for (const auto signal : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT})
+    {
+        if (sigaction(signal, &action, nullptr) != 0)
+        {
+            throw std::runtime_error("Could not install crash handler for "
+                                   + std::to_string(signal));
+        }
+    }
+}
+
+/// Record
+void UDataPacketImportProxy::FlightRecorder::record(
+    const EventType type,
+    const std::string_view label,
+    const int64_t value,
+    const uint16_t detail) noexcept
+{
+    auto ring = ::getRing();
+    if (ring == nullptr){return;}
+    Event event;
+    event.time = ::readTicks();
+    event.value = value;
+    event.type = type;
+    event.detail = detail;
+    // Keep the end of long labels since that is what distinguishes peers
+    const auto text = label.size() > event.label.size() ?
+                      label.substr(label.size() - event.label.size()) : label;
+    ::append(event.label, 0, text);
+    ring->push(event);
+}
+
+void UDataPacketImportProxy::FlightRecorder::record(
+    const EventType type,
+    const UDataPacketImportAPI::V1::StreamIdentifier &identifier,
+    const int64_t value,
+    const uint16_t detail) noexcept
+{
+    auto ring = ::getRing();
+    if (ring == nullptr){return;}
+    Event event;
+    event.time = ::readTicks();
+    event.value = value;
+    event.type = type;
+    event.detail = detail;
+    auto position = ::append(event.label, 0, identifier.network());
+    position = ::append(event.label, position, ".");
+    position = ::append(event.label, position, identifier.station());
+    position = ::append(event.label, position, ".");
+    position = ::append(event.label, position, identifier.channel());
+    position = ::append(event.label, position, ".");
+    ::append(event.label, position, identifier.location_code());
+    ring->push(event);
+}
+
+/// Dump
+std::filesystem::path UDataPacketImportProxy::FlightRecorder::dump(
+    const std::filesystem::path &directory)
+{
+    const auto nRingsToDump = ::nRings.load(std::memory_order_acquire);
+    const ::Calibration endCalibration;
+    const auto steadyTime = endCalibration.steadyTime;
+    const auto systemTime = ::toNanoSeconds(std::chrono::system_clock::now());
+    if (!directory.empty() && !std::filesystem::exists(directory))
+    {
+        std::filesystem::create_directories(directory);
+    }
+    const auto fileName
+        = directory / ("flightRecorder." + std::to_string(::getpid())
+                     + "." + std::to_string(systemTime/1000000) + ".bin");
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        throw std::runtime_error("Could not open " + fileName.string());
+    }
+    file.write(::magic.data(), ::magic.size());
+    ::writeValue(file, steadyTime);
+    ::writeValue(file, systemTime);
+    ::writeValue(file, static_cast<uint32_t> (nRingsToDump));
+    for (int i = 0; i < nRingsToDump; ++i)
+    {
+        const auto ring
+            = ::rings[static_cast<size_t> (i)].load(std::memory_order_acquire);
+        auto events = ring->copy();
+        for (auto &event : events)
+        {
+            event.time = ::toSteadyTime(event.time, endCalibration);
+        }
+        ::writeValue(file, static_cast<uint32_t> (events.size()));
+        file.write(reinterpret_cast<const char *> (events.data()),
+                   static_cast<std::streamsize> (events.size()*sizeof(Event)));
+    }
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write " + fileName.string());
+    }
+    return fileName;
+}
+
+/// Read
+Dump UDataPacketImportProxy::FlightRecorder::read(
+    const std::filesystem::path &fileName)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Could not open " + fileName.string());
+    }
+    std::array<char, 8> fileMagic{};
+    ::readValue(file, fileMagic);
+    if (fileMagic != ::magic)
+    {
+        throw std::runtime_error(fileName.string()
+                               + " is not a flight recorder file");
+    }
+    Dump result;
+    ::readValue(file, result.steadyTime);
+    ::readValue(file, result.systemTime);
+    uint32_t nThreads{0};
+    ::readValue(file, nThreads);
+    if (nThreads > maximumNumberOfThreads)
+    {
+        throw std::runtime_error("Too many threads in flight recorder file");
+    }
+    result.threads.resize(nThreads);
+    for (auto &events : result.threads)
+    {
+        uint32_t nEvents{0};
+        ::readValue(file, nEvents);
+        if (nEvents > maximumEventsPerThread)
+        {
+            throw std::runtime_error("Too many events in flight recorder file");
+        }
+        events.resize(nEvents);
+        if (!file.read(reinterpret_cast<char *> (events.data()),
+                       static_cast<std::streamsize> (nEvents*sizeof(Event))))
+        {
+            throw std::runtime_error("Flight recorder file is truncated");
+        }
+    }
+    return result;
+}
@@ -0,0 +1,136 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_FLIGHT_RECORDER_HPP
+#define UDATA_PACKET_IMPORT_PROXY_FLIGHT_RECORDER_HPP
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+namespace UDataPacketImportAPI::V1
+{
+ class StreamIdentifier;
+}
+/// @brief The flight recorder keeps the most recent pipeline events in a
+///        ring buffer per thread.  Recording is a clock read and a copy into
+///        memory owned by the calling thread so it is cheap enough to leave
+///        on in production.  When a thread exits its ring is retired and
+///        reused by the next new thread.  The rings are written to a file
+///        on request (SIGUSR1), when the application fails, or when it
+///        crashes, and the decodeFlightRecorder tool renders that file as
+///        text.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+namespace UDataPacketImportProxy::FlightRecorder
+{
+
+enum class EventType : uint16_t
+{
+    PacketAccepted = 0,   /*!< The frontend accepted a packet. */
+    PacketRejected,       /*!< The frontend rejected a packet.  The detail
+                               is the validation result. */
+    DuplicateAllowed,     /*!< The duplicate detector passed a packet. */
+    DuplicateRejected,    /*!< The duplicate detector rejected a packet. */
+    QueueOverflow,        /*!< A queue overflowed.  The detail is the queue
+                               and the value the number of packets lost. */
+    PublisherJoined,      /*!< A publisher connected.  The value is the
+                               number of publishers. */
+    PublisherLeft,        /*!< A publisher disconnected. */
+    SubscriberJoined,     /*!< A subscriber connected.  The value is the
+                               number of subscribers. */
+    SubscriberLeft        /*!< A subscriber disconnected. */
+};
+
+constexpr int NumberOfEventTypes{9};
+
+[[nodiscard]] constexpr const char *toString(const EventType type)
+{
+    constexpr std::array<const char *, NumberOfEventTypes> names
+    {
+        "packet_accepted",
+        "packet_rejected",
+        "duplicate_allowed",
+        "duplicate_rejected",
+        "queue_overflow",
+        "publisher_joined",
+        "publisher_left",
+        "subscriber_joined",
+        "subscriber_left"
+    };
+    const auto index = static_cast<size_t> (type);
+    return index < names.size() ? names[index] : "unknown";
+}
+
+/// @brief The queues reported in the detail of a queue overflow event.
+enum class Queue : uint16_t
+{
+    Import = 0,
+    Subscriber,
+    Writer,
+    Spool
+};
+
+/// @brief A compact event.  The label is the stream name - e.g.,
+///        UU.FORK.HHZ.01 - or the tail of a peer address, truncated to fit
+///        and not null terminated when it fills the field.
+struct Event
+{
+    int64_t time{0};  /*!< Nanoseconds on the steady clock.  While in a
+                           ring this is the raw time-stamp counter. */
+    int64_t value{0};
+    std::array<char, 16> label{};
+    EventType type{EventType::PacketAccepted};
+    uint16_t detail{0};
+    uint32_t reserved{0};
+};
+static_assert(sizeof(Event) == 40);
+
+/// @brief Sets the number of events kept by each thread.  This is rounded
+///        up to a power of two and only affects threads that have not yet
+///        recorded an event so it should be called at startup.
+/// @throws std::invalid_argument if this is not positive.
+void setEventsPerThread(int nEvents);
+
+/// @brief Records an event in the calling thread's ring.
+void record(EventType type,
+            std::string_view label,
+            int64_t value = 0,
+            uint16_t detail = 0) noexcept;
+/// @brief Records an event whose label is the stream's name.
+void record(EventType type,
+            const UDataPacketImportAPI::V1::StreamIdentifier &identifier,
+            int64_t value = 0,
+            uint16_t detail = 0) noexcept;
+
+/// @brief Installs handlers for SIGSEGV, SIGBUS, SIGFPE, SIGILL, and
+///        SIGABRT that write every thread's ring to
+///        flightRecorder.<pid>.crash.bin in the directory and then let the
+///        signal take its default action.  The handlers only make
+///        async-signal-safe calls.
+/// @throws std::runtime_error if the directory cannot be created or the
+///         handlers cannot be installed.
+/// @throws std::invalid_argument if the directory's name is too long.
+void installCrashHandlers(const std::filesystem::path &directory);
+
+/// @brief Writes every thread's ring to a file in the directory.
+/// @result The name of the file that was written.
+/// @throws std::runtime_error if the file cannot be written.
+std::filesystem::path dump(const std::filesystem::path &directory);
+
+/// @brief The contents of a dump file.
+struct Dump
+{
+    /// The steady and system clocks at the time of the dump so event times
+    /// can be converted to UTC.
+    int64_t steadyTime{0};
+    int64_t systemTime{0};
+    /// The events recorded by each thread in the order they were recorded.
+    std::vector<std::vector<Event>> threads;
+};
+
+/// @result The contents of the dump file.
+/// @throws std::runtime_error if the file cannot be read or is not a
+///         flight recorder dump.
+[[nodiscard]] Dump read(const std::filesystem::path &fileName);
+
+}
+#endif
@@ -9,13 +9,20 @@
 #include <atomic>
 #include <cmath>
 #include <chrono>
+#include <stdexcept>
 #include <string>
 #include <algorithm>
 #include <utility>
+#include <vector>
+#include <cerrno>
 #ifndef NDEBUG
 #include <cassert>
 #endif
-#include <boost/algorithm/string/trim.hpp>
+#include <netdb.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/support/status.h>
 #include <grpcpp/support/server_callback.h>
@@ -33,6 +40,13 @@
 #include "uDataPacketImportProxy/frontend.hpp"
 #include "uDataPacketImportProxy/frontendOptions.hpp"
 #include "uDataPacketImportProxy/grpcOptions.hpp"
+#include "flightRecorder.hpp"
+#include "packetValidator.hpp"
+#include "packetTime.hpp"
+#include "rateLimitedLog.hpp"
+#include "serverTuning.hpp"
+#include "streamIdentifier.hpp"
+#include "tracing.hpp"
 import metrics;
 
 using namespace UDataPacketImportProxy;
@@ -112,6 +126,8 @@ public:
             if (!::validatePublisher(mContext, *accessToken))
             {
                 SPDLOG_LOGGER_INFO(mLogger, "Frontend rejected {}", mPeer);
+                mMetrics.incrementDroppedPacketsCounter(
+                    Metrics::DropReason::Unauthenticated);
                 const grpc::Status status{grpc::StatusCode::UNAUTHENTICATED,
 R"""(
 Publisher must provide access token in x-custom-auth-token header field.
@@ -135,6 +151,10 @@ Publisher must provide access token in x-custom-auth-token header field.
             = static_cast<double> (nPublishers)
              /std::max(1, mMaximumNumberOfPublishers);
         mMetrics.updatePublisherUtilization(utilization);
+        mStatistics = mMetrics.registerPublisher(mPeer);
+        FlightRecorder::record(FlightRecorder::EventType::PublisherJoined,
+                               mPeer,
+                               nPublishers);
 
         SPDLOG_LOGGER_INFO(mLogger,
                            "Frontend managing {} publishers",
@@ -156,71 +176,64 @@ Publisher must provide access token in x-custom-auth-token header field.
         if (ok) 
         {
             mTotalPackets++;
+            const auto trace = Tracing::Trace::sample(mPeer);
+            Tracing::Span readSpan{trace, "read"};
             auto packet = mPacket;
             mMetrics.incrementReceivedPacketsCounter();
-            if (packet.number_of_samples() > 0 &&
-                packet.data_type() !=
-                    UDataPacketImportAPI::V1::DATA_TYPE_UNKNOWN &&
-                packet.sampling_rate() > 0)
+            if (mStatistics){mStatistics->incrementReceivedPacketsCounter();}
+            auto validationResult = validatePacket(packet);
+            readSpan.end();
+            if (validationResult == PacketValidationResult::Valid)
             {
-                // Stream identifier
-                auto streamIdentifier = packet.stream_identifier();
-                auto network = streamIdentifier.network();
-                boost::algorithm::trim(network);
-                std::transform(network.begin(), network.end(),
-                               network.begin(), ::toupper);
-
-                auto station = streamIdentifier.station();
-                boost::algorithm::trim(station);
-                std::transform(station.begin(), station.end(),
-                               station.begin(), ::toupper);
-
-                auto channel = streamIdentifier.channel();
-                boost::algorithm::trim(channel);
-                std::transform(channel.begin(), channel.end(),
-                               channel.begin(), ::toupper);
-
-                auto locationCode = streamIdentifier.location_code();
-                boost::algorithm::trim(locationCode);
-                std::transform(locationCode.begin(), locationCode.end(),
-                               locationCode.begin(), ::toupper);
-                if (locationCode.empty()){locationCode = "--";}
-                if (!network.empty() && !station.empty() && !channel.empty())
+                Tracing::Span normalizeSpan{trace, "normalize"};
+                if (normalizeStreamIdentifier(
+                        packet.mutable_stream_identifier()))
                 {
-                    streamIdentifier.set_network(std::move(network));
-                    streamIdentifier.set_station(std::move(station));
-                    streamIdentifier.set_channel(std::move(channel));
-#ifndef NDEBUG
-                    assert(!locationCode.empty());
-#endif
-                    streamIdentifier.set_location_code(std::move(locationCode));
-                    *packet.mutable_stream_identifier()
-                        = std::move(streamIdentifier);
+                    const auto &streamIdentifier = packet.stream_identifier();
+                    // N.B. validation guarantees a positive sampling rate
+                    mMetrics.recordDataLatency(
+                        Metrics::DataLatencyStage::Ingest,
+                        streamIdentifier.network(),
+                        getDataLatency(packet,
+                                       std::chrono::system_clock::now()));
+                    mMetrics.incrementStreamPacketsCounter(
+                        streamIdentifier.network(),
+                        streamIdentifier.station(),
+                        streamIdentifier.channel(),
+                        streamIdentifier.location_code());
+                    normalizeSpan.end();
+                    FlightRecorder::record(
+                        FlightRecorder::EventType::PacketAccepted,
+                        packet.stream_identifier());
                     // Send it
                     try
                     {
+                        const Tracing::Scope scope{trace};
                         mCallback(std::move(packet));
                         mConsecutiveInvalidMessagesCounter = 0;
                     }
                     catch (const std::exception &e) 
                     {
-                        SPDLOG_LOGGER_WARN(mLogger, 
+                        RATE_LIMITED_LOGGER_WARN(mLogger,
                                    "{} failed to submit packet because {}",
                                    mPeer, std::string {e.what()});
                         mPacketsRejected++;
+                        if (mStatistics)
+                        {
+                            mStatistics->incrementRejectedPacketsCounter();
+                        }
                     }
                 }
                 else
                 {
-                    mPacketsRejected++;
-                    mConsecutiveInvalidMessagesCounter++;
+                    rejectPacket(
+                        PacketValidationResult::InvalidStreamIdentifier);
                 }
             }
             else
             {
                 // Skip packet and propagate
-                mPacketsRejected++;
-                mConsecutiveInvalidMessagesCounter++;
+                rejectPacket(validationResult);
             }
             // Are we just constantly erroring out?
             if (mConsecutiveInvalidMessagesCounter >
@@ -251,8 +264,7 @@ Publisher must provide access token in x-custom-auth-token header field.
 #ifndef NDEBUG
             assert(mPublishResponse != nullptr);
 #endif
-            mPublishResponse->set_total_packets(mTotalPackets);
-            mPublishResponse->set_packets_rejected(mPacketsRejected);
+            fillPublishResponse();
             Finish(grpc::Status::OK);
         }
 /*
@@ -273,11 +285,30 @@ Publisher must provide access token in x-custom-auth-token header field.
 */
     } 
 
+    void rejectPacket(const PacketValidationResult reason)
+    {
+        mPacketsRejected++;
+        if (mStatistics){mStatistics->incrementRejectedPacketsCounter();}
+        FlightRecorder::record(FlightRecorder::EventType::PacketRejected,
+                               mPacket.stream_identifier(),
+                               mConsecutiveInvalidMessagesCounter + 1,
+                               static_cast<uint16_t> (reason));
+        mConsecutiveInvalidMessagesCounter++;
+        mMetrics.incrementRejectedPacketsCounter(reason);
+    }
+
+    void fillPublishResponse()
+    {
+        mPublishResponse->set_total_packets(mTotalPackets);
+        mPublishResponse->set_packets_rejected(mPacketsRejected);
+    }
+
     void OnDone() override 
     { 
 #ifndef NDEBUG
         assert(mKeepRunning != nullptr);
 #endif
+        if (mStatistics){mMetrics.unregisterPublisher(mStatistics);}
         // Client shutdown - decrement
         if (mKeepRunning->load())
         {
@@ -287,6 +318,9 @@ Publisher must provide access token in x-custom-auth-token header field.
                 = static_cast<double> (nPublishers)
                  /std::max(1, mMaximumNumberOfPublishers);
             mMetrics.updatePublisherUtilization(utilization);
+            FlightRecorder::record(FlightRecorder::EventType::PublisherLeft,
+                                   mPeer,
+                                   nPublishers);
             SPDLOG_LOGGER_INFO(mLogger,
                 "Async packet proxy frontend RPC completed for {} (number of publishers is now {})",
                 mPeer, nPublishers);
@@ -319,6 +353,8 @@ Publisher must provide access token in x-custom-auth-token header field.
     {
         UDataPacketImportProxy::Metrics::MetricsSingleton::getInstance()
     };
+    std::shared_ptr<UDataPacketImportProxy::Metrics::PublisherStatistics>
+        mStatistics{nullptr};
     std::string mPeer;
     UDataPacketImportAPI::V1::Packet mPacket;
     int mConsecutiveInvalidMessagesCounter{0};
@@ -331,12 +367,126 @@ Publisher must provide access token in x-custom-auth-token header field.
     std::atomic<bool> *mKeepRunning{nullptr};
 };
 
+/// Splits the CPUs this process may run on into contiguous subsets, one
+/// per frontend server.  When there are more servers than CPUs the
+/// servers share CPUs round-robin.
+[[nodiscard]] std::vector<cpu_set_t> makeCPUSubsets(const int numberOfServers)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    std::vector<int> cpus;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &allowed)){cpus.push_back(cpu);}
+        }
+    }
+    std::vector<cpu_set_t> subsets(numberOfServers);
+    for (auto &subset : subsets){CPU_ZERO(&subset);}
+    if (cpus.empty()){return subsets;}
+    const auto nCPUs = static_cast<int> (cpus.size());
+    for (int i = 0; i < std::max(nCPUs, numberOfServers); ++i)
+    {
+        const auto server = static_cast<int64_t> (i)*numberOfServers
+                           /std::max(nCPUs, numberOfServers);
+        CPU_SET(cpus[i%nCPUs], &subsets[server]);
+    }
+    return subsets;
+}
+
+/// SO_REUSEPORT lets any process of the same user bind a port that is
+/// already in use and the kernel then quietly splits the connections
+/// between them.  Before the frontend shares its port with itself this
+/// makes sure nobody else is listening there by binding it without
+/// SO_REUSEPORT.
+void throwIfAddressInUse(const std::string &host, const uint16_t port)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo *addresses{nullptr};
+    const auto service = std::to_string(port);
+    auto bindHost = host;
+    if (bindHost.size() > 1 && bindHost.front() == '[' && bindHost.back() == ']')
+    {
+        bindHost = bindHost.substr(1, bindHost.size() - 2);
+    }
+    const auto isWildcard = bindHost.empty() ||
+                            bindHost == "0.0.0.0" || bindHost == "::";
+    if (getaddrinfo(isWildcard ? nullptr : bindHost.c_str(),
+                    service.c_str(), &hints, &addresses) != 0)
+    {
+        return; // Let gRPC report the unresolvable address
+    }
+    std::unique_ptr<addrinfo, decltype(&freeaddrinfo)>
+        addressesOwner(addresses, &freeaddrinfo);
+    for (auto address = addresses; address != nullptr; address = address->ai_next)
+    {
+        const int descriptor = socket(address->ai_family,
+                                      address->ai_socktype | SOCK_CLOEXEC,
+                                      address->ai_protocol);
+        if (descriptor < 0){continue;}
+        const int one{1};
+        setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        const auto result = bind(descriptor, address->ai_addr,
+                                 address->ai_addrlen);
+        const auto error = errno;
+        close(descriptor);
+        if (result != 0 && error == EADDRINUSE)
+        {
+            throw std::runtime_error(host + ":" + service
+                                   + " is already in use by another process");
+        }
+    }
+}
+
 }
 
-class Frontend::FrontendImpl :
-    public UDataPacketImportAPI::V1::Frontend::CallbackService
+class Frontend::FrontendImpl
 {
 public:
+    /// Each server needs its own service instance.  The services all
+    /// forward to the same frontend so publishers on any server feed the
+    /// same pipeline and count against the same publisher limit.
+    class Service final :
+        public UDataPacketImportAPI::V1::Frontend::CallbackService
+    {
+    public:
+        explicit Service(FrontendImpl *frontend,
+                         const std::optional<cpu_set_t> &cpus = std::nullopt) :
+            mFrontend(frontend),
+            mCPUs(cpus)
+        {
+#ifndef NDEBUG
+            assert(mFrontend != nullptr);
+#endif
+        }
+        /// The RPC
+        grpc::ServerReadReactor<UDataPacketImportAPI::V1::Packet>*
+            Publish(grpc::CallbackServerContext* context,
+                    UDataPacketImportAPI::V1::PublishResponse *publishResponse) override
+        {
+            if (mCPUs){pinThread();}
+            return mFrontend->createReader(context, publishResponse);
+        }
+    private:
+        /// gRPC runs the reactors of every server on its own executor
+        /// threads so a thread is pinned to the CPU subset of the first
+        /// server that starts an RPC on it.  Pinning once per thread keeps
+        /// the affinity system call off the per-packet path.
+        void pinThread() const
+        {
+            thread_local bool pinned{false};
+            if (pinned){return;}
+            pinned = true;
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &*mCPUs);
+        }
+        FrontendImpl *mFrontend{nullptr};
+        std::optional<cpu_set_t> mCPUs;
+    };
+
     FrontendImpl
     (
         const FrontendOptions &options,
@@ -362,10 +512,13 @@ public:
     {
         mKeepRunning.store(false); 
         std::this_thread::sleep_for(std::chrono::milliseconds {10});
-        if (mServer)
+        if (!mServers.empty())
         {
             SPDLOG_LOGGER_INFO(mLogger, "Shutting down server");
-            mServer->Shutdown();
+            for (auto &server : mServers)
+            {
+                if (server){server->Shutdown();}
+            }
             SPDLOG_LOGGER_INFO(mLogger, "Server shut down");
         }
         mNumberOfPublishers.store(0);
@@ -377,54 +530,105 @@ public:
         mNumberOfPublishers.store(0);
         auto grpcOptions = mOptions.getGRPCOptions();
         auto address = makeAddress(grpcOptions);
-        grpc::ServerBuilder builder;
-        //constexpr std::chrono::milliseconds maxIdle{std::chrono::seconds {1}};
-        //auto idleOption = grpc::MakeChannelArgumentOption( GRPC_ARG_MAX_CONNECTION_IDLE_MS, maxIdle.count() );
-        //builder.SetOption(std::move(idleOption));
-        if (mOptions.getMaximumMessageSizeInBytes() > 0)
+        mSecured = grpcOptions.getServerKey() != std::nullopt &&
+                   grpcOptions.getServerCertificate() != std::nullopt;
+        if (mSecured)
         {
-            builder.SetMaxReceiveMessageSize(
-                mOptions.getMaximumMessageSizeInBytes());
+            SPDLOG_LOGGER_INFO(mLogger, "Initiating secured proxy frontend");
         }
-        if (grpcOptions.getServerKey() == std::nullopt ||
-            grpcOptions.getServerCertificate() == std::nullopt)
-        { 
+        else
+        {
             SPDLOG_LOGGER_INFO(mLogger,
                                "Initiating non-secured proxy frontend");
-            builder.AddListeningPort(address,
-                                     grpc::InsecureServerCredentials());
-            builder.RegisterService(this);
-            mSecured = false;
         }
-        else
-        {   
+        mServers.clear();
+        mServices.clear();
+        const auto numberOfServers = mOptions.getNumberOfServers();
+        std::vector<cpu_set_t> cpuSubsets;
+        if (numberOfServers > 1)
+        {
+            ::throwIfAddressInUse(grpcOptions.getHost(),
+                                  grpcOptions.getPort());
+            cpuSubsets = ::makeCPUSubsets(numberOfServers);
+        }
+        for (int i = 0; i < numberOfServers; ++i)
+        {
+            if (numberOfServers > 1)
+            {
+                mServices.push_back(
+                    std::make_unique<Service> (this, cpuSubsets.at(i)));
+            }
+            else
+            {
+                mServices.push_back(std::make_unique<Service> (this));
+            }
+            grpc::ServerBuilder builder;
+            //constexpr std::chrono::milliseconds maxIdle{std::chrono::seconds {1}};
+            //auto idleOption = grpc::MakeChannelArgumentOption( GRPC_ARG_MAX_CONNECTION_IDLE_MS, maxIdle.count() );
+            //builder.SetOption(std::move(idleOption));
+            if (mOptions.getMaximumMessageSizeInBytes() > 0)
+            {
+                builder.SetMaxReceiveMessageSize(
+                    mOptions.getMaximumMessageSizeInBytes());
+            }
+            applyServerTuning(grpcOptions, "frontend", &builder);
+            // N.B. Every server binds the same address so the kernel has
+            // to be told that the port is shared.  gRPC enables
+            // SO_REUSEPORT by default on Linux which would let a second
+            // proxy silently take half the publishers so a single server
+            // turns it off and binding an address in use fails.
+            builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT,
+                                       numberOfServers > 1 ? 1 : 0);
+            if (!mSecured)
+            {
+                builder.AddListeningPort(address,
+                                         grpc::InsecureServerCredentials());
+            }
+            else
+            {
 #ifndef NDEBUG
-            assert(grpcOptions.getServerKey() != std::nullopt);
-            assert(grpcOptions.getServerCertificate() != std::nullopt);
+                assert(grpcOptions.getServerKey() != std::nullopt);
+                assert(grpcOptions.getServerCertificate() != std::nullopt);
 #endif
-            SPDLOG_LOGGER_INFO(mLogger, "Initiating secured proxy frontend");
-            const grpc::SslServerCredentialsOptions::PemKeyCertPair keyCertPair
+                const grpc::SslServerCredentialsOptions::PemKeyCertPair
+                    keyCertPair
+                {
+                    *grpcOptions.getServerKey(),        // Private key
+                    *grpcOptions.getServerCertificate() // Public key (cert chain)
+                };
+                grpc::SslServerCredentialsOptions sslOptions; 
+                sslOptions.pem_key_cert_pairs.emplace_back(keyCertPair);
+                builder.AddListeningPort(
+                    address, grpc::SslServerCredentials(sslOptions));
+            }
+            builder.RegisterService(mServices.back().get());
+            auto server = builder.BuildAndStart();
+            if (server == nullptr)
             {
-                *grpcOptions.getServerKey(),        // Private key
-                *grpcOptions.getServerCertificate() // Public key (cert chain)
-            };
-            grpc::SslServerCredentialsOptions sslOptions; 
-            sslOptions.pem_key_cert_pairs.emplace_back(keyCertPair);
-            builder.AddListeningPort(address,
-                                     grpc::SslServerCredentials(sslOptions));
-            builder.RegisterService(this);
-            mSecured = true;
+                stop();
+                throw std::runtime_error("Frontend failed to listen at "
+                                       + address);
+            }
+            mServers.push_back(std::move(server));
         }
 
-        SPDLOG_LOGGER_INFO(mLogger,
-                           "Frontend listening at {}", address);
-        mServer = builder.BuildAndStart();
+        if (numberOfServers > 1)
+        {
+            SPDLOG_LOGGER_INFO(mLogger,
+                               "Frontend listening at {} with {} servers",
+                               address, numberOfServers);
+        }
+        else
+        {
+            SPDLOG_LOGGER_INFO(mLogger,
+                               "Frontend listening at {}", address);
+        }
     }
 
-    /// The RPC
+    [[nodiscard]]
     grpc::ServerReadReactor<UDataPacketImportAPI::V1::Packet>*
-        Publish(grpc::CallbackServerContext* context,
-                UDataPacketImportAPI::V1::PublishResponse *publishResponse) override
+        createReader(grpc::CallbackServerContext* context,
+                     UDataPacketImportAPI::V1::PublishResponse *publishResponse)
     {
         return new ::AsynchronousReader(
             mOptions,
@@ -437,7 +641,7 @@ public:
             &mKeepRunning);
     }
 
-    ~FrontendImpl() override
+    ~FrontendImpl()
     {
         stop();
         std::this_thread::sleep_for(std::chrono::milliseconds {25});
@@ -447,7 +651,9 @@ public:
     std::function<void (UDataPacketImportAPI::V1::Packet &&)> mAddPacketCallback;
     std::shared_ptr<spdlog::logger> mLogger{nullptr};
     bool mSecured{false};
-    std::unique_ptr<grpc::Server> mServer{nullptr};
+    // N.B. The servers must be destroyed before the services they use
+    std::vector<std::unique_ptr<Service>> mServices;
+    std::vector<std::unique_ptr<grpc::Server>> mServers;
     std::atomic<int> mNumberOfPublishers{0};
     std::atomic<bool> mKeepRunning{true};
 };
@@ -482,6 +688,16 @@ bool Frontend::isRunning() const noexcept
     return pImpl->mKeepRunning.load();
 }
 
+std::shared_ptr<grpc::Channel> Frontend::createInProcessChannel() const
+{
+    if (pImpl->mServers.empty())
+    {
+        throw std::runtime_error("Frontend not started");
+    }
+    return pImpl->mServers.front()->InProcessChannel(
+        grpc::ChannelArguments {});
+}
+
 
 /*
 Frontend::Frontend(
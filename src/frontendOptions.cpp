@@ -13,6 +13,7 @@ public:
     int mMaximumNumberOfPublishers{64};
     int mMaximumMessageSizeInBytes{8192};
     int mMaximumConsecutiveInvalidMessages{10};
+    int mNumberOfServers{1};
 };
 
 /// Constructor
@@ -111,3 +112,18 @@ int FrontendOptions::getMaximumNumberOfPublishers() const noexcept
 {
     return pImpl->mMaximumNumberOfPublishers;
 }
+
+/// Number of servers
+void FrontendOptions::setNumberOfServers(const int numberOfServers)
+{
+    if (numberOfServers < 1)
+    {
+        throw std::invalid_argument("Number of servers must be positive");
+    }
+    pImpl->mNumberOfServers = numberOfServers;
+}
+
+int FrontendOptions::getNumberOfServers() const noexcept
+{
+    return pImpl->mNumberOfServers;
+}
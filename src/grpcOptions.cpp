@@ -1,5 +1,8 @@
 #include <string>
 #include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
 #include <filesystem>
 #include "uDataPacketImportProxy/grpcOptions.hpp"
 
@@ -36,8 +39,13 @@ public:
     std::string mServerKey;
     std::string mServerCertificate;
     std::string mClientCertificate;
+    std::optional<int64_t> mResourceQuota;
+    std::optional<int> mMaximumConcurrentStreams;
+    std::optional<int> mHTTP2StreamWindowSize;
+    std::optional<int> mHTTP2WriteBufferSize;
     uint16_t mPort{50000};
     bool mReflectionEnabled{false};
+    bool mHTTP2BDPProbeEnabled{true};
     bool mHaveServerCertificate{false}; 
     bool mHaveServerKey{false};
     bool mHaveClientCertificate{false};
@@ -202,3 +210,116 @@ bool GRPCOptions::reflectionEnabled() const noexcept
 { 
     return pImpl->mReflectionEnabled;
 }
+
+/// Presets
+void GRPCOptions::applyServerPreset(const ServerPreset preset) noexcept
+{
+    if (preset == ServerPreset::ManySmallStreams)
+    {
+        // Each client holds one stream so a small cap stops a misbehaving
+        // client from multiplexing many streams over a connection.  Fixed,
+        // modest windows keep dozens of connections from each growing
+        // megabytes of buffered data.
+        pImpl->mResourceQuota = 256*1024*1024;
+        pImpl->mMaximumConcurrentStreams = 16;
+        pImpl->mHTTP2StreamWindowSize = 256*1024;
+        pImpl->mHTTP2WriteBufferSize = 64*1024;
+        pImpl->mHTTP2BDPProbeEnabled = false;
+    }
+    else if (preset == ServerPreset::FewLargeStreams)
+    {
+        // Large windows and write buffers let a few streams keep the link
+        // full and the probe can grow the windows further.
+        pImpl->mResourceQuota = int64_t {1024}*1024*1024;
+        pImpl->mMaximumConcurrentStreams = 100;
+        pImpl->mHTTP2StreamWindowSize = 8*1024*1024;
+        pImpl->mHTTP2WriteBufferSize = 1024*1024;
+        pImpl->mHTTP2BDPProbeEnabled = true;
+    }
+    else
+    {
+        pImpl->mResourceQuota = std::nullopt;
+        pImpl->mMaximumConcurrentStreams = std::nullopt;
+        pImpl->mHTTP2StreamWindowSize = std::nullopt;
+        pImpl->mHTTP2WriteBufferSize = std::nullopt;
+        pImpl->mHTTP2BDPProbeEnabled = true;
+    }
+}
+
+/// Resource quota
+void GRPCOptions::setResourceQuotaInBytes(const int64_t quota)
+{
+    if (quota < 1)
+    {
+        throw std::invalid_argument("Resource quota must be positive");
+    }
+    pImpl->mResourceQuota = quota;
+}
+
+std::optional<int64_t> GRPCOptions::getResourceQuotaInBytes() const noexcept
+{
+    return pImpl->mResourceQuota;
+}
+
+/// Concurrent streams
+void GRPCOptions::setMaximumNumberOfConcurrentStreams(const int maxStreams)
+{
+    if (maxStreams < 1)
+    {
+        throw std::invalid_argument(
+           "Maximum number of concurrent streams must be positive");
+    }
+    pImpl->mMaximumConcurrentStreams = maxStreams;
+}
+
+std::optional<int>
+GRPCOptions::getMaximumNumberOfConcurrentStreams() const noexcept
+{
+    return pImpl->mMaximumConcurrentStreams;
+}
+
+/// HTTP/2 stream window
+void GRPCOptions::setHTTP2StreamWindowSizeInBytes(const int windowSize)
+{
+    if (windowSize < 1)
+    {
+        throw std::invalid_argument("Stream window size must be positive");
+    }
+    pImpl->mHTTP2StreamWindowSize = windowSize;
+}
+
+std::optional<int> GRPCOptions::getHTTP2StreamWindowSizeInBytes() const noexcept
+{
+    return pImpl->mHTTP2StreamWindowSize;
+}
+
+/// HTTP/2 write buffer
+void GRPCOptions::setHTTP2WriteBufferSizeInBytes(const int bufferSize)
+{
+    if (bufferSize < 1)
+    {
+        throw std::invalid_argument("Write buffer size must be positive");
+    }
+    pImpl->mHTTP2WriteBufferSize = bufferSize;
+}
+
+std::optional<int> GRPCOptions::getHTTP2WriteBufferSizeInBytes() const noexcept
+{
+    return pImpl->mHTTP2WriteBufferSize;
+}
+
+/// BDP probe
+void GRPCOptions::enableHTTP2BDPProbe() noexcept
+{
+    pImpl->mHTTP2BDPProbeEnabled = true;
+}
+
+void GRPCOptions::disableHTTP2BDPProbe() noexcept
+{
+    pImpl->mHTTP2BDPProbeEnabled = false;
+}
+
+bool GRPCOptions::http2BDPProbeEnabled() const noexcept
+{
+    return pImpl->mHTTP2BDPProbeEnabled;
+}
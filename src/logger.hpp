@@ -5,9 +5,14 @@
 #include <mutex>
 #include <filesystem>
 #include <memory>
+#include <vector>
+#include <chrono>
+#include <thread>
 #ifndef NDEBUG
 #include <cassert>
 #endif
+#include <spdlog/async.h>
+#include <spdlog/async_logger.h>
 #include <spdlog/logger.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/common.h>
@@ -20,7 +25,8 @@
 #include <opentelemetry/logs/provider.h>
 #include <opentelemetry/logs/logger_provider.h>
 #include <opentelemetry/sdk/logs/logger_provider_factory.h>
-#include <opentelemetry/sdk/logs/simple_log_record_processor_factory.h>
+#include <opentelemetry/sdk/logs/batch_log_record_processor_factory.h>
+#include <opentelemetry/sdk/logs/batch_log_record_processor_options.h>
 //#include "programOptions.hpp"
 #include "otelSpdlogSink.hpp"
 
@@ -32,6 +38,44 @@ namespace
 // NOLINTBEGIN(misc-include-cleaner)
 std::shared_ptr<opentelemetry::sdk::logs::LoggerProvider> loggerProvider{nullptr};
 // NOLINTEND(misc-include-cleaner)
+// The async loggers only hold a weak reference to their thread pool
+std::shared_ptr<spdlog::details::thread_pool> loggerThreadPool{nullptr};
+
+/// Makes a logger whose sinks run on a background thread.  When the queue
+/// fills the oldest messages are overwritten so a burst of logging never
+/// blocks a thread handling packets.
+[[nodiscard]] std::shared_ptr<spdlog::logger>
+    makeAsynchronousLogger(const std::string &name,
+                           std::vector<spdlog::sink_ptr> sinks)
+{
+    constexpr size_t queueSize{8192};
+    constexpr size_t nThreads{1};
+    if (loggerThreadPool == nullptr)
+    {
+        loggerThreadPool
+            = std::make_shared<spdlog::details::thread_pool> (queueSize,
+                                                              nThreads);
+    }
+    return std::make_shared<spdlog::async_logger>
+           (name,
+            sinks.begin(), sinks.end(),
+            loggerThreadPool,
+            spdlog::async_overflow_policy::overrun_oldest);
+}
+
+/// Batches log records for export rather than exporting each record
+/// synchronously from the thread that logged it
+[[nodiscard]] std::unique_ptr<opentelemetry::sdk::logs::LogRecordProcessor>
+    makeLogRecordProcessor(
+        std::unique_ptr<opentelemetry::sdk::logs::LogRecordExporter> &&exporter)
+{
+    opentelemetry::sdk::logs::BatchLogRecordProcessorOptions options;
+    options.max_queue_size = 4096;
+    options.max_export_batch_size = 512;
+    options.schedule_delay_millis = std::chrono::milliseconds {1000};
+    return opentelemetry::sdk::logs::BatchLogRecordProcessorFactory::Create(
+              std::move(exporter), options);
+}
 
 void setVerbosityForSPDLOG(const int verbosity,
                            spdlog::logger *logger)
@@ -62,9 +106,7 @@ std::shared_ptr<spdlog::logger>
         httpOptions.url = options.url + options.suffix;
         auto exporter
             = otel::exporter::otlp::OtlpHttpLogRecordExporterFactory::Create(httpOptions);
-        auto processor
-            = otel::sdk::logs::SimpleLogRecordProcessorFactory::Create(
-                 std::move(exporter));
+        auto processor = ::makeLogRecordProcessor(std::move(exporter));
         loggerProvider
             = otel::sdk::logs::LoggerProviderFactory::Create(
                 std::move(processor));
@@ -77,15 +119,12 @@ std::shared_ptr<spdlog::logger>
             = std::make_shared<spdlog::sinks::OpenTelemetrySink<std::mutex>> ();
         // NOLINTEND(misc-include-cleaner)
 
-        logger
-            = std::make_shared<spdlog::logger>
-              (spdlog::logger ("OTelLogger", {otelLogger, consoleSink}));
+        logger = ::makeAsynchronousLogger("OTelLogger",
+                                          {otelLogger, consoleSink});
     }
     else
     {
-        logger
-            = std::make_shared<spdlog::logger>
-              (spdlog::logger ("", {consoleSink}));
+        logger = ::makeAsynchronousLogger("", {consoleSink});
     }
     // Verbosity
     ::setVerbosityForSPDLOG(verbosity, &*logger);
@@ -115,9 +154,7 @@ std::shared_ptr<spdlog::logger>
         }
         auto exporter
             = otel::exporter::otlp::OtlpGrpcLogRecordExporterFactory::Create(grpcOptions);
-        auto processor
-            = otel::sdk::logs::SimpleLogRecordProcessorFactory::Create(
-                 std::move(exporter));
+        auto processor = ::makeLogRecordProcessor(std::move(exporter));
         loggerProvider
             = otel::sdk::logs::LoggerProviderFactory::Create(
                 std::move(processor));
@@ -128,15 +165,12 @@ std::shared_ptr<spdlog::logger>
         auto otelLogger
             = std::make_shared<spdlog::sinks::OpenTelemetrySink<std::mutex>> ();
 
-        logger
-            = std::make_shared<spdlog::logger>
-              (spdlog::logger ("OTelLogger", {otelLogger, consoleSink}));
+        logger = ::makeAsynchronousLogger("OTelLogger",
+                                          {otelLogger, consoleSink});
     }
     else
     {
-        logger
-            = std::make_shared<spdlog::logger>
-              (spdlog::logger ("", {consoleSink}));
+        logger = ::makeAsynchronousLogger("", {consoleSink});
     }
     // Verbosity
     ::setVerbosityForSPDLOG(verbosity, &*logger);
@@ -172,6 +206,19 @@ std::shared_ptr<spdlog::logger> initialize(const auto &options)
 
 void cleanup()
 {
+    // Give the background thread a moment to hand off what is queued.
+    // N.B. The pool is not destroyed here since objects logging on their
+    // way out may outlive this call.
+    if (loggerThreadPool)
+    {
+        const auto deadline
+            = std::chrono::steady_clock::now() + std::chrono::seconds {2};
+        while (loggerThreadPool->queue_size() > 0 &&
+               std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds {10});
+        }
+    }
     if (loggerProvider)
     {   
         loggerProvider->ForceFlush();
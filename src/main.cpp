@@ -22,30 +22,56 @@ import metrics;
 #include <absl/log/initialize.h>
 #include <opentelemetry/metrics/meter_provider.h>
 #include <opentelemetry/metrics/provider.h>
+#include "uDataPacketImportProxy/admin.hpp"
+#include "uDataPacketImportProxy/grpcOptions.hpp"
 #include "uDataPacketImportProxy/proxy.hpp"
 #include "uDataPacketImportProxy/proxyOptions.hpp"
+#include "flightRecorder.hpp"
 #include "logger.hpp"
+#include "tracing.hpp"
 //#include "uDataPacketImportProxy/version.hpp"
 
 namespace
 {
 volatile std::sig_atomic_t mSignalStatus;
 std::atomic<bool> mInterrupted{false};
+std::atomic<bool> mFlightRecorderDumpRequested{false};
 
 opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
     receivedPacketsCounter;
 opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
     sentPacketsCounter;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    rejectedPacketsCounter;
 opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
     publisherUtilizationGauge;
 opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
     subscriberUtilizationGauge;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    latencyCounter;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    dataLatencyCounter;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    droppedPacketsCounter;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    queueDepthGauge;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    queueHighWaterMarkGauge;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    subscriberQueueDepthGauge;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    subscriberLagGauge;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    subscriberSentPacketsCounter;
+opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+    subscriberDroppedPacketsCounter;
 
 class ServerImpl
 {
 public:
     explicit ServerImpl(const UDataPacketImportProxy::Options::ProgramOptions &options,
                         std::shared_ptr<spdlog::logger> logger) :
+        mOptions(options),
         mLogger(std::move(logger))
     {
 #ifndef NDEBUG
@@ -54,6 +80,12 @@ public:
         mProxy
            = std::make_unique<UDataPacketImportProxy::Proxy>
              (options.proxyOptions, mLogger); 
+        if (options.adminOptions)
+        {
+            mAdmin
+               = std::make_unique<UDataPacketImportProxy::Admin>
+                 (*options.adminOptions, mLogger);
+        }
         // Metrics
         if (options.exportMetrics)
         {
@@ -85,6 +117,15 @@ public:
                 UDataPacketImportProxy::Metrics::observeNumberOfPacketsSent,
                 nullptr);
 
+            rejectedPacketsCounter
+                = meter->CreateInt64ObservableCounter(
+                  "seismic_data.import.grpc_proxy.client.rejected.packets",
+                  "Number of invalid packets rejected by the import proxy frontend by reason",
+                  "{packet}");
+            rejectedPacketsCounter->AddCallback(
+                UDataPacketImportProxy::Metrics::observeNumberOfPacketsRejected,
+                nullptr);
+
             publisherUtilizationGauge
                 = meter->CreateDoubleObservableGauge(
                   "seismic_data.import.grpc_proxy.client.utilization",
@@ -103,6 +144,86 @@ public:
                 UDataPacketImportProxy::Metrics::observeSubscriberUtilization,
                 nullptr);
 
+            latencyCounter
+                = meter->CreateInt64ObservableCounter(
+                  "seismic_data.import.grpc_proxy.latency",
+                  "Cumulative number of packets whose latency in each proxy stage is below the le bucket bound in microseconds",
+                  "{packet}");
+            latencyCounter->AddCallback(
+                UDataPacketImportProxy::Metrics::observeLatencies,
+                nullptr);
+
+            dataLatencyCounter
+                = meter->CreateInt64ObservableCounter(
+                  "seismic_data.import.grpc_proxy.data_latency",
+                  "Cumulative number of packets entering and leaving the proxy by network whose last sample's age is below the le bucket bound in microseconds",
+                  "{packet}");
+            dataLatencyCounter->AddCallback(
+                UDataPacketImportProxy::Metrics::observeDataLatencies,
+                nullptr);
+
+            droppedPacketsCounter
+                = meter->CreateInt64ObservableCounter(
+                  "seismic_data.import.grpc_proxy.dropped.packets",
+                  "Number of packets discarded by the import proxy by reason; invalid packets are counted by the rejected packets counter",
+                  "{packet}");
+            droppedPacketsCounter->AddCallback(
+                UDataPacketImportProxy::Metrics::observeNumberOfPacketsDropped,
+                nullptr);
+
+            queueDepthGauge
+                = meter->CreateInt64ObservableGauge(
+                  "seismic_data.import.grpc_proxy.queue.depth",
+                  "Number of packets in each of the import proxy's queues",
+                  "{packet}");
+            queueDepthGauge->AddCallback(
+                UDataPacketImportProxy::Metrics::observeQueueDepths,
+                nullptr);
+
+            queueHighWaterMarkGauge
+                = meter->CreateInt64ObservableGauge(
+                  "seismic_data.import.grpc_proxy.queue.high_water_mark",
+                  "Largest depth of each of the import proxy's queues over the export interval or, when scraped, since startup",
+                  "{packet}");
+            queueHighWaterMarkGauge->AddCallback(
+                UDataPacketImportProxy::Metrics::observeQueueHighWaterMarks,
+                nullptr);
+
+            subscriberQueueDepthGauge
+                = meter->CreateInt64ObservableGauge(
+                  "seismic_data.import.grpc_proxy.server.subscriber.queue.depth",
+                  "Number of packets waiting to be sent to each subscriber",
+                  "{packet}");
+            subscriberQueueDepthGauge->AddCallback(
+                UDataPacketImportProxy::Metrics::observeSubscriberQueueDepths,
+                nullptr);
+
+            subscriberLagGauge
+                = meter->CreateDoubleObservableGauge(
+                  "seismic_data.import.grpc_proxy.server.subscriber.lag",
+                  "Time the packet most recently sent to each subscriber waited in its queue",
+                  "s");
+            subscriberLagGauge->AddCallback(
+                UDataPacketImportProxy::Metrics::observeSubscriberLags,
+                nullptr);
+
+            subscriberSentPacketsCounter
+                = meter->CreateInt64ObservableCounter(
+                  "seismic_data.import.grpc_proxy.server.subscriber.sent.packets",
+                  "Number of packets sent to each subscriber",
+                  "{packet}");
+            subscriberSentPacketsCounter->AddCallback(
+                UDataPacketImportProxy::Metrics::observeSubscriberPacketsSent,
+                nullptr);
+
+            subscriberDroppedPacketsCounter
+                = meter->CreateInt64ObservableCounter(
+                  "seismic_data.import.grpc_proxy.server.subscriber.dropped.packets",
+                  "Number of packets dropped because each subscriber fell behind",
+                  "{packet}");
+            subscriberDroppedPacketsCounter->AddCallback(
+                UDataPacketImportProxy::Metrics::observeSubscriberPacketsDropped,
+                nullptr);
         }
     }
 
@@ -116,6 +237,7 @@ public:
         std::this_thread::sleep_for (std::chrono::milliseconds {10});
         mKeepRunning = true;
         mProxy->start();
+        if (mAdmin){mAdmin->start();}
         handleMainThread();
     }
 
@@ -126,6 +248,7 @@ public:
         assert(mProxy != nullptr);
 #endif
         mKeepRunning = false;
+        if (mAdmin){mAdmin->stop();}
         if (mProxy){mProxy->stop();}
         for (auto &future : mFutures)
         { 
@@ -220,9 +343,14 @@ public:
                     SPDLOG_LOGGER_CRITICAL(
                        mLogger,
                        "Futures exception caught; terminating app");
+                    dumpFlightRecorder();
                     mStopRequested = true;
                     break;
                 }   
+                if (mFlightRecorderDumpRequested.exchange(false))
+                {
+                    dumpFlightRecorder();
+                }
                 printSummary();
                 std::unique_lock<std::mutex> lock(mStopMutex);
                 constexpr std::chrono::milliseconds wait{100};
@@ -263,6 +391,7 @@ public:
     {   
         std::signal(SIGINT,  ServerImpl::signalHandler);
         std::signal(SIGTERM, ServerImpl::signalHandler);
+        std::signal(SIGUSR1, ServerImpl::flightRecorderSignalHandler);
     }   
 
     static void signalHandler(const int signal)
@@ -271,12 +400,38 @@ public:
         mInterrupted.store(true);
     } 
 
+    /// The dump does I/O so it is deferred to the main thread
+    static void flightRecorderSignalHandler(const int )
+    {
+        mFlightRecorderDumpRequested.store(true);
+    }
+
+    /// Writes the recent pipeline events to disk
+    void dumpFlightRecorder()
+    {
+        try
+        {
+            auto fileName
+                = UDataPacketImportProxy::FlightRecorder::dump(
+                     mOptions.flightRecorderDirectory);
+            SPDLOG_LOGGER_INFO(mLogger, "Wrote flight recorder to {}",
+                               fileName.string());
+        }
+        catch (const std::exception &e)
+        {
+            SPDLOG_LOGGER_ERROR(mLogger,
+                                "Failed to write flight recorder because {}",
+                                std::string {e.what()});
+        }
+    }
+
 //private:
     UDataPacketImportProxy::Options::ProgramOptions mOptions;
     std::shared_ptr<spdlog::logger> mLogger{nullptr};
     mutable std::mutex mStopMutex;
     std::vector<std::future<void>> mFutures;
     std::unique_ptr<UDataPacketImportProxy::Proxy> mProxy{nullptr};
+    std::unique_ptr<UDataPacketImportProxy::Admin> mAdmin{nullptr};
     std::condition_variable mStopCondition;
     std::chrono::microseconds mLastPrintSummary
     {
@@ -342,21 +497,52 @@ int main(int argc, char *argv[])
             SPDLOG_LOGGER_INFO(logger, "Initializing metrics");
             UDataPacketImportProxy::Metrics::initialize(programOptions);
         }
+        if (programOptions.exportTraces)
+        {
+            SPDLOG_LOGGER_INFO(logger, "Tracing one in {} packets",
+                               programOptions.traceSamplingPeriod);
+            if (programOptions.exportTracesWithHTTP)
+            {
+                UDataPacketImportProxy::Tracing::initialize(
+                    programOptions.otelHTTPTraceOptions,
+                    programOptions.traceSamplingPeriod);
+            }
+            else
+            {
+                UDataPacketImportProxy::Tracing::initialize(
+                    programOptions.otelGRPCTraceOptions,
+                    programOptions.traceSamplingPeriod);
+            }
+        }
     }
     catch (const std::exception &e)
     {
         SPDLOG_LOGGER_CRITICAL(logger,
-                               "Failed to initialize metrics because {}",
+                           "Failed to initialize metrics or tracing because {}",
                                std::string {e.what()});
         UDataPacketImportProxy::Logger::cleanup();
         return EXIT_FAILURE;
     }
  
+    UDataPacketImportProxy::FlightRecorder::setEventsPerThread(
+        programOptions.flightRecorderEventsPerThread);
+    try
+    {
+        UDataPacketImportProxy::FlightRecorder::installCrashHandlers(
+            programOptions.flightRecorderDirectory);
+    }
+    catch (const std::exception &e)
+    {
+        SPDLOG_LOGGER_WARN(logger,
+                           "Flight recorder will not be dumped on a crash because {}",
+                           std::string {e.what()});
+    }
     absl::InitializeLog();
     try
     {
         ::ServerImpl server{programOptions, logger};
         server.start();
+        UDataPacketImportProxy::Tracing::cleanup();
         UDataPacketImportProxy::Metrics::cleanup();
         UDataPacketImportProxy::Logger::cleanup();
     }
@@ -364,6 +550,18 @@ int main(int argc, char *argv[])
     {
         SPDLOG_LOGGER_CRITICAL(logger, "Proxy service exited with error {}",
                                std::string {e.what()});
+        try
+        {
+            auto fileName
+                = UDataPacketImportProxy::FlightRecorder::dump(
+                     programOptions.flightRecorderDirectory);
+            SPDLOG_LOGGER_INFO(logger, "Wrote flight recorder to {}",
+                               fileName.string());
+        }
+        catch (...)
+        {
+        }
+        UDataPacketImportProxy::Tracing::cleanup();
         UDataPacketImportProxy::Metrics::cleanup();
         UDataPacketImportProxy::Logger::cleanup();
         return EXIT_FAILURE;
@@ -1,14 +1,131 @@
 module;
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
 export module getNow;
 
 namespace UDataPacketImportProxy::Utilities
 {
-export std::chrono::microseconds getNow() 
+export std::chrono::microseconds getNow()
 {
-     auto now 
+     auto now
         = std::chrono::duration_cast<std::chrono::microseconds>
           ((std::chrono::high_resolution_clock::now()).time_since_epoch());
      return now;
 }
+
+/// @brief A source of time.  Components that take a clock rather than
+///        reading the system clocks directly can be driven in simulated
+///        time by a VirtualClock.
+export class Clock
+{
+public:
+    /// @result The monotonic time used for latencies and deadlines.
+    [[nodiscard]] virtual std::chrono::steady_clock::time_point now() const = 0;
+    /// @result The UTC time.
+    [[nodiscard]] virtual std::chrono::system_clock::time_point getUTCNow() const = 0;
+    /// @brief Waits for the given duration.
+    virtual void sleepFor(const std::chrono::nanoseconds &duration) = 0;
+    /// @brief Destructor.
+    virtual ~Clock() = default;
+};
+
+/// @brief The steady and system clocks.
+export class SystemClock final : public Clock
+{
+public:
+    [[nodiscard]] std::chrono::steady_clock::time_point now() const override
+    {
+        return std::chrono::steady_clock::now();
+    }
+    [[nodiscard]] std::chrono::system_clock::time_point getUTCNow() const override
+    {
+        return std::chrono::system_clock::now();
+    }
+    void sleepFor(const std::chrono::nanoseconds &duration) override
+    {
+        std::this_thread::sleep_for(duration);
+    }
+};
+
+/// @result The process's system clock.
+export [[nodiscard]] std::shared_ptr<Clock> getSystemClock()
+{
+    static const auto clock = std::make_shared<SystemClock> ();
+    return clock;
+}
+
+/// @brief A clock that only moves when told to.  Sleeping advances the
+///        clock rather than blocking so a single-threaded simulation can
+///        cover hours of traffic in seconds and reproduce the same result
+///        every time.
+/// @note The steady time starts at the steady clock's epoch.
+export class VirtualClock final : public Clock
+{
+public:
+    /// @param[in] utcStart  The UTC time at which the clock starts.
+    explicit VirtualClock(const std::chrono::system_clock::time_point &utcStart
+                              = std::chrono::system_clock::time_point {}) :
+        mUTCStart(utcStart)
+    {
+    }
+    [[nodiscard]] std::chrono::steady_clock::time_point now() const override
+    {
+        return std::chrono::steady_clock::time_point {}
+             + std::chrono::duration_cast<std::chrono::steady_clock::duration>
+               (getElapsedTime());
+    }
+    [[nodiscard]] std::chrono::system_clock::time_point getUTCNow() const override
+    {
+        return mUTCStart
+             + std::chrono::duration_cast<std::chrono::system_clock::duration>
+               (getElapsedTime());
+    }
+    /// @brief Advances the clock by the duration.
+    void sleepFor(const std::chrono::nanoseconds &duration) override
+    {
+        advance(duration);
+    }
+    /// @brief Advances the clock.
+    /// @throws std::invalid_argument if the duration is negative.
+    void advance(const std::chrono::nanoseconds &duration)
+    {
+        if (duration.count() < 0)
+        {
+            throw std::invalid_argument("Cannot advance clock backwards");
+        }
+        mElapsed.fetch_add(duration.count());
+    }
+    /// @brief Advances the clock to the given time.  Times in the past are
+    ///        ignored.
+    void advanceTo(const std::chrono::steady_clock::time_point &time)
+    {
+        const auto target
+            = std::chrono::duration_cast<std::chrono::nanoseconds>
+              (time.time_since_epoch()).count();
+        auto elapsed = mElapsed.load();
+        while (elapsed < target &&
+               !mElapsed.compare_exchange_weak(elapsed, target))
+        {
+        }
+    }
+    /// @result The time elapsed since the clock started.
+    [[nodiscard]] std::chrono::nanoseconds getElapsedTime() const noexcept
+    {
+        return std::chrono::nanoseconds {mElapsed.load()};
+    }
+private:
+    std::chrono::system_clock::time_point mUTCStart;
+    std::atomic<int64_t> mElapsed{0};
+};
+
+/// @result The clock's UTC time in microseconds since the epoch.
+export std::chrono::microseconds getNow(const Clock &clock)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>
+           (clock.getUTCNow().time_since_epoch());
+}
 }
@@ -1,13 +1,21 @@
 module;
 
 #include <iostream>
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <map>
 #include <cstdint>
 #include <exception>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 #include <opentelemetry/nostd/shared_ptr.h>
 #include <opentelemetry/metrics/meter.h>
 #include <opentelemetry/metrics/meter_provider.h>
@@ -19,6 +27,10 @@ module;
 #include <opentelemetry/exporters/otlp/otlp_grpc_metric_exporter_factory.h>
 #include <opentelemetry/exporters/otlp/otlp_grpc_metric_exporter_options.h>
 #endif
+#ifdef WITH_PROMETHEUS
+#include <opentelemetry/exporters/prometheus/exporter_factory.h>
+#include <opentelemetry/exporters/prometheus/exporter_options.h>
+#endif
 #include <opentelemetry/sdk/metrics/export/periodic_exporting_metric_reader_factory.h>
 #include <opentelemetry/sdk/metrics/export/periodic_exporting_metric_reader_options.h>
 #include <opentelemetry/sdk/metrics/meter_context.h>
@@ -28,6 +40,7 @@ module;
 #include <opentelemetry/sdk/metrics/provider.h>
 #include <opentelemetry/sdk/metrics/view/instrument_selector_factory.h>
 #include <opentelemetry/sdk/metrics/view/meter_selector_factory.h>
+#include "packetValidator.hpp"
 
 export module metrics;
 import programOptions;
@@ -36,6 +49,11 @@ namespace
 {
 
 bool metricsInitialized{false};
+/// True when a periodic reader pushes the metrics.  Only then is there
+/// exactly one collector so only then may an observer report an interval
+/// and reset its state.  A pull exporter collects on every scrape and
+/// there may be several scrapers.
+bool periodicReader{false};
 
 void initializeHTTP(
     const bool exportMetrics,
@@ -75,6 +93,7 @@ void initializeHTTP(
     const std::shared_ptr<otel::metrics::MeterProvider>
         provider(std::move(metricsProvider));
     otel::sdk::metrics::Provider::SetMeterProvider(provider);
+    periodicReader = true;
     metricsInitialized = true;
 }
 
@@ -120,6 +139,38 @@ void initializeGRPC(
     const std::shared_ptr<otel::metrics::MeterProvider>
         provider(std::move(metricsProvider));
     otel::sdk::metrics::Provider::SetMeterProvider(provider);
+    periodicReader = true;
+    metricsInitialized = true;
+}
+#endif
+
+#ifdef WITH_PROMETHEUS
+/// Unlike the OTLP exporters there is no periodic reader.  The exporter
+/// collects the instruments only when Prometheus scrapes the endpoint.
+void initializePrometheus(
+    const bool exportMetrics,
+    const auto &prometheusMetricsOptions)
+{
+    if (!exportMetrics){return;}
+    namespace otel = opentelemetry;
+    otel::exporter::metrics::PrometheusExporterOptions exporterOptions;
+    exporterOptions.url = prometheusMetricsOptions.url;
+
+    auto reader
+        = otel::exporter::metrics::PrometheusExporterFactory::Create(
+             exporterOptions);
+
+    auto context = otel::sdk::metrics::MeterContextFactory::Create();
+    context->AddMetricReader(std::move(reader));
+
+    auto metricsProvider
+        = otel::sdk::metrics::MeterProviderFactory::Create(
+             std::move(context));
+
+    const std::shared_ptr<otel::metrics::MeterProvider>
+        provider(std::move(metricsProvider));
+    otel::sdk::metrics::Provider::SetMeterProvider(provider);
+    periodicReader = false;
     metricsInitialized = true;
 }
 #endif
@@ -133,6 +184,15 @@ export void initialize(
     // NOLINTNEXTLINE(misc-include-cleaner)
     const Options::ProgramOptions &options)
 {
+    if (options.exportMetricsWithPrometheus)
+    {
+#ifdef WITH_PROMETHEUS
+        return ::initializePrometheus(options.exportMetrics,
+                                      options.prometheusMetricsOptions);
+#else
+        throw std::runtime_error("Recompile with WITH_PROMETHEUS");
+#endif
+    }
     if (options.exportMetricsWithHTTP)
     {
         return ::initializeHTTP(options.exportMetrics,
@@ -198,136 +258,1344 @@ export void cleanup()
         std::shared_ptr<opentelemetry::metrics::MeterProvider> none;
         opentelemetry::sdk::metrics::Provider::SetMeterProvider(none);
     }
+    periodicReader = false;
     metricsInitialized = false;
 }
 
-export class MetricsSingleton
+/// Threads are handed shard indices round-robin on first use.  Every
+/// sharded metric uses the same index, modulo its number of shards, so a
+/// thread touches the same shard of each.
+[[nodiscard]] size_t getShardIndex() noexcept
+{
+    static std::atomic<size_t> nextIndex{0};
+    thread_local const size_t index
+    {
+        nextIndex.fetch_add(1, std::memory_order_relaxed)
+    };
+    return index;
+}
+
+/// A counter split into cache-line-sized shards.  Each thread increments
+/// its own shard so the gRPC callback threads do not fight over a single
+/// cache line.  Reads sum the shards and so should be infrequent, e.g.,
+/// in the metrics observer callbacks.
+export class ShardedCounter
 {
 public:
-    static MetricsSingleton &getInstance()
+    static constexpr int nShards{64};
+
+    /// Adds the value to the calling thread's shard
+    void add(const int64_t value = 1) noexcept
+    {
+        mShards[getShardIndex()%nShards].value.fetch_add(
+            value, std::memory_order_relaxed);
+    }
+
+    /// @result The sum over the shards
+    [[nodiscard]] int64_t load() const noexcept
+    {
+        int64_t result{0};
+        for (const auto &shard : mShards)
+        {
+            result = result + shard.value.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /// Zeros every shard
+    void reset() noexcept
+    {
+        for (auto &shard : mShards)
+        {
+            shard.value.store(0, std::memory_order_relaxed);
+        }
+    }
+private:
+    // N.B. std::hardware_destructive_interference_size is not ABI stable
+    // so just use the x86-64/aarch64 cache line size
+    struct alignas(64) Shard
+    {
+        std::atomic<int64_t> value{0};
+    };
+    std::array<Shard, nShards> mShards{};
+};
+
+/// Why a packet (or, for unauthenticated, an RPC) was discarded.
+export enum class DropReason : int
+{
+    ImportOverflow = 0, /*!< Evicted from the full import queue. */
+    SubscriberOverflow, /*!< Evicted from a full subscriber queue. */
+    WriterOverflow,     /*!< Evicted from a full RPC writer queue. */
+    Duplicate,          /*!< Removed by the duplicate packet detector. */
+    Unauthenticated,    /*!< A publisher or subscriber RPC was rejected for
+                             lacking a valid access token. */
+    SpoolOverflow       /*!< Refused by the full overflow spool while it
+                             held older packets. */
+};
+
+export constexpr int NumberOfDropReasons{6};
+
+export [[nodiscard]] constexpr const char *toString(const DropReason reason)
+{
+    constexpr std::array<const char *, NumberOfDropReasons> names
+    {
+        "import_overflow",
+        "subscriber_overflow",
+        "writer_overflow",
+        "duplicate",
+        "unauthenticated",
+        "spool_overflow"
+    };
+    return names[static_cast<size_t> (reason)];
+}
+
+/// The queues in the pipeline.  The subscriber and writer queues exist
+/// per subscriber so their depths are summed over subscribers and their
+/// high-water marks are the largest single queue.
+export enum class QueueType : int
+{
+    Import = 0, /*!< The proxy's import queue. */
+    Subscriber, /*!< The backend's per-subscriber packet streams. */
+    Writer      /*!< The per-RPC writer queues. */
+};
+
+export constexpr int NumberOfQueueTypes{3};
+
+export [[nodiscard]] constexpr const char *toString(const QueueType queue)
+{
+    constexpr std::array<const char *, NumberOfQueueTypes> names
+    {
+        "import",
+        "subscriber",
+        "writer"
+    };
+    return names[static_cast<size_t> (queue)];
+}
+
+/// Tracks the depth of a queue (or a family of queues) and the largest
+/// depth seen since the high-water mark was last taken.
+export class QueueDepth
+{
+public:
+    /// Adjusts the depth by the number of packets added (positive) or
+    /// removed (negative)
+    void add(const int64_t delta) noexcept
+    {
+        mDepth.add(delta);
+    }
+    /// Raises the high-water mark if the depth exceeds it.  This is
+    /// usually a single read of a line that rarely changes.
+    void updateHighWaterMark(const int64_t depth) noexcept
+    {
+        auto current = mHighWaterMark.load(std::memory_order_relaxed);
+        while (depth > current &&
+               !mHighWaterMark.compare_exchange_weak(current, depth,
+                                                     std::memory_order_relaxed))
+        {
+        }
+    }
+    [[nodiscard]] int64_t getDepth() const noexcept
+    {
+        return std::max<int64_t> (0, mDepth.load());
+    }
+    /// @result The high-water mark without resetting it.
+    [[nodiscard]] int64_t getHighWaterMark() const noexcept
+    {
+        return std::max(mHighWaterMark.load(std::memory_order_relaxed),
+                        getDepth());
+    }
+    /// @result The high-water mark since the previous call.
+    [[nodiscard]] int64_t takeHighWaterMark() noexcept
+    {
+        return std::max(mHighWaterMark.exchange(0, std::memory_order_relaxed),
+                        getDepth());
+    }
+    void reset() noexcept
+    {
+        mDepth.reset();
+        mHighWaterMark.store(0, std::memory_order_relaxed);
+    }
+private:
+    ShardedCounter mDepth;
+    std::atomic<int64_t> mHighWaterMark{0};
+};
+
+/// Statistics for a single publisher.  The publisher's RPC reader updates
+/// these and the admin service reads them.
+export class PublisherStatistics
+{
+public:
+    explicit PublisherStatistics(std::string name) :
+        mName(std::move(name))
     {
-        std::mutex mutex;
-        std::scoped_lock lock{mutex};
-        static MetricsSingleton instance;
-        return instance;
+    }
+    [[nodiscard]] const std::string &getName() const noexcept
+    {
+        return mName;
+    }
+    [[nodiscard]] std::chrono::steady_clock::time_point
+        getConnectTime() const noexcept
+    {
+        return mConnectTime;
     }
     void incrementReceivedPacketsCounter() noexcept
     {
-        mReceivedPacketsCounter.fetch_add(1);
+        mReceivedPacketsCounter.fetch_add(1, std::memory_order_relaxed);
     }
     [[nodiscard]] int64_t getReceivedPacketsCount() const noexcept
     {
-        return mReceivedPacketsCounter.load();
+        return mReceivedPacketsCounter.load(std::memory_order_relaxed);
     }
-    void incrementSentPacketsCounter() noexcept
+    void incrementRejectedPacketsCounter() noexcept
     {
-        mSentPacketsCounter.fetch_add(1);
+        mRejectedPacketsCounter.fetch_add(1, std::memory_order_relaxed);
     }
-    [[nodiscard]] int64_t getSentPacketsCount() const noexcept
+    [[nodiscard]] int64_t getRejectedPacketsCount() const noexcept
     {
-        return mSentPacketsCounter.load();
+        return mRejectedPacketsCounter.load(std::memory_order_relaxed);
     }
-    void updatePublisherUtilization(const double utilization)
+    /// @result The packet rate over the last rateWindow to 2*rateWindow
+    ///         seconds, or since connecting if that is sooner.  The rate is
+    ///         the change in the received count since a sample that is
+    ///         refreshed whenever the newest sample is a window old.
+    /// @note Only the readers take the samples' mutex so this never blocks
+    ///       the publisher's RPC reader.
+    [[nodiscard]] double getPacketsPerSecond(
+        const std::chrono::steady_clock::time_point now)
     {
-        mPublisherUtilization.store(utilization);
+        const auto nReceived = getReceivedPacketsCount();
+        const std::lock_guard<std::mutex> lock(mSamplesMutex);
+        if (now - mNewestSample.time >= rateWindow)
+        {
+            mOldestSample = mNewestSample;
+            mNewestSample = Sample {now, nReceived};
+        }
+        const auto seconds
+            = std::chrono::duration<double> (now - mOldestSample.time).count();
+        if (seconds <= 0){return 0;}
+        return std::max(0.0,
+                        static_cast<double> (nReceived - mOldestSample.count)
+                       /seconds);
     }
-    [[nodiscard]] double getPublisherUtilization() const noexcept
+    static constexpr std::chrono::seconds rateWindow{10};
+private:
+    struct Sample
+    {
+        std::chrono::steady_clock::time_point time;
+        int64_t count{0};
+    };
+    std::string mName;
+    std::chrono::steady_clock::time_point mConnectTime
+    {
+        std::chrono::steady_clock::now()
+    };
+    std::atomic<int64_t> mReceivedPacketsCounter{0};
+    std::atomic<int64_t> mRejectedPacketsCounter{0};
+    std::mutex mSamplesMutex;
+    Sample mOldestSample{mConnectTime, 0};
+    Sample mNewestSample{mConnectTime, 0};
+};
+
+/// Statistics for a single subscriber.  The subscriber's packet stream
+/// and RPC writer update these and the observers read them.
+export class SubscriberStatistics
+{
+public:
+    explicit SubscriberStatistics(std::string name) :
+        mName(std::move(name))
     {
-        return mPublisherUtilization.load();
     }
-    void updateSubscriberUtilization(const double utilization)
+    [[nodiscard]] const std::string &getName() const noexcept
     {
-        mSubscriberUtilization.store(utilization);
+        return mName;
     }
-    [[nodiscard]] double getSubscriberUtilization() const noexcept
+    /// The number of packets waiting for this subscriber
+    void updateQueueDepth(const int64_t depth) noexcept
     {
-        return mSubscriberUtilization.load();
+        mQueueDepth.store(depth, std::memory_order_relaxed);
     }
-    void resetCounters()
+    [[nodiscard]] int64_t getQueueDepth() const noexcept
     {
-        mReceivedPacketsCounter.store(0);
-        mSentPacketsCounter.store(0);
-    } 
-    MetricsSingleton(const MetricsSingleton &) = delete;
-    MetricsSingleton(MetricsSingleton &&) noexcept = delete;
-    MetricsSingleton& operator=(const MetricsSingleton &) = delete;
-    MetricsSingleton& operator=(MetricsSingleton &&) noexcept = delete;
+        return mQueueDepth.load(std::memory_order_relaxed);
+    }
+    /// How long the packet being written waited for this subscriber
+    void updateLag(const std::chrono::steady_clock::duration &lag) noexcept
+    {
+        mLag.store(std::chrono::duration<double> (lag).count(),
+                   std::memory_order_relaxed);
+    }
+    /// @result The lag in seconds
+    [[nodiscard]] double getLag() const noexcept
+    {
+        return mLag.load(std::memory_order_relaxed);
+    }
+    void incrementSentPacketsCounter() noexcept
+    {
+        mSentPacketsCounter.fetch_add(1, std::memory_order_relaxed);
+    }
+    [[nodiscard]] int64_t getSentPacketsCount() const noexcept
+    {
+        return mSentPacketsCounter.load(std::memory_order_relaxed);
+    }
+    void incrementDroppedPacketsCounter(const int64_t nPackets = 1) noexcept
+    {
+        mDroppedPacketsCounter.fetch_add(nPackets, std::memory_order_relaxed);
+    }
+    [[nodiscard]] int64_t getDroppedPacketsCount() const noexcept
+    {
+        return mDroppedPacketsCounter.load(std::memory_order_relaxed);
+    }
 private:
-    MetricsSingleton() = default;
-    ~MetricsSingleton() = default;
-    std::atomic<int64_t> mReceivedPacketsCounter{0};
+    std::string mName;
+    std::atomic<int64_t> mQueueDepth{0};
+    std::atomic<double> mLag{0};
     std::atomic<int64_t> mSentPacketsCounter{0};
-    std::atomic<double> mPublisherUtilization{0};
-    std::atomic<double> mSubscriberUtilization{0};
+    std::atomic<int64_t> mDroppedPacketsCounter{0};
 };
 
-export void initializeMetricsSingleton()
+/// The stages a packet passes through on its way from a publisher to a
+/// subscriber.
+export enum class LatencyStage : int
 {
-    MetricsSingleton::getInstance();
+    ImportQueue = 0, /*!< Frontend receipt to the propagator. */
+    Deduplication,   /*!< Duplicate detection in the propagator. */
+    Fanout,          /*!< Copying the packet to every subscriber queue. */
+    SubscriberQueue, /*!< Subscriber queue to the start of the write. */
+    EndToEnd         /*!< Frontend receipt to the start of the write. */
+};
+
+export constexpr int NumberOfLatencyStages{5};
+
+export [[nodiscard]] constexpr const char *toString(const LatencyStage stage)
+{
+    constexpr std::array<const char *, NumberOfLatencyStages> names
+    {
+        "import_queue",
+        "deduplication",
+        "fanout",
+        "subscriber_queue",
+        "end_to_end"
+    };
+    return names[static_cast<size_t> (stage)];
 }
 
-export void observeNumberOfPacketsReceived(
-    opentelemetry::metrics::ObserverResult observerResult,
-    void *)
+/// A lock-free log-linear histogram of latencies in microseconds.  Each
+/// power of two is split into 8 linear sub-buckets so any recorded value
+/// is within 12.5 pct of its bucket's upper bound.  Bucket i holds the
+/// latencies in (toLowerBound(i), toLowerBound(i + 1)] so the count below
+/// a bucket edge is the number of latencies less than or equal to it.
+/// Like ShardedCounter, the buckets are split into cache-line-aligned
+/// shards so recording is a relaxed atomic increment on the calling
+/// thread's shard.
+export class LatencyHistogram
 {
-    if (opentelemetry::nostd::holds_alternative
-        <
-            opentelemetry::nostd::shared_ptr
-            <
-                opentelemetry::metrics::ObserverResultT<int64_t>
-            >
-        > (observerResult))
+public:
+    static constexpr int subBucketBits{3};
+    static constexpr int nSubBuckets{1 << subBucketBits};
+    // Up to 2^40 microseconds (about 12 days)
+    static constexpr int maximumBits{40};
+    static constexpr int nBuckets{(maximumBits - subBucketBits + 1)*nSubBuckets};
+    // N.B. A shard is about 2.4 kB so use fewer shards than ShardedCounter
+    static constexpr int nShards{16};
+
+    /// Records the latency
+    void record(const std::chrono::steady_clock::duration &latency) noexcept
     {
-        auto observer = opentelemetry::nostd::get
-        <
-            opentelemetry::nostd::shared_ptr
-            <
-               opentelemetry::metrics::ObserverResultT<int64_t>
-            >
-        > (observerResult);
-        try
+        // Round up so a latency is counted at or below an edge only when
+        // it does not exceed the edge
+        auto microSeconds
+            = std::chrono::ceil<std::chrono::microseconds> (latency).count();
+        auto value = static_cast<uint64_t> (std::max<int64_t> (1, microSeconds));
+        mShards[getShardIndex()%nShards]
+            .counts[static_cast<size_t> (toIndex(value - 1))]
+            .fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// @result The bucket index for the value in microseconds
+    [[nodiscard]] static constexpr int toIndex(const uint64_t value) noexcept
+    {
+        if (value < nSubBuckets){return static_cast<int> (value);}
+        const int magnitude = std::bit_width(value) - 1;
+        if (magnitude >= maximumBits){return nBuckets - 1;}
+        const int shift = magnitude - subBucketBits;
+        const auto subBucket
+            = static_cast<int> ((value >> shift) & (nSubBuckets - 1));
+        return (shift + 1)*nSubBuckets + subBucket;
+    }
+
+    /// @result The smallest value in microseconds that maps to this bucket
+    [[nodiscard]] static constexpr uint64_t toLowerBound(const int index) noexcept
+    {
+        if (index < nSubBuckets){return static_cast<uint64_t> (index);}
+        const int shift = index/nSubBuckets - 1;
+        const auto subBucket = static_cast<uint64_t> (index%nSubBuckets);
+        return (nSubBuckets + subBucket) << shift;
+    }
+
+    /// @result The bucket counts summed over the shards
+    [[nodiscard]] std::array<uint64_t, nBuckets> getCounts() const noexcept
+    {
+        std::array<uint64_t, nBuckets> result{};
+        for (const auto &shard : mShards)
         {
-            auto &instance = MetricsSingleton::getInstance();
-            auto value = instance.getReceivedPacketsCount();
-            observer->Observe(value);
+            for (size_t i = 0; i < result.size(); ++i)
+            {
+                result[i] = result[i]
+                          + shard.counts[i].load(std::memory_order_relaxed);
+            }
         }
-        catch (const std::exception &e)
-        {
+        return result;
+    }
 
+    /// Zeros every bucket
+    void reset() noexcept
+    {
+        for (auto &shard : mShards)
+        {
+            for (auto &count : shard.counts)
+            {
+                count.store(0, std::memory_order_relaxed);
+            }
         }
     }
+private:
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, nBuckets> counts{};
+    };
+    std::array<Shard, nShards> mShards{};
+};
+
+/// Where the data latency, i.e., the age of a packet's last sample, is
+/// measured.
+export enum class DataLatencyStage : int
+{
+    Ingest = 0, /*!< When the frontend accepts the packet. */
+    Egress      /*!< When the backend writes the packet to a subscriber. */
+};
+
+export constexpr int NumberOfDataLatencyStages{2};
+
+export [[nodiscard]] constexpr const char *toString(const DataLatencyStage stage)
+{
+    constexpr std::array<const char *, NumberOfDataLatencyStages> names
+    {
+        "ingest",
+        "egress"
+    };
+    return names[static_cast<size_t> (stage)];
 }
 
-export void observeNumberOfPacketsSent(
-    opentelemetry::metrics::ObserverResult observerResult,
-    void *)
+/// Assigns network codes to a fixed number of slots.  Slots are claimed
+/// with a compare-and-swap on the packed network code so a lookup is a
+/// hash and a short linear probe with no lock and no allocation.  Network
+/// codes longer than 8 characters or beyond the capacity share the
+/// overflow slot.
+export class NetworkTable
 {
-    if (opentelemetry::nostd::holds_alternative
-        <
-            opentelemetry::nostd::shared_ptr
-            <
-                opentelemetry::metrics::ObserverResultT<int64_t>
-            >
-        > (observerResult))
-    {   
-        auto observer = opentelemetry::nostd::get
-        <
-            opentelemetry::nostd::shared_ptr
-            <
-               opentelemetry::metrics::ObserverResultT<int64_t>
-            >
-        > (observerResult);
-        try
+public:
+    static constexpr int capacityBits{6};
+    static constexpr int capacity{1 << capacityBits};
+    static constexpr int overflowIndex{capacity};
+    static constexpr int nSlots{capacity + 1};
+
+    /// @result The slot for this network
+    [[nodiscard]] int getIndex(const std::string_view network) noexcept
+    {
+        const auto key = pack(network);
+        if (key == 0){return overflowIndex;}
+        // Fibonacci hashing
+        const auto hash = static_cast<int>
+                          ((key*0x9E3779B97F4A7C15ULL) >> (64 - capacityBits));
+        for (int probe = 0; probe < capacity; ++probe)
         {
-            auto &instance = MetricsSingleton::getInstance();
-            auto value = instance.getSentPacketsCount();
-            observer->Observe(value);
+            const auto index = (hash + probe) & (capacity - 1);
+            auto &slot = mKeys[static_cast<size_t> (index)];
+            auto current = slot.load(std::memory_order_acquire);
+            if (current == 0)
+            {
+                if (slot.compare_exchange_strong(current, key,
+                                                 std::memory_order_acq_rel))
+                {
+                    return index;
+                }
+                // current now holds whatever beat us to the slot
+            }
+            if (current == key){return index;}
         }
-        catch (const std::exception &e) 
+        return overflowIndex;
+    }
+
+    /// @result True indicates the slot has been claimed by a network
+    [[nodiscard]] bool isClaimed(const int index) const noexcept
+    {
+        if (index == overflowIndex){return true;}
+        return mKeys[static_cast<size_t> (index)].load(std::memory_order_acquire)
+            != 0;
+    }
+
+    /// @result The network code in this slot
+    [[nodiscard]] std::string getName(const int index) const
+    {
+        if (index == overflowIndex){return "other";}
+        const auto key
+            = mKeys[static_cast<size_t> (index)].load(std::memory_order_acquire);
+        std::string result;
+        for (int i = 0; i < 8; ++i)
+        {
+            const auto c = static_cast<char> ((key >> (8*i)) & 0xFF);
+            if (c == '\0'){break;}
+            result.push_back(c);
+        }
+        return result;
+    }
+private:
+    [[nodiscard]] static uint64_t pack(const std::string_view network) noexcept
+    {
+        if (network.size() > 8){return 0;}
+        uint64_t key{0};
+        for (size_t i = 0; i < network.size(); ++i)
+        {
+            key = key | (static_cast<uint64_t> (static_cast<uint8_t> (network[i]))
+                         << (8*i));
+        }
+        return key;
+    }
+    std::array<std::atomic<uint64_t>, capacity> mKeys{};
+};
+
+/// Counts packets per stream in a fixed number of slots.  Like the network
+/// table, a slot is claimed with a compare-and-swap on a hash of the stream
+/// name so counting is lock-free and allocation-free.  The claiming thread
+/// copies the name into the slot then publishes it so readers never see a
+/// partially written name.  Streams beyond the capacity are only counted
+/// in aggregate.
+export class StreamTable
+{
+public:
+    static constexpr int capacityBits{12};
+    static constexpr int capacity{1 << capacityBits};
+    static constexpr int maximumNameLength{47};
+
+    /// Counts a packet on this stream
+    void increment(const std::string_view network,
+                   const std::string_view station,
+                   const std::string_view channel,
+                   const std::string_view locationCode) noexcept
+    {
+        const std::array<std::string_view, 4> fields
         {
+            network, station, channel, locationCode
+        };
+        // FNV-1a over NETWORK.STATION.CHANNEL.LOCATION_CODE
+        uint64_t key{0xCBF29CE484222325ULL};
+        for (size_t i = 0; i < fields.size(); ++i)
+        {
+            if (i > 0){key = (key ^ '.')*0x100000001B3ULL;}
+            for (const auto c : fields[i])
+            {
+                key = (key ^ static_cast<uint8_t> (c))*0x100000001B3ULL;
+            }
+        }
+        if (key == 0){key = 1;}
+        const auto hash = static_cast<int>
+                          ((key*0x9E3779B97F4A7C15ULL) >> (64 - capacityBits));
+        for (int probe = 0; probe < maximumProbes; ++probe)
+        {
+            const auto index = (hash + probe) & (capacity - 1);
+            auto &slot = mSlots[static_cast<size_t> (index)];
+            auto current = slot.key.load(std::memory_order_acquire);
+            if (current == 0 &&
+                slot.key.compare_exchange_strong(current, key,
+                                                 std::memory_order_acq_rel))
+            {
+                size_t length{0};
+                for (size_t i = 0; i < fields.size(); ++i)
+                {
+                    if (i > 0 && length < maximumNameLength)
+                    {
+                        slot.name[length++] = '.';
+                    }
+                    for (const auto c : fields[i])
+                    {
+                        if (length == maximumNameLength){break;}
+                        slot.name[length++] = c;
+                    }
+                }
+                slot.name[length] = '\0';
+                slot.ready.store(true, std::memory_order_release);
+                slot.count.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (current == key)
+            {
+                slot.count.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        mOverflowCount.fetch_add(1, std::memory_order_relaxed);
+    }
 
+    /// @result The streams with the most packets in descending order
+    [[nodiscard]] std::vector<std::pair<std::string, int64_t>>
+        getBusiestStreams(const int maximumNumberOfStreams) const
+    {
+        std::vector<std::pair<std::string, int64_t>> result;
+        if (maximumNumberOfStreams < 1){return result;}
+        std::vector<std::pair<int64_t, int>> counts;
+        for (int index = 0; index < capacity; ++index)
+        {
+            const auto &slot = mSlots[static_cast<size_t> (index)];
+            if (!slot.ready.load(std::memory_order_acquire)){continue;}
+            counts.emplace_back(slot.count.load(std::memory_order_relaxed),
+                                index);
         }
-    }   
+        const auto nStreams
+            = std::min(counts.size(),
+                       static_cast<size_t> (maximumNumberOfStreams));
+        std::partial_sort(counts.begin(),
+                          counts.begin() + static_cast<std::ptrdiff_t> (nStreams),
+                          counts.end(),
+                          [](const auto &lhs, const auto &rhs)
+                          {
+                              return lhs.first > rhs.first;
+                          });
+        result.reserve(nStreams);
+        for (size_t i = 0; i < nStreams; ++i)
+        {
+            result.emplace_back(
+                std::string {mSlots[static_cast<size_t> (counts[i].second)]
+                                   .name.data()},
+                counts[i].first);
+        }
+        return result;
+    }
+
+    /// @result The number of packets on streams that did not fit in the table
+    [[nodiscard]] int64_t getOverflowCount() const noexcept
+    {
+        return mOverflowCount.load(std::memory_order_relaxed);
+    }
+private:
+    static constexpr int maximumProbes{64};
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> key{0};
+        std::atomic<int64_t> count{0};
+        std::atomic<bool> ready{false};
+        std::array<char, maximumNameLength + 1> name{};
+    };
+    std::array<Slot, capacity> mSlots{};
+    std::atomic<int64_t> mOverflowCount{0};
+};
+
+export class MetricsSingleton
+{
+public:
+    /// N.B. Initialization of function-local statics is thread-safe
+    static MetricsSingleton &getInstance() noexcept
+    {
+        static MetricsSingleton instance;
+        return instance;
+    }
+    void incrementReceivedPacketsCounter() noexcept
+    {
+        mReceivedPacketsCounter.add();
+    }
+    [[nodiscard]] int64_t getReceivedPacketsCount() const noexcept
+    {
+        return mReceivedPacketsCounter.load();
+    }
+    void incrementSentPacketsCounter() noexcept
+    {
+        mSentPacketsCounter.add();
+    }
+    [[nodiscard]] int64_t getSentPacketsCount() const noexcept
+    {
+        return mSentPacketsCounter.load();
+    }
+    void incrementRejectedPacketsCounter(
+        const PacketValidationResult reason) noexcept
+    {
+        mRejectedPacketsCounters[static_cast<size_t> (reason)].fetch_add(1);
+    }
+    [[nodiscard]] int64_t getRejectedPacketsCount(
+        const PacketValidationResult reason) const noexcept
+    {
+        return mRejectedPacketsCounters[static_cast<size_t> (reason)].load();
+    }
+    void incrementDroppedPacketsCounter(const DropReason reason,
+                                        const int64_t nPackets = 1) noexcept
+    {
+        mDroppedPacketsCounters[static_cast<size_t> (reason)].add(nPackets);
+    }
+    [[nodiscard]] int64_t getDroppedPacketsCount(
+        const DropReason reason) const noexcept
+    {
+        return mDroppedPacketsCounters[static_cast<size_t> (reason)].load();
+    }
+    /// Adjusts the depth of the queue and the high-water mark given the
+    /// individual queue's current size
+    void updateQueueDepth(const QueueType queue,
+                          const int64_t delta,
+                          const int64_t queueSize) noexcept
+    {
+        auto &queueDepth = mQueueDepths[static_cast<size_t> (queue)];
+        queueDepth.add(delta);
+        queueDepth.updateHighWaterMark(queueSize);
+    }
+    [[nodiscard]] QueueDepth &getQueueDepth(const QueueType queue) noexcept
+    {
+        return mQueueDepths[static_cast<size_t> (queue)];
+    }
+    /// Creates the statistics for a new publisher
+    [[nodiscard]] std::shared_ptr<PublisherStatistics>
+        registerPublisher(const std::string &name)
+    {
+        auto statistics = std::make_shared<PublisherStatistics> (name);
+        const std::lock_guard<std::mutex> lock(mPublishersMutex);
+        mPublisherStatistics.push_back(statistics);
+        return statistics;
+    }
+    /// Stops reporting the publisher's statistics
+    void unregisterPublisher(
+        const std::shared_ptr<PublisherStatistics> &statistics)
+    {
+        const std::lock_guard<std::mutex> lock(mPublishersMutex);
+        std::erase(mPublisherStatistics, statistics);
+    }
+    [[nodiscard]] std::vector<std::shared_ptr<PublisherStatistics>>
+        getPublisherStatistics() const
+    {
+        const std::lock_guard<std::mutex> lock(mPublishersMutex);
+        return mPublisherStatistics;
+    }
+    /// Creates the statistics for a new subscriber
+    [[nodiscard]] std::shared_ptr<SubscriberStatistics>
+        registerSubscriber(const std::string &name)
+    {
+        auto statistics = std::make_shared<SubscriberStatistics> (name);
+        const std::lock_guard<std::mutex> lock(mSubscribersMutex);
+        mSubscriberStatistics.push_back(statistics);
+        return statistics;
+    }
+    /// Stops reporting the subscriber's statistics
+    void unregisterSubscriber(
+        const std::shared_ptr<SubscriberStatistics> &statistics)
+    {
+        const std::lock_guard<std::mutex> lock(mSubscribersMutex);
+        std::erase(mSubscriberStatistics, statistics);
+    }
+    [[nodiscard]] std::vector<std::shared_ptr<SubscriberStatistics>>
+        getSubscriberStatistics() const
+    {
+        const std::lock_guard<std::mutex> lock(mSubscribersMutex);
+        return mSubscriberStatistics;
+    }
+    void recordLatency(const LatencyStage stage,
+                       const std::chrono::steady_clock::duration &latency) noexcept
+    {
+        mLatencyHistograms[static_cast<size_t> (stage)].record(latency);
+    }
+    [[nodiscard]] const LatencyHistogram &getLatencyHistogram(
+        const LatencyStage stage) const noexcept
+    {
+        return mLatencyHistograms[static_cast<size_t> (stage)];
+    }
+    /// Records the age of the packet's last sample for the network
+    void recordDataLatency(const DataLatencyStage stage,
+                           const std::string_view network,
+                           const std::chrono::microseconds &latency) noexcept
+    {
+        const auto index = mNetworks.getIndex(network);
+        mDataLatencyHistograms[static_cast<size_t> (index)]
+                              [static_cast<size_t> (stage)].record(latency);
+    }
+    [[nodiscard]] const NetworkTable &getNetworkTable() const noexcept
+    {
+        return mNetworks;
+    }
+    [[nodiscard]] const LatencyHistogram &getDataLatencyHistogram(
+        const int networkIndex, const DataLatencyStage stage) const
+    {
+        return mDataLatencyHistograms.at(static_cast<size_t> (networkIndex))
+                                     [static_cast<size_t> (stage)];
+    }
+    /// Counts a packet on the stream
+    void incrementStreamPacketsCounter(
+        const std::string_view network,
+        const std::string_view station,
+        const std::string_view channel,
+        const std::string_view locationCode) noexcept
+    {
+        mStreams.increment(network, station, channel, locationCode);
+    }
+    [[nodiscard]] const StreamTable &getStreamTable() const noexcept
+    {
+        return mStreams;
+    }
+    void updateNumberOfDeduplicatedStreams(const int64_t nStreams) noexcept
+    {
+        mNumberOfDeduplicatedStreams.store(nStreams, std::memory_order_relaxed);
+    }
+    [[nodiscard]] int64_t getNumberOfDeduplicatedStreams() const noexcept
+    {
+        return mNumberOfDeduplicatedStreams.load(std::memory_order_relaxed);
+    }
+    void updatePublisherUtilization(const double utilization)
+    {
+        mPublisherUtilization.store(utilization);
+    }
+    [[nodiscard]] double getPublisherUtilization() const noexcept
+    {
+        return mPublisherUtilization.load();
+    }
+    void updateSubscriberUtilization(const double utilization)
+    {
+        mSubscriberUtilization.store(utilization);
+    }
+    [[nodiscard]] double getSubscriberUtilization() const noexcept
+    {
+        return mSubscriberUtilization.load();
+    }
+    void resetCounters()
+    {
+        mReceivedPacketsCounter.reset();
+        mSentPacketsCounter.reset();
+        for (auto &counter : mRejectedPacketsCounters){counter.store(0);}
+        for (auto &counter : mDroppedPacketsCounters){counter.reset();}
+        for (auto &queueDepth : mQueueDepths){queueDepth.reset();}
+        for (auto &histogram : mLatencyHistograms){histogram.reset();}
+        for (auto &histograms : mDataLatencyHistograms)
+        {
+            for (auto &histogram : histograms){histogram.reset();}
+        }
+    } 
+    MetricsSingleton(const MetricsSingleton &) = delete;
+    MetricsSingleton(MetricsSingleton &&) noexcept = delete;
+    MetricsSingleton& operator=(const MetricsSingleton &) = delete;
+    MetricsSingleton& operator=(MetricsSingleton &&) noexcept = delete;
+private:
+    MetricsSingleton() = default;
+    ~MetricsSingleton() = default;
+    ShardedCounter mReceivedPacketsCounter;
+    ShardedCounter mSentPacketsCounter;
+    std::array<std::atomic<int64_t>, NumberOfPacketValidationResults>
+        mRejectedPacketsCounters{};
+    std::array<ShardedCounter, NumberOfDropReasons> mDroppedPacketsCounters;
+    std::array<QueueDepth, NumberOfQueueTypes> mQueueDepths;
+    mutable std::mutex mPublishersMutex;
+    std::vector<std::shared_ptr<PublisherStatistics>> mPublisherStatistics;
+    mutable std::mutex mSubscribersMutex;
+    std::vector<std::shared_ptr<SubscriberStatistics>> mSubscriberStatistics;
+    std::array<LatencyHistogram, NumberOfLatencyStages> mLatencyHistograms;
+    NetworkTable mNetworks;
+    std::array<std::array<LatencyHistogram, NumberOfDataLatencyStages>,
+               NetworkTable::nSlots> mDataLatencyHistograms;
+    StreamTable mStreams;
+    std::atomic<int64_t> mNumberOfDeduplicatedStreams{0};
+    std::atomic<double> mPublisherUtilization{0};
+    std::atomic<double> mSubscriberUtilization{0};
+};
+
+export void initializeMetricsSingleton()
+{
+    MetricsSingleton::getInstance();
+}
+
+export void observeNumberOfPacketsReceived(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            auto value = instance.getReceivedPacketsCount();
+            observer->Observe(value);
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+export void observeNumberOfPacketsSent(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {   
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            auto value = instance.getSentPacketsCount();
+            observer->Observe(value);
+        }
+        catch (const std::exception &e) 
+        {
+
+        }
+    }   
+}
+
+export void observeNumberOfPacketsRejected(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            // Skip valid
+            for (int i = 1; i < NumberOfPacketValidationResults; ++i)
+            {
+                auto reason = static_cast<PacketValidationResult> (i);
+                auto value = instance.getRejectedPacketsCount(reason);
+                const std::map<std::string, std::string>
+                    attributes{ {"reason", toString(reason)} };
+                observer->Observe(value, attributes);
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+export void observeNumberOfPacketsDropped(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            for (int i = 0; i < NumberOfDropReasons; ++i)
+            {
+                auto reason = static_cast<DropReason> (i);
+                auto value = instance.getDroppedPacketsCount(reason);
+                const std::map<std::string, std::string>
+                    attributes{ {"reason", toString(reason)} };
+                observer->Observe(value, attributes);
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+export void observeQueueDepths(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            for (int i = 0; i < NumberOfQueueTypes; ++i)
+            {
+                auto queue = static_cast<QueueType> (i);
+                auto value = instance.getQueueDepth(queue).getDepth();
+                const std::map<std::string, std::string>
+                    attributes{ {"queue", toString(queue)} };
+                observer->Observe(value, attributes);
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+/// Reports the high-water mark of each queue.  A periodic reader gets the
+/// high-water mark since its previous export and resets it.  A scrape
+/// gets the high-water mark since startup so concurrent scrapes do not
+/// steal each other's interval.
+export void observeQueueHighWaterMarks(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            for (int i = 0; i < NumberOfQueueTypes; ++i)
+            {
+                auto queue = static_cast<QueueType> (i);
+                auto &queueDepth = instance.getQueueDepth(queue);
+                auto value = ::periodicReader ?
+                             queueDepth.takeHighWaterMark() :
+                             queueDepth.getHighWaterMark();
+                const std::map<std::string, std::string>
+                    attributes{ {"queue", toString(queue)} };
+                observer->Observe(value, attributes);
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+export void observeSubscriberQueueDepths(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            for (const auto &subscriber : instance.getSubscriberStatistics())
+            {
+                const std::map<std::string, std::string>
+                    attributes{ {"subscriber", subscriber->getName()} };
+                observer->Observe(subscriber->getQueueDepth(), attributes);
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+export void observeSubscriberLags(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<double>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<double>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            for (const auto &subscriber : instance.getSubscriberStatistics())
+            {
+                const std::map<std::string, std::string>
+                    attributes{ {"subscriber", subscriber->getName()} };
+                observer->Observe(subscriber->getLag(), attributes);
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+export void observeSubscriberPacketsSent(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            for (const auto &subscriber : instance.getSubscriberStatistics())
+            {
+                const std::map<std::string, std::string>
+                    attributes{ {"subscriber", subscriber->getName()} };
+                observer->Observe(subscriber->getSentPacketsCount(), attributes);
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+export void observeSubscriberPacketsDropped(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            for (const auto &subscriber : instance.getSubscriberStatistics())
+            {
+                const std::map<std::string, std::string>
+                    attributes{ {"subscriber", subscriber->getName()} };
+                observer->Observe(subscriber->getDroppedPacketsCount(), attributes);
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+/// The exported latency buckets are bounded by the powers of two from
+/// 2^4 us to 2^28 us (about 4.5 minutes) plus +Inf.  Powers of two fall on
+/// the edges of the histogram's buckets so the exported counts are exact.
+constexpr int minimumExportedBits{4};
+constexpr int maximumExportedBits{28};
+
+/// Observes the histogram's cumulative bucket counts in the Prometheus
+/// style, i.e., each count is the number of latencies less than or equal
+/// to the bound in the le attribute.  The counts only ever grow so any number of readers
+/// may observe them and quantiles can be computed over any window.
+/// @result False indicates the histogram was empty and skipped.
+bool observeBuckets(
+    opentelemetry::metrics::ObserverResultT<int64_t> &observer,
+    const LatencyHistogram &histogram,
+    std::map<std::string, std::string> attributes,
+    const bool skipEmpty = false)
+{
+    const auto counts = histogram.getCounts();
+    uint64_t total{0};
+    for (const auto &count : counts){total = total + count;}
+    if (total == 0 && skipEmpty){return false;}
+    uint64_t cumulative{0};
+    size_t index{0};
+    for (int bits = minimumExportedBits; bits <= maximumExportedBits; ++bits)
+    {
+        const auto bound = uint64_t {1} << bits;
+        const auto end
+            = static_cast<size_t> (LatencyHistogram::toIndex(bound));
+        for (; index < end; ++index)
+        {
+            cumulative = cumulative + counts[index];
+        }
+        attributes["le"] = std::to_string(bound);
+        observer.Observe(static_cast<int64_t> (cumulative), attributes);
+    }
+    attributes["le"] = "+Inf";
+    observer.Observe(static_cast<int64_t> (total), attributes);
+    return true;
+}
+
+/// Reports the cumulative latency buckets of each stage.  OpenTelemetry
+/// C++ has no asynchronous histogram so the buckets are exported as a
+/// counter with stage and le attributes.
+export void observeLatencies(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            for (int i = 0; i < NumberOfLatencyStages; ++i)
+            {
+                auto stage = static_cast<LatencyStage> (i);
+                observeBuckets(*observer,
+                               instance.getLatencyHistogram(stage),
+                               { {"stage", toString(stage)} });
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
+}
+
+/// Reports the cumulative data latency buckets of each network.  Networks
+/// that sent nothing are skipped rather than reported as zero.
+export void observeDataLatencies(
+    opentelemetry::metrics::ObserverResult observerResult,
+    void *)
+{
+    if (opentelemetry::nostd::holds_alternative
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+                opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult))
+    {
+        auto observer = opentelemetry::nostd::get
+        <
+            opentelemetry::nostd::shared_ptr
+            <
+               opentelemetry::metrics::ObserverResultT<int64_t>
+            >
+        > (observerResult);
+        try
+        {
+            auto &instance = MetricsSingleton::getInstance();
+            const auto &networks = instance.getNetworkTable();
+            for (int i = 0; i < NetworkTable::nSlots; ++i)
+            {
+                if (!networks.isClaimed(i)){continue;}
+                const auto network = networks.getName(i);
+                for (int j = 0; j < NumberOfDataLatencyStages; ++j)
+                {
+                    auto stage = static_cast<DataLatencyStage> (j);
+                    observeBuckets(
+                        *observer,
+                        instance.getDataLatencyHistogram(i, stage),
+                        { {"network", network}, {"stage", toString(stage)} },
+                        true);
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+
+        }
+    }
 }
 
 export void observePublisherUtilization(
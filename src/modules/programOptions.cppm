@@ -22,6 +22,11 @@ module;
 #include "uDataPacketImportProxy/backendOptions.hpp"
 #include "uDataPacketImportProxy/grpcOptions.hpp"
 #include "uDataPacketImportProxy/duplicatePacketDetector.hpp"
+#include "uDataPacketImportProxy/packetSpool.hpp"
+#include "uDataPacketImportProxy/packetJournal.hpp"
+#include "uDataPacketImportProxy/packetCapture.hpp"
+#include "uDataPacketImportProxy/packetReorderBuffer.hpp"
+#include "uDataPacketImportProxy/packetCoalescer.hpp"
 #include "otelOptions.hpp"
 
 export module programOptions;
@@ -104,16 +109,26 @@ export struct ProgramOptions
     UDataPacketImportProxy::OTelOptions::HTTPLog otelHTTPLogOptions;
     UDataPacketImportProxy::OTelOptions::GRPCMetrics otelGRPCMetricsOptions;
     UDataPacketImportProxy::OTelOptions::GRPCLog otelGRPCLogOptions;
+    UDataPacketImportProxy::OTelOptions::PrometheusMetrics prometheusMetricsOptions;
+    UDataPacketImportProxy::OTelOptions::HTTPTraces otelHTTPTraceOptions;
+    UDataPacketImportProxy::OTelOptions::GRPCTraces otelGRPCTraceOptions;
     std::string applicationName{APPLICATION_NAME};
     //OTelHTTPMetricsOptions otelHTTPMetricsOptions;
     //OTelHTTPLogOptions otelHTTPLogOptions;
     UDataPacketImportProxy::ProxyOptions proxyOptions;
+    std::optional<UDataPacketImportProxy::GRPCOptions> adminOptions;
     std::chrono::seconds printSummaryInterval{std::chrono::minutes {15}};
+    std::filesystem::path flightRecorderDirectory{"/tmp"};
+    int flightRecorderEventsPerThread{16384};
+    int64_t traceSamplingPeriod{10000};
     int verbosity{3};
     bool exportLogs{false};
     bool exportLogsWithHTTP{true};
     bool exportMetrics{false};
     bool exportMetricsWithHTTP{true};
+    bool exportMetricsWithPrometheus{false};
+    bool exportTraces{false};
+    bool exportTracesWithHTTP{true};
 };
 
 export
@@ -249,6 +264,58 @@ loadStringFromFile(const std::filesystem::path &path)
 
     }
 
+    auto preset
+        = propertyTree.get<std::string> (section + ".serverPreset", "default");
+    if (preset == "manySmallStreams")
+    {
+        options.applyServerPreset(
+            UDataPacketImportProxy::GRPCOptions::ServerPreset::ManySmallStreams);
+    }
+    else if (preset == "fewLargeStreams")
+    {
+        options.applyServerPreset(
+            UDataPacketImportProxy::GRPCOptions::ServerPreset::FewLargeStreams);
+    }
+    else if (preset != "default")
+    {
+        throw std::invalid_argument(section
+            + ".serverPreset must be default, manySmallStreams, or fewLargeStreams");
+    }
+
+    auto resourceQuota
+        = propertyTree.get_optional<int64_t> (section + ".resourceQuotaInBytes");
+    if (resourceQuota){options.setResourceQuotaInBytes(*resourceQuota);}
+
+    auto maxStreams
+        = propertyTree.get_optional<int>
+          (section + ".maximumNumberOfConcurrentStreams");
+    if (maxStreams){options.setMaximumNumberOfConcurrentStreams(*maxStreams);}
+
+    auto windowSize
+        = propertyTree.get_optional<int>
+          (section + ".http2StreamWindowSizeInBytes");
+    if (windowSize){options.setHTTP2StreamWindowSizeInBytes(*windowSize);}
+
+    auto writeBufferSize
+        = propertyTree.get_optional<int>
+          (section + ".http2WriteBufferSizeInBytes");
+    if (writeBufferSize)
+    {
+        options.setHTTP2WriteBufferSizeInBytes(*writeBufferSize);
+    }
+
+    auto bdpProbe
+        = propertyTree.get<bool> (section + ".http2BDPProbe",
+                                  options.http2BDPProbeEnabled());
+    if (bdpProbe)
+    {
+        options.enableHTTP2BDPProbe();
+    }
+    else
+    {
+        options.disableHTTP2BDPProbe();
+    }
+
 
     return options;
 }
@@ -282,6 +349,12 @@ UDataPacketImportProxy::FrontendOptions getFrontendOptions(
              maxBadMessages); 
     frontendOptions.setMaximumNumberOfConsecutiveInvalidMessages(
         maxBadMessages);
+
+    auto numberOfServers = frontendOptions.getNumberOfServers();
+    numberOfServers
+        = propertyTree.get<int> (section + ".numberOfServers",
+                                 numberOfServers);
+    frontendOptions.setNumberOfServers(numberOfServers);
     return frontendOptions;
 } 
 
@@ -306,10 +379,75 @@ UDataPacketImportProxy::BackendOptions getBackendOptions(
                                  queueCapacity);
     backendOptions.setQueueCapacity(queueCapacity);
 
+    auto policy
+        = propertyTree.get<std::string> (section + ".slowConsumerPolicy",
+                                         "dropOldest");
+    if (policy == "dropOldest")
+    {
+        backendOptions.setSlowConsumerPolicy(
+            UDataPacketImportProxy::BackendOptions::SlowConsumerPolicy::DropOldest);
+    }
+    else if (policy == "latestPerStream")
+    {
+        backendOptions.setSlowConsumerPolicy(
+            UDataPacketImportProxy::BackendOptions::SlowConsumerPolicy::LatestPerStream);
+    }
+    else if (policy == "disconnect")
+    {
+        backendOptions.setSlowConsumerPolicy(
+            UDataPacketImportProxy::BackendOptions::SlowConsumerPolicy::Disconnect);
+    }
+    else
+    {
+        throw std::invalid_argument(
+            "Backend.slowConsumerPolicy must be dropOldest, latestPerStream, or disconnect");
+    }
+
+    auto maximumLag = static_cast<int> (
+        backendOptions.getMaximumSubscriberLag().count());
+    maximumLag
+        = propertyTree.get<int> (section + ".maximumSubscriberLagInMilliSeconds",
+                                 maximumLag);
+    backendOptions.setMaximumSubscriberLag(
+        std::chrono::milliseconds {maximumLag});
+
+    auto sustainedLagDuration = static_cast<int> (
+        backendOptions.getSustainedLagDuration().count());
+    sustainedLagDuration
+        = propertyTree.get<int> (section + ".sustainedLagDurationInMilliSeconds",
+                                 sustainedLagDuration);
+    backendOptions.setSustainedLagDuration(
+        std::chrono::milliseconds {sustainedLagDuration});
+
 
     return backendOptions;
 } 
 
+std::optional<UDataPacketImportProxy::GRPCOptions> getAdminOptions(
+    const boost::property_tree::ptree &propertyTree,
+    const UDataPacketImportProxy::ProxyOptions &proxyOptions)
+{
+    const std::string section{"Admin"};
+    if (!propertyTree.get_child_optional(section)){return std::nullopt;}
+    auto options = getGRPCOptions(propertyTree, section, false);
+    if (!propertyTree.get_optional<uint16_t> (section + ".port"))
+    {
+        options.setPort(50002);
+    }
+    for (const auto &grpcOptions :
+         {proxyOptions.getFrontendOptions().getGRPCOptions(),
+          proxyOptions.getBackendOptions().getGRPCOptions()})
+    {
+        if (options.getHost() == grpcOptions.getHost() &&
+            options.getPort() == grpcOptions.getPort())
+        {
+            throw std::invalid_argument(
+                "Can't bind admin service on same port as front or backend");
+        }
+    }
+    return options;
+}
+
 UDataPacketImportProxy::ProxyOptions getProxyOptions(
     const boost::property_tree::ptree &propertyTree)
 {
@@ -370,6 +508,117 @@ UDataPacketImportProxy::ProxyOptions getProxyOptions(
         }
     }
 
+    auto spoolDirectory
+        = propertyTree.get<std::string> ("Proxy.spoolDirectory", "");
+    if (!spoolDirectory.empty())
+    {
+        PacketSpoolOptions spoolOptions;
+        spoolOptions.setDirectory(spoolDirectory);
+        auto segmentSize = spoolOptions.getSegmentSizeInBytes();
+        segmentSize
+            = propertyTree.get<int64_t> ("Proxy.spoolSegmentSizeInBytes",
+                                         segmentSize);
+        spoolOptions.setSegmentSizeInBytes(segmentSize);
+        auto maximumSize = spoolOptions.getMaximumSizeInBytes();
+        maximumSize
+            = propertyTree.get<int64_t> ("Proxy.spoolMaximumSizeInBytes",
+                                         maximumSize);
+        spoolOptions.setMaximumSizeInBytes(maximumSize);
+        proxyOptions.setPacketSpoolOptions(spoolOptions);
+    }
+
+    auto journalFile
+        = propertyTree.get<std::string> ("Proxy.journalFile", "");
+    if (!journalFile.empty())
+    {
+        PacketJournalOptions journalOptions;
+        journalOptions.setFileName(journalFile);
+        auto capacity = journalOptions.getCapacityInBytes();
+        capacity
+            = propertyTree.get<int64_t> ("Proxy.journalCapacityInBytes",
+                                         capacity);
+        journalOptions.setCapacityInBytes(capacity);
+        auto slotSize = journalOptions.getSlotSizeInBytes();
+        slotSize
+            = propertyTree.get<int> ("Proxy.journalSlotSizeInBytes",
+                                     slotSize);
+        journalOptions.setSlotSizeInBytes(slotSize);
+        auto synchronizationInterval
+            = journalOptions.getSynchronizationInterval();
+        synchronizationInterval
+            = propertyTree.get<int> ("Proxy.journalSynchronizationInterval",
+                                     synchronizationInterval);
+        journalOptions.setSynchronizationInterval(synchronizationInterval);
+        auto replayWait
+            = static_cast<int> (journalOptions.getMaximumReplayWait().count());
+        replayWait
+            = propertyTree.get<int>
+              ("Proxy.journalMaximumReplayWaitInMilliSeconds", replayWait);
+        journalOptions.setMaximumReplayWait(
+            std::chrono::milliseconds {replayWait});
+        proxyOptions.setPacketJournalOptions(journalOptions);
+    }
+
+    auto captureDirectory
+        = propertyTree.get<std::string> ("Proxy.captureDirectory", "");
+    if (!captureDirectory.empty())
+    {
+        PacketCaptureOptions captureOptions;
+        captureOptions.setDirectory(captureDirectory);
+        auto maximumFileSize = captureOptions.getMaximumFileSizeInBytes();
+        maximumFileSize
+            = propertyTree.get<int64_t> ("Proxy.captureMaximumFileSizeInBytes",
+                                         maximumFileSize);
+        captureOptions.setMaximumFileSizeInBytes(maximumFileSize);
+        auto maximumNumberOfFiles = captureOptions.getMaximumNumberOfFiles();
+        maximumNumberOfFiles
+            = propertyTree.get<int> ("Proxy.captureMaximumNumberOfFiles",
+                                     maximumNumberOfFiles);
+        captureOptions.setMaximumNumberOfFiles(maximumNumberOfFiles);
+        proxyOptions.setPacketCaptureOptions(captureOptions);
+    }
+
+    auto reorderWindow
+        = propertyTree.get<int> ("Proxy.reorderWindowInMilliSeconds", 0);
+    if (reorderWindow > 0)
+    {
+        PacketReorderBufferOptions reorderOptions;
+        reorderOptions.setWindow(std::chrono::milliseconds {reorderWindow});
+        auto maximumNumberOfPackets
+            = reorderOptions.getMaximumNumberOfPacketsPerStream();
+        maximumNumberOfPackets
+            = propertyTree.get<int> ("Proxy.reorderMaximumPacketsPerStream",
+                                     maximumNumberOfPackets);
+        reorderOptions.setMaximumNumberOfPacketsPerStream(
+            maximumNumberOfPackets);
+        proxyOptions.setPacketReorderBufferOptions(reorderOptions);
+    }
+
+    auto coalesce = propertyTree.get<bool> ("Proxy.coalescePackets", false);
+    if (coalesce)
+    {
+        PacketCoalescerOptions coalescerOptions;
+        auto maximumDuration
+            = static_cast<int> (coalescerOptions.getMaximumDuration().count());
+        maximumDuration
+            = propertyTree.get<int>
+              ("Proxy.coalesceMaximumDurationInMilliSeconds", maximumDuration);
+        coalescerOptions.setMaximumDuration(
+            std::chrono::milliseconds {maximumDuration});
+        auto maximumSize = coalescerOptions.getMaximumSizeInBytes();
+        maximumSize
+            = propertyTree.get<int> ("Proxy.coalesceMaximumSizeInBytes",
+                                     maximumSize);
+        coalescerOptions.setMaximumSizeInBytes(maximumSize);
+        auto maximumLinger
+            = static_cast<int> (coalescerOptions.getMaximumLinger().count());
+        maximumLinger
+            = propertyTree.get<int>
+              ("Proxy.coalesceMaximumLingerInMilliSeconds", maximumLinger);
+        coalescerOptions.setMaximumLinger(
+            std::chrono::milliseconds {maximumLinger});
+        proxyOptions.setPacketCoalescerOptions(coalescerOptions);
+    }
     
     return proxyOptions;
 }
@@ -468,7 +717,32 @@ export ProgramOptions
 
     // Metrics
     options.exportMetrics = false;
-    if (propertyTree.get_optional<std::string> ("OTelHTTPMetricsOptions"))
+    options.exportMetricsWithPrometheus = false;
+    if (propertyTree.get_optional<std::string> ("PrometheusMetricsOptions"))
+    {
+#ifndef WITH_PROMETHEUS
+        throw std::runtime_error(
+            "Recompile with WITH_PROMETHEUS to use Prometheus metrics option");
+#endif
+        const std::string section{"PrometheusMetricsOptions"};
+        UDataPacketImportProxy::OTelOptions::PrometheusMetrics metricsOptions;
+        auto host
+            = propertyTree.get<std::string> (section + ".host", "localhost");
+        auto port = propertyTree.get<uint16_t> (section + ".port", 9464);
+        if (host.empty())
+        {
+            throw std::invalid_argument(section + ".host is empty");
+        }
+        if (port < 1)
+        {
+            throw std::invalid_argument(section + ".port must be positive");
+        }
+        metricsOptions.url = host + ":" + std::to_string(port);
+        options.prometheusMetricsOptions = metricsOptions;
+        options.exportMetrics = true;
+        options.exportMetricsWithPrometheus = true;
+    }
+    else if (propertyTree.get_optional<std::string> ("OTelHTTPMetricsOptions"))
     {
         UDataPacketImportProxy::OTelOptions::HTTPMetrics metricsOptions;
         metricsOptions.url
@@ -537,7 +811,87 @@ export ProgramOptions
         }
     }
 
+    // Tracing.  Spans go to the collector receiving the metrics or, failing
+    // that, the logs.
+    options.exportTraces = false;
+    if (propertyTree.get_optional<std::string> ("Tracing"))
+    {
+        options.traceSamplingPeriod
+            = propertyTree.get<int64_t> ("Tracing.samplingPeriod",
+                                         options.traceSamplingPeriod);
+        if (options.traceSamplingPeriod < 0)
+        {
+            throw std::invalid_argument(
+                "Tracing.samplingPeriod cannot be negative");
+        }
+        auto suffix
+            = propertyTree.get<std::string> ("Tracing.suffix",
+                                             options.otelHTTPTraceOptions.suffix);
+        if (!suffix.empty() && !suffix.starts_with("/"))
+        {
+            suffix = "/" + suffix;
+        }
+        if (options.traceSamplingPeriod > 0)
+        {
+            if (options.exportMetrics && !options.exportMetricsWithPrometheus)
+            {
+                options.exportTracesWithHTTP = options.exportMetricsWithHTTP;
+                if (options.exportMetricsWithHTTP)
+                {
+                    options.otelHTTPTraceOptions.url
+                        = options.otelHTTPMetricsOptions.url;
+                    options.otelHTTPTraceOptions.suffix = suffix;
+                }
+                else
+                {
+                    options.otelGRPCTraceOptions.url
+                        = options.otelGRPCMetricsOptions.url;
+                    options.otelGRPCTraceOptions.certificatePath
+                        = options.otelGRPCMetricsOptions.certificatePath;
+                }
+            }
+            else if (options.exportLogs)
+            {
+                options.exportTracesWithHTTP = options.exportLogsWithHTTP;
+                if (options.exportLogsWithHTTP)
+                {
+                    options.otelHTTPTraceOptions.url
+                        = options.otelHTTPLogOptions.url;
+                    options.otelHTTPTraceOptions.suffix = suffix;
+                }
+                else
+                {
+                    options.otelGRPCTraceOptions.url
+                        = options.otelGRPCLogOptions.url;
+                    options.otelGRPCTraceOptions.certificatePath
+                        = options.otelGRPCLogOptions.certificatePath;
+                }
+            }
+            else
+            {
+                throw std::invalid_argument(
+                    "Tracing requires an OTLP metrics or logs collector");
+            }
+            options.exportTraces = true;
+        }
+    }
+
+    // Flight recorder
+    options.flightRecorderDirectory
+        = propertyTree.get<std::string> (
+             "FlightRecorder.directory",
+             options.flightRecorderDirectory.string());
+    options.flightRecorderEventsPerThread
+        = propertyTree.get<int> ("FlightRecorder.eventsPerThread",
+                                 options.flightRecorderEventsPerThread);
+    if (options.flightRecorderEventsPerThread < 1)
+    {
+        throw std::invalid_argument(
+            "FlightRecorder.eventsPerThread must be positive");
+    }
+
     options.proxyOptions = getProxyOptions(propertyTree); 
+    options.adminOptions = getAdminOptions(propertyTree, options.proxyOptions);
     return options;
 }
 
@@ -31,6 +31,23 @@ struct HTTPMetrics
     std::string suffix{"/v1/metrics"};
 };
 
+struct PrometheusMetrics
+{
+    std::string url{"localhost:9464"}; // Address on which to serve /metrics
+};
+
+struct GRPCTraces
+{
+    std::string url{"localhost:4317"};
+    std::filesystem::path certificatePath; // Path to the cert file
+};
+
+struct HTTPTraces
+{
+    std::string url{"localhost:4318"};
+    std::string suffix{"/v1/traces"};
+};
+
 struct HTTPLog
 {
     std::string url{"localhost:4318"};
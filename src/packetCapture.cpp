@@ -0,0 +1,524 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "uDataPacketImportProxy/packetCapture.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+constexpr std::array<char, 8> captureMagic{'U', 'D', 'P', 'I', 'C', 'A', 'P', '1'};
+constexpr std::string_view filePrefix{"capture-"};
+constexpr std::string_view fileSuffix{".cap"};
+// Each record is a 4 byte little-endian length and an 8 byte little-endian
+// receive time followed by the serialized packet.
+constexpr size_t recordHeaderSize{sizeof(uint32_t) + sizeof(int64_t)};
+// Records are buffered and written in blocks of about this size
+constexpr size_t writeBufferSize{256*1024};
+
+[[nodiscard]] std::filesystem::path
+    makeFilePath(const std::filesystem::path &directory,
+                 const uint64_t index)
+{
+    constexpr size_t nDigits{12};
+    auto number = std::to_string(index);
+    if (number.size() < nDigits)
+    {
+        number.insert(0, nDigits - number.size(), '0');
+    }
+    return directory / (std::string {filePrefix}
+                      + number
+                      + std::string {fileSuffix});
+}
+
+[[nodiscard]] std::optional<uint64_t>
+    getFileIndex(const std::filesystem::path &path)
+{
+    const auto name = path.filename().string();
+    if (!name.starts_with(filePrefix) || !name.ends_with(fileSuffix))
+    {
+        return std::nullopt;
+    }
+    const auto digits
+        = name.substr(filePrefix.size(),
+                      name.size() - filePrefix.size() - fileSuffix.size());
+    if (digits.empty() ||
+        !std::all_of(digits.begin(), digits.end(),
+                     [](const char c)
+                     {
+                         return std::isdigit(static_cast<unsigned char> (c));
+                     }))
+    {
+        return std::nullopt;
+    }
+    return std::stoull(digits);
+}
+
+[[nodiscard]] std::vector<std::pair<uint64_t, std::filesystem::path>>
+    getIndexedFiles(const std::filesystem::path &directory)
+{
+    std::vector<std::pair<uint64_t, std::filesystem::path>> files;
+    std::error_code errorCode;
+    if (!std::filesystem::is_directory(directory, errorCode)){return files;}
+    for (const auto &entry :
+         std::filesystem::directory_iterator(directory, errorCode))
+    {
+        if (!entry.is_regular_file()){continue;}
+        auto index = ::getFileIndex(entry.path());
+        if (index){files.emplace_back(*index, entry.path());}
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+template<typename T>
+void encode(const T value, char *buffer)
+{
+    const auto bits = static_cast<std::make_unsigned_t<T>> (value);
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        buffer[i] = static_cast<char> ((bits >> (8*i)) & 0xFFU);
+    }
+}
+
+template<typename T>
+[[nodiscard]] T decode(const char *buffer)
+{
+    std::make_unsigned_t<T> bits{0};
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        bits = bits
+             | (static_cast<std::make_unsigned_t<T>>
+                (static_cast<unsigned char> (buffer[i])) << (8*i));
+    }
+    return static_cast<T> (bits);
+}
+
+void writeFully(const int fileDescriptor, const std::string &buffer)
+{
+    size_t nWritten{0};
+    while (nWritten < buffer.size())
+    {
+        auto nBytes = ::write(fileDescriptor,
+                              buffer.data() + nWritten,
+                              buffer.size() - nWritten);
+        if (nBytes < 0)
+        {
+            if (errno == EINTR){continue;}
+            throw std::runtime_error("Failed to write to capture file: "
+                                   + std::string {std::strerror(errno)});
+        }
+        nWritten = nWritten + static_cast<size_t> (nBytes);
+    }
+}
+
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketCaptureOptions::PacketCaptureOptionsImpl
+{
+public:
+    std::filesystem::path mDirectory;
+    int64_t mMaximumFileSize{256*1024*1024};
+    int mMaximumNumberOfFiles{16};
+    bool mHaveDirectory{false};
+};
+
+/// Constructor
+PacketCaptureOptions::PacketCaptureOptions() :
+    pImpl(std::make_unique<PacketCaptureOptionsImpl> ())
+{
+}
+
+/// Copy constructor
+PacketCaptureOptions::PacketCaptureOptions(const PacketCaptureOptions &options)
+{
+    *this = options;
+}
+
+/// Move constructor
+PacketCaptureOptions::PacketCaptureOptions(
+    PacketCaptureOptions &&options) noexcept
+{
+    *this = std::move(options);
+}
+
+/// Copy assignment
+PacketCaptureOptions&
+PacketCaptureOptions::operator=(const PacketCaptureOptions &options)
+{
+    if (&options == this){return *this;}
+    pImpl = std::make_unique<PacketCaptureOptionsImpl> (*options.pImpl);
+    return *this;
+}
+
+/// Move assignment
+PacketCaptureOptions&
+PacketCaptureOptions::operator=(PacketCaptureOptions &&options) noexcept
+{
+    if (&options == this){return *this;}
+    pImpl = std::move(options.pImpl);
+    return *this;
+}
+
+/// Destructor
+PacketCaptureOptions::~PacketCaptureOptions() = default;
+
+/// Directory
+void PacketCaptureOptions::setDirectory(const std::filesystem::path &directory)
+{
+    if (directory.empty())
+    {
+        throw std::invalid_argument("Capture directory is empty");
+    }
+    pImpl->mDirectory = directory;
+    pImpl->mHaveDirectory = true;
+}
+
+std::filesystem::path PacketCaptureOptions::getDirectory() const
+{
+    if (!haveDirectory())
+    {
+        throw std::runtime_error("Capture directory not set");
+    }
+    return pImpl->mDirectory;
+}
+
+bool PacketCaptureOptions::haveDirectory() const noexcept
+{
+    return pImpl->mHaveDirectory;
+}
+
+/// Maximum file size
+void PacketCaptureOptions::setMaximumFileSizeInBytes(
+    const int64_t maximumFileSize)
+{
+    constexpr int64_t minimumFileSize{64*1024};
+    if (maximumFileSize < minimumFileSize)
+    {
+        throw std::invalid_argument("Maximum capture file size must be at least "
+                                  + std::to_string(minimumFileSize)
+                                  + " bytes");
+    }
+    pImpl->mMaximumFileSize = maximumFileSize;
+}
+
+int64_t PacketCaptureOptions::getMaximumFileSizeInBytes() const noexcept
+{
+    return pImpl->mMaximumFileSize;
+}
+
+/// Maximum number of files
+void PacketCaptureOptions::setMaximumNumberOfFiles(
+    const int maximumNumberOfFiles)
+{
+    if (maximumNumberOfFiles < 1)
+    {
+        throw std::invalid_argument(
+            "Maximum number of capture files must be positive");
+    }
+    pImpl->mMaximumNumberOfFiles = maximumNumberOfFiles;
+}
+
+int PacketCaptureOptions::getMaximumNumberOfFiles() const noexcept
+{
+    return pImpl->mMaximumNumberOfFiles;
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketCapture::PacketCaptureImpl
+{
+public:
+    explicit PacketCaptureImpl(const PacketCaptureOptions &options)
+    {
+        if (!options.haveDirectory())
+        {
+            throw std::invalid_argument("Capture directory not set");
+        }
+        mDirectory = options.getDirectory();
+        mMaximumFileSize = options.getMaximumFileSizeInBytes();
+        mMaximumNumberOfFiles = options.getMaximumNumberOfFiles();
+        std::error_code errorCode;
+        std::filesystem::create_directories(mDirectory, errorCode);
+        if (errorCode)
+        {
+            throw std::runtime_error("Failed to create capture directory "
+                                   + mDirectory.string() + " because "
+                                   + errorCode.message());
+        }
+        // Never overwrite a previous run's capture
+        for (const auto &[index, path] : ::getIndexedFiles(mDirectory))
+        {
+            mFiles.push_back(path);
+            mNextIndex = std::max(mNextIndex, index + 1);
+        }
+        mBuffer.reserve(writeBufferSize);
+        openFile();
+    }
+
+    ~PacketCaptureImpl()
+    {
+        try
+        {
+            closeFile();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    void openFile()
+    {
+        const auto path = ::makeFilePath(mDirectory, mNextIndex);
+        mFileDescriptor
+            = ::open(path.c_str(),
+                     O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                     S_IRUSR | S_IWUSR | S_IRGRP);
+        if (mFileDescriptor < 0)
+        {
+            throw std::runtime_error("Failed to open capture file "
+                                   + path.string() + " because "
+                                   + std::string {std::strerror(errno)});
+        }
+        mNextIndex = mNextIndex + 1;
+        mFiles.push_back(path);
+        mBuffer.assign(captureMagic.data(), captureMagic.size());
+        mFileSize = static_cast<int64_t> (captureMagic.size());
+        // Rotate out the oldest captures
+        while (static_cast<int> (mFiles.size()) > mMaximumNumberOfFiles)
+        {
+            std::error_code errorCode;
+            std::filesystem::remove(mFiles.front(), errorCode);
+            mFiles.erase(mFiles.begin());
+        }
+    }
+
+    void flush()
+    {
+        if (mFileDescriptor < 0 || mBuffer.empty()){return;}
+        ::writeFully(mFileDescriptor, mBuffer);
+        mBuffer.clear();
+    }
+
+    void closeFile()
+    {
+        if (mFileDescriptor < 0){return;}
+        flush();
+        ::close(mFileDescriptor);
+        mFileDescriptor = -1;
+    }
+
+    void append(const UDataPacketImportAPI::V1::Packet &packet,
+                const std::chrono::microseconds &receiveTime)
+    {
+        const auto payloadSize = packet.ByteSizeLong();
+        const auto recordSize
+            = static_cast<int64_t> (recordHeaderSize + payloadSize);
+        const std::lock_guard<std::mutex> lock(mMutex);
+        // A record larger than a file still gets a file to itself
+        if (mFileSize + recordSize > mMaximumFileSize &&
+            mFileSize > static_cast<int64_t> (captureMagic.size()))
+        {
+            closeFile();
+            openFile();
+        }
+        if (mFileDescriptor < 0)
+        {
+            throw std::runtime_error("Capture file is not open");
+        }
+        const auto offset = mBuffer.size();
+        mBuffer.resize(offset + recordHeaderSize + payloadSize);
+        auto *destination = mBuffer.data() + offset;
+        ::encode(static_cast<uint32_t> (payloadSize), destination);
+        ::encode(static_cast<int64_t> (receiveTime.count()),
+                 destination + sizeof(uint32_t));
+        if (!packet.SerializeToArray(destination + recordHeaderSize,
+                                     static_cast<int> (payloadSize)))
+        {
+            mBuffer.resize(offset);
+            throw std::runtime_error("Failed to serialize packet to capture");
+        }
+        mFileSize = mFileSize + recordSize;
+        mNumberOfPackets.fetch_add(1, std::memory_order_relaxed);
+        if (mBuffer.size() >= writeBufferSize){flush();}
+    }
+
+    mutable std::mutex mMutex;
+    std::filesystem::path mDirectory;
+    std::vector<std::filesystem::path> mFiles;
+    std::string mBuffer;
+    std::atomic<int64_t> mNumberOfPackets{0};
+    int64_t mMaximumFileSize{256*1024*1024};
+    int64_t mFileSize{0};
+    uint64_t mNextIndex{0};
+    int mMaximumNumberOfFiles{16};
+    int mFileDescriptor{-1};
+};
+
+/// Constructor
+PacketCapture::PacketCapture(const PacketCaptureOptions &options) :
+    pImpl(std::make_unique<PacketCaptureImpl> (options))
+{
+}
+
+/// Destructor
+PacketCapture::~PacketCapture() = default;
+
+/// Append
+void PacketCapture::append(const UDataPacketImportAPI::V1::Packet &packet,
+                           const std::chrono::microseconds &receiveTime)
+{
+    pImpl->append(packet, receiveTime);
+}
+
+/// Flush
+void PacketCapture::flush()
+{
+    const std::lock_guard<std::mutex> lock(pImpl->mMutex);
+    pImpl->flush();
+}
+
+/// Number of packets
+int64_t PacketCapture::getNumberOfPackets() const noexcept
+{
+    return pImpl->mNumberOfPackets.load(std::memory_order_relaxed);
+}
+
+/// Files in a capture directory
+std::vector<std::filesystem::path>
+    PacketCapture::getFiles(const std::filesystem::path &directory)
+{
+    std::vector<std::filesystem::path> result;
+    for (auto &[index, path] : ::getIndexedFiles(directory))
+    {
+        result.push_back(std::move(path));
+    }
+    return result;
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketCaptureReader::PacketCaptureReaderImpl
+{
+public:
+    explicit PacketCaptureReaderImpl(const std::filesystem::path &fileName) :
+        mFileName(fileName)
+    {
+        auto fileDescriptor = ::open(mFileName.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fileDescriptor < 0)
+        {
+            throw std::runtime_error("Failed to open capture file "
+                                   + mFileName.string());
+        }
+        struct stat status{};
+        if (::fstat(fileDescriptor, &status) != 0)
+        {
+            ::close(fileDescriptor);
+            throw std::runtime_error("Failed to stat capture file "
+                                   + mFileName.string());
+        }
+        mSize = static_cast<size_t> (status.st_size);
+        if (mSize < captureMagic.size())
+        {
+            ::close(fileDescriptor);
+            throw std::runtime_error(mFileName.string()
+                                   + " is not a capture file");
+        }
+        auto address = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE,
+                              fileDescriptor, 0);
+        ::close(fileDescriptor);
+        if (address == MAP_FAILED)
+        {
+            throw std::runtime_error("Failed to map capture file "
+                                   + mFileName.string());
+        }
+        ::madvise(address, mSize, MADV_SEQUENTIAL);
+        mData = static_cast<const char *> (address);
+        if (std::memcmp(mData, captureMagic.data(), captureMagic.size()) != 0)
+        {
+            ::munmap(address, mSize);
+            mData = nullptr;
+            throw std::runtime_error(mFileName.string()
+                                   + " is not a capture file");
+        }
+        mOffset = captureMagic.size();
+    }
+
+    ~PacketCaptureReaderImpl()
+    {
+        if (mData != nullptr)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            ::munmap(const_cast<char *> (mData), mSize);
+        }
+    }
+
+    std::filesystem::path mFileName;
+    const char *mData{nullptr};
+    size_t mSize{0};
+    size_t mOffset{0};
+};
+
+/// Constructor
+PacketCaptureReader::PacketCaptureReader(
+    const std::filesystem::path &fileName) :
+    pImpl(std::make_unique<PacketCaptureReaderImpl> (fileName))
+{
+}
+
+/// Destructor
+PacketCaptureReader::~PacketCaptureReader() = default;
+
+/// Next packet
+bool PacketCaptureReader::next(UDataPacketImportAPI::V1::Packet *packet,
+                               std::chrono::microseconds *receiveTime)
+{
+    if (packet == nullptr){throw std::invalid_argument("Packet is NULL");}
+    if (receiveTime == nullptr)
+    {
+        throw std::invalid_argument("Receive time is NULL");
+    }
+    const auto offset = pImpl->mOffset;
+    const auto size = pImpl->mSize;
+    // N.B. A capture that was being written when the proxy died can end in
+    // a partial record
+    if (offset + recordHeaderSize > size){return false;}
+    const auto *header = pImpl->mData + offset;
+    const auto length = ::decode<uint32_t> (header);
+    if (offset + recordHeaderSize + length > size){return false;}
+    if (!packet->ParseFromArray(header + recordHeaderSize,
+                                static_cast<int> (length)))
+    {
+        throw std::runtime_error("Failed to parse packet in "
+                               + pImpl->mFileName.string());
+    }
+    *receiveTime
+        = std::chrono::microseconds
+          {::decode<int64_t> (header + sizeof(uint32_t))};
+    pImpl->mOffset = offset + recordHeaderSize + length;
+    return true;
+}
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <google/protobuf/util/time_util.h>
+#include "uDataPacketImportProxy/packetCoalescer.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
+#include "uDataPacketImportAPI/v1/data_type.pb.h"
+#include "packetValidator.hpp"
+#include "streamIdentifier.hpp"
+#include "timerWheel.hpp"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+
+/// @result The size of a sample in bytes or 0 if the packet's samples
+///         can't be merged.
+[[nodiscard]] size_t getSampleSize(
+    const UDataPacketImportAPI::V1::DataType dataType) noexcept
+{
+    if (dataType == UDataPacketImportAPI::V1::DATA_TYPE_TEXT){return 0;}
+    return UDataPacketImportProxy::getDataTypeSize(dataType);
+}
+
+/// A merged packet that is still accumulating samples.
+struct Stream
+{
+    UDataPacketImportAPI::V1::Packet pending;
+    PacketCoalescer::Clock::time_point deadline;
+    int64_t startTime{0}; // Start time in microseconds
+    // Lowest journal sequence number of the packets merged into pending
+    uint64_t journalSequence{0};
+    bool havePending{false};
+    bool scheduled{false};
+};
+
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketCoalescerOptions::PacketCoalescerOptionsImpl
+{
+public:
+    std::chrono::milliseconds mMaximumDuration{2000};
+    std::chrono::milliseconds mMaximumLinger{250};
+    int mMaximumSize{16384};
+};
+
+/// Constructor
+PacketCoalescerOptions::PacketCoalescerOptions() :
+    pImpl(std::make_unique<PacketCoalescerOptionsImpl> ())
+{
+}
+
+/// Copy constructor
+PacketCoalescerOptions::PacketCoalescerOptions(
+    const PacketCoalescerOptions &options)
+{
+    *this = options;
+}
+
+/// Move constructor
+PacketCoalescerOptions::PacketCoalescerOptions(
+    PacketCoalescerOptions &&options) noexcept
+{
+    *this = std::move(options);
+}
+
+/// Copy assignment
+PacketCoalescerOptions&
+PacketCoalescerOptions::operator=(const PacketCoalescerOptions &options)
+{
+    if (&options == this){return *this;}
+    pImpl = std::make_unique<PacketCoalescerOptionsImpl> (*options.pImpl);
+    return *this;
+}
+
+/// Move assignment
+PacketCoalescerOptions&
+PacketCoalescerOptions::operator=(PacketCoalescerOptions &&options) noexcept
+{
+    if (&options == this){return *this;}
+    pImpl = std::move(options.pImpl);
+    return *this;
+}
+
+/// Destructor
+PacketCoalescerOptions::~PacketCoalescerOptions() = default;
+
+/// Maximum duration
+void PacketCoalescerOptions::setMaximumDuration(
+    const std::chrono::milliseconds &duration)
+{
+    if (duration.count() <= 0)
+    {
+        throw std::invalid_argument("Maximum duration must be positive");
+    }
+    pImpl->mMaximumDuration = duration;
+}
+
+std::chrono::milliseconds
+PacketCoalescerOptions::getMaximumDuration() const noexcept
+{
+    return pImpl->mMaximumDuration;
+}
+
+/// Maximum size
+void PacketCoalescerOptions::setMaximumSizeInBytes(const int maximumSize)
+{
+    if (maximumSize <= 0)
+    {
+        throw std::invalid_argument("Maximum size must be positive");
+    }
+    pImpl->mMaximumSize = maximumSize;
+}
+
+int PacketCoalescerOptions::getMaximumSizeInBytes() const noexcept
+{
+    return pImpl->mMaximumSize;
+}
+
+/// Maximum linger
+void PacketCoalescerOptions::setMaximumLinger(
+    const std::chrono::milliseconds &linger)
+{
+    if (linger.count() <= 0)
+    {
+        throw std::invalid_argument("Maximum linger must be positive");
+    }
+    pImpl->mMaximumLinger = linger;
+}
+
+std::chrono::milliseconds
+PacketCoalescerOptions::getMaximumLinger() const noexcept
+{
+    return pImpl->mMaximumLinger;
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketCoalescer::PacketCoalescerImpl
+{
+public:
+    explicit PacketCoalescerImpl(const PacketCoalescerOptions &options) :
+        mMaximumDuration(
+            std::chrono::duration_cast<std::chrono::microseconds>
+            (options.getMaximumDuration())),
+        mMaximumLinger(options.getMaximumLinger()),
+        mMaximumSize(static_cast<size_t> (options.getMaximumSizeInBytes())),
+        mWheel(makeWheel())
+    {
+    }
+
+    [[nodiscard]] TimerWheel<size_t> makeWheel() const
+    {
+        auto linger
+            = std::chrono::duration_cast<std::chrono::microseconds>
+              (mMaximumLinger);
+        auto resolution
+            = std::max(std::chrono::microseconds {1000}, linger/16);
+        return TimerWheel<size_t> {resolution, 32};
+    }
+
+    /// @result The duration of the packet in microseconds.
+    [[nodiscard]] static int64_t computeDuration(
+        const UDataPacketImportAPI::V1::Packet &packet)
+    {
+        return static_cast<int64_t>
+               (std::round(packet.number_of_samples()*1.e6
+                          /packet.sampling_rate()));
+    }
+
+    /// @result True indicates the packet can be appended to the stream's
+    ///         pending packet.
+    [[nodiscard]] bool isContiguous(const ::Stream &stream,
+                                    const UDataPacketImportAPI::V1::Packet &packet,
+                                    const int64_t startTime) const
+    {
+        if (!stream.havePending){return false;}
+        const auto &pending = stream.pending;
+        if (pending.data_type() != packet.data_type()){return false;}
+        const auto samplingRate = pending.sampling_rate();
+        if (std::abs(samplingRate - packet.sampling_rate()) >
+            1.e-6*samplingRate)
+        {
+            return false;
+        }
+        // Within half a sample of where the pending packet ends
+        auto expectedStartTime = stream.startTime + computeDuration(pending);
+        auto halfSample = 0.5e6/samplingRate;
+        if (std::abs(static_cast<double> (startTime - expectedStartTime)) >
+            halfSample)
+        {
+            return false;
+        }
+        // Would merging exceed our limits?
+        if (pending.data().size() + packet.data().size() > mMaximumSize)
+        {
+            return false;
+        }
+        auto mergedDuration = computeDuration(pending)
+                            + computeDuration(packet);
+        return mergedDuration <= mMaximumDuration.count();
+    }
+
+    void flush(::Stream &stream,
+               std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> &released)
+    {
+        if (!stream.havePending){return;}
+        released.emplace_back(stream.journalSequence,
+                              std::move(stream.pending));
+        stream.pending.Clear();
+        stream.journalSequence = 0;
+        stream.havePending = false;
+        mSize = mSize - 1;
+    }
+
+    /// @result True indicates the merged packet is as big as it is allowed
+    ///         to get.
+    [[nodiscard]] bool isFull(const ::Stream &stream) const
+    {
+        if (!stream.havePending){return false;}
+        if (stream.pending.data().size() >= mMaximumSize){return true;}
+        return computeDuration(stream.pending) >= mMaximumDuration.count();
+    }
+
+    std::unordered_map<StreamKey, size_t, StreamKeyHash, StreamKeyEqual>
+        mStreamIndex;
+    std::vector<::Stream> mStreams;
+    std::vector<size_t> mExpired;
+    std::chrono::microseconds mMaximumDuration{2000000};
+    std::chrono::milliseconds mMaximumLinger{250};
+    size_t mMaximumSize{16384};
+    TimerWheel<size_t> mWheel;
+    int mSize{0};
+};
+
+/// Constructor
+PacketCoalescer::PacketCoalescer(const PacketCoalescerOptions &options) :
+    pImpl(std::make_unique<PacketCoalescerImpl> (options))
+{
+}
+
+/// Destructor
+PacketCoalescer::~PacketCoalescer() = default;
+
+/// Insert
+std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>>
+PacketCoalescer::insert(UDataPacketImportAPI::V1::Packet &&packet,
+                        const Clock::time_point now,
+                        const uint64_t journalSequence)
+{
+    std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> released;
+    if (!packet.has_stream_identifier())
+    {
+        throw std::invalid_argument("Stream identifier not set");
+    }
+    if (packet.sampling_rate() <= 0)
+    {
+        throw std::invalid_argument("Sampling rate must be positive");
+    }
+    const StreamKeyView key{packet.stream_identifier()};
+    auto it = pImpl->mStreamIndex.find(key);
+    if (it == pImpl->mStreamIndex.end())
+    {
+        it = pImpl->mStreamIndex.emplace(StreamKey {key},
+                                         pImpl->mStreams.size()).first;
+        pImpl->mStreams.emplace_back();
+    }
+    const auto index = it->second;
+    auto &stream = pImpl->mStreams[index];
+    // Packets we don't know how to merge go straight through but whatever
+    // preceded them must go first
+    auto sampleSize = ::getSampleSize(packet.data_type());
+    if (sampleSize == 0 ||
+        packet.data().size() != sampleSize*packet.number_of_samples())
+    {
+        pImpl->flush(stream, released);
+        released.emplace_back(journalSequence, std::move(packet));
+        return released;
+    }
+    auto startTime
+        = google::protobuf::util::TimeUtil::TimestampToMicroseconds(
+             packet.start_time());
+    if (pImpl->isContiguous(stream, packet, startTime))
+    {
+        auto &pending = stream.pending;
+        pending.mutable_data()->append(packet.data());
+        pending.set_number_of_samples(pending.number_of_samples()
+                                    + packet.number_of_samples());
+        // The merged packet holds back the journal for all of its parts
+        if (journalSequence > 0 &&
+            (stream.journalSequence == 0 ||
+             journalSequence < stream.journalSequence))
+        {
+            stream.journalSequence = journalSequence;
+        }
+    }
+    else
+    {
+        pImpl->flush(stream, released);
+        stream.pending = std::move(packet);
+        stream.startTime = startTime;
+        stream.journalSequence = journalSequence;
+        stream.deadline = now + pImpl->mMaximumLinger;
+        stream.havePending = true;
+        pImpl->mSize = pImpl->mSize + 1;
+        if (!stream.scheduled)
+        {
+            pImpl->mWheel.schedule(index, stream.deadline);
+            stream.scheduled = true;
+        }
+    }
+    if (pImpl->isFull(stream)){pImpl->flush(stream, released);}
+    return released;
+}
+
+/// Release lingering packets
+std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>>
+PacketCoalescer::release(const Clock::time_point now)
+{
+    std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> released;
+    if (pImpl->mWheel.empty()){return released;}
+    pImpl->mExpired.clear();
+    pImpl->mWheel.advance(now, pImpl->mExpired);
+    for (const auto index : pImpl->mExpired)
+    {
+        auto &stream = pImpl->mStreams[index];
+        stream.scheduled = false;
+        if (stream.havePending && stream.deadline <= now)
+        {
+            pImpl->flush(stream, released);
+        }
+        // A newer merged packet started after this entry was scheduled
+        if (stream.havePending)
+        {
+            pImpl->mWheel.schedule(index, stream.deadline);
+            stream.scheduled = true;
+        }
+    }
+    return released;
+}
+
+/// Release everything
+std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> PacketCoalescer::releaseAll()
+{
+    std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> released;
+    released.reserve(static_cast<size_t> (pImpl->mSize));
+    for (auto &stream : pImpl->mStreams)
+    {
+        pImpl->flush(stream, released);
+        stream.scheduled = false;
+    }
+    pImpl->mWheel = pImpl->makeWheel();
+    return released;
+}
+
+/// Size
+int PacketCoalescer::size() const noexcept
+{
+    return pImpl->mSize;
+}
+
+/// Lowest journal sequence number
+std::optional<uint64_t> PacketCoalescer::getLowestJournalSequence() const
+{
+    std::optional<uint64_t> result{std::nullopt};
+    if (pImpl->mSize == 0){return result;}
+    for (const auto &stream : pImpl->mStreams)
+    {
+        if (stream.havePending &&
+            stream.journalSequence > 0 &&
+            (!result || stream.journalSequence < *result))
+        {
+            result = stream.journalSequence;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#ifndef NDEBUG
+#include <cassert>
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/crc.hpp>
+#include "uDataPacketImportProxy/packetJournal.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+constexpr uint64_t journalMagic{0x314C4E524A504455}; // UDPJRNL1
+constexpr uint32_t journalVersion{2};
+constexpr uint32_t recordMagic{0x4345524A};  // JREC
+constexpr size_t journalHeaderSize{4096};
+constexpr size_t recordAlignment{8};
+
+/// The journal header occupies the first page of the file.
+struct JournalHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t capacity;
+    uint64_t slotSize;
+    uint64_t nextSequence;
+    uint64_t committedSequence;
+};
+static_assert(sizeof(JournalHeader) <= journalHeaderSize);
+static_assert(offsetof(JournalHeader, nextSequence) % 8 == 0);
+static_assert(offsetof(JournalHeader, committedSequence) % 8 == 0);
+
+/// Each record occupies one slot of the ring and starts with this
+/// fixed-size header.  The CRC covers the sequence number, length, and
+/// payload.
+struct RecordHeader
+{
+    uint32_t magic;
+    uint32_t length;
+    uint64_t sequence;
+    uint32_t crc;
+    uint32_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 24);
+
+[[nodiscard]] uint32_t computeCRC(const uint64_t sequence,
+                                  const uint32_t length,
+                                  const char *payload)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(&sequence, sizeof(sequence));
+    crc.process_bytes(&length, sizeof(length));
+    crc.process_bytes(payload, length);
+    return crc.checksum();
+}
+
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketJournalOptions::PacketJournalOptionsImpl
+{
+public:
+    std::filesystem::path mFileName;
+    std::chrono::milliseconds mMaximumReplayWait{std::chrono::seconds {10}};
+    int64_t mCapacity{64*1024*1024};
+    int mSlotSize{4096};
+    int mSynchronizationInterval{1024};
+    bool mHaveFileName{false};
+};
+
+/// Constructor
+PacketJournalOptions::PacketJournalOptions() :
+    pImpl(std::make_unique<PacketJournalOptionsImpl> ())
+{
+}
+
+/// Copy constructor
+PacketJournalOptions::PacketJournalOptions(const PacketJournalOptions &options)
+{
+    *this = options;
+}
+
+/// Move constructor
+PacketJournalOptions::PacketJournalOptions(
+    PacketJournalOptions &&options) noexcept
+{
+    *this = std::move(options);
+}
+
+/// Copy assignment
+PacketJournalOptions&
+PacketJournalOptions::operator=(const PacketJournalOptions &options)
+{
+    if (&options == this){return *this;}
+    pImpl = std::make_unique<PacketJournalOptionsImpl> (*options.pImpl);
+    return *this;
+}
+
+/// Move assignment
+PacketJournalOptions&
+PacketJournalOptions::operator=(PacketJournalOptions &&options) noexcept
+{
+    if (&options == this){return *this;}
+    pImpl = std::move(options.pImpl);
+    return *this;
+}
+
+/// Destructor
+PacketJournalOptions::~PacketJournalOptions() = default;
+
+/// File name
+void PacketJournalOptions::setFileName(const std::filesystem::path &fileName)
+{
+    if (fileName.empty())
+    {
+        throw std::invalid_argument("Journal file name is empty");
+    }
+    pImpl->mFileName = fileName;
+    pImpl->mHaveFileName = true;
+}
+
+std::filesystem::path PacketJournalOptions::getFileName() const
+{
+    if (!haveFileName())
+    {
+        throw std::runtime_error("Journal file name not set");
+    }
+    return pImpl->mFileName;
+}
+
+bool PacketJournalOptions::haveFileName() const noexcept
+{
+    return pImpl->mHaveFileName;
+}
+
+/// Capacity
+void PacketJournalOptions::setCapacityInBytes(const int64_t capacity)
+{
+    constexpr int64_t minimumCapacity{64*1024};
+    if (capacity < minimumCapacity)
+    {
+        throw std::invalid_argument("Journal capacity must be at least "
+                                  + std::to_string(minimumCapacity)
+                                  + " bytes");
+    }
+    pImpl->mCapacity = capacity;
+}
+
+int64_t PacketJournalOptions::getCapacityInBytes() const noexcept
+{
+    return pImpl->mCapacity;
+}
+
+/// Slot size
+void PacketJournalOptions::setSlotSizeInBytes(const int slotSize)
+{
+    constexpr int minimumSlotSize{256};
+    if (slotSize < minimumSlotSize)
+    {
+        throw std::invalid_argument("Journal slot size must be at least "
+                                  + std::to_string(minimumSlotSize)
+                                  + " bytes");
+    }
+    if (slotSize%static_cast<int> (recordAlignment) != 0)
+    {
+        throw std::invalid_argument(
+            "Journal slot size must be a multiple of 8 bytes");
+    }
+    pImpl->mSlotSize = slotSize;
+}
+
+int PacketJournalOptions::getSlotSizeInBytes() const noexcept
+{
+    return pImpl->mSlotSize;
+}
+
+/// Synchronization interval
+void PacketJournalOptions::setSynchronizationInterval(const int nRecords)
+{
+    if (nRecords < 1)
+    {
+        throw std::invalid_argument(
+            "Synchronization interval must be positive");
+    }
+    pImpl->mSynchronizationInterval = nRecords;
+}
+
+int PacketJournalOptions::getSynchronizationInterval() const noexcept
+{
+    return pImpl->mSynchronizationInterval;
+}
+
+/// Replay wait
+void PacketJournalOptions::setMaximumReplayWait(
+    const std::chrono::milliseconds &wait)
+{
+    if (wait.count() < 0)
+    {
+        throw std::invalid_argument("Maximum replay wait cannot be negative");
+    }
+    pImpl->mMaximumReplayWait = wait;
+}
+
+std::chrono::milliseconds
+PacketJournalOptions::getMaximumReplayWait() const noexcept
+{
+    return pImpl->mMaximumReplayWait;
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketJournal::PacketJournalImpl
+{
+public:
+    explicit PacketJournalImpl(const PacketJournalOptions &options)
+    {
+        if (!options.haveFileName())
+        {
+            throw std::invalid_argument("Journal file name not set");
+        }
+        mFileName = options.getFileName();
+        mSlotSize = static_cast<size_t> (options.getSlotSizeInBytes());
+        mNumberOfSlots
+            = static_cast<size_t> (options.getCapacityInBytes())/mSlotSize;
+        if (mNumberOfSlots < 2)
+        {
+            throw std::invalid_argument(
+                "Journal capacity must hold at least two slots");
+        }
+        mCapacity = mNumberOfSlots*mSlotSize;
+        mSynchronizationInterval
+            = static_cast<uint64_t> (options.getSynchronizationInterval());
+        if (mFileName.has_parent_path())
+        {
+            std::error_code errorCode;
+            std::filesystem::create_directories(mFileName.parent_path(),
+                                                errorCode);
+        }
+        map();
+        recover();
+    }
+
+    ~PacketJournalImpl()
+    {
+        if (mAddress != nullptr)
+        {
+            mHeader->nextSequence = mNextSequence.load();
+            ::msync(mAddress, mMappedSize, MS_SYNC);
+            ::munmap(mAddress, mMappedSize);
+        }
+    }
+
+    void map()
+    {
+        auto fileDescriptor
+            = ::open(mFileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                     S_IRUSR | S_IWUSR | S_IRGRP);
+        if (fileDescriptor < 0)
+        {
+            throw std::runtime_error("Failed to open journal "
+                                   + mFileName.string() + " because "
+                                   + std::string {std::strerror(errno)});
+        }
+        mMappedSize = journalHeaderSize + mCapacity;
+        struct stat status{};
+        if (::fstat(fileDescriptor, &status) != 0)
+        {
+            ::close(fileDescriptor);
+            throw std::runtime_error("Failed to stat journal "
+                                   + mFileName.string());
+        }
+        bool initialize{static_cast<size_t> (status.st_size) != mMappedSize};
+        if (initialize &&
+            ::ftruncate(fileDescriptor, static_cast<off_t> (mMappedSize)) != 0)
+        {
+            ::close(fileDescriptor);
+            throw std::runtime_error("Failed to size journal "
+                                   + mFileName.string());
+        }
+        auto address = ::mmap(nullptr, mMappedSize, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fileDescriptor, 0);
+        ::close(fileDescriptor);
+        if (address == MAP_FAILED)
+        {
+            throw std::runtime_error("Failed to map journal "
+                                   + mFileName.string());
+        }
+        mAddress = static_cast<char *> (address);
+        mHeader = reinterpret_cast<::JournalHeader *> (mAddress);
+        mData = mAddress + journalHeaderSize;
+        if (mHeader->magic != journalMagic ||
+            mHeader->version != journalVersion ||
+            mHeader->headerSize != journalHeaderSize ||
+            mHeader->capacity != mCapacity ||
+            mHeader->slotSize != mSlotSize)
+        {
+            initialize = true;
+        }
+        if (initialize)
+        {
+            std::memset(mAddress, 0, mMappedSize);
+            mHeader->magic = journalMagic;
+            mHeader->version = journalVersion;
+            mHeader->headerSize = journalHeaderSize;
+            mHeader->capacity = mCapacity;
+            mHeader->slotSize = mSlotSize;
+            mHeader->nextSequence = 1;
+            mHeader->committedSequence = 0;
+            ::msync(mAddress, mMappedSize, MS_SYNC);
+        }
+    }
+
+    /// Scan the slots for intact records that were never committed
+    void recover()
+    {
+        const auto committedSequence = mHeader->committedSequence;
+        auto nextSequence = std::max<uint64_t> ({1,
+                                                 mHeader->nextSequence,
+                                                 committedSequence + 1});
+        std::vector<std::pair<uint64_t, size_t>> records;
+        for (size_t slot = 0; slot < mNumberOfSlots; ++slot)
+        {
+            const auto offset = slot*mSlotSize;
+            ::RecordHeader header{};
+            std::memcpy(&header, mData + offset, sizeof(header));
+            if (header.magic != recordMagic){continue;}
+            if (sizeof(header) + header.length > mSlotSize){continue;}
+            const auto *payload = mData + offset + sizeof(header);
+            if (::computeCRC(header.sequence, header.length, payload) !=
+                header.crc)
+            {
+                continue;
+            }
+            nextSequence = std::max(nextSequence, header.sequence + 1);
+            if (header.sequence > committedSequence)
+            {
+                records.emplace_back(header.sequence, offset);
+            }
+        }
+        std::sort(records.begin(), records.end());
+        mUncommittedPackets.reserve(records.size());
+        for (const auto &[sequence, offset] : records)
+        {
+            ::RecordHeader header{};
+            std::memcpy(&header, mData + offset, sizeof(header));
+            UDataPacketImportAPI::V1::Packet packet;
+            if (packet.ParseFromArray(mData + offset + sizeof(header),
+                                      static_cast<int> (header.length)))
+            {
+                mUncommittedPackets.emplace_back(sequence, std::move(packet));
+            }
+        }
+        mHeader->nextSequence = nextSequence;
+        mNextSequence.store(nextSequence);
+        mCommittedSequence.store(committedSequence);
+    }
+
+    [[nodiscard]] uint64_t append(
+        const UDataPacketImportAPI::V1::Packet &packet)
+    {
+        const auto payloadSize = packet.ByteSizeLong();
+        if (sizeof(::RecordHeader) + payloadSize > mSlotSize)
+        {
+            throw std::invalid_argument("Packet too large for a journal slot");
+        }
+        // Reserve the sequence number and, with it, the slot.  Sequence s
+        // lives in slot (s - 1) % nSlots which is free once s - nSlots is
+        // committed.  A compare-and-swap rather than a fetch-and-add lets
+        // a refused append leave the sequence numbers dense.
+        auto sequence = mNextSequence.load(std::memory_order_relaxed);
+        do
+        {
+            if (sequence - mCommittedSequence.load(std::memory_order_acquire)
+                > mNumberOfSlots)
+            {
+                mOverflows.fetch_add(1, std::memory_order_relaxed);
+                throw std::runtime_error(
+                    "Journal is full of uncommitted packets");
+            }
+        }
+        while (!mNextSequence.compare_exchange_weak(
+                   sequence, sequence + 1, std::memory_order_relaxed));
+        // The slot is ours so copy the packet in without a lock.  The
+        // payload goes first so a torn write fails the CRC.
+        auto *destination = mData + ((sequence - 1)%mNumberOfSlots)*mSlotSize;
+        auto *payload = destination + sizeof(::RecordHeader);
+        ::RecordHeader header{};
+        header.length = static_cast<uint32_t> (payloadSize);
+        header.sequence = sequence;
+        if (packet.SerializeToArray(payload, static_cast<int> (payloadSize)))
+        {
+            header.magic = recordMagic;
+            header.crc = ::computeCRC(header.sequence, header.length, payload);
+        }
+        // N.B. A packet that fails to serialize still gets its sequence
+        // number so the sequence numbers stay dense; it is not replayed.
+        std::memcpy(destination, &header, sizeof(header));
+        // Occasionally hint to the kernel that it should write back
+        if (sequence%mSynchronizationInterval == 0)
+        {
+            ::msync(mAddress, mMappedSize, MS_ASYNC);
+        }
+        return sequence;
+    }
+
+    void commit(const uint64_t sequence) noexcept
+    {
+        auto committed = mCommittedSequence.load(std::memory_order_relaxed);
+        while (sequence > committed &&
+               !mCommittedSequence.compare_exchange_weak(
+                   committed, sequence, std::memory_order_release,
+                   std::memory_order_relaxed))
+        {
+        }
+        if (sequence > committed)
+        {
+            std::atomic_ref<uint64_t> (mHeader->committedSequence)
+                .store(mCommittedSequence.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+            std::atomic_ref<uint64_t> (mHeader->nextSequence)
+                .store(mNextSequence.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+        }
+    }
+
+    mutable std::mutex mMutex;
+    std::filesystem::path mFileName;
+    // N.B. The mutex protects only the packets recovered at start up
+    std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>>
+        mUncommittedPackets;
+    char *mAddress{nullptr};
+    char *mData{nullptr};
+    ::JournalHeader *mHeader{nullptr};
+    size_t mMappedSize{0};
+    size_t mCapacity{64*1024*1024};
+    size_t mSlotSize{4096};
+    size_t mNumberOfSlots{16384};
+    uint64_t mSynchronizationInterval{1024};
+    std::atomic<uint64_t> mNextSequence{1};
+    std::atomic<uint64_t> mCommittedSequence{0};
+    std::atomic<uint64_t> mOverflows{0};
+};
+
+/// Constructor
+PacketJournal::PacketJournal(const PacketJournalOptions &options) :
+    pImpl(std::make_unique<PacketJournalImpl> (options))
+{
+}
+
+/// Destructor
+PacketJournal::~PacketJournal() = default;
+
+/// Append
+uint64_t PacketJournal::append(const UDataPacketImportAPI::V1::Packet &packet)
+{
+    return pImpl->append(packet);
+}
+
+/// Commit
+void PacketJournal::commit(const uint64_t sequence) noexcept
+{
+    pImpl->commit(sequence);
+}
+
+/// Uncommitted packets from the previous run
+std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>>
+PacketJournal::takeUncommittedPackets()
+{
+    const std::lock_guard<std::mutex> lock(pImpl->mMutex);
+    auto result = std::move(pImpl->mUncommittedPackets);
+    pImpl->mUncommittedPackets.clear();
+    return result;
+}
+
+/// Committed sequence
+uint64_t PacketJournal::getCommittedSequence() const noexcept
+{
+    return pImpl->mCommittedSequence.load();
+}
+
+/// Next sequence
+uint64_t PacketJournal::getNextSequence() const noexcept
+{
+    return pImpl->mNextSequence.load();
+}
+
+/// Overflows
+uint64_t PacketJournal::getNumberOfOverflows() const noexcept
+{
+    return pImpl->mOverflows.load();
+}
+
+/// Slots
+uint64_t PacketJournal::getNumberOfSlots() const noexcept
+{
+    return pImpl->mNumberOfSlots;
+}
+
+/// Flush
+void PacketJournal::synchronize()
+{
+    std::atomic_ref<uint64_t> (pImpl->mHeader->nextSequence)
+        .store(pImpl->mNextSequence.load(), std::memory_order_relaxed);
+    if (::msync(pImpl->mAddress, pImpl->mMappedSize, MS_SYNC) != 0)
+    {
+        throw std::runtime_error("Failed to synchronize journal");
+    }
+}
@@ -0,0 +1,518 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_PACKET_PIPELINE_HPP
+#define UDATA_PACKET_IMPORT_PROXY_PACKET_PIPELINE_HPP
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <tbb/concurrent_queue.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/logger.h>
+#include "uDataPacketImportProxy/duplicatePacketDetector.hpp"
+#include "uDataPacketImportProxy/packetSpool.hpp"
+#include "uDataPacketImportProxy/packetJournal.hpp"
+#include "uDataPacketImportProxy/packetReorderBuffer.hpp"
+#include "uDataPacketImportProxy/packetCoalescer.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "deliveryTracker.hpp"
+#include "flightRecorder.hpp"
+#include "rateLimitedLog.hpp"
+#include "tracing.hpp"
+import metrics;
+import getNow;
+/// @brief The proxy's path from the frontend's callback to the backend.
+///        This is separate from the proxy's threads and RPCs so that the
+///        simulation can drive it on a virtual clock.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+namespace UDataPacketImportProxy
+{
+
+/// A packet in the import queue along with its journal sequence number,
+/// the time it arrived from the frontend, and its trace.  A sequence number
+/// of 0 indicates the packet was not journaled.
+struct ImportedPacket
+{
+    UDataPacketImportAPI::V1::Packet packet;
+    uint64_t journalSequence{0};
+    std::chrono::steady_clock::time_point ingestTime;
+    Tracing::Trace trace;
+};
+
+/// @brief Admits packets to the import queue and propagates them, one at a
+///        time, through duplicate detection, the reorder buffer, and the
+///        coalescer to the subscribers.  Every stage is optional and owned
+///        by the caller.
+/// @note Any number of threads may admit packets but only one thread, the
+///       propagator, may step the pipeline.
+class PacketPipeline
+{
+public:
+    /// Hands a packet and its delivery receipt, which may be null, to the
+    /// subscribers.  The result is the number of packets overwritten in
+    /// the subscribers' queues.
+    using Sink
+        = std::function<int (UDataPacketImportAPI::V1::Packet &&,
+                             const std::chrono::steady_clock::time_point &,
+                             const DeliveryReceipt *)>;
+    /// The optional stages.  They must outlive the pipeline.
+    struct Stages
+    {
+        DuplicatePacketDetector *duplicateDetector{nullptr};
+        PacketSpool *spool{nullptr};
+        PacketJournal *journal{nullptr};
+        DeliveryTracker *deliveryTracker{nullptr};
+        PacketReorderBuffer *reorderBuffer{nullptr};
+        PacketCoalescer *coalescer{nullptr};
+    };
+
+    /// @param[in] queueCapacity  The capacity of the import queue.
+    /// @param[in] stages         The optional stages.  A journal requires a
+    ///                           delivery tracker.
+    /// @param[in] sink           Forwards packets to the subscribers.
+    /// @param[in] logger         The logger.
+    /// @param[in] clock          The clock.  By default this is the system
+    ///                           clock.
+    /// @throws std::invalid_argument if the capacity is not positive, the
+    ///         sink is not callable, or a journal lacks a tracker.
+    PacketPipeline(const int queueCapacity,
+                   const Stages &stages,
+                   Sink sink,
+                   std::shared_ptr<spdlog::logger> logger,
+                   std::shared_ptr<Utilities::Clock> clock = nullptr) :
+        mStages(stages),
+        mSink(std::move(sink)),
+        mLogger(std::move(logger)),
+        mClock(std::move(clock))
+    {
+        if (queueCapacity < 1)
+        {
+            throw std::invalid_argument("Queue capacity must be positive");
+        }
+        if (!mSink)
+        {
+            throw std::invalid_argument("Sink not set");
+        }
+        if (mStages.journal && !mStages.deliveryTracker)
+        {
+            throw std::invalid_argument("Journal requires a delivery tracker");
+        }
+        if (mClock == nullptr)
+        {
+            mClock = Utilities::getSystemClock();
+        }
+        mQueueCapacity = queueCapacity;
+        mQueue.set_capacity(mQueueCapacity);
+        mLastCommit = mClock->now();
+    }
+
+    /// @brief Adds the packet to the import queue.  Once the spool is in use
+    ///        every packet goes through it.  Otherwise, a full queue evicts
+    ///        its oldest packet.  When journaling, the packet is journaled
+    ///        before it is queued.
+    /// @note This is called by the frontend's threads.
+    void admit(UDataPacketImportAPI::V1::Packet &&packet,
+               const Tracing::Trace &trace = {})
+    {
+        const auto ingestTime = mClock->now();
+        auto approximateSize = static_cast<int> (mQueue.size());
+        // Once the spool is in use everything goes through it so that
+        // the propagator drains packets in the order they arrived
+        if (mStages.spool)
+        {
+            const bool spoolInUse{!mStages.spool->empty()};
+            if (approximateSize >= mQueueCapacity || spoolInUse)
+            {
+                try
+                {
+                    if (mStages.spool->push(packet)){return;}
+                }
+                catch (const std::exception &e)
+                {
+                    RATE_LIMITED_LOGGER_ERROR(mLogger,
+                                        "Failed to spool packet because {}",
+                                        std::string {e.what()});
+                }
+                // Bypassing a spool that holds older packets would
+                // deliver this one out of order so drop it instead
+                if (spoolInUse)
+                {
+                    mMetrics.incrementDroppedPacketsCounter(
+                        Metrics::DropReason::SpoolOverflow);
+                    FlightRecorder::record(
+                        FlightRecorder::EventType::QueueOverflow,
+                        packet.stream_identifier(),
+                        1,
+                        static_cast<uint16_t> (FlightRecorder::Queue::Spool));
+                    return;
+                }
+                // Spool is unavailable - fall through and evict
+            }
+        }
+        // Try to ensure there is enough space
+        while (approximateSize >= mQueueCapacity)
+        {
+            ImportedPacket workSpace;
+            if (!mQueue.try_pop(workSpace))
+            {
+                RATE_LIMITED_LOGGER_WARN(
+                    mLogger,
+                    "Failed to pop element from import queue");
+                break;
+            }
+            mMetrics.getQueueDepth(Metrics::QueueType::Import).add(-1);
+            mMetrics.incrementDroppedPacketsCounter(
+                Metrics::DropReason::ImportOverflow);
+            if (workSpace.journalSequence > 0)
+            {
+                mStages.deliveryTracker->markDequeued(
+                    workSpace.journalSequence);
+            }
+            FlightRecorder::record(
+                FlightRecorder::EventType::QueueOverflow,
+                workSpace.packet.stream_identifier(),
+                1,
+                static_cast<uint16_t> (FlightRecorder::Queue::Import));
+            approximateSize = static_cast<int> (mQueue.size());
+        }
+        // Try to add the packet.  Journaled packets may enter the queue
+        // out of sequence order; the delivery tracker only commits a
+        // sequence number once every one before it has left the queue.
+        ImportedPacket importedPacket{std::move(packet),
+                                      0,
+                                      ingestTime,
+                                      trace};
+        if (mStages.journal)
+        {
+            try
+            {
+                importedPacket.journalSequence
+                    = mStages.journal->append(importedPacket.packet);
+            }
+            catch (const std::exception &e)
+            {
+                RATE_LIMITED_LOGGER_WARN(mLogger,
+                         "Failed to journal packet because {} ({} overflows)",
+                         std::string {e.what()},
+                         mStages.journal->getNumberOfOverflows());
+            }
+        }
+        const auto journalSequence = importedPacket.journalSequence;
+        if (mQueue.try_push(std::move(importedPacket)))
+        {
+            mMetrics.updateQueueDepth(
+                Metrics::QueueType::Import,
+                1,
+                static_cast<int64_t> (mQueue.size()));
+        }
+        else
+        {
+            if (journalSequence > 0)
+            {
+                mStages.deliveryTracker->markDequeued(journalSequence);
+            }
+            RATE_LIMITED_LOGGER_ERROR(
+                mLogger,
+                "Failed to add packet to import queue");
+        }
+    }
+
+    /// @brief One pass of the propagator.  This propagates the next packet
+    ///        from the import queue or, once that is caught up, the spool.
+    ///        It then forwards the packets whose reorder windows or linger
+    ///        times elapsed and periodically commits the journal.
+    /// @result True indicates a packet was taken.  False indicates there was
+    ///         nothing to do so the caller should idle.
+    bool step()
+    {
+        bool busy{false};
+        ImportedPacket importedPacket;
+        if (mQueue.try_pop(importedPacket))
+        {
+            busy = true;
+            mMetrics.getQueueDepth(Metrics::QueueType::Import).add(-1);
+            mMetrics.recordLatency(Metrics::LatencyStage::ImportQueue,
+                                   mClock->now() - importedPacket.ingestTime);
+            if (importedPacket.journalSequence > 0)
+            {
+                mStages.deliveryTracker->markDequeued(
+                    importedPacket.journalSequence);
+            }
+            propagate(std::move(importedPacket.packet),
+                      importedPacket.ingestTime,
+                      importedPacket.trace,
+                      importedPacket.journalSequence);
+        }
+        else if (mStages.spool && !mStages.spool->empty())
+        {
+            // Caught up on the in-memory queue so drain the spool
+            std::optional<UDataPacketImportAPI::V1::Packet>
+                spooledPacket{std::nullopt};
+            try
+            {
+                spooledPacket = mStages.spool->pop();
+            }
+            catch (const std::exception &e)
+            {
+                RATE_LIMITED_LOGGER_ERROR(mLogger,
+                                    "Failed to read from spool because {}",
+                                    std::string {e.what()});
+            }
+            if (spooledPacket)
+            {
+                busy = true;
+                propagate(std::move(*spooledPacket),
+                          mClock->now(),
+                          Tracing::Trace{});
+            }
+        }
+        releaseHeldPackets();
+        const auto now = mClock->now();
+        if (now - mLastCommit >= commitInterval)
+        {
+            commitJournal();
+            mLastCommit = now;
+        }
+        return busy;
+    }
+
+    /// @brief Forwards everything held by the reorder buffer and coalescer
+    ///        and commits the journal.  This is for shutting down.
+    void flush()
+    {
+        releaseHeldPackets(true);
+        commitJournal();
+    }
+
+    /// @brief Propagates the packet, e.g., one replayed from the journal.
+    /// @note Packets held by the spool, reorder buffer, or coalescer are
+    ///       restamped with the time they are released so the latency
+    ///       histograms measure queueing and not deliberate hold time.
+    ///       Their traces are likewise dropped since a released packet
+    ///       can be a merger of several packets.
+    void propagate(
+        UDataPacketImportAPI::V1::Packet &&packet,
+        const std::chrono::steady_clock::time_point &ingestTime,
+        const Tracing::Trace &trace,
+        const uint64_t journalSequence = 0)
+    {
+        // Check duplicates
+        if (mStages.duplicateDetector)
+        {
+            bool allow{false};
+            Tracing::Span dedupSpan{trace, "dedup"};
+            const auto deduplicationStart = mClock->now();
+            try
+            {
+                allow = mStages.duplicateDetector->allow(packet);
+            }
+            catch (const std::exception &e)
+            {
+                 RATE_LIMITED_LOGGER_WARN(mLogger,
+                                    "Failed to check packet because {}",
+                                    std::string {e.what()});
+            }
+            mMetrics.recordLatency(Metrics::LatencyStage::Deduplication,
+                                   mClock->now() - deduplicationStart);
+            dedupSpan.end();
+            mMetrics.updateNumberOfDeduplicatedStreams(
+                mStages.duplicateDetector->getNumberOfStreams());
+            FlightRecorder::record(
+                allow ? FlightRecorder::EventType::DuplicateAllowed :
+                        FlightRecorder::EventType::DuplicateRejected,
+                packet.stream_identifier());
+            if (!allow)
+            {
+                mMetrics.incrementDroppedPacketsCounter(
+                    Metrics::DropReason::Duplicate);
+                return;
+            }
+        }
+        // Hold the packet until its stream can be put in order
+        if (mStages.reorderBuffer)
+        {
+            try
+            {
+                const auto now = mClock->now();
+                auto releasedPackets
+                    = mStages.reorderBuffer->insert(std::move(packet),
+                                                    now,
+                                                    journalSequence);
+                for (auto &[sequence, releasedPacket] : releasedPackets)
+                {
+                    coalesce(std::move(releasedPacket),
+                             now,
+                             Tracing::Trace{},
+                             sequence);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                RATE_LIMITED_LOGGER_WARN(mLogger,
+                                   "Failed to reorder packet because {}",
+                                   std::string {e.what()});
+            }
+            return;
+        }
+        coalesce(std::move(packet), ingestTime, trace, journalSequence);
+    }
+
+    /// @brief Commits the journal up to the packet before the oldest one
+    ///        still in the proxy.  A packet has left the proxy once it is
+    ///        off the import queue, the reorder buffer and coalescer are not
+    ///        holding it, and every subscriber has written or dropped it.
+    ///        A merged packet holds back the journal at the lowest sequence
+    ///        number of its parts.
+    void commitJournal()
+    {
+        if (!mStages.journal){return;}
+        // N.B. The tracker must not advance past a held packet since its
+        // receipt is made only once the packet is released
+        auto sequence = std::numeric_limits<uint64_t>::max();
+        if (mStages.reorderBuffer)
+        {
+            if (auto lowestSequence
+                    = mStages.reorderBuffer->getLowestJournalSequence())
+            {
+                sequence = std::min(sequence, *lowestSequence - 1);
+            }
+        }
+        if (mStages.coalescer)
+        {
+            if (auto lowestSequence
+                    = mStages.coalescer->getLowestJournalSequence())
+            {
+                sequence = std::min(sequence, *lowestSequence - 1);
+            }
+        }
+        mStages.journal->commit(mStages.deliveryTracker->advance(sequence));
+    }
+private:
+    /// Merges small contiguous packets prior to sending them on
+    void coalesce(
+        UDataPacketImportAPI::V1::Packet &&packet,
+        const std::chrono::steady_clock::time_point &ingestTime,
+        const Tracing::Trace &trace,
+        const uint64_t journalSequence = 0)
+    {
+        if (mStages.coalescer)
+        {
+            try
+            {
+                const auto now = mClock->now();
+                auto releasedPackets
+                    = mStages.coalescer->insert(std::move(packet),
+                                                now,
+                                                journalSequence);
+                for (auto &[sequence, releasedPacket] : releasedPackets)
+                {
+                    forward(std::move(releasedPacket),
+                            now,
+                            Tracing::Trace{},
+                            sequence);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                RATE_LIMITED_LOGGER_WARN(mLogger,
+                                   "Failed to coalesce packet because {}",
+                                   std::string {e.what()});
+            }
+            return;
+        }
+        forward(std::move(packet), ingestTime, trace, journalSequence);
+    }
+
+    /// Forwards the packets whose reorder windows or linger times elapsed
+    void releaseHeldPackets(const bool releaseAll = false)
+    {
+        const auto now = mClock->now();
+        if (mStages.reorderBuffer)
+        {
+            auto releasedPackets = releaseAll ?
+                                   mStages.reorderBuffer->releaseAll() :
+                                   mStages.reorderBuffer->release(now);
+            for (auto &[sequence, releasedPacket] : releasedPackets)
+            {
+                coalesce(std::move(releasedPacket),
+                         now,
+                         Tracing::Trace{},
+                         sequence);
+            }
+        }
+        if (mStages.coalescer)
+        {
+            auto releasedPackets = releaseAll ?
+                                   mStages.coalescer->releaseAll() :
+                                   mStages.coalescer->release(now);
+            for (auto &[sequence, releasedPacket] : releasedPackets)
+            {
+                forward(std::move(releasedPacket),
+                        now,
+                        Tracing::Trace{},
+                        sequence);
+            }
+        }
+    }
+
+    /// Sends the packet to the subscribers.  The sink picks up the trace
+    /// from the scope.  A journaled packet carries a receipt that holds
+    /// back the journal's commit until every subscriber has written or
+    /// dropped the packet.
+    void forward(
+        UDataPacketImportAPI::V1::Packet &&packet,
+        const std::chrono::steady_clock::time_point &ingestTime,
+        const Tracing::Trace &trace,
+        const uint64_t journalSequence = 0)
+    {
+        try
+        {
+            DeliveryReceipt deliveryReceipt;
+            if (mStages.deliveryTracker && journalSequence > 0)
+            {
+                deliveryReceipt
+                    = mStages.deliveryTracker->makeReceipt(journalSequence);
+            }
+            const Tracing::Span fanoutSpan{trace, "fanout"};
+            const Tracing::Scope scope{trace};
+            const auto fanoutStart = mClock->now();
+            // N.B. Packets over-written in the subscriber queues are
+            // counted by the backend's drop metrics
+            [[maybe_unused]] auto nPacketsLost
+                = mSink(std::move(packet),
+                        ingestTime,
+                        deliveryReceipt ? &deliveryReceipt : nullptr);
+            mMetrics.recordLatency(Metrics::LatencyStage::Fanout,
+                                   mClock->now() - fanoutStart);
+        }
+        catch (const std::exception &e)
+        {
+           RATE_LIMITED_LOGGER_ERROR(
+              mLogger,
+        "Failed to propagate packet to subscription manager because {}",
+              std::string {e.what()});
+        }
+    }
+
+    static constexpr std::chrono::milliseconds commitInterval{10};
+    Stages mStages;
+    Sink mSink;
+    std::shared_ptr<spdlog::logger> mLogger{nullptr};
+    std::shared_ptr<Utilities::Clock> mClock{nullptr};
+    Metrics::MetricsSingleton &mMetrics
+    {
+        Metrics::MetricsSingleton::getInstance()
+    };
+    tbb::concurrent_bounded_queue<ImportedPacket> mQueue;
+    std::chrono::steady_clock::time_point mLastCommit;
+    int mQueueCapacity{8192};
+};
+
+}
+#endif
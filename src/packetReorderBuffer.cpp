@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#ifndef NDEBUG
+#include <cassert>
+#endif
+#include <google/protobuf/util/time_util.h>
+#include "uDataPacketImportProxy/packetReorderBuffer.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
+#include "streamIdentifier.hpp"
+#include "timerWheel.hpp"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+
+struct PendingPacket
+{
+    UDataPacketImportAPI::V1::Packet packet;
+    PacketReorderBuffer::Clock::time_point deadline;
+    int64_t startTime{0}; // Start time in microseconds
+    uint64_t journalSequence{0};
+};
+
+/// The pending packets for a stream sorted on start time.  There are
+/// rarely more than a handful so a sorted array beats a heap.
+struct Stream
+{
+    std::vector<::PendingPacket> pending;
+    int64_t lastReleasedStartTime{0};
+    bool haveReleased{false};
+    bool scheduled{false};
+};
+
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketReorderBufferOptions::PacketReorderBufferOptionsImpl
+{
+public:
+    std::chrono::milliseconds mWindow{500};
+    int mMaximumNumberOfPacketsPerStream{64};
+};
+
+/// Constructor
+PacketReorderBufferOptions::PacketReorderBufferOptions() :
+    pImpl(std::make_unique<PacketReorderBufferOptionsImpl> ())
+{
+}
+
+/// Copy constructor
+PacketReorderBufferOptions::PacketReorderBufferOptions(
+    const PacketReorderBufferOptions &options)
+{
+    *this = options;
+}
+
+/// Move constructor
+PacketReorderBufferOptions::PacketReorderBufferOptions(
+    PacketReorderBufferOptions &&options) noexcept
+{
+    *this = std::move(options);
+}
+
+/// Copy assignment
+PacketReorderBufferOptions&
+PacketReorderBufferOptions::operator=(const PacketReorderBufferOptions &options)
+{
+    if (&options == this){return *this;}
+    pImpl = std::make_unique<PacketReorderBufferOptionsImpl> (*options.pImpl);
+    return *this;
+}
+
+/// Move assignment
+PacketReorderBufferOptions&
+PacketReorderBufferOptions::operator=(
+    PacketReorderBufferOptions &&options) noexcept
+{
+    if (&options == this){return *this;}
+    pImpl = std::move(options.pImpl);
+    return *this;
+}
+
+/// Destructor
+PacketReorderBufferOptions::~PacketReorderBufferOptions() = default;
+
+/// Window
+void PacketReorderBufferOptions::setWindow(
+    const std::chrono::milliseconds &window)
+{
+    if (window.count() <= 0)
+    {
+        throw std::invalid_argument("Reorder window must be positive");
+    }
+    pImpl->mWindow = window;
+}
+
+std::chrono::milliseconds PacketReorderBufferOptions::getWindow() const noexcept
+{
+    return pImpl->mWindow;
+}
+
+/// Packets per stream
+void PacketReorderBufferOptions::setMaximumNumberOfPacketsPerStream(
+    const int maximumNumberOfPackets)
+{
+    if (maximumNumberOfPackets < 1)
+    {
+        throw std::invalid_argument(
+            "Maximum number of packets per stream must be positive");
+    }
+    pImpl->mMaximumNumberOfPacketsPerStream = maximumNumberOfPackets;
+}
+
+int PacketReorderBufferOptions::getMaximumNumberOfPacketsPerStream()
+    const noexcept
+{
+    return pImpl->mMaximumNumberOfPacketsPerStream;
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketReorderBuffer::PacketReorderBufferImpl
+{
+public:
+    explicit PacketReorderBufferImpl(const PacketReorderBufferOptions &options) :
+        mWindow(options.getWindow()),
+        mMaximumNumberOfPacketsPerStream(
+            options.getMaximumNumberOfPacketsPerStream()),
+        mWheel(makeWheel())
+    {
+    }
+
+    [[nodiscard]] TimerWheel<size_t> makeWheel() const
+    {
+        // Aim for a slot width of about 1/16th of the window and a horizon
+        // of a couple windows
+        auto window
+            = std::chrono::duration_cast<std::chrono::microseconds> (mWindow);
+        auto resolution
+            = std::max(std::chrono::microseconds {1000}, window/16);
+        return TimerWheel<size_t> {resolution, 32};
+    }
+
+    void releaseFront(::Stream &stream, const size_t nRelease,
+                      std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> &released)
+    {
+        if (nRelease == 0){return;}
+#ifndef NDEBUG
+        assert(nRelease <= stream.pending.size());
+#endif
+        for (size_t i = 0; i < nRelease; ++i)
+        {
+            released.emplace_back(stream.pending[i].journalSequence,
+                                  std::move(stream.pending[i].packet));
+        }
+        stream.lastReleasedStartTime
+            = std::max(stream.lastReleasedStartTime,
+                       stream.pending[nRelease - 1].startTime);
+        stream.haveReleased = true;
+        stream.pending.erase(stream.pending.begin(),
+                             stream.pending.begin()
+                           + static_cast<std::ptrdiff_t> (nRelease));
+        mSize = mSize - static_cast<int> (nRelease);
+    }
+
+    void schedule(const size_t index)
+    {
+        auto &stream = mStreams[index];
+        stream.scheduled = false;
+        if (stream.pending.empty()){return;}
+        auto deadline = stream.pending.front().deadline;
+        for (const auto &pendingPacket : stream.pending)
+        {
+            deadline = std::min(deadline, pendingPacket.deadline);
+        }
+        mWheel.schedule(index, deadline);
+        stream.scheduled = true;
+    }
+
+    std::unordered_map<StreamKey, size_t, StreamKeyHash, StreamKeyEqual>
+        mStreamIndex;
+    std::vector<::Stream> mStreams;
+    std::vector<size_t> mExpired;
+    std::chrono::milliseconds mWindow{500};
+    int mMaximumNumberOfPacketsPerStream{64};
+    TimerWheel<size_t> mWheel;
+    int mSize{0};
+};
+
+/// Constructor
+PacketReorderBuffer::PacketReorderBuffer(
+    const PacketReorderBufferOptions &options) :
+    pImpl(std::make_unique<PacketReorderBufferImpl> (options))
+{
+}
+
+/// Destructor
+PacketReorderBuffer::~PacketReorderBuffer() = default;
+
+/// Insert
+std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>>
+PacketReorderBuffer::insert(UDataPacketImportAPI::V1::Packet &&packet,
+                            const Clock::time_point now,
+                            const uint64_t journalSequence)
+{
+    std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> released;
+    if (!packet.has_stream_identifier())
+    {
+        throw std::invalid_argument("Stream identifier not set");
+    }
+    auto startTime
+        = google::protobuf::util::TimeUtil::TimestampToMicroseconds(
+             packet.start_time());
+    const StreamKeyView key{packet.stream_identifier()};
+    auto it = pImpl->mStreamIndex.find(key);
+    if (it == pImpl->mStreamIndex.end())
+    {
+        it = pImpl->mStreamIndex.emplace(StreamKey {key},
+                                         pImpl->mStreams.size()).first;
+        pImpl->mStreams.emplace_back();
+    }
+    const auto index = it->second;
+    auto &stream = pImpl->mStreams[index];
+    // Too late - a later packet already went out so we can't fix this one
+    if (stream.haveReleased && startTime <= stream.lastReleasedStartTime)
+    {
+        released.emplace_back(journalSequence, std::move(packet));
+        return released;
+    }
+    ::PendingPacket pendingPacket{std::move(packet),
+                                  now + pImpl->mWindow,
+                                  startTime,
+                                  journalSequence};
+    auto position
+        = std::upper_bound(stream.pending.begin(), stream.pending.end(),
+                           startTime,
+                           [](const int64_t time, const ::PendingPacket &rhs)
+                           {
+                               return time < rhs.startTime;
+                           });
+    stream.pending.insert(position, std::move(pendingPacket));
+    pImpl->mSize = pImpl->mSize + 1;
+    if (static_cast<int> (stream.pending.size()) >
+        pImpl->mMaximumNumberOfPacketsPerStream)
+    {
+        pImpl->releaseFront(stream, 1, released);
+    }
+    // Arrival times increase so only an idle stream needs a new deadline
+    if (!stream.scheduled){pImpl->schedule(index);}
+    return released;
+}
+
+/// Release expired packets
+std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>>
+PacketReorderBuffer::release(const Clock::time_point now)
+{
+    std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> released;
+    if (pImpl->mSize == 0){return released;}
+    pImpl->mExpired.clear();
+    pImpl->mWheel.advance(now, pImpl->mExpired);
+    for (const auto index : pImpl->mExpired)
+    {
+        auto &stream = pImpl->mStreams[index];
+        // Everything at or before the latest expired packet goes out
+        size_t nRelease{0};
+        for (size_t i = 0; i < stream.pending.size(); ++i)
+        {
+            if (stream.pending[i].deadline <= now){nRelease = i + 1;}
+        }
+        pImpl->releaseFront(stream, nRelease, released);
+        pImpl->schedule(index);
+    }
+    return released;
+}
+
+/// Release everything
+std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>>
+PacketReorderBuffer::releaseAll()
+{
+    std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> released;
+    released.reserve(static_cast<size_t> (pImpl->mSize));
+    for (auto &stream : pImpl->mStreams)
+    {
+        pImpl->releaseFront(stream, stream.pending.size(), released);
+        stream.scheduled = false;
+    }
+    pImpl->mWheel = pImpl->makeWheel();
+    return released;
+}
+
+/// Size
+int PacketReorderBuffer::size() const noexcept
+{
+    return pImpl->mSize;
+}
+
+/// Lowest journal sequence number
+std::optional<uint64_t> PacketReorderBuffer::getLowestJournalSequence() const
+{
+    std::optional<uint64_t> result{std::nullopt};
+    if (pImpl->mSize == 0){return result;}
+    for (const auto &stream : pImpl->mStreams)
+    {
+        for (const auto &pendingPacket : stream.pending)
+        {
+            if (pendingPacket.journalSequence > 0 &&
+                (!result || pendingPacket.journalSequence < *result))
+            {
+                result = pendingPacket.journalSequence;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,753 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+#ifndef NDEBUG
+#include <cassert>
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "uDataPacketImportProxy/packetSpool.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+constexpr std::string_view segmentPrefix{"spool-"};
+constexpr std::string_view segmentSuffix{".seg"};
+// The read position of a partially read segment is kept next to it
+constexpr std::string_view offsetSuffix{".offset"};
+// Each record is a 4 byte little-endian length followed by the serialized
+// packet.
+constexpr size_t recordHeaderSize{sizeof(uint32_t)};
+
+[[nodiscard]] std::filesystem::path
+    makeSegmentPath(const std::filesystem::path &directory,
+                    const uint64_t index)
+{
+    constexpr size_t nDigits{12};
+    auto number = std::to_string(index);
+    if (number.size() < nDigits)
+    {
+        number.insert(0, nDigits - number.size(), '0');
+    }
+    return directory / (std::string {segmentPrefix}
+                      + number
+                      + std::string {segmentSuffix});
+}
+
+[[nodiscard]] std::optional<uint64_t>
+    getSegmentIndex(const std::filesystem::path &path)
+{
+    const auto name = path.filename().string();
+    if (!name.starts_with(segmentPrefix) || !name.ends_with(segmentSuffix))
+    {
+        return std::nullopt;
+    }
+    const auto digits
+        = name.substr(segmentPrefix.size(),
+                      name.size() - segmentPrefix.size()
+                                  - segmentSuffix.size());
+    if (digits.empty() ||
+        !std::all_of(digits.begin(), digits.end(),
+                     [](const char c)
+                     {
+                         return std::isdigit(static_cast<unsigned char> (c));
+                     }))
+    {
+        return std::nullopt;
+    }
+    return std::stoull(digits);
+}
+
+[[nodiscard]] std::filesystem::path
+    makeOffsetPath(const std::filesystem::path &segmentPath)
+{
+    auto path = segmentPath;
+    path+= offsetSuffix;
+    return path;
+}
+
+void encodeLength(const uint32_t length, char *buffer)
+{
+    for (size_t i = 0; i < recordHeaderSize; ++i)
+    {
+        buffer[i] = static_cast<char> ((length >> (8*i)) & 0xFFU);
+    }
+}
+
+[[nodiscard]] uint32_t decodeLength(const char *buffer)
+{
+    uint32_t length{0};
+    for (size_t i = 0; i < recordHeaderSize; ++i)
+    {
+        length = length
+               | (static_cast<uint32_t> (static_cast<unsigned char> (buffer[i]))
+                  << (8*i));
+    }
+    return length;
+}
+
+void writeFully(const int fileDescriptor,
+                const std::string &buffer,
+                const int64_t offset)
+{
+    size_t nWritten{0};
+    while (nWritten < buffer.size())
+    {
+        auto nBytes = ::pwrite(fileDescriptor,
+                               buffer.data() + nWritten,
+                               buffer.size() - nWritten,
+                               static_cast<off_t> (offset + nWritten));
+        if (nBytes < 0)
+        {
+            if (errno == EINTR){continue;}
+            throw std::runtime_error("Failed to write to spool segment: "
+                                   + std::string {std::strerror(errno)});
+        }
+        nWritten = nWritten + static_cast<size_t> (nBytes);
+    }
+}
+
+[[nodiscard]] bool readFully(const int fileDescriptor,
+                            char *buffer,
+                            const size_t size,
+                            const int64_t offset)
+{
+    size_t nRead{0};
+    while (nRead < size)
+    {
+        auto nBytes = ::pread(fileDescriptor,
+                              buffer + nRead,
+                              size - nRead,
+                              static_cast<off_t> (offset + nRead));
+        if (nBytes < 0)
+        {
+            if (errno == EINTR){continue;}
+            throw std::runtime_error("Failed to read from spool segment: "
+                                   + std::string {std::strerror(errno)});
+        }
+        if (nBytes == 0){return false;}
+        nRead = nRead + static_cast<size_t> (nBytes);
+    }
+    return true;
+}
+
+/// @result The persisted read position of the segment or 0 if the segment
+///         has not been read.
+[[nodiscard]] int64_t readOffset(const std::filesystem::path &segmentPath)
+{
+    auto fileDescriptor = ::open(::makeOffsetPath(segmentPath).c_str(),
+                                 O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor < 0){return 0;}
+    std::array<char, sizeof(int64_t)> buffer{};
+    int64_t offset{0};
+    try
+    {
+        if (::readFully(fileDescriptor, buffer.data(), buffer.size(), 0))
+        {
+            std::memcpy(&offset, buffer.data(), buffer.size());
+        }
+    }
+    catch (...)
+    {
+        offset = 0;
+    }
+    ::close(fileDescriptor);
+    return std::max<int64_t> (0, offset);
+}
+
+/// Persists the read position of the segment being read.  A crash then
+/// replays at most the packet being read rather than the whole segment.
+class ReadCursor
+{
+public:
+    ReadCursor() = default;
+    ~ReadCursor()
+    {
+        close();
+    }
+    /// Starts tracking the given segment
+    void open(const std::filesystem::path &segmentPath)
+    {
+        if (mFileDescriptor >= 0 && segmentPath == mSegmentPath){return;}
+        close();
+        mSegmentPath = segmentPath;
+        mFileDescriptor = ::open(::makeOffsetPath(mSegmentPath).c_str(),
+                                 O_WRONLY | O_CREAT | O_CLOEXEC,
+                                 S_IRUSR | S_IWUSR | S_IRGRP);
+        if (mFileDescriptor < 0)
+        {
+            throw std::runtime_error("Failed to open spool offset for "
+                                   + mSegmentPath.string() + " because "
+                                   + std::string {std::strerror(errno)});
+        }
+    }
+    void update(const int64_t offset)
+    {
+        if (mFileDescriptor < 0){return;}
+        std::string buffer(sizeof(offset), '\0');
+        std::memcpy(buffer.data(), &offset, sizeof(offset));
+        ::writeFully(mFileDescriptor, buffer, 0);
+    }
+    /// Stops tracking the segment and removes its offset
+    void remove(const std::filesystem::path &segmentPath)
+    {
+        if (segmentPath == mSegmentPath){close();}
+        std::error_code errorCode;
+        std::filesystem::remove(::makeOffsetPath(segmentPath), errorCode);
+    }
+    void close()
+    {
+        if (mFileDescriptor >= 0)
+        {
+            ::close(mFileDescriptor);
+            mFileDescriptor =-1;
+        }
+        mSegmentPath.clear();
+    }
+    ReadCursor(const ReadCursor &) = delete;
+    ReadCursor& operator=(const ReadCursor &) = delete;
+private:
+    std::filesystem::path mSegmentPath;
+    int mFileDescriptor{-1};
+};
+
+/// A sealed segment that is read back through mmap.
+class MappedSegment
+{
+public:
+    explicit MappedSegment(const std::filesystem::path &path) :
+        mPath(path)
+    {
+        auto fileDescriptor = ::open(mPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fileDescriptor < 0)
+        {
+            throw std::runtime_error("Failed to open spool segment "
+                                   + mPath.string());
+        }
+        struct stat status{};
+        if (::fstat(fileDescriptor, &status) != 0)
+        {
+            ::close(fileDescriptor);
+            throw std::runtime_error("Failed to stat spool segment "
+                                   + mPath.string());
+        }
+        mSize = static_cast<size_t> (status.st_size);
+        if (mSize > 0)
+        {
+            auto address = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE,
+                                  fileDescriptor, 0);
+            if (address == MAP_FAILED)
+            {
+                ::close(fileDescriptor);
+                throw std::runtime_error("Failed to map spool segment "
+                                       + mPath.string());
+            }
+            ::madvise(address, mSize, MADV_SEQUENTIAL);
+            mData = static_cast<const char *> (address);
+        }
+        ::close(fileDescriptor);
+    }
+    /// @result The next record's payload or std::nullopt if the segment
+    ///         is exhausted or the tail is truncated.
+    [[nodiscard]] std::optional<std::string_view> next()
+    {
+        if (mOffset + recordHeaderSize > mSize){return std::nullopt;}
+        auto length = ::decodeLength(mData + mOffset);
+        if (mOffset + recordHeaderSize + length > mSize){return std::nullopt;}
+        std::string_view payload{mData + mOffset + recordHeaderSize, length};
+        mOffset = mOffset + recordHeaderSize + length;
+        return payload;
+    }
+    ~MappedSegment()
+    {
+        if (mData != nullptr)
+        {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            ::munmap(const_cast<char *> (mData), mSize);
+        }
+    }
+    MappedSegment(const MappedSegment &) = delete;
+    MappedSegment(MappedSegment &&) noexcept = delete;
+    MappedSegment& operator=(const MappedSegment &) = delete;
+    MappedSegment& operator=(MappedSegment &&) noexcept = delete;
+
+    std::filesystem::path mPath;
+    const char *mData{nullptr};
+    size_t mSize{0};
+    size_t mOffset{0};
+};
+
+struct SealedSegment
+{
+    std::filesystem::path path;
+    int64_t size{0};
+    int64_t readOffset{0};
+};
+
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketSpoolOptions::PacketSpoolOptionsImpl
+{
+public:
+    std::filesystem::path mDirectory;
+    int64_t mSegmentSize{16*1024*1024};
+    int64_t mMaximumSize{1024*1024*1024};
+    bool mHaveDirectory{false};
+};
+
+/// Constructor
+PacketSpoolOptions::PacketSpoolOptions() :
+    pImpl(std::make_unique<PacketSpoolOptionsImpl> ())
+{
+}
+
+/// Copy constructor
+PacketSpoolOptions::PacketSpoolOptions(const PacketSpoolOptions &options)
+{
+    *this = options;
+}
+
+/// Move constructor
+PacketSpoolOptions::PacketSpoolOptions(PacketSpoolOptions &&options) noexcept
+{
+    *this = std::move(options);
+}
+
+/// Copy assignment
+PacketSpoolOptions&
+PacketSpoolOptions::operator=(const PacketSpoolOptions &options)
+{
+    if (&options == this){return *this;}
+    pImpl = std::make_unique<PacketSpoolOptionsImpl> (*options.pImpl);
+    return *this;
+}
+
+/// Move assignment
+PacketSpoolOptions&
+PacketSpoolOptions::operator=(PacketSpoolOptions &&options) noexcept
+{
+    if (&options == this){return *this;}
+    pImpl = std::move(options.pImpl);
+    return *this;
+}
+
+/// Destructor
+PacketSpoolOptions::~PacketSpoolOptions() = default;
+
+/// Directory
+void PacketSpoolOptions::setDirectory(const std::filesystem::path &directory)
+{
+    if (directory.empty())
+    {
+        throw std::invalid_argument("Spool directory is empty");
+    }
+    pImpl->mDirectory = directory;
+    pImpl->mHaveDirectory = true;
+}
+
+std::filesystem::path PacketSpoolOptions::getDirectory() const
+{
+    if (!haveDirectory())
+    {
+        throw std::runtime_error("Spool directory not set");
+    }
+    return pImpl->mDirectory;
+}
+
+bool PacketSpoolOptions::haveDirectory() const noexcept
+{
+    return pImpl->mHaveDirectory;
+}
+
+/// Segment size
+void PacketSpoolOptions::setSegmentSizeInBytes(const int64_t segmentSize)
+{
+    if (segmentSize <= 0)
+    {
+        throw std::invalid_argument("Segment size must be positive");
+    }
+    pImpl->mSegmentSize = segmentSize;
+}
+
+int64_t PacketSpoolOptions::getSegmentSizeInBytes() const noexcept
+{
+    return pImpl->mSegmentSize;
+}
+
+/// Maximum size
+void PacketSpoolOptions::setMaximumSizeInBytes(const int64_t maximumSize)
+{
+    if (maximumSize <= 0)
+    {
+        throw std::invalid_argument("Maximum spool size must be positive");
+    }
+    pImpl->mMaximumSize = maximumSize;
+}
+
+int64_t PacketSpoolOptions::getMaximumSizeInBytes() const noexcept
+{
+    return pImpl->mMaximumSize;
+}
+
+///--------------------------------------------------------------------------///
+
+class PacketSpool::PacketSpoolImpl
+{
+public:
+    explicit PacketSpoolImpl(const PacketSpoolOptions &options)
+    {
+        if (!options.haveDirectory())
+        {
+            throw std::invalid_argument("Spool directory not set");
+        }
+        mDirectory = options.getDirectory();
+        mSegmentSize = options.getSegmentSizeInBytes();
+        mMaximumSize = options.getMaximumSizeInBytes();
+        std::error_code errorCode;
+        std::filesystem::create_directories(mDirectory, errorCode);
+        if (errorCode)
+        {
+            throw std::runtime_error("Failed to create spool directory "
+                                   + mDirectory.string() + " because "
+                                   + errorCode.message());
+        }
+        recover();
+    }
+
+    ~PacketSpoolImpl()
+    {
+        closeWriteSegment();
+    }
+
+    /// Picks up the segments left behind by a previous run
+    void recover()
+    {
+        std::vector<std::pair<uint64_t, std::filesystem::path>> segments;
+        std::vector<std::filesystem::path> offsets;
+        for (const auto &entry :
+             std::filesystem::directory_iterator(mDirectory))
+        {
+            if (!entry.is_regular_file()){continue;}
+            auto index = ::getSegmentIndex(entry.path());
+            if (index){segments.emplace_back(*index, entry.path());}
+            if (entry.path().extension() == offsetSuffix)
+            {
+                offsets.push_back(entry.path());
+            }
+        }
+        // Offsets outlive their segment if we crash while retiring it
+        for (const auto &offset : offsets)
+        {
+            auto segmentPath = offset;
+            segmentPath.replace_extension();
+            if (!std::filesystem::exists(segmentPath))
+            {
+                std::error_code errorCode;
+                std::filesystem::remove(offset, errorCode);
+            }
+        }
+        std::sort(segments.begin(), segments.end());
+        for (const auto &[index, path] : segments)
+        {
+            mNextSegmentIndex = std::max(mNextSegmentIndex, index + 1);
+            auto size = static_cast<int64_t> (std::filesystem::file_size(path));
+            const auto offset = std::min(::readOffset(path), size);
+            if (size == 0 || offset == size)
+            {
+                std::error_code errorCode;
+                std::filesystem::remove(path, errorCode);
+                mCursor.remove(path);
+                continue;
+            }
+            // Count the complete records that have yet to be read
+            ::MappedSegment segment{path};
+            segment.mOffset = static_cast<size_t> (offset);
+            int64_t nPackets{0};
+            while (segment.next()){nPackets = nPackets + 1;}
+            mSealedSegments.push_back(::SealedSegment {path, size, offset});
+            mSizeInBytes.fetch_add(size);
+            mNumberOfPackets.fetch_add(nPackets);
+        }
+    }
+
+    [[nodiscard]] bool push(const UDataPacketImportAPI::V1::Packet &packet)
+    {
+        const auto payloadSize = packet.ByteSizeLong();
+        if (payloadSize > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::invalid_argument("Packet too large to spool");
+        }
+        std::string record;
+        record.resize(recordHeaderSize + payloadSize);
+        ::encodeLength(static_cast<uint32_t> (payloadSize), record.data());
+        if (!packet.SerializeToArray(record.data() + recordHeaderSize,
+                                     static_cast<int> (payloadSize)))
+        {
+            throw std::runtime_error("Failed to serialize packet for spool");
+        }
+        const auto recordSize = static_cast<int64_t> (record.size());
+        const std::lock_guard<std::mutex> lock(mMutex);
+        if (mSizeInBytes.load() + recordSize > mMaximumSize){return false;}
+        if (mWriteDescriptor < 0 ||
+            (mWriteOffset > 0 && mWriteOffset + recordSize > mSegmentSize))
+        {
+            sealWriteSegment();
+            openWriteSegment();
+        }
+        ::writeFully(mWriteDescriptor, record, mWriteOffset);
+        mWriteOffset = mWriteOffset + recordSize;
+        mSizeInBytes.fetch_add(recordSize);
+        mNumberOfPackets.fetch_add(1);
+        return true;
+    }
+
+    [[nodiscard]] std::optional<UDataPacketImportAPI::V1::Packet> pop()
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        while (true)
+        {
+            if (mReadSegment == nullptr && !mSealedSegments.empty())
+            {
+                const auto &sealedSegment = mSealedSegments.front();
+                mReadSegment
+                    = std::make_unique<::MappedSegment> (sealedSegment.path);
+                mReadSegment->mOffset
+                    = static_cast<size_t> (sealedSegment.readOffset);
+                mReadSegmentSize = sealedSegment.size;
+                mCursor.open(sealedSegment.path);
+                mSealedSegments.pop_front();
+            }
+            std::optional<std::string_view> payload{std::nullopt};
+            if (mReadSegment != nullptr)
+            {
+                payload = mReadSegment->next();
+                if (!payload)
+                {
+                    retireReadSegment();
+                    continue;
+                }
+                mCursor.update(static_cast<int64_t> (mReadSegment->mOffset));
+            }
+            else
+            {
+                // Caught up to the writer so read its segment in place
+                payload = readWriteSegment();
+                if (!payload){return std::nullopt;}
+            }
+            mNumberOfPackets.fetch_sub(1);
+            UDataPacketImportAPI::V1::Packet packet;
+            if (packet.ParseFromArray(payload->data(),
+                                      static_cast<int> (payload->size())))
+            {
+                // Once the writer's segment is drained start it over
+                if (mReadSegment == nullptr && mWriteReadOffset == mWriteOffset)
+                {
+                    truncateWriteSegment();
+                }
+                return std::make_optional<UDataPacketImportAPI::V1::Packet>
+                       (std::move(packet));
+            }
+            // Corrupt record - skip it
+        }
+    }
+
+    /// @result The next record in the segment being written or
+    ///         std::nullopt if the reader has caught up to the writer.
+    [[nodiscard]] std::optional<std::string_view> readWriteSegment()
+    {
+        if (mWriteDescriptor < 0 ||
+            mWriteReadOffset + static_cast<int64_t> (recordHeaderSize)
+            > mWriteOffset)
+        {
+            return std::nullopt;
+        }
+        std::array<char, recordHeaderSize> header{};
+        if (!::readFully(mWriteDescriptor, header.data(), header.size(),
+                         mWriteReadOffset))
+        {
+            return std::nullopt;
+        }
+        const auto length = ::decodeLength(header.data());
+        const auto payloadOffset
+            = mWriteReadOffset + static_cast<int64_t> (recordHeaderSize);
+        if (payloadOffset + static_cast<int64_t> (length) > mWriteOffset)
+        {
+            return std::nullopt;
+        }
+        mReadBuffer.resize(length);
+        if (!::readFully(mWriteDescriptor, mReadBuffer.data(), length,
+                         payloadOffset))
+        {
+            return std::nullopt;
+        }
+        mWriteReadOffset = payloadOffset + static_cast<int64_t> (length);
+        mCursor.open(mWritePath);
+        mCursor.update(mWriteReadOffset);
+        return std::string_view {mReadBuffer.data(), mReadBuffer.size()};
+    }
+
+    /// Empties the fully read segment being written so it can be reused
+    void truncateWriteSegment()
+    {
+        if (mWriteDescriptor < 0){return;}
+        if (::ftruncate(mWriteDescriptor, 0) != 0)
+        {
+            // Leave it be - it will be retired once it is sealed
+            return;
+        }
+        mSizeInBytes.fetch_sub(mWriteOffset);
+        mWriteOffset = 0;
+        mWriteReadOffset = 0;
+        mCursor.update(0);
+    }
+
+    void openWriteSegment()
+    {
+#ifndef NDEBUG
+        assert(mWriteDescriptor < 0);
+#endif
+        mWritePath = ::makeSegmentPath(mDirectory, mNextSegmentIndex);
+        mNextSegmentIndex = mNextSegmentIndex + 1;
+        mWriteDescriptor
+            = ::open(mWritePath.c_str(),
+                     O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     S_IRUSR | S_IWUSR | S_IRGRP);
+        if (mWriteDescriptor < 0)
+        {
+            throw std::runtime_error("Failed to open spool segment "
+                                   + mWritePath.string() + " because "
+                                   + std::string {std::strerror(errno)});
+        }
+        mWriteOffset = 0;
+    }
+
+    void closeWriteSegment()
+    {
+        if (mWriteDescriptor >= 0)
+        {
+            ::close(mWriteDescriptor);
+            mWriteDescriptor =-1;
+            if (mWriteOffset == 0)
+            {
+                std::error_code errorCode;
+                std::filesystem::remove(mWritePath, errorCode);
+                mCursor.remove(mWritePath);
+            }
+        }
+    }
+
+    void sealWriteSegment()
+    {
+        if (mWriteDescriptor < 0){return;}
+        auto size = mWriteOffset;
+        auto readOffset = mWriteReadOffset;
+        closeWriteSegment();
+        if (size > 0 && readOffset >= size)
+        {
+            // Already read in place
+            std::error_code errorCode;
+            std::filesystem::remove(mWritePath, errorCode);
+            mCursor.remove(mWritePath);
+            mSizeInBytes.fetch_sub(size);
+        }
+        else if (size > 0)
+        {
+            mSealedSegments.push_back(
+                ::SealedSegment {mWritePath, size, readOffset});
+        }
+        mWriteOffset = 0;
+        mWriteReadOffset = 0;
+    }
+
+    void retireReadSegment()
+    {
+        if (mReadSegment == nullptr){return;}
+        auto path = mReadSegment->mPath;
+        mReadSegment = nullptr;
+        mSizeInBytes.fetch_sub(mReadSegmentSize);
+        mReadSegmentSize = 0;
+        std::error_code errorCode;
+        std::filesystem::remove(path, errorCode);
+        mCursor.remove(path);
+    }
+
+    mutable std::mutex mMutex;
+    std::filesystem::path mDirectory;
+    std::filesystem::path mWritePath;
+    std::deque<::SealedSegment> mSealedSegments;
+    std::unique_ptr<::MappedSegment> mReadSegment{nullptr};
+    ::ReadCursor mCursor;
+    std::string mReadBuffer;
+    std::atomic<int64_t> mSizeInBytes{0};
+    std::atomic<int64_t> mNumberOfPackets{0};
+    int64_t mSegmentSize{16*1024*1024};
+    int64_t mMaximumSize{1024*1024*1024};
+    int64_t mWriteOffset{0};
+    // How far the reader got in the segment being written
+    int64_t mWriteReadOffset{0};
+    int64_t mReadSegmentSize{0};
+    uint64_t mNextSegmentIndex{0};
+    int mWriteDescriptor{-1};
+};
+
+/// Constructor
+PacketSpool::PacketSpool(const PacketSpoolOptions &options) :
+    pImpl(std::make_unique<PacketSpoolImpl> (options))
+{
+}
+
+/// Destructor
+PacketSpool::~PacketSpool() = default;
+
+/// Push
+bool PacketSpool::push(const UDataPacketImportAPI::V1::Packet &packet)
+{
+    return pImpl->push(packet);
+}
+
+/// Pop
+std::optional<UDataPacketImportAPI::V1::Packet> PacketSpool::pop()
+{
+    return pImpl->pop();
+}
+
+/// Empty?
+bool PacketSpool::empty() const noexcept
+{
+    return pImpl->mNumberOfPackets.load() <= 0;
+}
+
+/// Number of packets
+int64_t PacketSpool::getNumberOfPackets() const noexcept
+{
+    return std::max<int64_t> (0, pImpl->mNumberOfPackets.load());
+}
+
+/// Size on disk
+int64_t PacketSpool::getSizeInBytes() const noexcept
+{
+    return std::max<int64_t> (0, pImpl->mSizeInBytes.load());
+}
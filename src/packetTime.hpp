@@ -0,0 +1,55 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_PACKET_TIME_HPP
+#define UDATA_PACKET_IMPORT_PROXY_PACKET_TIME_HPP
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <google/protobuf/util/time_util.h>
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+namespace UDataPacketImportProxy
+{
+
+/// @result The time of the first sample in the packet in microseconds
+///         since the epoch.
+[[nodiscard]] inline std::chrono::microseconds
+    getStartTimeInMicroSeconds(const UDataPacketImportAPI::V1::Packet &packet)
+{
+    return std::chrono::microseconds
+    {
+        google::protobuf::util::TimeUtil::TimestampToMicroseconds(
+            packet.start_time())
+    };
+}
+
+/// @result The time of the last sample in the packet in microseconds
+///         since the epoch.
+/// @throws std::invalid_argument if the sampling rate is not positive.
+[[nodiscard]] inline std::chrono::microseconds
+    getEndTimeInMicroSeconds(const UDataPacketImportAPI::V1::Packet &packet)
+{
+    auto startTimeMuSec = getStartTimeInMicroSeconds(packet).count();
+    auto nSamples = packet.number_of_samples();
+    const double samplingRate = packet.sampling_rate();
+    if (samplingRate <= 0)
+    {
+        throw std::invalid_argument("Sampling rate not positive");
+    }
+    auto dtMuSec = static_cast<int64_t> (std::round(1000000/samplingRate));
+    auto endTimeMuSec = startTimeMuSec + dtMuSec*(nSamples - 1);
+    return std::chrono::microseconds {endTimeMuSec};
+}
+
+/// @result The age of the packet's last sample at the given time.  This is
+///         the data latency in the sense of how stale the newest sample is.
+/// @throws std::invalid_argument if the sampling rate is not positive.
+[[nodiscard]] inline std::chrono::microseconds
+    getDataLatency(const UDataPacketImportAPI::V1::Packet &packet,
+                   const std::chrono::system_clock::time_point &now)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>
+           (now.time_since_epoch())
+         - getEndTimeInMicroSeconds(packet);
+}
+
+}
+#endif
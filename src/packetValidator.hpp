@@ -0,0 +1,176 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_PACKET_VALIDATOR_HPP
+#define UDATA_PACKET_IMPORT_PROXY_PACKET_VALIDATOR_HPP
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "uDataPacketImportAPI/v1/data_type.pb.h"
+namespace UDataPacketImportProxy
+{
+
+/// @brief The reasons a packet can be rejected by the frontend.
+enum class PacketValidationResult : int
+{
+    Valid = 0,               /*!< The packet is valid. */
+    NoSamples,               /*!< The packet has no samples. */
+    UnknownDataType,         /*!< The data type is unknown. */
+    InvalidSamplingRate,     /*!< The sampling rate is not positive. */
+    InconsistentDataLength,  /*!< The data size does not match the number
+                                  of samples and data type. */
+    NonFiniteValue,          /*!< A float or double sample is NaN or Inf. */
+    InvalidStreamIdentifier  /*!< The network, station, or channel is
+                                  blank. */
+};
+
+/// @brief The number of packet validation results.
+constexpr int NumberOfPacketValidationResults{7};
+
+/// @result A short name for the validation result suitable for logging and
+///         metric attributes.
+[[nodiscard]] constexpr const char *toString(
+    const PacketValidationResult result) noexcept
+{
+    constexpr std::array<const char *, NumberOfPacketValidationResults> names
+    {
+        "valid",
+        "no_samples",
+        "unknown_data_type",
+        "invalid_sampling_rate",
+        "inconsistent_data_length",
+        "non_finite_value",
+        "invalid_stream_identifier"
+    };
+    return names[static_cast<size_t> (result)];
+}
+
+/// @result The size in bytes of a sample of the given data type or 0 if
+///         the data type is unknown.
+[[nodiscard]] constexpr size_t getDataTypeSize(
+    const UDataPacketImportAPI::V1::DataType dataType) noexcept
+{
+    constexpr std::array<size_t, 6> sizes
+    {
+        0,               // DATA_TYPE_UNKNOWN
+        sizeof(int32_t), // DATA_TYPE_INTEGER_32
+        sizeof(float),   // DATA_TYPE_FLOAT
+        sizeof(double),  // DATA_TYPE_DOUBLE
+        sizeof(char),    // DATA_TYPE_TEXT
+        sizeof(int64_t)  // DATA_TYPE_INTEGER_64
+    };
+    const auto index = static_cast<size_t> (dataType);
+    return index < sizes.size() ? sizes[index] : 0;
+}
+static_assert(getDataTypeSize(UDataPacketImportAPI::V1::DATA_TYPE_UNKNOWN) == 0);
+static_assert(getDataTypeSize(UDataPacketImportAPI::V1::DATA_TYPE_DOUBLE) == 8);
+static_assert(getDataTypeSize(UDataPacketImportAPI::V1::DATA_TYPE_INTEGER_64) == 8);
+
+/// @brief Scans little-endian IEEE-754 values for NaNs and infinities.
+///        Both have every exponent bit set.  Adding one to the lowest
+///        exponent bit of a masked exponent carries into the sign bit only
+///        when every exponent bit is set.  This keeps the loop to ands, adds,
+///        and ors so the compiler can vectorize it.
+/// @param[in] data     The packed little-endian values.
+/// @param[in] nValues  The number of values in data.
+/// @result True indicates at least one value is NaN or Inf.
+template<typename U, U exponentMask, U exponentLowBit>
+[[nodiscard]] bool haveNonFiniteValues(const char *data,
+                                       const size_t nValues) noexcept
+{
+    constexpr U signBit{static_cast<U> (1) << (8*sizeof(U) - 1)};
+    static_assert(static_cast<U> (exponentMask + exponentLowBit) == signBit);
+    // Work on fixed-size blocks so the compiler doesn't need a runtime
+    // trip count to vectorize
+    constexpr size_t blockSize{64/sizeof(U)};
+    auto load = [](const char *values, const size_t i)
+    {
+        U value;
+        std::memcpy(&value, values + i*sizeof(U), sizeof(U));
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            if constexpr (sizeof(U) == 4)
+            {
+                value = __builtin_bswap32(value);
+            }
+            else
+            {
+                value = __builtin_bswap64(value);
+            }
+        }
+        return (value & exponentMask) + exponentLowBit;
+    };
+    std::array<U, blockSize> nonFinite{};
+    const size_t nBlocks{nValues/blockSize};
+    for (size_t block = 0; block < nBlocks; ++block)
+    {
+        const auto *values = data + block*blockSize*sizeof(U);
+        for (size_t i = 0; i < blockSize; ++i)
+        {
+            nonFinite[i] = nonFinite[i] | load(values, i);
+        }
+    }
+    U result{0};
+    for (size_t i = nBlocks*blockSize; i < nValues; ++i)
+    {
+        result = result | load(data, i);
+    }
+    for (const auto &value : nonFinite){result = result | value;}
+    return (result & signBit) != 0;
+}
+
+/// @result True indicates a packed float contains a NaN or Inf.
+[[nodiscard]] inline bool haveNonFiniteFloats(const char *data,
+                                              const size_t nValues) noexcept
+{
+    return haveNonFiniteValues<uint32_t, 0x7F800000U, 0x00800000U>
+           (data, nValues);
+}
+
+/// @result True indicates a packed double contains a NaN or Inf.
+[[nodiscard]] inline bool haveNonFiniteDoubles(const char *data,
+                                               const size_t nValues) noexcept
+{
+    return haveNonFiniteValues<uint64_t,
+                               0x7FF0000000000000ULL,
+                               0x0010000000000000ULL> (data, nValues);
+}
+
+/// @brief Validates a packet's header and payload.
+/// @note This does not check the stream identifier since the frontend
+///       normalizes it first.
+[[nodiscard]] inline PacketValidationResult validatePacket(
+    const UDataPacketImportAPI::V1::Packet &packet) noexcept
+{
+    const auto nSamples = static_cast<size_t> (packet.number_of_samples());
+    if (nSamples <= 0){return PacketValidationResult::NoSamples;}
+    const auto dataType = packet.data_type();
+    const auto dataTypeSize = getDataTypeSize(dataType);
+    if (dataTypeSize == 0){return PacketValidationResult::UnknownDataType;}
+    if (!(packet.sampling_rate() > 0))
+    {
+        return PacketValidationResult::InvalidSamplingRate;
+    }
+    const auto &data = packet.data();
+    if (data.size() != nSamples*dataTypeSize)
+    {
+        return PacketValidationResult::InconsistentDataLength;
+    }
+    if (dataType == UDataPacketImportAPI::V1::DATA_TYPE_FLOAT)
+    {
+        if (haveNonFiniteFloats(data.data(), nSamples))
+        {
+            return PacketValidationResult::NonFiniteValue;
+        }
+    }
+    else if (dataType == UDataPacketImportAPI::V1::DATA_TYPE_DOUBLE)
+    {
+        if (haveNonFiniteDoubles(data.data(), nSamples))
+        {
+            return PacketValidationResult::NonFiniteValue;
+        }
+    }
+    return PacketValidationResult::Valid;
+}
+
+}
+#endif
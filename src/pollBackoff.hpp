@@ -0,0 +1,57 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_POLL_BACKOFF_HPP
+#define UDATA_PACKET_IMPORT_PROXY_POLL_BACKOFF_HPP
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+namespace UDataPacketImportProxy
+{
+/// @brief The interval at which an idle subscriber's writer polls its
+///        queue.  The interval doubles each time the queue is found empty,
+///        up to a maximum which bounds both how long a canceled subscriber
+///        goes unnoticed and how long shutdown waits, and snaps back to the
+///        initial interval once data flows again.
+/// @note This is not thread safe.
+class PollBackoff
+{
+public:
+    /// @param[in] initial  The interval after data was seen.
+    /// @param[in] maximum  The largest interval.
+    /// @throws std::invalid_argument if the initial interval is not positive
+    ///         or exceeds the maximum.
+    explicit PollBackoff(const std::chrono::milliseconds initial
+                             = std::chrono::milliseconds {10},
+                         const std::chrono::milliseconds maximum
+                             = std::chrono::milliseconds {250}) :
+        mInitial(initial),
+        mCurrent(initial),
+        mMaximum(maximum)
+    {
+        if (initial.count() <= 0)
+        {
+            throw std::invalid_argument("Initial interval must be positive");
+        }
+        if (maximum < initial)
+        {
+            throw std::invalid_argument(
+                "Maximum interval cannot be less than the initial interval");
+        }
+    }
+    /// @brief Call this when the queue had data.
+    void reset() noexcept
+    {
+        mCurrent = mInitial;
+    }
+    /// @result How long to wait before polling the empty queue again.
+    [[nodiscard]] std::chrono::milliseconds next() noexcept
+    {
+        const auto interval = std::min(mCurrent, mMaximum);
+        mCurrent = std::min(interval*2, mMaximum);
+        return interval;
+    }
+private:
+    std::chrono::milliseconds mInitial{10};
+    std::chrono::milliseconds mCurrent{10};
+    std::chrono::milliseconds mMaximum{250};
+};
+}
+#endif
@@ -1,16 +1,17 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <utility>
 #ifndef NDEBUG
 #include <cassert>
 #endif
-#include <tbb/concurrent_queue.h>
 #include <spdlog/spdlog.h>
 #include <spdlog/logger.h>
 #include <spdlog/sinks/stdout_color_sinks.h> //NOLINT
@@ -21,8 +22,16 @@
 #include "uDataPacketImportProxy/frontend.hpp"
 #include "uDataPacketImportProxy/frontendOptions.hpp"
 #include "uDataPacketImportProxy/duplicatePacketDetector.hpp"
+#include "uDataPacketImportProxy/packetSpool.hpp"
+#include "uDataPacketImportProxy/packetJournal.hpp"
+#include "uDataPacketImportProxy/packetReorderBuffer.hpp"
+#include "uDataPacketImportProxy/packetCoalescer.hpp"
+#include "uDataPacketImportProxy/packetCapture.hpp"
 #include "uDataPacketImportAPI/v1/packet.pb.h"
-import metrics;
+#include "deliveryTracker.hpp"
+#include "packetPipeline.hpp"
+#include "rateLimitedLog.hpp"
+#include "tracing.hpp"
 
 using namespace UDataPacketImportProxy;
 
@@ -55,9 +64,64 @@ public:
             mDuplicateDetector
                 = std::make_unique<DuplicatePacketDetector>
                   (*duplicateDetectorOptions);
-            mRemoveDuplicates = true;
         }
-        mImportExportQueueCapacity = mOptions.getQueueCapacity();
+        if (mOptions.getPacketSpoolOptions())
+        {
+            auto spoolOptions = mOptions.getPacketSpoolOptions();
+            mSpool = std::make_unique<PacketSpool> (*spoolOptions);
+            if (!mSpool->empty())
+            {
+                SPDLOG_LOGGER_INFO(mLogger,
+                                   "Recovered {} packets from overflow spool",
+                                   mSpool->getNumberOfPackets());
+            }
+        }
+        if (mOptions.getPacketJournalOptions())
+        {
+            auto journalOptions = mOptions.getPacketJournalOptions();
+            mJournal = std::make_unique<PacketJournal> (*journalOptions);
+            mDeliveryTracker = std::make_unique<DeliveryTracker>
+                (mJournal->getNumberOfSlots(),
+                 mJournal->getCommittedSequence());
+            mMaximumReplayWait = journalOptions->getMaximumReplayWait();
+        }
+        if (mOptions.getPacketReorderBufferOptions())
+        {
+            auto reorderOptions = mOptions.getPacketReorderBufferOptions();
+            mReorderBuffer
+                = std::make_unique<PacketReorderBuffer> (*reorderOptions);
+        }
+        if (mOptions.getPacketCoalescerOptions())
+        {
+            auto coalescerOptions = mOptions.getPacketCoalescerOptions();
+            mCoalescer = std::make_unique<PacketCoalescer> (*coalescerOptions);
+        }
+        if (mOptions.getPacketCaptureOptions())
+        {
+            auto captureOptions = mOptions.getPacketCaptureOptions();
+            mCapture = std::make_unique<PacketCapture> (*captureOptions);
+            SPDLOG_LOGGER_INFO(mLogger, "Capturing traffic to {}",
+                               captureOptions->getDirectory().string());
+        }
+        mPipeline = std::make_unique<PacketPipeline>
+        (
+            mOptions.getQueueCapacity(),
+            PacketPipeline::Stages {mDuplicateDetector.get(),
+                                    mSpool.get(),
+                                    mJournal.get(),
+                                    mDeliveryTracker.get(),
+                                    mReorderBuffer.get(),
+                                    mCoalescer.get()},
+            [this](UDataPacketImportAPI::V1::Packet &&packet,
+                   const std::chrono::steady_clock::time_point &ingestTime,
+                   const DeliveryReceipt *deliveryReceipt)
+            {
+                return mBackend->enqueuePacket(std::move(packet),
+                                               ingestTime,
+                                               deliveryReceipt);
+            },
+            mLogger
+        );
         mFrontend
             = std::make_unique<Frontend> (mOptions.getFrontendOptions(),
                                           mAddPacketCallback,
@@ -65,7 +129,6 @@ public:
         mBackend
             = std::make_unique<Backend>
               (mOptions.getBackendOptions(), mLogger);
-        mImportExportQueue.set_capacity(mImportExportQueueCapacity);
     }   
 
     ~ProxyImpl()
@@ -75,34 +138,32 @@ public:
 
     void addPacketCallback(UDataPacketImportAPI::V1::Packet &&packet)
     {
+        // N.B. The frontend makes a sampled packet's trace current
+        const auto &trace = Tracing::current();
+        const Tracing::Span enqueueSpan{trace, "enqueue"};
         try
         {
-            // Try to ensure there is enough space
-            auto approximateSize
-                = static_cast<int> (mImportExportQueue.size());
-            while (approximateSize >= mImportExportQueueCapacity)
+            if (mCapture)
             {
-                UDataPacketImportAPI::V1::Packet workSpace;
-                if (!mImportExportQueue.try_pop(workSpace))
+                try
                 {
-                    SPDLOG_LOGGER_WARN(
-                        mLogger,
-                        "Failed to pop element from import queue");
-                    break;
+                    mCapture->append(
+                        packet,
+                        std::chrono::duration_cast<std::chrono::microseconds>
+                        (std::chrono::system_clock::now().time_since_epoch()));
+                }
+                catch (const std::exception &e)
+                {
+                    RATE_LIMITED_LOGGER_WARN(mLogger,
+                                       "Failed to capture packet because {}",
+                                       std::string {e.what()});
                 }
-                approximateSize = static_cast<int> (mImportExportQueue.size());
-            }
-            // Try to add the packet
-            if (!mImportExportQueue.try_push(std::move(packet)))
-            {
-                SPDLOG_LOGGER_ERROR(
-                    mLogger,
-                    "Failed to add packet to import queue");
             }
+            mPipeline->admit(std::move(packet), trace);
         }
         catch (const std::exception &e) 
         {
-            SPDLOG_LOGGER_ERROR(
+            RATE_LIMITED_LOGGER_ERROR(
                 mLogger,
                 "Failed to add packet to import queue because {}",
                 std::string {e.what()});
@@ -111,60 +172,13 @@ public:
 
     void propagatePacketToBackend()
     {
-#ifndef NDEBUG
-        assert(mBackend);
-        if (mRemoveDuplicates){assert(mDuplicateDetector);}
-#endif
         constexpr std::chrono::milliseconds timeOut{15};
         while (mKeepRunning.load())
         {
-            UDataPacketImportAPI::V1::Packet packet;
-            if (mImportExportQueue.try_pop(packet))
-            {
-                // Check duplicates
-                if (mRemoveDuplicates)
-                {
-                    bool allow{false};
-                    try
-                    {
-                        allow = mDuplicateDetector->allow(packet);
-                    }
-                    catch (const std::exception &e)
-                    {
-                         SPDLOG_LOGGER_WARN(mLogger,
-                                            "Failed to check packet because {}",
-                                            std::string {e.what()});
-                    }
-                    if (!allow)
-                    {
-                        continue;
-                    }
-                }
-                // Okay, send them to the backend
-                try
-                {
-                    auto nPacketsLost
-                        = mBackend->enqueuePacket(std::move(packet));
-                    if (nPacketsLost > 0)
-                    {
-                        SPDLOG_LOGGER_WARN(mLogger,
-                           "Over-wrote {} packets in the outbound queue - consider increasing backend queueSize",
-                           nPacketsLost);
-                    }
-                }
-                catch (const std::exception &e) 
-                {
-                   SPDLOG_LOGGER_ERROR(
-                      mLogger,
-                "Failed to propagate packet to subscription manager because {}",
-                      std::string {e.what()});
-                }
-            }
-            else
-            {
-                std::this_thread::sleep_for(timeOut);
-            }
+            if (!mPipeline->step()){std::this_thread::sleep_for(timeOut);}
         }
+        // Don't strand anything in the reorder buffer or coalescer
+        mPipeline->flush();
         SPDLOG_LOGGER_DEBUG(mLogger, "Thread exiting propagate packet thread");
     }
 
@@ -178,17 +192,73 @@ public:
         std::this_thread::sleep_for (std::chrono::milliseconds {10});
 
         mKeepRunning = true;
-        // Get our propagator thread going before anything else
-        mProxyThread = std::thread(&ProxyImpl::propagatePacketToBackend, this);
-        // Technically starting the backend first will let the eager beavers
-        // not miss a packet
-        // N.B. start constructs the callback server so this can throw
-        mBackend->start();
+        if (mJournal)
+        {
+            // The backend must be up to replay anything that did not make
+            // it out last time
+            mBackend->start();
+            replayJournal();
+            mProxyThread
+                = std::thread(&ProxyImpl::propagatePacketToBackend, this);
+        }
+        else
+        {
+            // Get our propagator thread going before anything else
+            mProxyThread
+                = std::thread(&ProxyImpl::propagatePacketToBackend, this);
+            // Technically starting the backend first will let the eager
+            // beavers not miss a packet
+            // N.B. start constructs the callback server so this can throw
+            mBackend->start();
+        }
         // N.B. start constructs the callback server so this can throw
         mFrontend->start();
         mWasStarted = true;
     }
 
+    /// Forwards the packets journaled but not propagated prior to the
+    /// last shutdown
+    void replayJournal()
+    {
+        // N.B. Sequence numbers lost to torn records are also done
+        for (auto sequence = mJournal->getCommittedSequence() + 1;
+             sequence < mJournal->getNextSequence();
+             ++sequence)
+        {
+            mDeliveryTracker->markDequeued(sequence);
+        }
+        auto uncommittedPackets = mJournal->takeUncommittedPackets();
+        if (uncommittedPackets.empty())
+        {
+            mPipeline->commitJournal();
+            return;
+        }
+        SPDLOG_LOGGER_INFO(mLogger,
+                           "Replaying {} uncommitted packets from journal",
+                           uncommittedPackets.size());
+        // Give the subscribers a moment to reconnect
+        const auto deadline
+            = std::chrono::steady_clock::now() + mMaximumReplayWait;
+        while (mBackend->getNumberOfSubscribers() < 1 &&
+               std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds {50});
+        }
+        if (mBackend->getNumberOfSubscribers() < 1)
+        {
+            SPDLOG_LOGGER_WARN(mLogger,
+                               "No subscribers connected prior to replay");
+        }
+        for (auto &[sequence, packet] : uncommittedPackets)
+        {
+            mPipeline->propagate(std::move(packet),
+                                 std::chrono::steady_clock::now(),
+                                 Tracing::Trace{},
+                                 sequence);
+        }
+        mPipeline->commitJournal();
+    }
+
     void stop()
     {
         // Kill the importers first.  Closing the RPC will force the producers
@@ -208,6 +278,19 @@ public:
         // the backend to finish its sends.
         mKeepRunning.store(false);
         if (mProxyThread.joinable()){mProxyThread.join();}
+        if (mCapture)
+        {
+            try
+            {
+                mCapture->flush();
+            }
+            catch (const std::exception &e)
+            {
+                SPDLOG_LOGGER_WARN(mLogger,
+                                   "Failed to flush capture because {}",
+                                   std::string {e.what()});
+            }
+        }
 
         // Now purge the subscribers.  By this point no new messages come in
         // but to help the subsribers out just a bit we'll pause just a moment
@@ -227,6 +310,13 @@ public:
     std::shared_ptr<spdlog::logger> mLogger{nullptr};
     std::unique_ptr<DuplicatePacketDetector>
         mDuplicateDetector{nullptr};
+    std::unique_ptr<PacketSpool> mSpool{nullptr};
+    std::unique_ptr<PacketJournal> mJournal{nullptr};
+    // N.B. The tracker outlives the backend's queues which hold receipts
+    std::unique_ptr<DeliveryTracker> mDeliveryTracker{nullptr};
+    std::unique_ptr<PacketReorderBuffer> mReorderBuffer{nullptr};
+    std::unique_ptr<PacketCoalescer> mCoalescer{nullptr};
+    std::unique_ptr<PacketCapture> mCapture{nullptr};
     std::function<void (UDataPacketImportAPI::V1::Packet &&)>
         mAddPacketCallback
     {   
@@ -234,14 +324,12 @@ public:
                   this,
                   std::placeholders::_1)
     };  
-    tbb::concurrent_bounded_queue<UDataPacketImportAPI::V1::Packet>
-        mImportExportQueue;
+    std::unique_ptr<PacketPipeline> mPipeline{nullptr};
     std::thread mProxyThread; 
     std::unique_ptr<Backend> mBackend{nullptr};
     std::unique_ptr<Frontend> mFrontend{nullptr};
-    int mImportExportQueueCapacity{8192};
+    std::chrono::milliseconds mMaximumReplayWait{0};
     std::atomic<bool> mKeepRunning{true};
-    bool mRemoveDuplicates{false};
     bool mWasStarted{false};
 };
 
@@ -305,4 +393,22 @@ int Proxy::getNumberOfSubscribers() const noexcept
     return 0;
 }
 
+/// Bypass the frontend
+void Proxy::enqueuePacket(UDataPacketImportAPI::V1::Packet &&packet)
+{
+    if (!pImpl->mWasStarted){throw std::runtime_error("Proxy not started");}
+    pImpl->addPacketCallback(std::move(packet));
+}
 
+/// In-process channels
+std::shared_ptr<grpc::Channel> Proxy::createFrontendInProcessChannel() const
+{
+    if (!pImpl->mWasStarted){throw std::runtime_error("Proxy not started");}
+    return pImpl->mFrontend->createInProcessChannel();
+}
+
+std::shared_ptr<grpc::Channel> Proxy::createBackendInProcessChannel() const
+{
+    if (!pImpl->mWasStarted){throw std::runtime_error("Proxy not started");}
+    return pImpl->mBackend->createInProcessChannel();
+}
@@ -5,6 +5,11 @@
 #include "uDataPacketImportProxy/frontendOptions.hpp"
 #include "uDataPacketImportProxy/backendOptions.hpp"
 #include "uDataPacketImportProxy/duplicatePacketDetector.hpp"
+#include "uDataPacketImportProxy/packetSpool.hpp"
+#include "uDataPacketImportProxy/packetJournal.hpp"
+#include "uDataPacketImportProxy/packetReorderBuffer.hpp"
+#include "uDataPacketImportProxy/packetCoalescer.hpp"
+#include "uDataPacketImportProxy/packetCapture.hpp"
 
 using namespace UDataPacketImportProxy;
 
@@ -14,8 +19,18 @@ public:
     FrontendOptions mFrontendOptions;
     BackendOptions mBackendOptions;
     DuplicatePacketDetectorOptions mDuplicatePacketDetectorOptions;
+    PacketSpoolOptions mPacketSpoolOptions;
+    PacketJournalOptions mPacketJournalOptions;
+    PacketReorderBufferOptions mPacketReorderBufferOptions;
+    PacketCoalescerOptions mPacketCoalescerOptions;
+    PacketCaptureOptions mPacketCaptureOptions;
     int mQueueCapacity{8192};
     bool mHaveDuplicatePacketDetectorOptions{false}; 
+    bool mHavePacketSpoolOptions{false};
+    bool mHavePacketJournalOptions{false};
+    bool mHavePacketReorderBufferOptions{false};
+    bool mHavePacketCoalescerOptions{false};
+    bool mHavePacketCaptureOptions{false};
 };
 
 /// Constructor
@@ -115,3 +130,108 @@ std::optional<DuplicatePacketDetectorOptions>
     }
     return std::nullopt;
 }
+
+/// The overflow spool options
+void ProxyOptions::setPacketSpoolOptions(const PacketSpoolOptions &options)
+{
+    if (!options.haveDirectory())
+    {
+        throw std::invalid_argument("Spool directory not set");
+    }
+    pImpl->mPacketSpoolOptions = options;
+    pImpl->mHavePacketSpoolOptions = true;
+}
+
+std::optional<PacketSpoolOptions>
+    ProxyOptions::getPacketSpoolOptions() const noexcept
+{
+    if (pImpl->mHavePacketSpoolOptions)
+    {
+        return std::make_optional<PacketSpoolOptions>
+               (pImpl->mPacketSpoolOptions);
+    }
+    return std::nullopt;
+}
+
+/// The packet journal options
+void ProxyOptions::setPacketJournalOptions(const PacketJournalOptions &options)
+{
+    if (!options.haveFileName())
+    {
+        throw std::invalid_argument("Journal file name not set");
+    }
+    pImpl->mPacketJournalOptions = options;
+    pImpl->mHavePacketJournalOptions = true;
+}
+
+std::optional<PacketJournalOptions>
+    ProxyOptions::getPacketJournalOptions() const noexcept
+{
+    if (pImpl->mHavePacketJournalOptions)
+    {
+        return std::make_optional<PacketJournalOptions>
+               (pImpl->mPacketJournalOptions);
+    }
+    return std::nullopt;
+}
+
+/// The reorder buffer options
+void ProxyOptions::setPacketReorderBufferOptions(
+    const PacketReorderBufferOptions &options)
+{
+    pImpl->mPacketReorderBufferOptions = options;
+    pImpl->mHavePacketReorderBufferOptions = true;
+}
+
+std::optional<PacketReorderBufferOptions>
+    ProxyOptions::getPacketReorderBufferOptions() const noexcept
+{
+    if (pImpl->mHavePacketReorderBufferOptions)
+    {
+        return std::make_optional<PacketReorderBufferOptions>
+               (pImpl->mPacketReorderBufferOptions);
+    }
+    return std::nullopt;
+}
+
+/// The coalescer options
+void ProxyOptions::setPacketCoalescerOptions(
+    const PacketCoalescerOptions &options)
+{
+    pImpl->mPacketCoalescerOptions = options;
+    pImpl->mHavePacketCoalescerOptions = true;
+}
+
+std::optional<PacketCoalescerOptions>
+    ProxyOptions::getPacketCoalescerOptions() const noexcept
+{
+    if (pImpl->mHavePacketCoalescerOptions)
+    {
+        return std::make_optional<PacketCoalescerOptions>
+               (pImpl->mPacketCoalescerOptions);
+    }
+    return std::nullopt;
+}
+
+/// The capture options
+void ProxyOptions::setPacketCaptureOptions(
+    const PacketCaptureOptions &options)
+{
+    if (!options.haveDirectory())
+    {
+        throw std::invalid_argument("Capture directory not set");
+    }
+    pImpl->mPacketCaptureOptions = options;
+    pImpl->mHavePacketCaptureOptions = true;
+}
+
+std::optional<PacketCaptureOptions>
+    ProxyOptions::getPacketCaptureOptions() const noexcept
+{
+    if (pImpl->mHavePacketCaptureOptions)
+    {
+        return std::make_optional<PacketCaptureOptions>
+               (pImpl->mPacketCaptureOptions);
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,108 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_RATE_LIMITED_LOG_HPP
+#define UDATA_PACKET_IMPORT_PROXY_RATE_LIMITED_LOG_HPP
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+namespace UDataPacketImportProxy
+{
+
+/// @brief A lock-free token bucket for suppressing repetitive log messages.
+///        This is implemented as the generic cell rate algorithm so the
+///        entire state is the theoretical arrival time of the next message.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+class LogRateLimiter
+{
+public:
+    /// @param[in] messagesPerSecond  The sustained rate at which messages
+    ///                               are let through.
+    /// @param[in] burst              The number of messages that can be let
+    ///                               through at once after a quiet period.
+    /// @throws std::invalid_argument if the rate or burst is not positive.
+    explicit LogRateLimiter(const double messagesPerSecond = 1,
+                            const int burst = 5)
+    {
+        if (!(messagesPerSecond > 0))
+        {
+            throw std::invalid_argument("Messages per second must be positive");
+        }
+        if (burst < 1)
+        {
+            throw std::invalid_argument("Burst must be positive");
+        }
+        mInterval = static_cast<int64_t> (std::round(1.e9/messagesPerSecond));
+        mInterval = std::max<int64_t> (1, mInterval);
+        mBurstTolerance = mInterval*(burst - 1);
+    }
+
+    /// @param[in] now  The current time.
+    /// @result If the message should be logged then the number of messages
+    ///         suppressed since the previously logged message.  Otherwise,
+    ///         std::nullopt indicates the message should be suppressed.
+    [[nodiscard]] std::optional<int64_t> tryAcquire(
+        const std::chrono::steady_clock::time_point now
+            = std::chrono::steady_clock::now()) noexcept
+    {
+        const auto nowNanoSeconds
+            = std::chrono::duration_cast<std::chrono::nanoseconds>
+              (now.time_since_epoch()).count();
+        auto arrivalTime
+            = mTheoreticalArrivalTime.load(std::memory_order_relaxed);
+        while (true)
+        {
+            if (nowNanoSeconds < arrivalTime - mBurstTolerance)
+            {
+                mSuppressedMessages.fetch_add(1, std::memory_order_relaxed);
+                return std::nullopt;
+            }
+            const auto nextArrivalTime
+                = std::max(arrivalTime, nowNanoSeconds) + mInterval;
+            if (mTheoreticalArrivalTime.compare_exchange_weak(
+                    arrivalTime, nextArrivalTime, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        return mSuppressedMessages.exchange(0, std::memory_order_relaxed);
+    }
+private:
+    std::atomic<int64_t> mTheoreticalArrivalTime{0};
+    std::atomic<int64_t> mSuppressedMessages{0};
+    int64_t mInterval{1000000000};
+    int64_t mBurstTolerance{0};
+};
+
+}
+
+/// @brief Logs at most about one message per second from this call site
+///        after an initial burst.  When messages were suppressed a summary
+///        precedes the next message that is let through.
+#define RATE_LIMITED_LOGGER_CALL(logger, level, ...) \
+    do \
+    { \
+        static UDataPacketImportProxy::LogRateLimiter rateLimiter_; \
+        if (const auto nSuppressed_ = rateLimiter_.tryAcquire()) \
+        { \
+            if (*nSuppressed_ > 0) \
+            { \
+                SPDLOG_LOGGER_CALL(logger, level, \
+                                   "{} similar messages suppressed", \
+                                   *nSuppressed_); \
+            } \
+            SPDLOG_LOGGER_CALL(logger, level, __VA_ARGS__); \
+        } \
+    } while (false)
+
+#define RATE_LIMITED_LOGGER_INFO(logger, ...) \
+    RATE_LIMITED_LOGGER_CALL(logger, spdlog::level::info, __VA_ARGS__)
+#define RATE_LIMITED_LOGGER_WARN(logger, ...) \
+    RATE_LIMITED_LOGGER_CALL(logger, spdlog::level::warn, __VA_ARGS__)
+#define RATE_LIMITED_LOGGER_ERROR(logger, ...) \
+    RATE_LIMITED_LOGGER_CALL(logger, spdlog::level::err, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <grpc/grpc.h>
+#include <grpcpp/grpcpp.h>
+#include <spdlog/fmt/fmt.h>
+#include <tbb/concurrent_queue.h>
+#include "uDataPacketImportProxy/packetCapture.hpp"
+#include "uDataPacketImportAPI/v1/frontend.grpc.pb.h"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+
+/// Publishes a traffic capture to a proxy's frontend.  The inter-arrival
+/// times of the capture are preserved, optionally compressed by a speed-up
+/// factor, so that a production incident can be reproduced in the lab.
+
+namespace
+{
+
+struct Options
+{
+    std::vector<std::filesystem::path> files;
+    std::string frontendAddress{"localhost:50000"};
+    std::string accessToken;
+    double speed{1};
+    int nPublishers{1};
+};
+
+[[nodiscard]] std::optional<::Options>
+    parseCommandLine(int argc, char *argv[])
+{
+    ::Options options;
+    std::vector<std::string> inputs;
+    boost::program_options::options_description description(R"""(
+The uDataPacketImportReplay publishes the packets in capture files written
+by a uDataPacketImportProxy with Proxy.captureDirectory set.  The packets
+are sent with the same spacing they were received with, divided by the
+speed.  A speed of 0 sends the packets as fast as possible.
+
+Example usage:
+    uDataPacketImportReplay --frontend localhost:50000 --speed 10 /data/capture
+
+Allowed options)""");
+    description.add_options()
+        ("help", "Produces this help message")
+        ("frontend", boost::program_options::value<std::string>
+                     (&options.frontendAddress)->default_value(options.frontendAddress),
+         "The frontend address")
+        ("token", boost::program_options::value<std::string>
+                  (&options.accessToken),
+         "The access token sent as x-custom-auth-token")
+        ("speed", boost::program_options::value<double>
+                  (&options.speed)->default_value(options.speed),
+         "The replay speed-up factor; 0 replays as fast as possible")
+        ("publishers", boost::program_options::value<int>
+                       (&options.nPublishers)->default_value(options.nPublishers),
+         "The number of publishers; streams are spread across publishers")
+        ("input", boost::program_options::value<std::vector<std::string>>
+                  (&inputs),
+         "Capture files or capture directories");
+    boost::program_options::positional_options_description positional;
+    positional.add("input", -1);
+    boost::program_options::variables_map vm;
+    boost::program_options::store(
+        boost::program_options::command_line_parser(argc, argv)
+            .options(description).positional(positional).run(),
+        vm);
+    boost::program_options::notify(vm);
+    if (vm.count("help"))
+    {
+        std::cout << description << std::endl;
+        return std::nullopt;
+    }
+    if (options.speed < 0)
+    {
+        throw std::invalid_argument("Speed cannot be negative");
+    }
+    if (options.nPublishers < 1 || options.nPublishers > 1000)
+    {
+        throw std::invalid_argument("Publishers must be in range [1,1000]");
+    }
+    if (inputs.empty())
+    {
+        throw std::invalid_argument("No capture files given");
+    }
+    for (const auto &input : inputs)
+    {
+        if (std::filesystem::is_directory(input))
+        {
+            auto files
+                = UDataPacketImportProxy::PacketCapture::getFiles(input);
+            options.files.insert(options.files.end(),
+                                 files.begin(), files.end());
+        }
+        else if (std::filesystem::exists(input))
+        {
+            options.files.push_back(input);
+        }
+        else
+        {
+            throw std::invalid_argument(input + " does not exist");
+        }
+    }
+    if (options.files.empty())
+    {
+        throw std::invalid_argument("No capture files found");
+    }
+    return options;
+}
+
+/// A packet and when it should be sent.  An empty packet tells the
+/// publisher the capture is exhausted.
+struct ScheduledPacket
+{
+    std::chrono::steady_clock::time_point due;
+    std::optional<UDataPacketImportAPI::V1::Packet> packet;
+};
+
+struct PublisherStatistics
+{
+    int64_t packetsSent{0};
+    int64_t bytesSent{0};
+    std::chrono::steady_clock::duration maximumLateness{0};
+    std::string error;
+};
+
+void publish(const ::Options &options,
+             tbb::concurrent_bounded_queue<::ScheduledPacket> *queue,
+             ::PublisherStatistics *statistics)
+{
+    grpc::ChannelArguments arguments;
+    arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    auto channel = grpc::CreateCustomChannel(options.frontendAddress,
+                                             grpc::InsecureChannelCredentials(),
+                                             arguments);
+    auto stub = UDataPacketImportAPI::V1::Frontend::NewStub(channel);
+    grpc::ClientContext context;
+    if (!options.accessToken.empty())
+    {
+        context.AddMetadata("x-custom-auth-token", options.accessToken);
+    }
+    UDataPacketImportAPI::V1::PublishResponse response;
+    auto writer = stub->Publish(&context, &response);
+    bool connected{true};
+    while (true)
+    {
+        ::ScheduledPacket scheduledPacket;
+        queue->pop(scheduledPacket);
+        if (!scheduledPacket.packet){break;}
+        // Keep draining so the reader never blocks on a dead publisher
+        if (!connected){continue;}
+        std::this_thread::sleep_until(scheduledPacket.due);
+        const auto lateness
+            = std::chrono::steady_clock::now() - scheduledPacket.due;
+        statistics->maximumLateness
+            = std::max(statistics->maximumLateness, lateness);
+        if (!writer->Write(*scheduledPacket.packet))
+        {
+            statistics->error = "Publisher lost its connection";
+            connected = false;
+            continue;
+        }
+        statistics->packetsSent = statistics->packetsSent + 1;
+        statistics->bytesSent
+            = statistics->bytesSent
+            + static_cast<int64_t> (scheduledPacket.packet->ByteSizeLong());
+    }
+    if (connected){writer->WritesDone();}
+    auto status = writer->Finish();
+    if (!status.ok() && statistics->error.empty())
+    {
+        statistics->error = "Publisher finished with: "
+                          + status.error_message();
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::optional<::Options> options;
+    try
+    {
+        options = ::parseCommandLine(argc, argv);
+        if (!options){return EXIT_SUCCESS;}
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // The capture does not record which publisher sent a packet so the
+    // streams are spread over the publishers.  A stream always goes to the
+    // same publisher which preserves its packet order.
+    constexpr int queueCapacity{8192};
+    std::vector<tbb::concurrent_bounded_queue<::ScheduledPacket>>
+        queues(options->nPublishers);
+    for (auto &queue : queues){queue.set_capacity(queueCapacity);}
+    std::vector<::PublisherStatistics> statistics(options->nPublishers);
+    std::vector<std::thread> publishers;
+    for (int i = 0; i < options->nPublishers; ++i)
+    {
+        publishers.emplace_back(&::publish,
+                                std::cref(*options),
+                                &queues[i],
+                                &statistics[i]);
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+    std::optional<std::chrono::microseconds> firstReceiveTime;
+    std::chrono::microseconds lastReceiveTime{0};
+    int64_t packetsRead{0};
+    int exitCode{EXIT_SUCCESS};
+    try
+    {
+        for (const auto &file : options->files)
+        {
+            UDataPacketImportProxy::PacketCaptureReader reader{file};
+            UDataPacketImportAPI::V1::Packet packet;
+            std::chrono::microseconds receiveTime{0};
+            while (reader.next(&packet, &receiveTime))
+            {
+                if (!firstReceiveTime){firstReceiveTime = receiveTime;}
+                lastReceiveTime = receiveTime;
+                auto due = startTime;
+                if (options->speed > 0)
+                {
+                    // N.B. Rotated files can overlap slightly in time
+                    const auto offset
+                        = std::max(std::chrono::microseconds {0},
+                                   receiveTime - *firstReceiveTime);
+                    due = due
+                        + std::chrono::duration_cast
+                          <std::chrono::steady_clock::duration>
+                          (std::chrono::duration<double, std::micro>
+                             (static_cast<double> (offset.count())
+                             /options->speed));
+                }
+                const auto &identifier = packet.stream_identifier();
+                const auto hash
+                    = std::hash<std::string> {}
+                      (identifier.network() + "." + identifier.station() + "."
+                     + identifier.channel() + "."
+                     + identifier.location_code());
+                const auto publisher = hash % queues.size();
+                queues[publisher].push(::ScheduledPacket {due,
+                                                          std::move(packet)});
+                packetsRead = packetsRead + 1;
+                packet.Clear();
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+    for (auto &queue : queues){queue.push(::ScheduledPacket {});}
+    for (auto &thread : publishers){thread.join();}
+    const auto elapsed
+        = std::chrono::duration<double>
+          (std::chrono::steady_clock::now() - startTime).count();
+
+    // Summarize
+    int64_t packetsSent{0};
+    int64_t bytesSent{0};
+    std::chrono::steady_clock::duration maximumLateness{0};
+    for (const auto &publisherStatistics : statistics)
+    {
+        if (!publisherStatistics.error.empty())
+        {
+            std::cerr << publisherStatistics.error << std::endl;
+            exitCode = EXIT_FAILURE;
+        }
+        packetsSent += publisherStatistics.packetsSent;
+        bytesSent += publisherStatistics.bytesSent;
+        maximumLateness = std::max(maximumLateness,
+                                   publisherStatistics.maximumLateness);
+    }
+    const auto captureDuration
+        = firstReceiveTime ?
+          std::chrono::duration<double>
+          (lastReceiveTime - *firstReceiveTime).count() : 0;
+    std::cout << fmt::format("Replayed {} of {} packets ({} bytes) spanning {:.3f} s in {:.3f} s",
+                             packetsSent,
+                             packetsRead,
+                             bytesSent,
+                             captureDuration,
+                             elapsed)
+              << std::endl;
+    std::cout << fmt::format("  Achieved {:.1f} packets/s with a maximum lateness of {:.3f} ms",
+                             elapsed > 0 ?
+                             static_cast<double> (packetsSent)/elapsed : 0,
+                             std::chrono::duration<double, std::milli>
+                                (maximumLateness).count())
+              << std::endl;
+    return exitCode;
+}
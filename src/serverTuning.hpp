@@ -0,0 +1,50 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_SERVER_TUNING_HPP
+#define UDATA_PACKET_IMPORT_PROXY_SERVER_TUNING_HPP
+#include <cstddef>
+#include <string>
+#include <grpc/grpc.h>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/resource_quota.h>
+#include "uDataPacketImportProxy/grpcOptions.hpp"
+namespace UDataPacketImportProxy
+{
+
+/// @brief Applies the resource quota, concurrent stream, and HTTP/2 options
+///        to a server under construction.  Options that are not set are
+///        left at gRPC's defaults.
+/// @param[in] options   The gRPC options.
+/// @param[in] name      The resource quota's name - e.g., frontend.
+/// @param[in,out] builder  The server builder.
+inline void applyServerTuning(const GRPCOptions &options,
+                              const std::string &name,
+                              grpc::ServerBuilder *builder)
+{
+    if (auto quota = options.getResourceQuotaInBytes())
+    {
+        grpc::ResourceQuota resourceQuota{name};
+        resourceQuota.Resize(static_cast<size_t> (*quota));
+        builder->SetResourceQuota(resourceQuota);
+    }
+    if (auto maxStreams = options.getMaximumNumberOfConcurrentStreams())
+    {
+        builder->AddChannelArgument(GRPC_ARG_MAX_CONCURRENT_STREAMS,
+                                    *maxStreams);
+    }
+    // N.B. gRPC sizes each stream's initial flow-control window with the
+    // lookahead bytes
+    if (auto windowSize = options.getHTTP2StreamWindowSizeInBytes())
+    {
+        builder->AddChannelArgument(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES,
+                                    *windowSize);
+    }
+    if (auto bufferSize = options.getHTTP2WriteBufferSizeInBytes())
+    {
+        builder->AddChannelArgument(GRPC_ARG_HTTP2_WRITE_BUFFER_SIZE,
+                                    *bufferSize);
+    }
+    builder->AddChannelArgument(GRPC_ARG_HTTP2_BDP_PROBE,
+                                options.http2BDPProbeEnabled() ? 1 : 0);
+}
+
+}
+#endif
@@ -0,0 +1,146 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_STREAM_IDENTIFIER_HPP
+#define UDATA_PACKET_IMPORT_PROXY_STREAM_IDENTIFIER_HPP
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <boost/algorithm/string/trim.hpp>
+#include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
+namespace UDataPacketImportProxy
+{
+
+namespace Detail
+{
+inline void normalizeCode(std::string *code)
+{
+    boost::algorithm::trim(*code);
+    std::transform(code->begin(), code->end(), code->begin(), ::toupper);
+}
+}
+
+/// @brief Normalizes the stream identifier in place.  The network, station,
+///        channel, and location code are trimmed and upper-cased and a blank
+///        location code becomes "--".
+/// @param[in,out] identifier  The stream identifier to normalize.
+/// @result True indicates the network, station, and channel are not blank.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+[[nodiscard]] inline bool normalizeStreamIdentifier(
+    UDataPacketImportAPI::V1::StreamIdentifier *identifier)
+{
+    Detail::normalizeCode(identifier->mutable_network());
+    Detail::normalizeCode(identifier->mutable_station());
+    Detail::normalizeCode(identifier->mutable_channel());
+    Detail::normalizeCode(identifier->mutable_location_code());
+    if (identifier->location_code().empty())
+    {
+        identifier->set_location_code("--");
+    }
+    return !identifier->network().empty() &&
+           !identifier->station().empty() &&
+           !identifier->channel().empty();
+}
+
+/// @result The stream's name - i.e., NETWORK.STATION.CHANNEL.LOCATION.
+[[nodiscard]] inline std::string toName(
+    const UDataPacketImportAPI::V1::StreamIdentifier &identifier)
+{
+    std::string result;
+    result.reserve(identifier.network().size()
+                 + identifier.station().size()
+                 + identifier.channel().size()
+                 + identifier.location_code().size() + 3);
+    result.append(identifier.network());
+    result.push_back('.');
+    result.append(identifier.station());
+    result.push_back('.');
+    result.append(identifier.channel());
+    result.push_back('.');
+    result.append(identifier.location_code());
+    return result;
+}
+
+/// @brief Views a stream identifier's codes.  This is for looking up
+///        per-stream state without building a name for every packet.
+struct StreamKeyView
+{
+    explicit StreamKeyView(
+        const UDataPacketImportAPI::V1::StreamIdentifier &identifier) noexcept :
+        network(identifier.network()),
+        station(identifier.station()),
+        channel(identifier.channel()),
+        locationCode(identifier.location_code())
+    {
+    }
+    StreamKeyView(const std::string_view networkIn,
+                  const std::string_view stationIn,
+                  const std::string_view channelIn,
+                  const std::string_view locationCodeIn) noexcept :
+        network(networkIn),
+        station(stationIn),
+        channel(channelIn),
+        locationCode(locationCodeIn)
+    {
+    }
+    bool operator==(const StreamKeyView &rhs) const noexcept = default;
+    std::string_view network;
+    std::string_view station;
+    std::string_view channel;
+    std::string_view locationCode;
+};
+
+/// @brief Owns a stream identifier's codes.  Maps keyed on this and
+///        declared with StreamKeyHash and StreamKeyEqual can be searched
+///        with a StreamKeyView.
+struct StreamKey
+{
+    explicit StreamKey(const StreamKeyView &view) :
+        network(view.network),
+        station(view.station),
+        channel(view.channel),
+        locationCode(view.locationCode)
+    {
+    }
+    operator StreamKeyView() const noexcept //NOLINT
+    {
+        return StreamKeyView {network, station, channel, locationCode};
+    }
+    std::string network;
+    std::string station;
+    std::string channel;
+    std::string locationCode;
+};
+
+struct StreamKeyHash
+{
+    using is_transparent = void;
+    [[nodiscard]] size_t operator()(const StreamKeyView &key) const noexcept
+    {
+        const std::hash<std::string_view> hash;
+        auto result = hash(key.network);
+        for (const auto &code : {key.station, key.channel, key.locationCode})
+        {
+            result = result*31 + hash(code);
+        }
+        return result;
+    }
+    [[nodiscard]] size_t operator()(const StreamKey &key) const noexcept
+    {
+        return (*this)(static_cast<StreamKeyView> (key));
+    }
+};
+
+struct StreamKeyEqual
+{
+    using is_transparent = void;
+    [[nodiscard]] bool operator()(const StreamKeyView &lhs,
+                                  const StreamKeyView &rhs) const noexcept
+    {
+        return lhs == rhs;
+    }
+};
+
+}
+#endif
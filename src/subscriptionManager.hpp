@@ -0,0 +1,529 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_SUBSCRIPTION_MANAGER_HPP
+#define UDATA_PACKET_IMPORT_PROXY_SUBSCRIPTION_MANAGER_HPP
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#ifndef NDEBUG
+#include <cassert>
+#endif
+#include <spdlog/spdlog.h>
+#include <spdlog/logger.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <tbb/concurrent_queue.h>
+#include "uDataPacketImportProxy/backendOptions.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
+#include "deliveryTracker.hpp"
+#include "flightRecorder.hpp"
+#include "packetTime.hpp"
+#include "rateLimitedLog.hpp"
+#include "streamIdentifier.hpp"
+#include "tracing.hpp"
+import metrics;
+import getNow;
+/// @brief The backend's per-subscriber packet queues and the manager that
+///        fans packets out to them.  These are separate from the gRPC
+///        service so they can be exercised by the benchmarks.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+namespace UDataPacketImportProxy
+{
+
+/// A packet in a subscriber's queue along with when the packet arrived
+/// at the frontend, when it was put in this queue, its trace, its
+/// delivery receipt, and when, on the queue's clock, its last sample was
+/// recorded.  The receipt is shared by every subscriber's copy of the
+/// packet and is released once the last copy is written or dropped.
+struct OutboundPacket
+{
+    UDataPacketImportAPI::V1::Packet packet;
+    std::chrono::steady_clock::time_point ingestTime;
+    std::chrono::steady_clock::time_point enqueueTime;
+    UDataPacketImportProxy::Tracing::Trace trace;
+    UDataPacketImportProxy::DeliveryReceipt deliveryReceipt;
+    std::chrono::steady_clock::time_point lastSampleTime;
+};
+
+/// @result The packet as it is put in the subscribers' queues at the given
+///         time.  The system clock is read once here so that the writers
+///         can measure the data latency from the time of the last sample
+///         on the steady clock.
+[[nodiscard]] inline OutboundPacket makeOutboundPacket(
+    const UDataPacketImportAPI::V1::Packet &packet,
+    const std::chrono::steady_clock::time_point &ingestTime,
+    const std::chrono::steady_clock::time_point &enqueueTime,
+    const UDataPacketImportProxy::Tracing::Trace &trace,
+    const UDataPacketImportProxy::DeliveryReceipt &deliveryReceipt)
+{
+    OutboundPacket result{packet,
+                          ingestTime,
+                          enqueueTime,
+                          trace,
+                          deliveryReceipt,
+                          enqueueTime};
+    if (packet.sampling_rate() > 0)
+    {
+        result.lastSampleTime
+            = enqueueTime
+            - UDataPacketImportProxy::getDataLatency(
+                  packet, std::chrono::system_clock::now());
+    }
+    return result;
+}
+
+/// A subscriber's queue.  When the queue is full the oldest packets - or,
+/// with the latest-per-stream policy, all but the latest packet of each
+/// stream - are dropped.  A compaction that frees little of the queue
+/// means the subscriber has about as many streams as the queue has room
+/// for, so the oldest packets are evicted until the queue turns over
+/// before compacting again.  This bounds the cost of compacting to a few
+/// moves per packet.
+class PacketStream
+{
+public:
+    PacketStream(const int queueCapacity,
+                 const BackendOptions::SlowConsumerPolicy policy,
+                 std::shared_ptr<UDataPacketImportProxy::Metrics::SubscriberStatistics> statistics,
+                 std::shared_ptr<spdlog::logger> logger,
+                 std::shared_ptr<UDataPacketImportProxy::Utilities::Clock> clock = nullptr) :
+        mLogger(std::move(logger)),
+        mStatistics(std::move(statistics)),
+        mClock(std::move(clock)),
+        mPolicy(policy)
+    {
+        if (mClock == nullptr)
+        {
+            mClock = UDataPacketImportProxy::Utilities::getSystemClock();
+        }
+        if (queueCapacity < 1)
+        {
+            throw std::invalid_argument("Queue capacity must be positive");
+        }
+        mQueueCapacity = queueCapacity;
+        mQueue.set_capacity(mQueueCapacity);
+    }
+    ~PacketStream()
+    {
+        // Whatever the subscriber did not get to leaves with the stream
+        mMetrics.getQueueDepth(
+            UDataPacketImportProxy::Metrics::QueueType::Subscriber)
+                .add(-getQueueSize());
+    }
+    PacketStream(const PacketStream &) = delete;
+    PacketStream& operator=(const PacketStream &) = delete;
+    [[nodiscard]] int enqueuePacket(
+        const UDataPacketImportAPI::V1::Packet &packet,
+        const std::chrono::steady_clock::time_point &ingestTime,
+        const UDataPacketImportProxy::Tracing::Trace &trace,
+        const UDataPacketImportProxy::DeliveryReceipt &deliveryReceipt = {})
+    {
+        return enqueuePacket(makeOutboundPacket(packet,
+                                                ingestTime,
+                                                mClock->now(),
+                                                trace,
+                                                deliveryReceipt));
+    }
+    [[nodiscard]] int enqueuePacket(OutboundPacket &&packet)
+    {
+        int packetsLost{0};
+        if (mPacketsUntilCompaction > 0){mPacketsUntilCompaction--;}
+        auto approximateSize = static_cast<int> (mQueue.size());
+        if (approximateSize >= mQueueCapacity)
+        {
+            if (mPolicy == BackendOptions::SlowConsumerPolicy::LatestPerStream &&
+                mPacketsUntilCompaction == 0)
+            {
+                packetsLost = compact();
+                approximateSize = static_cast<int> (mQueue.size());
+                // A compaction is a pass over the whole queue so it has to
+                // free a good part of the queue to pay for itself.  When
+                // the queue holds about as many streams as packets, evict
+                // the oldest packets until the queue has turned over.
+                if (packetsLost < mQueueCapacity/4)
+                {
+                    mPacketsUntilCompaction = mQueueCapacity;
+                    RATE_LIMITED_LOGGER_WARN(mLogger,
+                        "Queue capacity of {} is too small to keep the latest packet of each stream for {}; evicting the oldest packets",
+                        mQueueCapacity,
+                        mStatistics ? mStatistics->getName() : "");
+                }
+            }
+            // Fall back to evicting the oldest packets
+            while (approximateSize >= mQueueCapacity)
+            {
+                OutboundPacket workSpace;
+                if (!mQueue.try_pop(workSpace))
+                {
+                    RATE_LIMITED_LOGGER_WARN(mLogger,
+                                       "Failed to pop element from stream queue");
+                    break;
+                }
+                packetsLost = packetsLost + 1; 
+                approximateSize = static_cast<int> (mQueue.size());
+            }
+            mMetrics.getQueueDepth(UDataPacketImportProxy::Metrics::QueueType::Subscriber)
+                    .add(-packetsLost);
+            mMetrics.incrementDroppedPacketsCounter(
+                UDataPacketImportProxy::Metrics::DropReason::SubscriberOverflow,
+                packetsLost);
+            if (mStatistics)
+            {
+                mStatistics->incrementDroppedPacketsCounter(packetsLost);
+            }
+            if (packetsLost > 0)
+            {
+                FlightRecorder::record(
+                    FlightRecorder::EventType::QueueOverflow,
+                    mStatistics ? mStatistics->getName() : "",
+                    packetsLost,
+                    static_cast<uint16_t> (FlightRecorder::Queue::Subscriber));
+            }
+            // Say so once rather than for every packet
+            if (packetsLost > 0 && !mFallingBehind)
+            {
+                mFallingBehind = true;
+                SPDLOG_LOGGER_WARN(mLogger,
+                                   "Subscriber {} is falling behind and losing packets",
+                                   mStatistics ? mStatistics->getName() : "");
+            }
+        } 
+        else if (mFallingBehind && approximateSize < mQueueCapacity/2)
+        {
+            mFallingBehind = false;
+            SPDLOG_LOGGER_INFO(mLogger, "Subscriber {} has caught up",
+                               mStatistics ? mStatistics->getName() : "");
+        }
+        // Try to add the packet
+        if (mQueue.try_push(std::move(packet)))
+        {
+            const auto queueSize = getQueueSize();
+            mMetrics.updateQueueDepth(
+                UDataPacketImportProxy::Metrics::QueueType::Subscriber,
+                1,
+                queueSize);
+            if (mStatistics){mStatistics->updateQueueDepth(queueSize);}
+        }
+        else
+        {
+            RATE_LIMITED_LOGGER_ERROR(mLogger,
+                                 "Failed to add packet to stream queue");
+        }
+        return packetsLost;
+    }
+    [[nodiscard]] std::optional<OutboundPacket> dequeuePacket()
+    {
+        std::optional<OutboundPacket> result{std::nullopt};
+        OutboundPacket packet;
+        if (mQueue.try_pop(packet))
+        {
+            mMetrics.getQueueDepth(UDataPacketImportProxy::Metrics::QueueType::Subscriber)
+                    .add(-1);
+            if (mStatistics){mStatistics->updateQueueDepth(getQueueSize());}
+            result = std::make_optional<OutboundPacket> (std::move(packet));
+        }
+        return result; 
+    }
+    /// N.B. tbb's size can be negative when consumers are waiting
+    [[nodiscard]] int64_t getQueueSize() const
+    {
+        return std::max<int64_t> (0, static_cast<int64_t> (mQueue.size()));
+    }
+    std::shared_ptr<spdlog::logger> mLogger{nullptr};
+    std::shared_ptr<UDataPacketImportProxy::Metrics::SubscriberStatistics>
+        mStatistics{nullptr};
+    std::shared_ptr<UDataPacketImportProxy::Utilities::Clock> mClock{nullptr};
+    UDataPacketImportProxy::Metrics::MetricsSingleton &mMetrics
+    {
+        UDataPacketImportProxy::Metrics::MetricsSingleton::getInstance()
+    };
+    oneapi::tbb::concurrent_bounded_queue<OutboundPacket> mQueue;
+    int mQueueCapacity{1024};
+    BackendOptions::SlowConsumerPolicy mPolicy{BackendOptions::SlowConsumerPolicy::DropOldest};
+    int mPacketsUntilCompaction{0};
+    bool mFallingBehind{false};
+private:
+    /// Reduces the queue to the most recent packet of each stream while
+    /// preserving the order.  The writer may dequeue concurrently which
+    /// is fine since it only takes packets we would have kept or dropped.
+    /// @result The number of packets dropped.
+    [[nodiscard]] int compact()
+    {
+        std::vector<OutboundPacket> packets;
+        packets.reserve(static_cast<size_t> (mQueueCapacity));
+        OutboundPacket workSpace;
+        while (mQueue.try_pop(workSpace))
+        {
+            packets.push_back(std::move(workSpace));
+        }
+        std::vector<bool> keep(packets.size(), false);
+        std::unordered_set<StreamKeyView, StreamKeyHash, StreamKeyEqual>
+            streams;
+        for (auto i = static_cast<int> (packets.size()) - 1; i >= 0; --i)
+        {
+            if (streams.emplace(packets[i].packet.stream_identifier()).second)
+            {
+                keep[i] = true;
+            }
+        }
+        int packetsLost{0};
+        for (size_t i = 0; i < packets.size(); ++i)
+        {
+            if (keep[i] && mQueue.try_push(std::move(packets[i])))
+            {
+                continue;
+            }
+            packetsLost = packetsLost + 1;
+        }
+        return packetsLost;
+    }
+};
+
+/// Fans each packet out to every subscriber's queue
+class SubscriptionManager
+{
+public:
+    /// @param[in] clock  Stamps the packets' enqueue times.  By default
+    ///                   this is the system clock.
+    SubscriptionManager(const int queueCapacity,
+                        const BackendOptions::SlowConsumerPolicy policy,
+                        std::shared_ptr<spdlog::logger> logger,
+                        std::shared_ptr<UDataPacketImportProxy::Utilities::Clock> clock = nullptr) :
+        mLogger(std::move(logger)),
+        mClock(std::move(clock)),
+        mQueueCapacity(queueCapacity),
+        mPolicy(policy)
+    {
+        if (mLogger == nullptr)
+        {
+            mLogger = spdlog::stdout_color_mt("SubscriptionManagerConsole");
+        }
+        if (mClock == nullptr)
+        {
+            mClock = UDataPacketImportProxy::Utilities::getSystemClock();
+        }
+    }
+
+    /// @result The clock that stamps the packets' enqueue times.
+    [[nodiscard]] const UDataPacketImportProxy::Utilities::Clock &getClock() const noexcept
+    {
+        return *mClock;
+    }
+
+    ~SubscriptionManager()
+    {
+        unsubscribeAll();
+    }
+
+    // Number of subscribers
+    [[nodiscard]] int getNumberOfSubscribers() const
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        return static_cast<int> (mSubscribers.size());
+    }
+
+    // Unsubscribes all
+    void unsubscribeAll()
+    {
+        mKeepRunning.store(false);
+        auto nSubscribers = getNumberOfSubscribers();
+        {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        mSubscribers.clear();
+        }
+        if (nSubscribers > 0)
+        {
+            SPDLOG_LOGGER_INFO(mLogger,
+                               "Subscription manager purged {} subscribers",
+                               nSubscribers);
+        }
+    }
+
+    // Subscribe
+    void subscribe(uintptr_t contextAddress,
+                   const std::string &peer,
+                   std::shared_ptr<UDataPacketImportProxy::Metrics::SubscriberStatistics> statistics)
+    {
+        if (!mKeepRunning.load()){return;}
+        std::string errorMessage;
+        bool alreadyExists{true};
+        {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        auto idx = mSubscribers.find(contextAddress);
+        // Add it
+        if (idx == mSubscribers.end())
+        {
+            alreadyExists = false;
+            auto packetStream
+                = std::make_unique<PacketStream> (mQueueCapacity,
+                                                    mPolicy,
+                                                    std::move(statistics),
+                                                    mLogger,
+                                                    mClock);
+            std::pair<uintptr_t, std::unique_ptr<PacketStream>>
+                newPacketStream{contextAddress, std::move(packetStream)};
+            try
+            {
+                mSubscribers.insert(std::move(newPacketStream));
+            }
+            catch (const std::exception &e)
+            {
+                errorMessage = "Failed to subscribe " + peer
+                             + " because "
+                             + std::string {e.what()}; 
+            }
+        }
+        }
+        if (!alreadyExists)
+        {
+            if (errorMessage.empty())
+            {
+                SPDLOG_LOGGER_INFO(mLogger, "Subscribed {} ({})",
+                                   peer, std::to_string (contextAddress));
+            }
+            else
+            {
+                throw std::runtime_error(errorMessage);
+            } 
+        }
+    }
+
+    // Unsubscribe
+    void unsubscribe(uintptr_t contextAddress, const std::string &peer)
+    {
+        if (!mKeepRunning.load()){return;}
+        const std::string errorMessage;
+        size_t nErased{0};
+        {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        nErased = mSubscribers.erase(contextAddress) == 1 ? true : false;
+        }
+        auto exists = (nErased == 1) ? true : false;
+        if (!exists)
+        { 
+            SPDLOG_LOGGER_WARN(mLogger, "{} ({}) was not subscribed",
+                               peer,
+                               std::to_string(contextAddress));
+        }
+        else
+        {
+            if (!errorMessage.empty())
+            {
+                throw std::runtime_error(errorMessage);
+            }
+        }
+    }
+
+    /// Adds a packet
+    [[nodiscard]] int enqueuePacket(
+        const UDataPacketImportAPI::V1::Packet &packet,
+        const std::chrono::steady_clock::time_point &ingestTime,
+        const UDataPacketImportProxy::DeliveryReceipt &deliveryReceipt = {})
+    {
+        int nPacketsLost{0};
+        std::string errorMessages;
+        if (!mKeepRunning.load()){return nPacketsLost;}
+        // N.B. The proxy makes a sampled packet's trace current
+        const auto &trace = UDataPacketImportProxy::Tracing::current();
+        {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        if (mSubscribers.empty()){return nPacketsLost;}
+        // Read the clocks once for every subscriber's copy
+        const auto outboundPacket = makeOutboundPacket(packet,
+                                                       ingestTime,
+                                                       mClock->now(),
+                                                       trace,
+                                                       deliveryReceipt);
+        for (auto &subscriber : mSubscribers)
+        {
+            try
+            {
+#ifndef NDEBUG
+                assert(subscriber.second != nullptr);
+#endif
+                nPacketsLost = nPacketsLost
+                             + subscriber.second->enqueuePacket(
+                                   OutboundPacket {outboundPacket});
+            }
+            catch (const std::exception &e)
+            {
+                errorMessages.append(std::string {e.what()});
+                //SPDLOG_LOGGER_ERROR(mLogger,
+                //     "Subscription manager failed to enqueue packet because {}",
+                //     std::string {e.what()}); 
+            } 
+        }
+        }
+        if (!errorMessages.empty())
+        {
+            RATE_LIMITED_LOGGER_ERROR(mLogger,
+               "Subscription manager failed to enqueue packet because {}",
+               errorMessages);
+        }
+        return nPacketsLost;
+    } 
+
+    // Get next batch of packets
+    [[nodiscard]] std::vector<OutboundPacket> getNextPackets(
+        const uintptr_t contextAddress,
+        const std::string &peer,
+        const int maxPackets)
+    {
+        std::vector<OutboundPacket> result;
+        result.reserve(8);
+        if (!mKeepRunning.load()){return result;}
+        bool exists{false};
+        {   
+        const std::lock_guard<std::mutex> lock(mMutex);
+        auto idx = mSubscribers.find(contextAddress);
+        if (idx != mSubscribers.end())
+        {
+            exists = true;
+            for (int i = 0; i < maxPackets; ++i)
+            {
+                auto packet = idx->second->dequeuePacket();
+                if (packet)
+                {
+                    result.push_back(std::move(*packet));
+                }
+                else
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            exists = false;
+        }
+        }
+        if (!exists)
+        {
+            auto errorMessage = peer + " was not found in subscriber map"; 
+            throw std::runtime_error(errorMessage);
+        }
+        return result;
+    }
+
+    mutable std::mutex mMutex;
+    std::shared_ptr<spdlog::logger> mLogger{nullptr};
+    std::shared_ptr<UDataPacketImportProxy::Utilities::Clock> mClock{nullptr};
+    //oneapi::tbb::concurrent_map<uintptr_t, std::unique_ptr<PacketStream>> mSubscribers;
+    std::map<uintptr_t, std::unique_ptr<PacketStream>> mSubscribers;
+    int mQueueCapacity{124};
+    BackendOptions::SlowConsumerPolicy mPolicy{BackendOptions::SlowConsumerPolicy::DropOldest};
+    std::atomic<bool> mKeepRunning{true};
+};
+
+}
+#endif
@@ -0,0 +1,138 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_TIMER_WHEEL_HPP
+#define UDATA_PACKET_IMPORT_PROXY_TIMER_WHEEL_HPP
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+namespace UDataPacketImportProxy
+{
+/// @brief A hashed timing wheel.  Deadlines are hashed into fixed-width
+///        slots so that scheduling is O(1) and advancing the wheel only
+///        visits the slots that elapsed.  Deadlines beyond the wheel's
+///        horizon simply stay in their slot until a later revolution.
+/// @note The wheel keeps time only through the times it is given so it
+///       works with any epoch, e.g., a simulated clock that starts at
+///       time_point{}.
+/// @note Entries are never cancelled.  Callers that reschedule a key should
+///       verify on expiry that the key is actually due.
+/// @note This is not thread safe.
+template<typename Key>
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// @param[in] resolution  The width of a slot.
+    /// @param[in] nSlots      The number of slots in the wheel.
+    /// @param[in] now         The current time.  If not given the wheel
+    ///                        starts at the earliest time it is scheduled
+    ///                        for or advanced to.
+    TimerWheel(const std::chrono::microseconds resolution,
+               const int nSlots,
+               const std::optional<Clock::time_point> now = std::nullopt) :
+        mResolution(resolution)
+    {
+        if (resolution.count() <= 0)
+        {
+            throw std::invalid_argument("Resolution must be positive");
+        }
+        if (nSlots < 1)
+        {
+            throw std::invalid_argument("Number of slots must be positive");
+        }
+        mSlots.resize(static_cast<size_t> (nSlots));
+        if (now)
+        {
+            mCurrentTick = toTick(*now);
+            mHaveCurrentTick = true;
+        }
+    }
+
+    /// @brief Schedules the key to expire at the deadline.
+    void schedule(const Key &key, const Clock::time_point deadline)
+    {
+        auto tick = toTick(deadline);
+        if (!mHaveCurrentTick)
+        {
+            // Nothing has been visited yet so start at the earliest deadline
+            mCurrentTick = mSize == 0 ? tick : std::min(mCurrentTick, tick);
+        }
+        tick = std::max(tick, mCurrentTick);
+        mSlots[static_cast<size_t> (tick) % mSlots.size()]
+            .emplace_back(key, deadline);
+        mSize = mSize + 1;
+    }
+
+    /// @brief Advances the wheel to now.
+    /// @param[in] now       The current time.
+    /// @param[out] expired  The keys whose deadlines have elapsed are
+    ///                      appended to this.
+    void advance(const Clock::time_point now, std::vector<Key> &expired)
+    {
+        const auto nowTick = toTick(now);
+        if (!mHaveCurrentTick)
+        {
+            mCurrentTick
+                = mSize == 0 ? nowTick : std::min(mCurrentTick, nowTick);
+            mHaveCurrentTick = true;
+        }
+        if (mSize == 0)
+        {
+            mCurrentTick = std::max(mCurrentTick, nowTick);
+            return;
+        }
+        if (nowTick < mCurrentTick){return;}
+        // Visiting every slot once is sufficient no matter how far we jump
+        auto nTicks = std::min<int64_t> (nowTick - mCurrentTick + 1,
+                                         static_cast<int64_t> (mSlots.size()));
+        for (int64_t i = 0; i < nTicks; ++i)
+        {
+            auto &slot
+                = mSlots[static_cast<size_t> (mCurrentTick + i) % mSlots.size()];
+            size_t nKeep{0};
+            for (size_t j = 0; j < slot.size(); ++j)
+            {
+                if (slot[j].second <= now)
+                {
+                    expired.push_back(std::move(slot[j].first));
+                    mSize = mSize - 1;
+                }
+                else
+                {
+                    if (nKeep != j){slot[nKeep] = std::move(slot[j]);}
+                    nKeep = nKeep + 1;
+                }
+            }
+            slot.resize(nKeep);
+        }
+        mCurrentTick = nowTick;
+    }
+
+    /// @result The number of scheduled entries.
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return mSize;
+    }
+
+    /// @result True indicates nothing is scheduled.
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return mSize == 0;
+    }
+private:
+    [[nodiscard]] int64_t toTick(const Clock::time_point time) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>
+               (time.time_since_epoch()).count()/mResolution.count();
+    }
+    std::vector<std::vector<std::pair<Key, Clock::time_point>>> mSlots;
+    std::chrono::microseconds mResolution{1000};
+    int64_t mCurrentTick{0};
+    size_t mSize{0};
+    bool mHaveCurrentTick{false};
+};
+}
+#endif
@@ -0,0 +1,247 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <opentelemetry/nostd/shared_ptr.h>
+#include <opentelemetry/nostd/string_view.h>
+#include <opentelemetry/trace/provider.h>
+#include <opentelemetry/trace/span.h>
+#include <opentelemetry/trace/span_context.h>
+#include <opentelemetry/trace/span_startoptions.h>
+#include <opentelemetry/trace/tracer.h>
+#include <opentelemetry/trace/tracer_provider.h>
+#include <opentelemetry/exporters/otlp/otlp_http.h>
+#include <opentelemetry/exporters/otlp/otlp_http_exporter_factory.h>
+#include <opentelemetry/exporters/otlp/otlp_http_exporter_options.h>
+#ifdef WITH_OTLP_GRPC
+#include <opentelemetry/exporters/otlp/otlp_grpc_exporter_factory.h>
+#include <opentelemetry/exporters/otlp/otlp_grpc_exporter_options.h>
+#endif
+#include <opentelemetry/sdk/trace/batch_span_processor_factory.h>
+#include <opentelemetry/sdk/trace/batch_span_processor_options.h>
+#include <opentelemetry/sdk/trace/exporter.h>
+#include <opentelemetry/sdk/trace/provider.h>
+#include <opentelemetry/sdk/trace/tracer_provider.h>
+#include <opentelemetry/sdk/trace/tracer_provider_factory.h>
+#include "tracing.hpp"
+
+using namespace UDataPacketImportProxy::Tracing;
+
+struct Trace::Context
+{
+    Context(opentelemetry::nostd::shared_ptr<opentelemetry::trace::Tracer> tracerIn,
+            opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> spanIn) :
+        tracer(std::move(tracerIn)),
+        span(std::move(spanIn))
+    {
+    }
+    ~Context()
+    {
+        span->End();
+    }
+    Context(const Context &) = delete;
+    Context& operator=(const Context &) = delete;
+    opentelemetry::nostd::shared_ptr<opentelemetry::trace::Tracer> tracer;
+    opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> span;
+};
+
+struct Span::Impl
+{
+    opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> span;
+};
+
+namespace
+{
+
+constexpr std::string_view tracerName{"uDataPacketImportProxy"};
+
+std::atomic<int64_t> samplingPeriod{0};
+std::mutex tracerMutex;
+std::shared_ptr<opentelemetry::sdk::trace::TracerProvider> tracerProvider{nullptr};
+opentelemetry::nostd::shared_ptr<opentelemetry::trace::Tracer> tracer{nullptr};
+
+/// The tracer from the provider set by initialize or, when tracing was not
+/// initialized, the global provider's - which is a no-op by default.  This
+/// is only called for sampled packets so the lock is uncontended.
+[[nodiscard]]
+opentelemetry::nostd::shared_ptr<opentelemetry::trace::Tracer> getTracer()
+{
+    const std::lock_guard<std::mutex> lock(tracerMutex);
+    if (tracer == nullptr)
+    {
+        tracer = opentelemetry::trace::Provider::GetTracerProvider()
+                    ->GetTracer(opentelemetry::nostd::string_view
+                                {tracerName.data(), tracerName.size()});
+    }
+    return tracer;
+}
+
+/// Batches spans for export rather than exporting each span synchronously
+/// from the thread that ended it
+void setTracerProvider(
+    std::unique_ptr<opentelemetry::sdk::trace::SpanExporter> &&exporter)
+{
+    namespace otel = opentelemetry;
+    otel::sdk::trace::BatchSpanProcessorOptions processorOptions;
+    processorOptions.max_queue_size = 2048;
+    processorOptions.max_export_batch_size = 512;
+    processorOptions.schedule_delay_millis = std::chrono::milliseconds {5000};
+    auto processor
+        = otel::sdk::trace::BatchSpanProcessorFactory::Create(
+             std::move(exporter), processorOptions);
+    std::shared_ptr<otel::sdk::trace::TracerProvider> provider
+        = otel::sdk::trace::TracerProviderFactory::Create(std::move(processor));
+    const std::shared_ptr<otel::trace::TracerProvider> apiProvider = provider;
+    otel::sdk::trace::Provider::SetTracerProvider(apiProvider);
+    const std::lock_guard<std::mutex> lock(tracerMutex);
+    tracerProvider = std::move(provider);
+    tracer = tracerProvider->GetTracer(otel::nostd::string_view
+                                       {tracerName.data(), tracerName.size()});
+}
+
+}
+
+/// Sampling period
+void UDataPacketImportProxy::Tracing::setSamplingPeriod(
+    const int64_t samplingPeriodIn)
+{
+    if (samplingPeriodIn < 0)
+    {
+        throw std::invalid_argument("Sampling period cannot be negative");
+    }
+    ::samplingPeriod.store(samplingPeriodIn, std::memory_order_relaxed);
+}
+
+int64_t UDataPacketImportProxy::Tracing::getSamplingPeriod() noexcept
+{
+    return ::samplingPeriod.load(std::memory_order_relaxed);
+}
+
+/// The countdown reached zero
+bool UDataPacketImportProxy::Tracing::Detail::resetCountdown() noexcept
+{
+    const auto period = ::samplingPeriod.load(std::memory_order_relaxed);
+    if (period < 1)
+    {
+        // Disabled - don't come back here
+        countdown = std::numeric_limits<int64_t>::max();
+        return false;
+    }
+    countdown = period;
+    return true;
+}
+
+/// Initialize
+void UDataPacketImportProxy::Tracing::initialize(
+    const OTelOptions::HTTPTraces &options,
+    const int64_t samplingPeriodIn)
+{
+    setSamplingPeriod(samplingPeriodIn);
+    namespace otel = opentelemetry;
+    otel::exporter::otlp::OtlpHttpExporterOptions exporterOptions;
+    exporterOptions.url = options.url + options.suffix;
+    exporterOptions.content_type
+        = otel::exporter::otlp::HttpRequestContentType::kBinary;
+    ::setTracerProvider(
+        otel::exporter::otlp::OtlpHttpExporterFactory::Create(exporterOptions));
+}
+
+void UDataPacketImportProxy::Tracing::initialize(
+    [[maybe_unused]] const OTelOptions::GRPCTraces &options,
+    const int64_t samplingPeriodIn)
+{
+#ifdef WITH_OTLP_GRPC
+    setSamplingPeriod(samplingPeriodIn);
+    namespace otel = opentelemetry;
+    otel::exporter::otlp::OtlpGrpcExporterOptions exporterOptions;
+    exporterOptions.endpoint = options.url;
+    exporterOptions.use_ssl_credentials = false;
+    if (!options.certificatePath.empty())
+    {
+        exporterOptions.use_ssl_credentials = true;
+        exporterOptions.ssl_credentials_cacert_path = options.certificatePath;
+    }
+    ::setTracerProvider(
+        otel::exporter::otlp::OtlpGrpcExporterFactory::Create(exporterOptions));
+#else
+    if (samplingPeriodIn > 0)
+    {
+        throw std::runtime_error("Recompile with Conan and OTLP_GRPC");
+    }
+#endif
+}
+
+/// Cleanup
+void UDataPacketImportProxy::Tracing::cleanup()
+{
+    ::samplingPeriod.store(0, std::memory_order_relaxed);
+    std::shared_ptr<opentelemetry::sdk::trace::TracerProvider> provider;
+    {
+    const std::lock_guard<std::mutex> lock(::tracerMutex);
+    provider = ::tracerProvider;
+    }
+    if (provider)
+    {
+        provider->ForceFlush();
+        provider->Shutdown();
+    }
+}
+
+/// Starts the packet's root span
+Trace Trace::start(const std::string_view publisher) noexcept
+{
+    Trace result;
+    try
+    {
+        namespace otel = opentelemetry;
+        auto packetTracer = ::getTracer();
+        otel::trace::StartSpanOptions options;
+        // Each packet is its own trace
+        options.parent = otel::trace::SpanContext::GetInvalid();
+        options.kind = otel::trace::SpanKind::kServer;
+        auto span
+            = packetTracer->StartSpan(
+                 "packet",
+                 {{"publisher",
+                   otel::nostd::string_view {publisher.data(),
+                                             publisher.size()}}},
+                 options);
+        result.mContext
+            = std::make_shared<Context> (std::move(packetTracer),
+                                         std::move(span));
+    }
+    catch (...)
+    {
+        result.mContext = nullptr;
+    }
+    return result;
+}
+
+/// Starts a stage's span
+void Span::start(const Trace &trace, const char *name) noexcept
+{
+    try
+    {
+        opentelemetry::trace::StartSpanOptions options;
+        options.parent = trace.mContext->span->GetContext();
+        mImpl = new Impl{trace.mContext->tracer->StartSpan(name, options)};
+    }
+    catch (...)
+    {
+        mImpl = nullptr;
+    }
+}
+
+/// Ends a stage's span
+void Span::finish() noexcept
+{
+    mImpl->span->End();
+    delete mImpl;
+    mImpl = nullptr;
+}
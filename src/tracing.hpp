@@ -0,0 +1,158 @@
+#ifndef UDATA_PACKET_IMPORT_PROXY_TRACING_HPP
+#define UDATA_PACKET_IMPORT_PROXY_TRACING_HPP
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include "otelOptions.hpp"
+/// @brief Head-sampled OpenTelemetry tracing of packets through the proxy.
+///        The frontend decides whether to trace a packet when the packet is
+///        read.  A sampled packet carries its trace through the import queue
+///        and the subscriber queues and each stage - read, normalize,
+///        enqueue, dedup, fanout, and write - records a child span.  An
+///        unsampled packet carries an empty trace so every stage costs a
+///        single, well-predicted branch.
+/// @copyright Ben Baker (University of Utah) distributed under the
+///            MIT NO AI license.
+namespace UDataPacketImportProxy::Tracing
+{
+
+/// @brief Sets the sampling period - i.e., one in every samplingPeriod
+///        packets is traced.  A period of 0 disables tracing.  This is
+///        per frontend thread and only affects threads that have not yet
+///        read a packet so it should be called at startup.
+/// @throws std::invalid_argument if this is negative.
+void setSamplingPeriod(int64_t samplingPeriod);
+/// @result The sampling period.  0 indicates tracing is disabled.
+[[nodiscard]] int64_t getSamplingPeriod() noexcept;
+
+/// @brief Sends spans to an OTLP/HTTP collector and sets the sampling period.
+void initialize(const OTelOptions::HTTPTraces &options,
+                int64_t samplingPeriod);
+/// @brief Sends spans to an OTLP/gRPC collector and sets the sampling period.
+/// @throws std::runtime_error if not compiled with WITH_OTLP_GRPC.
+void initialize(const OTelOptions::GRPCTraces &options,
+                int64_t samplingPeriod);
+/// @brief Disables tracing and flushes the spans waiting to be exported.
+void cleanup();
+
+namespace Detail
+{
+/// @result True if the next packet should be traced.
+[[nodiscard]] bool resetCountdown() noexcept;
+inline thread_local int64_t countdown{1};
+}
+
+/// @brief The trace of a sampled packet.  The packet's root span ends when
+///        the last copy of the trace - e.g., the one held by the slowest
+///        subscriber's queue - is destroyed.
+class Trace
+{
+public:
+    /// @brief An empty trace.
+    Trace() = default;
+    /// @result A trace for one in every sampling period packets read by the
+    ///         calling thread and an empty trace otherwise.
+    [[nodiscard]] static Trace sample(std::string_view publisher)
+    {
+        if (--Detail::countdown == 0 && Detail::resetCountdown()) [[unlikely]]
+        {
+            return start(publisher);
+        }
+        return Trace{};
+    }
+    /// @result True indicates the packet is being traced.
+    [[nodiscard]] bool isSampled() const noexcept
+    {
+        return mContext != nullptr;
+    }
+    /// @result True indicates the packet is being traced.
+    [[nodiscard]] explicit operator bool() const noexcept
+    {
+        return isSampled();
+    }
+    struct Context;
+private:
+    [[nodiscard]] static Trace start(std::string_view publisher) noexcept;
+    friend class Span;
+    std::shared_ptr<Context> mContext{nullptr};
+};
+
+/// @brief A child span of a packet's trace that covers one stage of the
+///        pipeline.  The span ends when end() is called or when it is
+///        destroyed.  A span of an empty trace does nothing.
+class Span
+{
+public:
+    Span() = default;
+    Span(const Trace &trace, const char *name) noexcept
+    {
+        if (trace) [[unlikely]] {start(trace, name);}
+    }
+    Span(Span &&span) noexcept
+    {
+        *this = std::move(span);
+    }
+    Span& operator=(Span &&span) noexcept
+    {
+        if (&span == this){return *this;}
+        end();
+        mImpl = span.mImpl;
+        span.mImpl = nullptr;
+        return *this;
+    }
+    /// @brief Ends the span.
+    void end() noexcept
+    {
+        if (mImpl) [[unlikely]] {finish();}
+    }
+    ~Span()
+    {
+        end();
+    }
+    Span(const Span &) = delete;
+    Span& operator=(const Span &) = delete;
+private:
+    void start(const Trace &trace, const char *name) noexcept;
+    void finish() noexcept;
+    struct Impl;
+    Impl *mImpl{nullptr};
+};
+
+namespace Detail
+{
+inline thread_local const Trace *currentTrace{nullptr};
+inline const Trace emptyTrace{};
+}
+
+/// @brief Makes a trace the calling thread's current trace until this goes
+///        out of scope.  This carries the trace across the frontend's
+///        callback and the backend's enqueue which only take a packet.
+class Scope
+{
+public:
+    explicit Scope(const Trace &trace) noexcept :
+        mPrevious(Detail::currentTrace)
+    {
+        Detail::currentTrace = &trace;
+    }
+    ~Scope()
+    {
+        Detail::currentTrace = mPrevious;
+    }
+    Scope(const Scope &) = delete;
+    Scope& operator=(const Scope &) = delete;
+private:
+    const Trace *mPrevious{nullptr};
+};
+
+/// @result The calling thread's current trace.  This is empty outside of a
+///         scope.
+[[nodiscard]] inline const Trace &current() noexcept
+{
+    return Detail::currentTrace != nullptr ?
+           *Detail::currentTrace : Detail::emptyTrace;
+}
+
+}
+#endif
@@ -0,0 +1,294 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <google/protobuf/util/time_util.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/logger.h>
+#include <spdlog/sinks/null_sink.h>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
+#include "uDataPacketImportProxy/backendOptions.hpp"
+#include "uDataPacketImportProxy/duplicatePacketDetector.hpp"
+#include "streamIdentifier.hpp"
+#include "subscriptionManager.hpp"
+#include "tracing.hpp"
+#include "packetUtilities.hpp"
+
+// Micro-benchmarks of the proxy's hot paths.  Write the results as JSON with
+//   ./proxyBenchmarks --reporter JSON::out=proxyBenchmarks.json
+// or build the runProxyBenchmarks target.
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+[[nodiscard]] std::shared_ptr<spdlog::logger> createQuietLogger()
+{
+    return std::make_shared<spdlog::logger>
+           ("benchmarks", std::make_shared<spdlog::sinks::null_sink_mt> ());
+}
+
+/// A packet with 400 doubles - i.e., 4 s of 100 Hz data
+[[nodiscard]] UDataPacketImportAPI::V1::Packet createDoublePacket()
+{
+    std::vector<double> data(400);
+    for (int i = 0; i < static_cast<int> (data.size()); ++i)
+    {
+        data[i] = std::sin(0.01*i);
+    }
+    auto packet = ::generatePackets(1).at(0);
+    packet.set_data_type(UDataPacketImportAPI::V1::DATA_TYPE_DOUBLE);
+    packet.set_number_of_samples(static_cast<int> (data.size()));
+    packet.set_data(::pack(data));
+    return packet;
+}
+
+/// The packet header the duplicate detector sees for the round'th 1 s packet
+/// of the stream'th station.  The data is irrelevant so it is left empty.
+[[nodiscard]] UDataPacketImportAPI::V1::Packet
+    createHeader(const int stream, const int round)
+{
+    constexpr double samplingRate{100};
+    constexpr int64_t originMuS{1700000000000000};
+    constexpr int nSamples{100};
+    UDataPacketImportAPI::V1::Packet packet;
+    auto identifier = packet.mutable_stream_identifier();
+    identifier->set_network("UU");
+    identifier->set_station("S" + std::to_string(stream));
+    identifier->set_channel("HHZ");
+    identifier->set_location_code("01");
+    *packet.mutable_start_time()
+        = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(
+             originMuS + static_cast<int64_t> (round)*1000000);
+    packet.set_sampling_rate(samplingRate);
+    packet.set_number_of_samples(nSamples);
+    packet.set_data_type(UDataPacketImportAPI::V1::DATA_TYPE_INTEGER_32);
+    return packet;
+}
+
+enum class Mix
+{
+    InOrder,    /*!< Each stream's packets arrive in order. */
+    OutOfOrder, /*!< Each stream's packets arrive in swapped pairs. */
+    Duplicates  /*!< Each packet arrives twice. */
+};
+
+/// Creates nPackets packets that cycle through the streams.  Round 0 is
+/// reserved for warming up the detector.
+[[nodiscard]] std::vector<UDataPacketImportAPI::V1::Packet>
+    createHeaders(const int nStreams, const int nPackets, const Mix mix)
+{
+    std::vector<UDataPacketImportAPI::V1::Packet> packets;
+    packets.reserve(nPackets);
+    for (int i = 0; i < nPackets; ++i)
+    {
+        if (mix == Mix::Duplicates)
+        {
+            // 1, 1, 2, 2, ...
+            packets.push_back(::createHeader((i/2)%nStreams,
+                                             1 + i/(2*nStreams)));
+            continue;
+        }
+        auto round = 1 + i/nStreams;
+        if (mix == Mix::OutOfOrder)
+        {
+            // 2, 1, 4, 3, ...
+            round = round%2 == 1 ? round + 1 : round - 1;
+        }
+        packets.push_back(::createHeader(i%nStreams, round));
+    }
+    return packets;
+}
+
+}
+
+TEST_CASE("UDataPacketImportProxy::Benchmarks::Normalization",
+          "[benchmark][normalization]")
+{
+    UDataPacketImportAPI::V1::StreamIdentifier messyIdentifier;
+    messyIdentifier.set_network(" uu");
+    messyIdentifier.set_station("ctu ");
+    messyIdentifier.set_channel(" hhz ");
+    messyIdentifier.set_location_code("  ");
+    auto cleanIdentifier = messyIdentifier;
+    REQUIRE(normalizeStreamIdentifier(&cleanIdentifier));
+    REQUIRE(cleanIdentifier.station() == "CTU");
+    REQUIRE(cleanIdentifier.location_code() == "--");
+
+    BENCHMARK_ADVANCED("Normalize messy identifier")
+        (Catch::Benchmark::Chronometer meter)
+    {
+        std::vector<UDataPacketImportAPI::V1::StreamIdentifier>
+            identifiers(meter.runs(), messyIdentifier);
+        meter.measure([&identifiers](const int i)
+        {
+            return normalizeStreamIdentifier(&identifiers[i]);
+        });
+    };
+
+    BENCHMARK_ADVANCED("Normalize clean identifier")
+        (Catch::Benchmark::Chronometer meter)
+    {
+        std::vector<UDataPacketImportAPI::V1::StreamIdentifier>
+            identifiers(meter.runs(), cleanIdentifier);
+        meter.measure([&identifiers](const int i)
+        {
+            return normalizeStreamIdentifier(&identifiers[i]);
+        });
+    };
+}
+
+TEST_CASE("UDataPacketImportProxy::Benchmarks::DuplicatePacketDetector",
+          "[benchmark][duplicatePacketDetector]")
+{
+    const std::vector<std::pair<Mix, std::string>> mixes
+    {
+        {Mix::InOrder,    "in order"},
+        {Mix::OutOfOrder, "out of order"},
+        {Mix::Duplicates, "duplicates"}
+    };
+    DuplicatePacketDetectorOptions options;
+    options.setCircularBufferSize(30);
+    for (const int nStreams : {1000, 10000})
+    {
+        for (const auto &[mix, mixName] : mixes)
+        {
+            BENCHMARK_ADVANCED("Allow " + mixName + " with "
+                             + std::to_string(nStreams) + " streams")
+                (Catch::Benchmark::Chronometer meter)
+            {
+                // Register every stream so the benchmark measures the
+                // steady state rather than the creation of circular buffers
+                DuplicatePacketDetector detector{options};
+                for (int stream = 0; stream < nStreams; ++stream)
+                {
+                    static_cast<void> (detector.allow(
+                        ::createHeader(stream, 0)));
+                }
+                const auto packets
+                    = ::createHeaders(nStreams, meter.runs(), mix);
+                meter.measure([&detector, &packets](const int i)
+                {
+                    return detector.allow(packets[i]);
+                });
+            };
+        }
+    }
+}
+
+TEST_CASE("UDataPacketImportProxy::Benchmarks::PacketStream",
+          "[benchmark][packetStream]")
+{
+    const auto logger = ::createQuietLogger();
+    const auto packet = ::createDoublePacket();
+    const Tracing::Trace trace;
+
+    BENCHMARK_ADVANCED("Enqueue and dequeue")
+        (Catch::Benchmark::Chronometer meter)
+    {
+        PacketStream stream{1024,
+                            BackendOptions::SlowConsumerPolicy::DropOldest,
+                            nullptr,
+                            logger};
+        const auto ingestTime = std::chrono::steady_clock::now();
+        meter.measure([&]()
+        {
+            static_cast<void> (stream.enqueuePacket(packet, ingestTime, trace));
+            return stream.dequeuePacket();
+        });
+    };
+
+    BENCHMARK_ADVANCED("Enqueue into a full queue")
+        (Catch::Benchmark::Chronometer meter)
+    {
+        constexpr int queueCapacity{64};
+        PacketStream stream{queueCapacity,
+                            BackendOptions::SlowConsumerPolicy::DropOldest,
+                            nullptr,
+                            logger};
+        const auto ingestTime = std::chrono::steady_clock::now();
+        for (int i = 0; i < queueCapacity; ++i)
+        {
+            static_cast<void> (stream.enqueuePacket(packet, ingestTime, trace));
+        }
+        meter.measure([&]()
+        {
+            return stream.enqueuePacket(packet, ingestTime, trace);
+        });
+    };
+}
+
+TEST_CASE("UDataPacketImportProxy::Benchmarks::SubscriptionManager",
+          "[benchmark][subscriptionManager]")
+{
+    const auto logger = ::createQuietLogger();
+    const auto packet = ::createDoublePacket();
+    for (const int nSubscribers : {1, 8, 64})
+    {
+        SubscriptionManager manager{
+            1024, BackendOptions::SlowConsumerPolicy::DropOldest, logger};
+        std::vector<std::pair<uintptr_t, std::string>> subscribers;
+        for (int i = 0; i < nSubscribers; ++i)
+        {
+            // N.B. The address only has to be unique
+            subscribers.emplace_back(static_cast<uintptr_t> (i + 1),
+                                     "subscriber" + std::to_string(i));
+            manager.subscribe(subscribers.back().first,
+                              subscribers.back().second,
+                              nullptr);
+        }
+        REQUIRE(manager.getNumberOfSubscribers() == nSubscribers);
+
+        // Each subscriber's writer drains its queue as the packets arrive
+        BENCHMARK("Fan-out to " + std::to_string(nSubscribers)
+                + " subscribers")
+        {
+            auto nLost
+                = manager.enqueuePacket(packet,
+                                        std::chrono::steady_clock::now());
+            for (const auto &[address, peer] : subscribers)
+            {
+                nLost = nLost
+                      + static_cast<int>
+                        (manager.getNextPackets(address, peer, 1).size());
+            }
+            return nLost;
+        };
+        manager.unsubscribeAll();
+    }
+}
+
+TEST_CASE("UDataPacketImportProxy::Benchmarks::ProtobufCopyVersusMove",
+          "[benchmark][protobuf]")
+{
+    const auto packet = ::createDoublePacket();
+
+    BENCHMARK_ADVANCED("Copy packet")(Catch::Benchmark::Chronometer meter)
+    {
+        std::vector<UDataPacketImportAPI::V1::Packet> packets(meter.runs(),
+                                                              packet);
+        meter.measure([&packets](const int i)
+        {
+            UDataPacketImportAPI::V1::Packet copy{packets[i]};
+            return copy.number_of_samples();
+        });
+    };
+
+    BENCHMARK_ADVANCED("Move packet")(Catch::Benchmark::Chronometer meter)
+    {
+        std::vector<UDataPacketImportAPI::V1::Packet> packets(meter.runs(),
+                                                              packet);
+        meter.measure([&packets](const int i)
+        {
+            UDataPacketImportAPI::V1::Packet moved{std::move(packets[i])};
+            return moved.number_of_samples();
+        });
+    };
+}
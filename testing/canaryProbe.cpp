@@ -0,0 +1,451 @@
+import programOptions;
+import metrics;
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <opentelemetry/metrics/meter_provider.h>
+#include <opentelemetry/metrics/provider.h>
+#include <spdlog/fmt/fmt.h>
+#include "canaryProbe.hpp"
+
+/// Continuously measures the latency and loss of a running proxy by
+/// publishing canary packets to its frontend and subscribing to its backend
+/// for them.  The probe exports its own metrics so that the proxy can be
+/// alerted on independently of the proxy's instrumentation.
+
+namespace
+{
+
+std::atomic<bool> mInterrupted{false};
+
+void signalHandler(const int )
+{
+    mInterrupted.store(true);
+}
+
+struct Options
+{
+    ::CanaryProbeOptions probeOptions;
+    std::string applicationName{"uDataPacketImportCanary"};
+    std::string metricsURL;
+    std::chrono::seconds metricsInterval{15};
+    std::chrono::seconds reportInterval{60};
+    std::chrono::seconds duration{0};
+};
+
+[[nodiscard]] std::optional<::Options>
+    parseCommandLine(int argc, char *argv[])
+{
+    ::Options options;
+    auto &probeOptions = options.probeOptions;
+    int64_t interval{probeOptions.interval.count()};
+    int64_t lossTimeOut{probeOptions.lossTimeOut.count()};
+    int64_t metricsInterval{options.metricsInterval.count()};
+    int64_t reportInterval{options.reportInterval.count()};
+    int64_t duration{options.duration.count()};
+    boost::program_options::options_description description(R"""(
+The uDataPacketImportCanary publishes canary packets on a dedicated stream
+to a uDataPacketImportProxy's frontend and subscribes to its backend for
+them.  It reports the round-trip latency and the canaries lost, and can
+export these as OpenTelemetry metrics.
+
+Example usage:
+    uDataPacketImportCanary --frontend localhost:50000 --backend localhost:50001 --metrics-url localhost:4318
+
+Allowed options)""");
+    description.add_options()
+        ("help", "Produces this help message")
+        ("frontend", boost::program_options::value<std::string>
+                     (&probeOptions.frontendAddress)->default_value(probeOptions.frontendAddress),
+         "The proxy frontend's address")
+        ("backend", boost::program_options::value<std::string>
+                    (&probeOptions.backendAddress)->default_value(probeOptions.backendAddress),
+         "The proxy backend's address")
+        ("token", boost::program_options::value<std::string>
+                  (&probeOptions.accessToken),
+         "The access token sent in the x-custom-auth-token header")
+        ("network", boost::program_options::value<std::string>
+                    (&probeOptions.network)->default_value(probeOptions.network),
+         "The canary stream's network code")
+        ("station", boost::program_options::value<std::string>
+                    (&probeOptions.station)->default_value(probeOptions.station),
+         "The canary stream's station name")
+        ("channel", boost::program_options::value<std::string>
+                    (&probeOptions.channel)->default_value(probeOptions.channel),
+         "The canary stream's channel code")
+        ("location", boost::program_options::value<std::string>
+                     (&probeOptions.locationCode)->default_value(probeOptions.locationCode),
+         "The canary stream's location code")
+        ("interval", boost::program_options::value<int64_t>
+                     (&interval)->default_value(interval),
+         "Milliseconds between canaries")
+        ("loss-timeout", boost::program_options::value<int64_t>
+                         (&lossTimeOut)->default_value(lossTimeOut),
+         "Milliseconds after which a canary that has not arrived is counted as lost")
+        ("metrics-url", boost::program_options::value<std::string>
+                        (&options.metricsURL),
+         "If set, the OTLP/HTTP collector, e.g., localhost:4318, to which metrics are exported")
+        ("metrics-interval", boost::program_options::value<int64_t>
+                             (&metricsInterval)->default_value(metricsInterval),
+         "Seconds between metric exports")
+        ("name", boost::program_options::value<std::string>
+                 (&options.applicationName)->default_value(options.applicationName),
+         "The name of the meter")
+        ("report-interval", boost::program_options::value<int64_t>
+                            (&reportInterval)->default_value(reportInterval),
+         "Seconds between summaries written to standard out")
+        ("duration", boost::program_options::value<int64_t>
+                     (&duration)->default_value(duration),
+         "Seconds to run for.  0 runs until interrupted");
+    boost::program_options::variables_map vm;
+    boost::program_options::store(
+        boost::program_options::parse_command_line(argc, argv, description),
+        vm);
+    boost::program_options::notify(vm);
+    if (vm.count("help"))
+    {
+        std::cout << description << std::endl;
+        return std::nullopt;
+    }
+    if (metricsInterval < 1)
+    {
+        throw std::invalid_argument("Metrics interval must be positive");
+    }
+    if (reportInterval < 1)
+    {
+        throw std::invalid_argument("Report interval must be positive");
+    }
+    if (duration < 0){throw std::invalid_argument("Duration cannot be negative");}
+    probeOptions.interval = std::chrono::milliseconds {interval};
+    probeOptions.lossTimeOut = std::chrono::milliseconds {lossTimeOut};
+    options.metricsInterval = std::chrono::seconds {metricsInterval};
+    options.reportInterval = std::chrono::seconds {reportInterval};
+    options.duration = std::chrono::seconds {duration};
+    return options;
+}
+
+[[nodiscard]] double computeQuantile(const std::vector<double> &sortedValues,
+                                     const double quantile)
+{
+    if (sortedValues.empty()){return 0;}
+    auto index
+        = static_cast<size_t> (std::ceil(quantile*static_cast<double> (sortedValues.size())));
+    index = std::clamp<size_t> (index, 1, sortedValues.size());
+    return sortedValues[index - 1];
+}
+
+/// The probe hands its latencies over once.  They are kept here for both
+/// the metrics exporter and the console summary, each of which reports
+/// the latencies since it last looked.
+class Latencies
+{
+public:
+    void add(const std::vector<std::chrono::microseconds> &latencies)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto &latency : latencies)
+        {
+            const auto value = static_cast<double> (latency.count());
+            mForMetrics.push_back(value);
+            mForReport.push_back(value);
+        }
+    }
+    [[nodiscard]] std::vector<double> takeForMetrics()
+    {
+        std::vector<double> result;
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::swap(result, mForMetrics);
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+    [[nodiscard]] std::vector<double> takeForReport()
+    {
+        std::vector<double> result;
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::swap(result, mForReport);
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+private:
+    std::mutex mMutex;
+    std::vector<double> mForMetrics;
+    std::vector<double> mForReport;
+};
+
+/// What the metrics callbacks observe
+struct MetricsState
+{
+    ::CanaryProbe *probe{nullptr};
+    ::Latencies *latencies{nullptr};
+    std::string stream;
+};
+
+template<typename T>
+[[nodiscard]] opentelemetry::nostd::shared_ptr
+<
+    opentelemetry::metrics::ObserverResultT<T>
+> getObserver(opentelemetry::metrics::ObserverResult &observerResult)
+{
+    using ObserverPointer
+        = opentelemetry::nostd::shared_ptr
+          <
+              opentelemetry::metrics::ObserverResultT<T>
+          >;
+    if (opentelemetry::nostd::holds_alternative<ObserverPointer> (observerResult))
+    {
+        return opentelemetry::nostd::get<ObserverPointer> (observerResult);
+    }
+    return ObserverPointer {};
+}
+
+void observeCanaryPackets(opentelemetry::metrics::ObserverResult observerResult,
+                          void *state)
+{
+    auto observer = ::getObserver<int64_t> (observerResult);
+    if (!observer || !state){return;}
+    try
+    {
+        const auto metricsState = static_cast<const ::MetricsState *> (state);
+        const auto statistics = metricsState->probe->getStatistics();
+        const std::array<std::pair<int64_t, const char *>, 4> counts
+        {
+            std::pair {statistics.packetsSent, "sent"},
+            std::pair {statistics.packetsReceived, "received"},
+            std::pair {statistics.packetsLost, "lost"},
+            std::pair {statistics.unexpectedPackets, "unexpected"}
+        };
+        for (const auto &[count, outcome] : counts)
+        {
+            const std::map<std::string, std::string>
+                attributes{ {"stream", metricsState->stream},
+                            {"outcome", outcome} };
+            observer->Observe(count, attributes);
+        }
+    }
+    catch (const std::exception &e)
+    {
+    }
+}
+
+void observeCanaryErrors(opentelemetry::metrics::ObserverResult observerResult,
+                         void *state)
+{
+    auto observer = ::getObserver<int64_t> (observerResult);
+    if (!observer || !state){return;}
+    try
+    {
+        const auto metricsState = static_cast<const ::MetricsState *> (state);
+        const auto statistics = metricsState->probe->getStatistics();
+        std::map<std::string, std::string>
+            attributes{ {"stream", metricsState->stream},
+                        {"service", "frontend"} };
+        observer->Observe(statistics.publisherErrors, attributes);
+        attributes["service"] = "backend";
+        observer->Observe(statistics.subscriberErrors, attributes);
+    }
+    catch (const std::exception &e)
+    {
+    }
+}
+
+/// Intervals without canaries are skipped rather than reported as zero
+/// latency so that an outage cannot look like a fast proxy.
+void observeCanaryLatencies(opentelemetry::metrics::ObserverResult observerResult,
+                            void *state)
+{
+    auto observer = ::getObserver<double> (observerResult);
+    if (!observer || !state){return;}
+    try
+    {
+        const auto metricsState = static_cast<const ::MetricsState *> (state);
+        const auto latencies = metricsState->latencies->takeForMetrics();
+        if (latencies.empty()){return;}
+        constexpr std::array<std::pair<double, const char *>, 4> quantiles
+        {
+            std::pair {0.5, "0.5"},
+            std::pair {0.9, "0.9"},
+            std::pair {0.99, "0.99"},
+            std::pair {1.0, "1"}
+        };
+        std::map<std::string, std::string>
+            attributes{ {"stream", metricsState->stream} };
+        for (const auto &[quantile, name] : quantiles)
+        {
+            attributes["quantile"] = name;
+            observer->Observe(::computeQuantile(latencies, quantile),
+                              attributes);
+        }
+    }
+    catch (const std::exception &e)
+    {
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::optional<::Options> options;
+    try
+    {
+        options = ::parseCommandLine(argc, argv);
+        if (!options){return EXIT_SUCCESS;}
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<::CanaryProbe> probe;
+    try
+    {
+        probe = std::make_unique<::CanaryProbe> (options->probeOptions);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    ::Latencies latencies;
+    ::MetricsState metricsState{probe.get(), &latencies, probe->getStreamName()};
+
+    // The probe's metrics go through the same exporter set-up as the proxy's
+    opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+        packetsCounter;
+    opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+        errorsCounter;
+    opentelemetry::nostd::shared_ptr<opentelemetry::metrics::ObservableInstrument>
+        latencyGauge;
+    if (!options->metricsURL.empty())
+    {
+        try
+        {
+            UDataPacketImportProxy::Options::ProgramOptions programOptions;
+            programOptions.applicationName = options->applicationName;
+            programOptions.exportMetrics = true;
+            programOptions.exportMetricsWithHTTP = true;
+            programOptions.otelHTTPMetricsOptions.url = options->metricsURL;
+            programOptions.otelHTTPMetricsOptions.exportInterval
+                = options->metricsInterval;
+            UDataPacketImportProxy::Metrics::initialize(programOptions);
+
+            auto provider
+                = opentelemetry::metrics::Provider::GetMeterProvider();
+            auto meter = provider->GetMeter(options->applicationName, "1.2.0");
+
+            packetsCounter
+                = meter->CreateInt64ObservableCounter(
+                  "seismic_data.import.grpc_proxy.canary.packets",
+                  "Number of canary packets sent to, received from, and lost by the import proxy",
+                  "{packet}");
+            packetsCounter->AddCallback(::observeCanaryPackets,
+                                        &metricsState);
+
+            errorsCounter
+                = meter->CreateInt64ObservableCounter(
+                  "seismic_data.import.grpc_proxy.canary.connection_errors",
+                  "Number of times the canary probe lost its connection to the import proxy",
+                  "{error}");
+            errorsCounter->AddCallback(::observeCanaryErrors,
+                                       &metricsState);
+
+            latencyGauge
+                = meter->CreateDoubleObservableGauge(
+                  "seismic_data.import.grpc_proxy.canary.latency",
+                  "Round-trip latency quantiles of canary packets through the import proxy over the export interval",
+                  "us");
+            latencyGauge->AddCallback(::observeCanaryLatencies,
+                                      &metricsState);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Failed to initialize metrics because "
+                      << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::signal(SIGINT,  ::signalHandler);
+    std::signal(SIGTERM, ::signalHandler);
+    probe->start();
+    const auto startTime = std::chrono::steady_clock::now();
+    auto nextReport = startTime + options->reportInterval;
+    ::CanaryProbeStatistics reported;
+    auto report = [&]()
+    {
+        const auto statistics = probe->getStatistics();
+        const auto reportLatencies = latencies.takeForReport();
+        std::cout << fmt::format("{}: sent {}, received {}, lost {}, unexpected {}, errors {}; p50 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms",
+                                 metricsState.stream,
+                                 statistics.packetsSent - reported.packetsSent,
+                                 statistics.packetsReceived - reported.packetsReceived,
+                                 statistics.packetsLost - reported.packetsLost,
+                                 statistics.unexpectedPackets - reported.unexpectedPackets,
+                                 statistics.publisherErrors + statistics.subscriberErrors
+                               - reported.publisherErrors - reported.subscriberErrors,
+                                 ::computeQuantile(reportLatencies, 0.5)/1000,
+                                 ::computeQuantile(reportLatencies, 0.99)/1000,
+                                 ::computeQuantile(reportLatencies, 1.0)/1000)
+                  << std::endl;
+        reported = statistics;
+    };
+    while (!mInterrupted.load())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds {250});
+        latencies.add(probe->takeLatencies());
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= nextReport)
+        {
+            report();
+            nextReport = nextReport + options->reportInterval;
+        }
+        if (options->duration.count() > 0 &&
+            now - startTime >= options->duration)
+        {
+            break;
+        }
+    }
+    probe->stop();
+    latencies.add(probe->takeLatencies());
+    if (probe->getStatistics().packetsSent != reported.packetsSent){report();}
+
+    packetsCounter = nullptr;
+    errorsCounter = nullptr;
+    latencyGauge = nullptr;
+    UDataPacketImportProxy::Metrics::cleanup();
+
+    // A timed run, e.g., a smoke test after a deployment, fails if anything
+    // was lost
+    const auto statistics = probe->getStatistics();
+    std::cout << fmt::format("Total: sent {}, received {}, lost {}, unexpected {}, errors {}",
+                             statistics.packetsSent,
+                             statistics.packetsReceived,
+                             statistics.packetsLost,
+                             statistics.unexpectedPackets,
+                             statistics.publisherErrors
+                           + statistics.subscriberErrors)
+              << std::endl;
+    if (options->duration.count() > 0 &&
+        (statistics.packetsLost > 0 || statistics.packetsReceived == 0))
+    {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,406 @@
+#ifndef CANARY_PROBE_HPP
+#define CANARY_PROBE_HPP
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <grpc/grpc.h>
+#include <grpcpp/grpcpp.h>
+#include <google/protobuf/util/time_util.h>
+#include "uDataPacketImportAPI/v1/backend.grpc.pb.h"
+#include "uDataPacketImportAPI/v1/frontend.grpc.pb.h"
+#include "packetUtilities.hpp"
+
+namespace
+{
+
+struct CanaryProbeOptions
+{
+    std::string frontendAddress{"localhost:50000"};
+    std::string backendAddress{"localhost:50001"};
+    std::string accessToken;
+    std::string network{"XX"};
+    std::string station{"CANRY"};
+    std::string channel{"HHZ"};
+    std::string locationCode{"00"};
+    /// A canary is sent every interval and carries an interval of data
+    std::chrono::milliseconds interval{1000};
+    /// A canary not received within this time is counted as lost
+    std::chrono::milliseconds lossTimeOut{10000};
+    /// How long to wait before reconnecting a dropped publisher or subscriber
+    std::chrono::milliseconds reconnectInterval{1000};
+    /// How long the subscriber is given to subscribe before the first
+    /// canary is sent
+    std::chrono::milliseconds startUpDelay{1000};
+};
+
+struct CanaryProbeStatistics
+{
+    int64_t packetsSent{0};
+    int64_t packetsReceived{0};
+    int64_t packetsLost{0};
+    /// Duplicates and canaries that arrived after they were counted as lost
+    int64_t unexpectedPackets{0};
+    int64_t publisherErrors{0};
+    int64_t subscriberErrors{0};
+};
+
+/// Publishes canary packets on a dedicated stream to a proxy's frontend and
+/// subscribes to its backend for them.  This measures the latency from the
+/// publisher's write to the subscriber's read, and the loss, through the
+/// proxy without relying on the proxy's own instrumentation.  Canary k
+/// starts at origin + k*interval so the subscriber identifies a canary by
+/// its start time.  The publisher and subscriber reconnect if the proxy goes
+/// away so the probe can run indefinitely.
+class CanaryProbe
+{
+public:
+    explicit CanaryProbe(const CanaryProbeOptions &options) :
+        mOptions(options)
+    {
+        if (mOptions.frontendAddress.empty())
+        {
+            throw std::invalid_argument("Frontend address not set");
+        }
+        if (mOptions.backendAddress.empty())
+        {
+            throw std::invalid_argument("Backend address not set");
+        }
+        if (mOptions.network.empty() || mOptions.station.empty() ||
+            mOptions.channel.empty())
+        {
+            throw std::invalid_argument(
+                "Network, station, and channel must be set");
+        }
+        if (mOptions.interval.count() <= 0)
+        {
+            throw std::invalid_argument("Interval must be positive");
+        }
+        if (mOptions.lossTimeOut <= mOptions.interval)
+        {
+            throw std::invalid_argument(
+                "Loss time-out must exceed the interval");
+        }
+        if (mOptions.reconnectInterval.count() <= 0)
+        {
+            throw std::invalid_argument("Reconnect interval must be positive");
+        }
+        if (mOptions.startUpDelay.count() < 0)
+        {
+            throw std::invalid_argument("Start-up delay cannot be negative");
+        }
+        // Borrow the data type, sampling rate, and samples from a test
+        // packet and trim it to an interval's worth of samples
+        mTemplate = ::generatePackets(1,
+                                      mOptions.network,
+                                      mOptions.station,
+                                      mOptions.channel,
+                                      mOptions.locationCode).at(0);
+        const auto samplingRate = mTemplate.sampling_rate();
+        const auto nSamples
+            = static_cast<double> (mOptions.interval.count())*samplingRate/1000;
+        const auto samplesPerPacket = std::llround(nSamples);
+        if (samplesPerPacket < 1 ||
+            std::abs(nSamples - static_cast<double> (samplesPerPacket)) > 1.e-8)
+        {
+            throw std::invalid_argument(
+                "Interval must be a whole number of samples");
+        }
+        auto data = mTemplate.data();
+        const auto sampleSize = data.size()/mTemplate.number_of_samples();
+        const auto packetSize = sampleSize*static_cast<size_t> (samplesPerPacket);
+        while (data.size() < packetSize){data = data + data;}
+        data.resize(packetSize);
+        mTemplate.set_data(data);
+        mTemplate.set_number_of_samples(static_cast<uint32_t> (samplesPerPacket));
+    }
+
+    ~CanaryProbe()
+    {
+        stop();
+    }
+
+    /// Starts the subscriber then the publisher
+    void start()
+    {
+        stop();
+        {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPending.clear();
+        mLatencies.clear();
+        mKeepRunning = true;
+        }
+        const auto now = std::chrono::system_clock::now();
+        mOrigin = std::chrono::floor<std::chrono::seconds> (now);
+        mSteadyOrigin = std::chrono::steady_clock::now()
+                      - std::chrono::duration_cast
+                        <std::chrono::steady_clock::duration> (now - mOrigin);
+        mSubscriberThread = std::thread(&CanaryProbe::subscribe, this);
+        mPublisherThread = std::thread(&CanaryProbe::publish, this);
+    }
+
+    /// Stops the probe.  Canaries still in flight are not counted as lost.
+    void stop()
+    {
+        {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mKeepRunning = false;
+        if (mPublisherContext){mPublisherContext->TryCancel();}
+        if (mSubscriberContext){mSubscriberContext->TryCancel();}
+        }
+        mStopCondition.notify_all();
+        if (mPublisherThread.joinable()){mPublisherThread.join();}
+        if (mSubscriberThread.joinable()){mSubscriberThread.join();}
+    }
+
+    [[nodiscard]] CanaryProbeStatistics getStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStatistics;
+    }
+
+    /// @result The round-trip latencies measured since the previous call
+    [[nodiscard]] std::vector<std::chrono::microseconds> takeLatencies()
+    {
+        std::vector<std::chrono::microseconds> result;
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::swap(result, mLatencies);
+        return result;
+    }
+
+    /// @result The canary stream's name, i.e., NET.STA.CHAN.LOC
+    [[nodiscard]] std::string getStreamName() const
+    {
+        return mOptions.network + "." + mOptions.station + "."
+             + mOptions.channel + "." + mOptions.locationCode;
+    }
+private:
+    [[nodiscard]] std::shared_ptr<grpc::Channel>
+        makeChannel(const std::string &address) const
+    {
+        grpc::ChannelArguments arguments;
+        arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+        return grpc::CreateCustomChannel(address,
+                                         grpc::InsecureChannelCredentials(),
+                                         arguments);
+    }
+
+    void addAccessToken(grpc::ClientContext *context) const
+    {
+        if (!mOptions.accessToken.empty())
+        {
+            context->AddMetadata("x-custom-auth-token", mOptions.accessToken);
+        }
+    }
+
+    /// @result True if the probe was stopped while waiting
+    [[nodiscard]] bool waitUntil(
+        const std::chrono::steady_clock::time_point &time)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mStopCondition.wait_until(lock, time,
+                                         [this] {return !mKeepRunning;});
+    }
+
+    [[nodiscard]] std::chrono::steady_clock::time_point
+        getDueTime(const int64_t sequence) const
+    {
+        return mSteadyOrigin + (sequence + 1)*mOptions.interval;
+    }
+
+    [[nodiscard]] UDataPacketImportAPI::V1::Packet
+        makePacket(const int64_t sequence) const
+    {
+        auto packet = mTemplate;
+        const auto startTime = mOrigin + sequence*mOptions.interval;
+        *packet.mutable_start_time()
+            = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(
+                 std::chrono::duration_cast<std::chrono::microseconds>
+                 (startTime.time_since_epoch()).count());
+        return packet;
+    }
+
+    /// Counts the canaries that have been in flight too long as lost
+    void expireLostCanaries(const std::chrono::steady_clock::time_point &now)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        while (!mPending.empty() &&
+               now - mPending.begin()->second > mOptions.lossTimeOut)
+        {
+            mPending.erase(mPending.begin());
+            mStatistics.packetsLost = mStatistics.packetsLost + 1;
+        }
+    }
+
+    void publish()
+    {
+        auto stub
+            = UDataPacketImportAPI::V1::Frontend::NewStub(
+                 makeChannel(mOptions.frontendAddress));
+        const auto firstDueTime
+            = std::chrono::steady_clock::now() + mOptions.startUpDelay;
+        auto sequence
+            = static_cast<int64_t> ((firstDueTime - mSteadyOrigin)
+                                    /mOptions.interval);
+        while (true)
+        {
+            grpc::ClientContext context;
+            addAccessToken(&context);
+            {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mKeepRunning){break;}
+            mPublisherContext = &context;
+            }
+            UDataPacketImportAPI::V1::PublishResponse response;
+            auto writer = stub->Publish(&context, &response);
+            bool connected{true};
+            bool stopped{false};
+            while (connected)
+            {
+                // Skip the canaries that were due while disconnected
+                const auto elapsed
+                    = std::chrono::steady_clock::now() - mSteadyOrigin;
+                sequence = std::max(sequence,
+                                    static_cast<int64_t> (elapsed/mOptions.interval) - 1);
+                stopped = waitUntil(getDueTime(sequence));
+                if (stopped){break;}
+                const auto packet = makePacket(sequence);
+                const auto sendTime = std::chrono::steady_clock::now();
+                expireLostCanaries(sendTime);
+                {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mPending[sequence] = sendTime;
+                }
+                connected = writer->Write(packet);
+                {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (connected)
+                {
+                    mStatistics.packetsSent = mStatistics.packetsSent + 1;
+                }
+                else
+                {
+                    mPending.erase(sequence);
+                    // N.B. Stopping cancels the write
+                    if (mKeepRunning)
+                    {
+                        mStatistics.publisherErrors
+                            = mStatistics.publisherErrors + 1;
+                    }
+                }
+                }
+                sequence = sequence + 1;
+            }
+            if (connected){writer->WritesDone();}
+            writer->Finish();
+            {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPublisherContext = nullptr;
+            }
+            if (stopped){break;}
+            if (waitUntil(std::chrono::steady_clock::now()
+                        + mOptions.reconnectInterval))
+            {
+                break;
+            }
+        }
+    }
+
+    void subscribe()
+    {
+        auto stub
+            = UDataPacketImportAPI::V1::Backend::NewStub(
+                 makeChannel(mOptions.backendAddress));
+        const auto originMicroSeconds
+            = std::chrono::duration_cast<std::chrono::microseconds>
+              (mOrigin.time_since_epoch()).count();
+        const auto interval
+            = std::chrono::duration_cast<std::chrono::microseconds>
+              (mOptions.interval).count();
+        while (true)
+        {
+            grpc::ClientContext context;
+            addAccessToken(&context);
+            {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mKeepRunning){break;}
+            mSubscriberContext = &context;
+            }
+            UDataPacketImportAPI::V1::SubscriptionRequest request;
+            request.set_identifier("canary");
+            auto reader = stub->Subscribe(&context, request);
+            UDataPacketImportAPI::V1::Packet packet;
+            while (reader->Read(&packet))
+            {
+                const auto now = std::chrono::steady_clock::now();
+                const auto &identifier = packet.stream_identifier();
+                if (identifier.network() != mOptions.network ||
+                    identifier.station() != mOptions.station ||
+                    identifier.channel() != mOptions.channel ||
+                    identifier.location_code() != mOptions.locationCode)
+                {
+                    continue;
+                }
+                const auto offset
+                    = google::protobuf::util::TimeUtil::TimestampToMicroseconds(
+                         packet.start_time()) - originMicroSeconds;
+                std::lock_guard<std::mutex> lock(mMutex);
+                auto pending = mPending.end();
+                if (offset >= 0 && offset % interval == 0)
+                {
+                    pending = mPending.find(offset/interval);
+                }
+                if (pending == mPending.end())
+                {
+                    mStatistics.unexpectedPackets
+                        = mStatistics.unexpectedPackets + 1;
+                    continue;
+                }
+                mLatencies.push_back(
+                    std::chrono::duration_cast<std::chrono::microseconds>
+                    (now - pending->second));
+                mPending.erase(pending);
+                mStatistics.packetsReceived = mStatistics.packetsReceived + 1;
+            }
+            reader->Finish();
+            {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mSubscriberContext = nullptr;
+            if (!mKeepRunning){break;}
+            mStatistics.subscriberErrors = mStatistics.subscriberErrors + 1;
+            }
+            if (waitUntil(std::chrono::steady_clock::now()
+                        + mOptions.reconnectInterval))
+            {
+                break;
+            }
+        }
+    }
+
+    CanaryProbeOptions mOptions;
+    UDataPacketImportAPI::V1::Packet mTemplate;
+    mutable std::mutex mMutex;
+    std::condition_variable mStopCondition;
+    std::thread mPublisherThread;
+    std::thread mSubscriberThread;
+    std::map<int64_t, std::chrono::steady_clock::time_point> mPending;
+    std::vector<std::chrono::microseconds> mLatencies;
+    CanaryProbeStatistics mStatistics;
+    std::chrono::system_clock::time_point mOrigin;
+    std::chrono::steady_clock::time_point mSteadyOrigin;
+    grpc::ClientContext *mPublisherContext{nullptr};
+    grpc::ClientContext *mSubscriberContext{nullptr};
+    bool mKeepRunning{false};
+};
+
+}
+
+#endif
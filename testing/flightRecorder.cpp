@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <latch>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <catch2/catch_test_macros.hpp>
+#include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
+#include "flightRecorder.hpp"
+
+namespace
+{
+[[nodiscard]] std::string toString(const std::array<char, 16> &label)
+{
+    return std::string(label.data(),
+                       std::find(label.begin(), label.end(), '\0'));
+}
+}
+
+TEST_CASE("UDataPacketImportProxy::FlightRecorder", "[flightRecorder]")
+{
+    namespace UFR = UDataPacketImportProxy::FlightRecorder;
+    constexpr int eventsPerThread{8};
+    UFR::setEventsPerThread(eventsPerThread);
+
+    UDataPacketImportAPI::V1::StreamIdentifier identifier;
+    identifier.set_network("UU");
+    identifier.set_station("FORK");
+    identifier.set_channel("HHZ");
+    identifier.set_location_code("01");
+
+    // Each thread gets its own ring and only keeps its most recent events.
+    // Both threads hold their rings at once so neither reuses the other's.
+    std::latch running{2};
+    auto recordEvents = [&]()
+    {
+        UFR::record(UFR::EventType::PublisherJoined,
+                    "ipv4:127.0.0.1:4321234", 1);
+        running.arrive_and_wait();
+        for (int i = 0; i < 2*eventsPerThread; ++i)
+        {
+            UFR::record(UFR::EventType::PacketAccepted, identifier, i);
+        }
+        UFR::record(UFR::EventType::PacketRejected, identifier, 1, 3);
+    };
+    std::thread thread1(recordEvents);
+    std::thread thread2(recordEvents);
+    thread1.join();
+    thread2.join();
+
+    const auto directory
+        = std::filesystem::temp_directory_path() / "flightRecorderTest";
+    const auto fileName = UFR::dump(directory);
+    REQUIRE(std::filesystem::exists(fileName));
+    const auto dump = UFR::read(fileName);
+    REQUIRE(dump.steadyTime > 0);
+    REQUIRE(dump.systemTime > 0);
+    REQUIRE(dump.threads.size() >= 2);
+    // Other tests may have recorded events so check the last two rings
+    for (auto iThread = dump.threads.size() - 2;
+         iThread < dump.threads.size(); ++iThread)
+    {
+        const auto &events = dump.threads[iThread];
+        REQUIRE(events.size() == eventsPerThread);
+        REQUIRE(std::is_sorted(events.begin(), events.end(),
+                               [](const auto &lhs, const auto &rhs)
+                               {
+                                   return lhs.time < rhs.time;
+                               }));
+        for (int i = 0; i < eventsPerThread - 1; ++i)
+        {
+            REQUIRE(events[i].type == UFR::EventType::PacketAccepted);
+            REQUIRE(events[i].value == eventsPerThread + 1 + i);
+            REQUIRE(::toString(events[i].label) == "UU.FORK.HHZ.01");
+        }
+        REQUIRE(events.back().type == UFR::EventType::PacketRejected);
+        REQUIRE(events.back().detail == 3);
+    }
+    std::filesystem::remove_all(directory);
+
+    SECTION("Long labels keep their end")
+    {
+        std::thread thread([]()
+        {
+            UFR::record(UFR::EventType::SubscriberJoined,
+                        "ipv6:[::1]:5432109876", 2);
+        });
+        thread.join();
+        const auto fileName2 = UFR::dump(directory);
+        const auto dump2 = UFR::read(fileName2);
+        // The thread reused the ring of one of the finished threads
+        REQUIRE(dump2.threads.size() == dump.threads.size());
+        auto joined = std::find_if(dump2.threads.begin(), dump2.threads.end(),
+                                   [](const auto &events)
+                                   {
+                                       return events.back().type
+                                           == UFR::EventType::SubscriberJoined;
+                                   });
+        REQUIRE(joined != dump2.threads.end());
+        const auto &event = joined->back();
+        REQUIRE(std::string(event.label.data(), event.label.size())
+             == "[::1]:5432109876");
+        std::filesystem::remove_all(directory);
+    }
+
+    SECTION("Crash handler dumps the rings")
+    {
+        const auto pid = fork();
+        REQUIRE(pid >= 0);
+        if (pid == 0)
+        {
+            // Don't leave a core file behind
+            const rlimit noCore{0, 0};
+            setrlimit(RLIMIT_CORE, &noCore);
+            UFR::installCrashHandlers(directory);
+            UFR::record(UFR::EventType::SubscriberLeft, "crash", 7);
+            std::abort();
+        }
+        int status{0};
+        REQUIRE(waitpid(pid, &status, 0) == pid);
+        REQUIRE(WIFSIGNALED(status));
+        REQUIRE(WTERMSIG(status) == SIGABRT);
+        const auto crashFileName
+            = directory / ("flightRecorder." + std::to_string(pid)
+                         + ".crash.bin");
+        REQUIRE(std::filesystem::exists(crashFileName));
+        const auto crashDump = UFR::read(crashFileName);
+        REQUIRE(crashDump.threads.size() >= dump.threads.size());
+        bool found{false};
+        for (const auto &events : crashDump.threads)
+        {
+            for (const auto &event : events)
+            {
+                if (event.type == UFR::EventType::SubscriberLeft &&
+                    event.value == 7 &&
+                    ::toString(event.label) == "crash")
+                {
+                    REQUIRE(event.time <= crashDump.steadyTime);
+                    found = true;
+                }
+            }
+        }
+        REQUIRE(found);
+        std::filesystem::remove_all(directory);
+    }
+}
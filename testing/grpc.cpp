@@ -17,6 +17,11 @@ TEST_CASE("UPacketImportProxy", "[grpcOptions]")
         REQUIRE(options.getServerKey() == std::nullopt);
         REQUIRE(options.getClientCertificate() == std::nullopt);
         REQUIRE(options.reflectionEnabled() == false);
+        REQUIRE(options.getResourceQuotaInBytes() == std::nullopt);
+        REQUIRE(options.getMaximumNumberOfConcurrentStreams() == std::nullopt);
+        REQUIRE(options.getHTTP2StreamWindowSizeInBytes() == std::nullopt);
+        REQUIRE(options.getHTTP2WriteBufferSizeInBytes() == std::nullopt);
+        REQUIRE(options.http2BDPProbeEnabled() == true);
     }
 
     SECTION("Options")
@@ -49,4 +54,56 @@ TEST_CASE("UPacketImportProxy", "[grpcOptions]")
         REQUIRE(*options.getClientCertificate() == clientCertificate); //NOLINT
         REQUIRE(options.reflectionEnabled() == true);
     }
+
+    SECTION("Server Tuning")
+    {
+        constexpr int64_t resourceQuota{512*1024*1024};
+        constexpr int maxStreams{32};
+        constexpr int windowSize{1024*1024};
+        constexpr int writeBufferSize{128*1024};
+        UDataPacketImportProxy::GRPCOptions options;
+        options.setResourceQuotaInBytes(resourceQuota);
+        options.setMaximumNumberOfConcurrentStreams(maxStreams);
+        options.setHTTP2StreamWindowSizeInBytes(windowSize);
+        options.setHTTP2WriteBufferSizeInBytes(writeBufferSize);
+        options.disableHTTP2BDPProbe();
+
+        REQUIRE(options.getResourceQuotaInBytes() == resourceQuota);
+        REQUIRE(options.getMaximumNumberOfConcurrentStreams() == maxStreams);
+        REQUIRE(options.getHTTP2StreamWindowSizeInBytes() == windowSize);
+        REQUIRE(options.getHTTP2WriteBufferSizeInBytes() == writeBufferSize);
+        REQUIRE(options.http2BDPProbeEnabled() == false);
+
+        REQUIRE_THROWS(options.setResourceQuotaInBytes(0));
+        REQUIRE_THROWS(options.setMaximumNumberOfConcurrentStreams(0));
+        REQUIRE_THROWS(options.setHTTP2StreamWindowSizeInBytes(0));
+        REQUIRE_THROWS(options.setHTTP2WriteBufferSizeInBytes(0));
+    }
+
+    SECTION("Server Presets")
+    {
+        using ServerPreset = UDataPacketImportProxy::GRPCOptions::ServerPreset;
+        UDataPacketImportProxy::GRPCOptions small;
+        small.applyServerPreset(ServerPreset::ManySmallStreams);
+        UDataPacketImportProxy::GRPCOptions large;
+        large.applyServerPreset(ServerPreset::FewLargeStreams);
+        REQUIRE(small.getHTTP2StreamWindowSizeInBytes() != std::nullopt);
+        REQUIRE(large.getHTTP2StreamWindowSizeInBytes() != std::nullopt);
+        REQUIRE(*small.getHTTP2StreamWindowSizeInBytes() < //NOLINT
+                *large.getHTTP2StreamWindowSizeInBytes()); //NOLINT
+        REQUIRE(*small.getMaximumNumberOfConcurrentStreams() < //NOLINT
+                *large.getMaximumNumberOfConcurrentStreams()); //NOLINT
+        REQUIRE(small.http2BDPProbeEnabled() == false);
+        REQUIRE(large.http2BDPProbeEnabled() == true);
+        // Individual options override the preset
+        small.setMaximumNumberOfConcurrentStreams(2);
+        REQUIRE(small.getMaximumNumberOfConcurrentStreams() == 2);
+        // The default preset restores gRPC's defaults
+        small.applyServerPreset(ServerPreset::Default);
+        REQUIRE(small.getResourceQuotaInBytes() == std::nullopt);
+        REQUIRE(small.getMaximumNumberOfConcurrentStreams() == std::nullopt);
+        REQUIRE(small.getHTTP2StreamWindowSizeInBytes() == std::nullopt);
+        REQUIRE(small.getHTTP2WriteBufferSizeInBytes() == std::nullopt);
+        REQUIRE(small.http2BDPProbeEnabled() == true);
+    }
 }
@@ -0,0 +1,832 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/program_options.hpp>
+#include <grpc/grpc.h>
+#include <grpcpp/grpcpp.h>
+#include <google/protobuf/util/time_util.h>
+#include <spdlog/fmt/fmt.h>
+#include "uDataPacketImportAPI/v1/admin.grpc.pb.h"
+#include "uDataPacketImportAPI/v1/backend.grpc.pb.h"
+#include "uDataPacketImportAPI/v1/frontend.grpc.pb.h"
+#include "loadGeneratorCore.hpp"
+
+/// Simulates many publishers, each carrying many streams, and a few
+/// subscribers against a running proxy then reports the sustained
+/// throughput, the packets lost, and the latency percentiles.  This is
+/// intended for capacity planning so the streams are paced in real time
+/// and can be made to burst, backfill, repeat, and arrive out of order.
+
+namespace
+{
+
+struct Options
+{
+    std::string frontendAddress{"localhost:50000"};
+    std::string backendAddress{"localhost:50001"};
+    std::string adminAddress;
+    std::string accessToken;
+    std::string network{"XX"};
+    std::string outputFile;
+    std::chrono::seconds duration{60};
+    std::chrono::seconds backfill{0};
+    std::chrono::seconds burstPeriod{0};
+    std::chrono::seconds burstDuration{5};
+    std::chrono::seconds drain{2};
+    double samplingRate{100};
+    double packetDuration{1};
+    double duplicateFraction{0};
+    double outOfOrderFraction{0};
+    int nPublishers{4};
+    int nStreamsPerPublisher{25};
+    int nSubscribers{1};
+    uint32_t seed{86753};
+};
+
+[[nodiscard]] std::optional<::Options>
+    parseCommandLine(int argc, char *argv[])
+{
+    ::Options options;
+    int64_t duration{options.duration.count()};
+    int64_t backfill{options.backfill.count()};
+    int64_t burstPeriod{options.burstPeriod.count()};
+    int64_t burstDuration{options.burstDuration.count()};
+    int64_t drain{options.drain.count()};
+    boost::program_options::options_description description(R"""(
+The uDataPacketImportLoadGenerator simulates publishers and subscribers
+against a running uDataPacketImportProxy and reports the sustained
+throughput, packets lost, and end-to-end latency percentiles.
+
+Example usage:
+    uDataPacketImportLoadGenerator --publishers 20 --streams 50 --duration 300
+
+Allowed options)""");
+    description.add_options()
+        ("help", "Produces this help message")
+        ("frontend", boost::program_options::value<std::string>
+                     (&options.frontendAddress)->default_value(options.frontendAddress),
+         "The proxy frontend's address")
+        ("backend", boost::program_options::value<std::string>
+                    (&options.backendAddress)->default_value(options.backendAddress),
+         "The proxy backend's address")
+        ("admin", boost::program_options::value<std::string>
+                  (&options.adminAddress),
+         "If set, the proxy admin service's address from which to fetch the drop counts")
+        ("token", boost::program_options::value<std::string>
+                  (&options.accessToken),
+         "The access token sent in the x-custom-auth-token header")
+        ("network", boost::program_options::value<std::string>
+                    (&options.network)->default_value(options.network),
+         "The network code of the simulated streams")
+        ("publishers", boost::program_options::value<int>
+                       (&options.nPublishers)->default_value(options.nPublishers),
+         "The number of publishers")
+        ("streams", boost::program_options::value<int>
+                    (&options.nStreamsPerPublisher)->default_value(options.nStreamsPerPublisher),
+         "The number of streams carried by each publisher")
+        ("subscribers", boost::program_options::value<int>
+                        (&options.nSubscribers)->default_value(options.nSubscribers),
+         "The number of subscribers")
+        ("duration", boost::program_options::value<int64_t>
+                     (&duration)->default_value(duration),
+         "The number of seconds of live data to publish")
+        ("sampling-rate", boost::program_options::value<double>
+                          (&options.samplingRate)->default_value(options.samplingRate),
+         "The sampling rate of each stream in Hz")
+        ("packet-duration", boost::program_options::value<double>
+                            (&options.packetDuration)->default_value(options.packetDuration),
+         "The number of seconds of data in each packet")
+        ("backfill", boost::program_options::value<int64_t>
+                     (&backfill)->default_value(backfill),
+         "Each stream first publishes this many seconds of historical data as fast as possible")
+        ("burst-period", boost::program_options::value<int64_t>
+                         (&burstPeriod)->default_value(burstPeriod),
+         "Every this many seconds each publisher withholds its packets for the burst duration then sends them at once.  0 disables bursts")
+        ("burst-duration", boost::program_options::value<int64_t>
+                           (&burstDuration)->default_value(burstDuration),
+         "The number of seconds of packets withheld in a burst")
+        ("duplicates", boost::program_options::value<double>
+                       (&options.duplicateFraction)->default_value(options.duplicateFraction),
+         "The fraction of packets sent twice")
+        ("out-of-order", boost::program_options::value<double>
+                         (&options.outOfOrderFraction)->default_value(options.outOfOrderFraction),
+         "The fraction of packets sent after their successor")
+        ("drain", boost::program_options::value<int64_t>
+                  (&drain)->default_value(drain),
+         "Seconds the subscribers wait for stragglers after the publishers finish")
+        ("seed", boost::program_options::value<uint32_t>
+                 (&options.seed)->default_value(options.seed),
+         "The random number generator seed")
+        ("output", boost::program_options::value<std::string>
+                   (&options.outputFile),
+         "If set, a JSON file to which the throughput, loss, and latency percentiles are written");
+    boost::program_options::variables_map vm;
+    boost::program_options::store(
+        boost::program_options::parse_command_line(argc, argv, description),
+        vm);
+    boost::program_options::notify(vm);
+    if (vm.count("help"))
+    {
+        std::cout << description << std::endl;
+        return std::nullopt;
+    }
+    if (options.nPublishers < 1 || options.nPublishers > 9999)
+    {
+        throw std::invalid_argument("Publishers must be in range [1,9999]");
+    }
+    if (options.nStreamsPerPublisher < 1 ||
+        options.nStreamsPerPublisher > 1000)
+    {
+        throw std::invalid_argument("Streams must be in range [1,1000]");
+    }
+    if (options.nSubscribers < 0)
+    {
+        throw std::invalid_argument("Subscribers cannot be negative");
+    }
+    if (duration < 1){throw std::invalid_argument("Duration must be positive");}
+    if (backfill < 0){throw std::invalid_argument("Backfill cannot be negative");}
+    if (burstPeriod < 0)
+    {
+        throw std::invalid_argument("Burst period cannot be negative");
+    }
+    if (burstPeriod > 0 && (burstDuration < 1 || burstDuration >= burstPeriod))
+    {
+        throw std::invalid_argument(
+            "Burst duration must be positive and less than the burst period");
+    }
+    if (drain < 0){throw std::invalid_argument("Drain cannot be negative");}
+    if (!(options.samplingRate > 0))
+    {
+        throw std::invalid_argument("Sampling rate must be positive");
+    }
+    if (std::llround(options.samplingRate*options.packetDuration) < 1)
+    {
+        throw std::invalid_argument("Packets must have at least one sample");
+    }
+    if (options.duplicateFraction < 0 || options.duplicateFraction > 1)
+    {
+        throw std::invalid_argument("Duplicates must be in range [0,1]");
+    }
+    if (options.outOfOrderFraction < 0 || options.outOfOrderFraction > 1)
+    {
+        throw std::invalid_argument("Out-of-order must be in range [0,1]");
+    }
+    if (options.network.empty() || options.network.size() > 2)
+    {
+        throw std::invalid_argument("Network code must have 1 or 2 characters");
+    }
+    options.duration = std::chrono::seconds {duration};
+    options.backfill = std::chrono::seconds {backfill};
+    options.burstPeriod = std::chrono::seconds {burstPeriod};
+    options.burstDuration = std::chrono::seconds {burstDuration};
+    options.drain = std::chrono::seconds {drain};
+    return options;
+}
+
+/// When each stream's recent packets were sent.  A subscriber identifies
+/// a packet by its stream and start time so the registry lets it measure
+/// the time from the publisher's write to its read without changing the
+/// packet.  Only the most recent slots are kept so a subscriber that falls
+/// this far behind stops reporting latencies.
+class SendTimes
+{
+public:
+    static constexpr int64_t nSlots{4096};
+    explicit SendTimes(const int nStreams) :
+        mSlots(std::make_unique<Slot[]> (static_cast<size_t> (nStreams)*nSlots))
+    {
+    }
+    void set(const int stream, const int64_t sequence,
+             const std::chrono::steady_clock::time_point &time) noexcept
+    {
+        auto &slot = mSlots[stream*nSlots + sequence % nSlots];
+        slot.time.store(time.time_since_epoch().count(),
+                        std::memory_order_relaxed);
+        slot.sequence.store(sequence, std::memory_order_release);
+    }
+    [[nodiscard]] std::optional<std::chrono::steady_clock::time_point>
+        get(const int stream, const int64_t sequence) const noexcept
+    {
+        const auto &slot = mSlots[stream*nSlots + sequence % nSlots];
+        if (slot.sequence.load(std::memory_order_acquire) != sequence)
+        {
+            return std::nullopt;
+        }
+        return std::chrono::steady_clock::time_point
+        {
+            std::chrono::steady_clock::duration
+            {
+                slot.time.load(std::memory_order_relaxed)
+            }
+        };
+    }
+private:
+    struct Slot
+    {
+        std::atomic<int64_t> sequence{-1};
+        std::atomic<int64_t> time{0};
+    };
+    std::unique_ptr<Slot[]> mSlots;
+};
+
+/// Everything the publishers and subscribers need to agree on
+struct Simulation
+{
+    Simulation(const ::Options &optionsIn) :
+        options(optionsIn),
+        nSamplesPerPacket(::getNumberOfSamplesPerPacket(
+                              options.samplingRate, options.packetDuration)),
+        packetDuration(::getPacketDuration(options.samplingRate,
+                                           nSamplesPerPacket)),
+        nStreams(options.nPublishers*options.nStreamsPerPublisher),
+        sendTimes(nStreams)
+    {
+        // Packet k of every stream starts at origin + k*packetDuration
+        // (plus the stream's phase) so the subscribers can work out which
+        // packet they received from its start time.
+        const auto now = std::chrono::system_clock::now();
+        startTime = std::chrono::floor<std::chrono::seconds> (now)
+                  + std::chrono::seconds {1};
+        steadyStartTime = std::chrono::steady_clock::now()
+                        + (startTime - now);
+        origin = startTime - options.backfill;
+        nPacketsPerStream
+            = (options.backfill + options.duration)/packetDuration;
+    }
+    [[nodiscard]] std::string getStation(const int publisher) const
+    {
+        return fmt::format("P{:04d}", publisher);
+    }
+    ::Options options;
+    int64_t nSamplesPerPacket{0};
+    std::chrono::microseconds packetDuration{0};
+    int nStreams{0};
+    int64_t nPacketsPerStream{0};
+    std::chrono::system_clock::time_point startTime;
+    std::chrono::steady_clock::time_point steadyStartTime;
+    std::chrono::system_clock::time_point origin;
+    /// N.B. This is the only state the threads modify
+    mutable ::SendTimes sendTimes;
+};
+
+struct PublisherStatistics
+{
+    int64_t packetsSent{0};
+    int64_t bytesSent{0};
+    int64_t uniquePackets{0};
+    int64_t duplicatePackets{0};
+    int64_t reorderedPackets{0};
+    int64_t backfillPackets{0};
+    std::chrono::steady_clock::time_point firstSend;
+    std::chrono::steady_clock::time_point lastSend;
+    std::string error;
+};
+
+struct SubscriberStatistics
+{
+    int64_t packetsReceived{0};
+    int64_t bytesReceived{0};
+    int64_t uniquePackets{0};
+    int64_t duplicatePackets{0};
+    int64_t outOfOrderPackets{0};
+    int64_t unknownPackets{0};
+    std::vector<int64_t> latencies; // Microseconds
+    std::chrono::steady_clock::time_point firstReceive;
+    std::chrono::steady_clock::time_point lastReceive;
+    std::string error;
+};
+
+void addAccessToken(grpc::ClientContext *context, const ::Options &options)
+{
+    if (!options.accessToken.empty())
+    {
+        context->AddMetadata("x-custom-auth-token", options.accessToken);
+    }
+}
+
+/// Each publisher gets its own connection
+[[nodiscard]] std::shared_ptr<grpc::Channel>
+    makeChannel(const std::string &address)
+{
+    grpc::ChannelArguments arguments;
+    arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    return grpc::CreateCustomChannel(address,
+                                     grpc::InsecureChannelCredentials(),
+                                     arguments);
+}
+
+void publish(const int publisher,
+             const ::Simulation *simulation,
+             ::PublisherStatistics *statistics)
+{
+    const auto &options = simulation->options;
+    const auto nStreams = options.nStreamsPerPublisher;
+    const auto station = simulation->getStation(publisher);
+    ::PacketGeneratorOptions generatorOptions;
+    generatorOptions.network = options.network;
+    generatorOptions.station = station;
+    generatorOptions.origin = simulation->origin;
+    generatorOptions.startTime = simulation->startTime;
+    generatorOptions.steadyStartTime = simulation->steadyStartTime;
+    generatorOptions.burstPeriod = options.burstPeriod;
+    generatorOptions.burstDuration = options.burstDuration;
+    generatorOptions.samplingRate = options.samplingRate;
+    generatorOptions.packetDuration = options.packetDuration;
+    generatorOptions.nStreams = nStreams;
+    generatorOptions.nPacketsPerStream = simulation->nPacketsPerStream;
+    generatorOptions.seed = options.seed + static_cast<uint32_t> (publisher);
+    ::PacketGenerator packetGenerator{generatorOptions};
+    std::mt19937 generator(options.seed + static_cast<uint32_t> (publisher));
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<std::optional<std::pair<int64_t, UDataPacketImportAPI::V1::Packet>>>
+        heldPackets(nStreams);
+
+    auto channel = ::makeChannel(options.frontendAddress);
+    auto stub = UDataPacketImportAPI::V1::Frontend::NewStub(channel);
+    grpc::ClientContext context;
+    ::addAccessToken(&context, options);
+    UDataPacketImportAPI::V1::PublishResponse response;
+    auto writer = stub->Publish(&context, &response);
+
+    auto send = [&](const int stream,
+                    const int64_t sequence,
+                    const UDataPacketImportAPI::V1::Packet &packet)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        simulation->sendTimes.set(publisher*nStreams + stream, sequence, now);
+        if (!writer->Write(packet))
+        {
+            throw std::runtime_error("Publisher " + station
+                                   + " lost its connection");
+        }
+        if (statistics->packetsSent == 0){statistics->firstSend = now;}
+        statistics->lastSend = now;
+        statistics->packetsSent = statistics->packetsSent + 1;
+        statistics->bytesSent = statistics->bytesSent
+                              + static_cast<int64_t> (packet.ByteSizeLong());
+    };
+
+    const auto nBackfillPackets
+        = options.backfill/simulation->packetDuration;
+    try
+    {
+        while (!packetGenerator.empty())
+        {
+            const auto due = packetGenerator.pop();
+            std::this_thread::sleep_until(due.time);
+            const auto stream = due.stream;
+            const auto sequence = due.sequence;
+            auto packet = packetGenerator.makePacket(stream, sequence);
+            statistics->uniquePackets = statistics->uniquePackets + 1;
+            if (sequence < nBackfillPackets)
+            {
+                statistics->backfillPackets = statistics->backfillPackets + 1;
+            }
+            // Hold this packet back and send it after its successor
+            if (!heldPackets[stream] &&
+                packetGenerator.hasSuccessor(due) &&
+                uniform(generator) < options.outOfOrderFraction)
+            {
+                heldPackets[stream] = std::pair {sequence, std::move(packet)};
+                statistics->reorderedPackets
+                    = statistics->reorderedPackets + 1;
+                continue;
+            }
+            send(stream, sequence, packet);
+            if (uniform(generator) < options.duplicateFraction)
+            {
+                send(stream, sequence, packet);
+                statistics->duplicatePackets
+                    = statistics->duplicatePackets + 1;
+            }
+            if (heldPackets[stream])
+            {
+                send(stream,
+                     heldPackets[stream]->first,
+                     heldPackets[stream]->second);
+                heldPackets[stream].reset();
+            }
+        }
+        writer->WritesDone();
+    }
+    catch (const std::exception &e)
+    {
+        statistics->error = e.what();
+        context.TryCancel();
+    }
+    auto status = writer->Finish();
+    if (!status.ok() && statistics->error.empty())
+    {
+        statistics->error = "Publisher " + station + " finished with: "
+                          + status.error_message();
+    }
+}
+
+void subscribe(const ::Simulation *simulation,
+               grpc::ClientContext *context,
+               ::SubscriberStatistics *statistics)
+{
+    const auto &options = simulation->options;
+    // Keep a bounded, uniform sample of the latencies
+    constexpr size_t maximumNumberOfLatencies{2000000};
+    std::mt19937_64 generator(options.seed);
+    int64_t nLatencies{0};
+    // Which packets of each stream were received
+    std::vector<std::vector<bool>> received(
+        simulation->nStreams,
+        std::vector<bool>(simulation->nPacketsPerStream, false));
+    std::vector<int64_t> lastSequence(simulation->nStreams, -1);
+    const auto originMicroSeconds = ::toMicroSeconds(simulation->origin);
+    const auto packetDuration = simulation->packetDuration.count();
+
+    auto channel = ::makeChannel(options.backendAddress);
+    auto stub = UDataPacketImportAPI::V1::Backend::NewStub(channel);
+    ::addAccessToken(context, options);
+    UDataPacketImportAPI::V1::SubscriptionRequest request;
+    auto reader = stub->Subscribe(context, request);
+    UDataPacketImportAPI::V1::Packet packet;
+    while (reader->Read(&packet))
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (statistics->packetsReceived == 0){statistics->firstReceive = now;}
+        statistics->lastReceive = now;
+        statistics->packetsReceived = statistics->packetsReceived + 1;
+        statistics->bytesReceived
+            = statistics->bytesReceived
+            + static_cast<int64_t> (packet.ByteSizeLong());
+        // Work out which packet this is
+        const auto &identifier = packet.stream_identifier();
+        int publisher{-1};
+        int streamInPublisher{-1};
+        try
+        {
+            if (identifier.network() == options.network &&
+                identifier.station().size() == 5)
+            {
+                publisher = std::stoi(identifier.station().substr(1));
+                streamInPublisher = std::stoi(identifier.channel());
+            }
+        }
+        catch (...)
+        {
+        }
+        if (publisher < 0 || publisher >= options.nPublishers ||
+            streamInPublisher < 0 ||
+            streamInPublisher >= options.nStreamsPerPublisher)
+        {
+            statistics->unknownPackets = statistics->unknownPackets + 1;
+            continue;
+        }
+        const auto stream
+            = publisher*options.nStreamsPerPublisher + streamInPublisher;
+        // The stream's phase is less than a packet duration
+        const auto sequence
+            = (google::protobuf::util::TimeUtil::TimestampToMicroseconds(
+                  packet.start_time()) - originMicroSeconds)/packetDuration;
+        if (sequence < 0 || sequence >= simulation->nPacketsPerStream)
+        {
+            statistics->unknownPackets = statistics->unknownPackets + 1;
+            continue;
+        }
+        if (received[stream][sequence])
+        {
+            statistics->duplicatePackets = statistics->duplicatePackets + 1;
+            continue;
+        }
+        received[stream][sequence] = true;
+        statistics->uniquePackets = statistics->uniquePackets + 1;
+        if (sequence < lastSequence[stream])
+        {
+            statistics->outOfOrderPackets = statistics->outOfOrderPackets + 1;
+        }
+        lastSequence[stream] = std::max(lastSequence[stream], sequence);
+        auto sendTime = simulation->sendTimes.get(stream, sequence);
+        if (sendTime)
+        {
+            const auto latency
+                = std::chrono::duration_cast<std::chrono::microseconds>
+                  (now - *sendTime).count();
+            nLatencies = nLatencies + 1;
+            if (statistics->latencies.size() < maximumNumberOfLatencies)
+            {
+                statistics->latencies.push_back(latency);
+            }
+            else
+            {
+                std::uniform_int_distribution<int64_t>
+                    distribution(0, nLatencies - 1);
+                const auto index = distribution(generator);
+                if (index < static_cast<int64_t> (maximumNumberOfLatencies))
+                {
+                    statistics->latencies[index] = latency;
+                }
+            }
+        }
+    }
+    auto status = reader->Finish();
+    if (!status.ok() && status.error_code() != grpc::StatusCode::CANCELLED)
+    {
+        statistics->error = status.error_message();
+    }
+}
+
+[[nodiscard]] double toSeconds(const std::chrono::steady_clock::duration &duration)
+{
+    return std::chrono::duration<double> (duration).count();
+}
+
+void printRate(const std::string &what,
+               const int64_t nPackets,
+               const int64_t nBytes,
+               const double elapsed)
+{
+    const auto denominator = elapsed > 0 ? elapsed : 1;
+    std::cout << fmt::format("{}: {} packets ({:.1f} MB) in {:.1f} s; {:.1f} packets/s, {:.3f} MB/s",
+                             what,
+                             nPackets,
+                             static_cast<double> (nBytes)/1.e6,
+                             elapsed,
+                             static_cast<double> (nPackets)/denominator,
+                             static_cast<double> (nBytes)/1.e6/denominator)
+              << std::endl;
+}
+
+/// @result The percentile in milliseconds of the sorted latencies
+[[nodiscard]] double getPercentile(const std::vector<int64_t> &sortedLatencies,
+                                   const double p)
+{
+    if (sortedLatencies.empty()){return 0;}
+    const auto index
+        = static_cast<size_t> (std::ceil(p/100*static_cast<double> (sortedLatencies.size()))) - 1;
+    return static_cast<double> (sortedLatencies[std::min(index, sortedLatencies.size() - 1)])/1000;
+}
+
+void printLatencies(std::vector<int64_t> latencies)
+{
+    if (latencies.empty())
+    {
+        std::cout << "  Latency: no measurements" << std::endl;
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << fmt::format("  Latency (ms): p50 {:.3f}, p90 {:.3f}, p99 {:.3f}, p99.9 {:.3f}, max {:.3f}",
+                             ::getPercentile(latencies, 50),
+                             ::getPercentile(latencies, 90),
+                             ::getPercentile(latencies, 99),
+                             ::getPercentile(latencies, 99.9),
+                             static_cast<double> (latencies.back())/1000)
+              << std::endl;
+}
+
+/// Writes the summary that the benchmark gate compares to its baseline.
+/// The subscribers' delivery rates are averaged and their latencies pooled.
+void writeSummary(const ::Options &options,
+                  const ::PublisherStatistics &published,
+                  const double publishElapsed,
+                  const std::vector<::SubscriberStatistics> &subscriberStatistics)
+{
+    double deliveredRate{0};
+    int64_t packetsLost{0};
+    std::vector<int64_t> latencies;
+    for (const auto &statistics : subscriberStatistics)
+    {
+        const auto elapsed
+            = statistics.packetsReceived > 0 ?
+              ::toSeconds(statistics.lastReceive - statistics.firstReceive) :
+              0;
+        if (elapsed > 0)
+        {
+            deliveredRate = deliveredRate
+                          + static_cast<double> (statistics.packetsReceived)
+                           /elapsed;
+        }
+        packetsLost = packetsLost
+                    + std::max<int64_t> (0, published.uniquePackets
+                                          - statistics.uniquePackets);
+        latencies.insert(latencies.end(),
+                         statistics.latencies.begin(),
+                         statistics.latencies.end());
+    }
+    if (!subscriberStatistics.empty())
+    {
+        deliveredRate
+            = deliveredRate/static_cast<double> (subscriberStatistics.size());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::ofstream output(options.outputFile);
+    if (!output)
+    {
+        throw std::runtime_error("Could not open " + options.outputFile);
+    }
+    output << fmt::format(R"""({{
+  "publishers": {},
+  "streamsPerPublisher": {},
+  "subscribers": {},
+  "durationInSeconds": {},
+  "seed": {},
+  "packetsPublished": {},
+  "publishedPacketsPerSecond": {:.3f},
+  "deliveredPacketsPerSecond": {:.3f},
+  "packetsLost": {},
+  "latencyInMilliSeconds": {{
+    "p50": {:.6f},
+    "p90": {:.6f},
+    "p99": {:.6f},
+    "p99.9": {:.6f},
+    "max": {:.6f}
+  }}
+}}
+)""",
+                          options.nPublishers,
+                          options.nStreamsPerPublisher,
+                          options.nSubscribers,
+                          options.duration.count(),
+                          options.seed,
+                          published.packetsSent,
+                          publishElapsed > 0 ?
+                          static_cast<double> (published.packetsSent)/publishElapsed : 0,
+                          deliveredRate,
+                          packetsLost,
+                          ::getPercentile(latencies, 50),
+                          ::getPercentile(latencies, 90),
+                          ::getPercentile(latencies, 99),
+                          ::getPercentile(latencies, 99.9),
+                          latencies.empty() ?
+                          0 : static_cast<double> (latencies.back())/1000);
+}
+
+void printPipelineState(const ::Options &options)
+{
+    auto channel = grpc::CreateChannel(options.adminAddress,
+                                       grpc::InsecureChannelCredentials());
+    auto stub = UDataPacketImportAPI::V1::Admin::NewStub(channel);
+    grpc::ClientContext context;
+    ::addAccessToken(&context, options);
+    context.set_deadline(std::chrono::system_clock::now()
+                       + std::chrono::seconds {5});
+    UDataPacketImportAPI::V1::PipelineStateRequest request;
+    request.set_maximum_number_of_streams(0);
+    UDataPacketImportAPI::V1::PipelineState state;
+    auto status = stub->GetPipelineState(&context, request, &state);
+    if (!status.ok())
+    {
+        std::cerr << "Failed to get pipeline state: "
+                  << status.error_message() << std::endl;
+        return;
+    }
+    std::cout << "Proxy:" << std::endl;
+    for (const auto &drop : state.drops())
+    {
+        std::cout << fmt::format("  Dropped ({}): {}",
+                                 drop.reason(), drop.packets_dropped())
+                  << std::endl;
+    }
+    for (const auto &queue : state.queues())
+    {
+        std::cout << fmt::format("  Queue ({}) high water mark: {}",
+                                 queue.name(), queue.high_water_mark())
+                  << std::endl;
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::optional<::Options> options;
+    try
+    {
+        options = ::parseCommandLine(argc, argv);
+        if (!options){return EXIT_SUCCESS;}
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    const ::Simulation simulation{*options};
+    std::cout << fmt::format("Simulating {} publishers with {} streams each ({} packets/s) and {} subscribers",
+                             options->nPublishers,
+                             options->nStreamsPerPublisher,
+                             static_cast<double> (simulation.nStreams)
+                            *1.e6/static_cast<double> (simulation.packetDuration.count()),
+                             options->nSubscribers)
+              << std::endl;
+
+    std::vector<std::unique_ptr<grpc::ClientContext>> subscriberContexts;
+    std::vector<::SubscriberStatistics> subscriberStatistics(options->nSubscribers);
+    std::vector<std::thread> subscriberThreads;
+    for (int i = 0; i < options->nSubscribers; ++i)
+    {
+        subscriberContexts.push_back(std::make_unique<grpc::ClientContext> ());
+        subscriberThreads.emplace_back(&::subscribe,
+                                       &simulation,
+                                       subscriberContexts.back().get(),
+                                       &subscriberStatistics[i]);
+    }
+    // Give the subscribers a moment to connect.  The publishers do not
+    // start until the simulation's start time.
+    std::this_thread::sleep_until(simulation.steadyStartTime);
+
+    std::vector<::PublisherStatistics> publisherStatistics(options->nPublishers);
+    std::vector<std::thread> publisherThreads;
+    for (int i = 0; i < options->nPublishers; ++i)
+    {
+        publisherThreads.emplace_back(&::publish,
+                                      i,
+                                      &simulation,
+                                      &publisherStatistics[i]);
+    }
+    for (auto &thread : publisherThreads){thread.join();}
+    std::this_thread::sleep_for(options->drain);
+    for (auto &context : subscriberContexts){context->TryCancel();}
+    for (auto &thread : subscriberThreads){thread.join();}
+
+    // Summarize
+    ::PublisherStatistics published;
+    published.firstSend = std::chrono::steady_clock::time_point::max();
+    for (const auto &statistics : publisherStatistics)
+    {
+        if (!statistics.error.empty())
+        {
+            std::cerr << statistics.error << std::endl;
+        }
+        if (statistics.packetsSent == 0){continue;}
+        published.packetsSent += statistics.packetsSent;
+        published.bytesSent += statistics.bytesSent;
+        published.uniquePackets += statistics.uniquePackets;
+        published.duplicatePackets += statistics.duplicatePackets;
+        published.reorderedPackets += statistics.reorderedPackets;
+        published.backfillPackets += statistics.backfillPackets;
+        published.firstSend = std::min(published.firstSend,
+                                       statistics.firstSend);
+        published.lastSend = std::max(published.lastSend,
+                                      statistics.lastSend);
+    }
+    const auto publishElapsed
+        = published.packetsSent > 0 ?
+          ::toSeconds(published.lastSend - published.firstSend) : 0;
+    ::printRate("Published", published.packetsSent, published.bytesSent,
+                publishElapsed);
+    std::cout << fmt::format("  Unique {}, duplicates {}, out of order {}, backfill {}",
+                             published.uniquePackets,
+                             published.duplicatePackets,
+                             published.reorderedPackets,
+                             published.backfillPackets)
+              << std::endl;
+    for (int i = 0; i < options->nSubscribers; ++i)
+    {
+        const auto &statistics = subscriberStatistics[i];
+        if (!statistics.error.empty())
+        {
+            std::cerr << "Subscriber " << i << ": " << statistics.error
+                      << std::endl;
+        }
+        const auto elapsed
+            = statistics.packetsReceived > 0 ?
+              ::toSeconds(statistics.lastReceive - statistics.firstReceive) :
+              0;
+        ::printRate(fmt::format("Subscriber {}", i),
+                    statistics.packetsReceived,
+                    statistics.bytesReceived,
+                    elapsed);
+        std::cout << fmt::format("  Unique {}, lost {}, duplicates {}, out of order {}, unknown {}",
+                                 statistics.uniquePackets,
+                                 std::max<int64_t> (0, published.uniquePackets
+                                                     - statistics.uniquePackets),
+                                 statistics.duplicatePackets,
+                                 statistics.outOfOrderPackets,
+                                 statistics.unknownPackets)
+                  << std::endl;
+        ::printLatencies(statistics.latencies);
+    }
+    if (!options->adminAddress.empty()){::printPipelineState(*options);}
+    if (!options->outputFile.empty())
+    {
+        try
+        {
+            ::writeSummary(*options, published, publishElapsed,
+                           subscriberStatistics);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+#ifndef LOAD_GENERATOR_CORE_HPP
+#define LOAD_GENERATOR_CORE_HPP
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <google/protobuf/util/time_util.h>
+#include <spdlog/fmt/fmt.h>
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "packetUtilities.hpp"
+
+namespace
+{
+
+[[nodiscard]] int64_t toMicroSeconds(
+    const std::chrono::system_clock::time_point &time)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>
+           (time.time_since_epoch()).count();
+}
+
+/// @result The number of samples in a packet spanning (about) the given
+///         number of seconds.
+[[nodiscard]] int64_t getNumberOfSamplesPerPacket(const double samplingRate,
+                                                  const double packetDuration)
+{
+    return std::llround(samplingRate*packetDuration);
+}
+
+/// @result The time spanned by a packet with the given number of samples.
+[[nodiscard]] std::chrono::microseconds
+    getPacketDuration(const double samplingRate, const int64_t nSamples)
+{
+    return std::chrono::microseconds
+    {
+        std::llround(1000000*static_cast<double> (nSamples)/samplingRate)
+    };
+}
+
+struct PacketGeneratorOptions
+{
+    std::string network{"XX"};
+    std::string station;
+    std::string locationCode{"00"};
+    /// Packet k of every stream starts at origin + k*packetDuration plus the
+    /// stream's phase.  Set the origin before the start time to backfill.
+    std::chrono::system_clock::time_point origin;
+    /// When the live data begins.  Bursts are measured from here.
+    std::chrono::system_clock::time_point startTime;
+    /// The start time on the steady clock which paces the packets
+    std::chrono::steady_clock::time_point steadyStartTime;
+    /// Every burst period the packets are withheld for the burst duration
+    /// and then sent at once.  0 disables bursts.
+    std::chrono::seconds burstPeriod{0};
+    std::chrono::seconds burstDuration{5};
+    double samplingRate{100};
+    double packetDuration{1}; // Seconds
+    int nStreams{1};
+    /// The number of packets in each stream.  0 means the streams never end.
+    int64_t nPacketsPerStream{0};
+    uint32_t seed{86753};
+};
+
+/// Paces the streams of one publisher in real time and builds their packets.
+/// The streams are staggered throughout the packet duration and a packet is
+/// due when its last sample would have been recorded.  The samples are a
+/// random walk so successive packets do not compress to nothing.
+class PacketGenerator
+{
+public:
+    /// A packet that is due to be sent
+    struct Due
+    {
+        std::chrono::steady_clock::time_point time;
+        int stream{0};
+        int64_t sequence{0};
+        bool operator>(const Due &rhs) const noexcept
+        {
+            return time > rhs.time;
+        }
+    };
+
+    explicit PacketGenerator(const PacketGeneratorOptions &options) :
+        mOptions(options),
+        mGenerator(options.seed),
+        mNumberOfSamplesPerPacket(
+            ::getNumberOfSamplesPerPacket(options.samplingRate,
+                                          options.packetDuration))
+    {
+        if (mOptions.nStreams < 1)
+        {
+            throw std::invalid_argument("Number of streams must be positive");
+        }
+        if (!(mOptions.samplingRate > 0))
+        {
+            throw std::invalid_argument("Sampling rate must be positive");
+        }
+        if (mNumberOfSamplesPerPacket < 1)
+        {
+            throw std::invalid_argument("Packets must have at least one sample");
+        }
+        if (mOptions.nPacketsPerStream < 0)
+        {
+            throw std::invalid_argument(
+                "Number of packets per stream cannot be negative");
+        }
+        mPacketDuration = ::getPacketDuration(mOptions.samplingRate,
+                                              mNumberOfSamplesPerPacket);
+        std::uniform_int_distribution<int64_t>
+            phaseDistribution(0, mPacketDuration.count() - 1);
+        mPhases.resize(mOptions.nStreams);
+        for (auto &phase : mPhases)
+        {
+            phase = std::chrono::microseconds {phaseDistribution(mGenerator)};
+        }
+        mLastSample.resize(mOptions.nStreams, 0);
+        for (int stream = 0; stream < mOptions.nStreams; ++stream)
+        {
+            if (hasPacket(0)){mSchedule.push(makeDue(stream, 0));}
+        }
+    }
+
+    /// @result True indicates every packet has been handed out.
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return mSchedule.empty();
+    }
+
+    /// @result The next packet to send.  The caller should wait until it is
+    ///         due.
+    /// @throws std::runtime_error if every packet has been handed out.
+    [[nodiscard]] Due pop()
+    {
+        if (mSchedule.empty())
+        {
+            throw std::runtime_error("No packets left to generate");
+        }
+        const auto due = mSchedule.top();
+        mSchedule.pop();
+        if (hasPacket(due.sequence + 1))
+        {
+            mSchedule.push(makeDue(due.stream, due.sequence + 1));
+        }
+        return due;
+    }
+
+    /// @result True indicates the stream has a packet after this one.
+    [[nodiscard]] bool hasSuccessor(const Due &due) const noexcept
+    {
+        return hasPacket(due.sequence + 1);
+    }
+
+    /// @result The packet for this stream and sequence number.
+    /// @note The samples continue the stream's random walk so packets should
+    ///       be made in sequence.
+    [[nodiscard]] UDataPacketImportAPI::V1::Packet makePacket(
+        const int stream, const int64_t sequence)
+    {
+        std::uniform_int_distribution<int> amplitude(-1000, 1000);
+        std::vector<int> data(mNumberOfSamplesPerPacket);
+        for (auto &sample : data)
+        {
+            mLastSample[stream] = mLastSample[stream] + amplitude(mGenerator);
+            sample = mLastSample[stream];
+        }
+        UDataPacketImportAPI::V1::Packet packet;
+        auto identifier = packet.mutable_stream_identifier();
+        identifier->set_network(mOptions.network);
+        identifier->set_station(mOptions.station);
+        identifier->set_channel(getChannel(stream));
+        identifier->set_location_code(mOptions.locationCode);
+        *packet.mutable_start_time()
+            = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(
+                 ::toMicroSeconds(getStartTime(stream, sequence)));
+        packet.set_sampling_rate(mOptions.samplingRate);
+        packet.set_number_of_samples(static_cast<int> (data.size()));
+        packet.set_data_type(
+            UDataPacketImportAPI::V1::DataType::DATA_TYPE_INTEGER_32);
+        packet.set_data(::pack(data));
+        return packet;
+    }
+
+    /// @result The channel code of the stream.
+    [[nodiscard]] static std::string getChannel(const int stream)
+    {
+        return fmt::format("{:03d}", stream);
+    }
+
+    [[nodiscard]] std::chrono::microseconds getPacketDuration() const noexcept
+    {
+        return mPacketDuration;
+    }
+private:
+    [[nodiscard]] bool hasPacket(const int64_t sequence) const noexcept
+    {
+        return mOptions.nPacketsPerStream == 0 ||
+               sequence < mOptions.nPacketsPerStream;
+    }
+
+    [[nodiscard]] std::chrono::system_clock::time_point
+        getStartTime(const int stream, const int64_t sequence) const
+    {
+        return mOptions.origin + mPhases[stream] + sequence*mPacketDuration;
+    }
+
+    /// During a burst a publisher's packets are withheld until the burst
+    /// ends.
+    [[nodiscard]] Due makeDue(const int stream, const int64_t sequence) const
+    {
+        const auto endTime = getStartTime(stream, sequence + 1);
+        auto dueTime = endTime;
+        if (mOptions.burstPeriod.count() > 0 && endTime > mOptions.startTime)
+        {
+            const auto sinceStart = endTime - mOptions.startTime;
+            const auto intoPeriod = sinceStart % mOptions.burstPeriod;
+            if (intoPeriod < mOptions.burstDuration)
+            {
+                dueTime = endTime - intoPeriod + mOptions.burstDuration;
+            }
+        }
+        return Due {mOptions.steadyStartTime
+                  + std::chrono::duration_cast<std::chrono::steady_clock::duration>
+                    (dueTime - mOptions.startTime),
+                    stream,
+                    sequence};
+    }
+
+    PacketGeneratorOptions mOptions;
+    std::mt19937 mGenerator;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> mSchedule;
+    std::vector<std::chrono::microseconds> mPhases;
+    std::vector<int> mLastSample;
+    std::chrono::microseconds mPacketDuration{0};
+    int64_t mNumberOfSamplesPerPacket{0};
+};
+
+}
+
+#endif
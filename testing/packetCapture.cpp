@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include "uDataPacketImportProxy/packetCapture.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "packetUtilities.hpp"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+[[nodiscard]] std::filesystem::path makeCaptureDirectory(const std::string &name)
+{
+    auto directory
+        = std::filesystem::temp_directory_path()
+        / ("uDataPacketImportProxyCaptureTest-" + name);
+    std::filesystem::remove_all(directory);
+    return directory;
+}
+
+[[nodiscard]] std::vector<std::pair<std::chrono::microseconds,
+                                    UDataPacketImportAPI::V1::Packet>>
+    readAll(const std::vector<std::filesystem::path> &files)
+{
+    std::vector<std::pair<std::chrono::microseconds,
+                          UDataPacketImportAPI::V1::Packet>> result;
+    for (const auto &file : files)
+    {
+        PacketCaptureReader reader{file};
+        UDataPacketImportAPI::V1::Packet packet;
+        std::chrono::microseconds receiveTime{0};
+        while (reader.next(&packet, &receiveTime))
+        {
+            result.emplace_back(receiveTime, packet);
+        }
+    }
+    return result;
+}
+
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketCapture", "[packetCaptureOptions]")
+{
+    SECTION("Defaults")
+    {
+        const PacketCaptureOptions options;
+        REQUIRE(!options.haveDirectory());
+        REQUIRE_THROWS_AS(options.getDirectory(), std::runtime_error);
+        REQUIRE(options.getMaximumFileSizeInBytes() == 256*1024*1024);
+        REQUIRE(options.getMaximumNumberOfFiles() == 16);
+    }
+    SECTION("Options")
+    {
+        const std::filesystem::path directory{"/tmp/capture"};
+        constexpr int64_t maximumFileSize{128*1024};
+        constexpr int maximumNumberOfFiles{3};
+        PacketCaptureOptions options;
+        options.setDirectory(directory);
+        options.setMaximumFileSizeInBytes(maximumFileSize);
+        options.setMaximumNumberOfFiles(maximumNumberOfFiles);
+        REQUIRE(options.getDirectory() == directory);
+        REQUIRE(options.getMaximumFileSizeInBytes() == maximumFileSize);
+        REQUIRE(options.getMaximumNumberOfFiles() == maximumNumberOfFiles);
+        REQUIRE_THROWS_AS(options.setDirectory(""), std::invalid_argument);
+        REQUIRE_THROWS_AS(options.setMaximumFileSizeInBytes(1024),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(options.setMaximumNumberOfFiles(0),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketCapture", "[packetCapture]")
+{
+    const auto packets = ::generatePackets(200, "UU", "CWU", "HHZ", "01");
+    constexpr std::chrono::microseconds origin{1700000000000000};
+
+    SECTION("Round trip")
+    {
+        const auto directory = ::makeCaptureDirectory("roundTrip");
+        PacketCaptureOptions options;
+        options.setDirectory(directory);
+        {
+        PacketCapture capture{options};
+        for (int i = 0; i < static_cast<int> (packets.size()); ++i)
+        {
+            capture.append(packets[i], origin + std::chrono::microseconds {i});
+        }
+        REQUIRE(capture.getNumberOfPackets()
+             == static_cast<int64_t> (packets.size()));
+        }
+        const auto files = PacketCapture::getFiles(directory);
+        REQUIRE(files.size() == 1);
+        const auto captured = ::readAll(files);
+        REQUIRE(captured.size() == packets.size());
+        for (int i = 0; i < static_cast<int> (packets.size()); ++i)
+        {
+            REQUIRE(captured[i].first == origin + std::chrono::microseconds {i});
+            REQUIRE(captured[i].second.SerializeAsString()
+                 == packets[i].SerializeAsString());
+        }
+        // A restart starts a new file rather than overwriting the old one
+        {
+        const PacketCapture capture{options};
+        }
+        REQUIRE(PacketCapture::getFiles(directory).size() == 2);
+        REQUIRE(PacketCapture::getFiles(directory).front() == files.front());
+        std::filesystem::remove_all(directory);
+    }
+
+    SECTION("Rotation")
+    {
+        const auto directory = ::makeCaptureDirectory("rotation");
+        constexpr int maximumNumberOfFiles{2};
+        PacketCaptureOptions options;
+        options.setDirectory(directory);
+        options.setMaximumFileSizeInBytes(64*1024);
+        options.setMaximumNumberOfFiles(maximumNumberOfFiles);
+        {
+        PacketCapture capture{options};
+        for (int i = 0; i < static_cast<int> (packets.size()); ++i)
+        {
+            capture.append(packets[i], origin + std::chrono::microseconds {i});
+        }
+        }
+        const auto files = PacketCapture::getFiles(directory);
+        REQUIRE(static_cast<int> (files.size()) == maximumNumberOfFiles);
+        for (const auto &file : files)
+        {
+            REQUIRE(std::filesystem::file_size(file) <= 64*1024);
+        }
+        // The newest packets survive and are in order
+        const auto captured = ::readAll(files);
+        REQUIRE(!captured.empty());
+        REQUIRE(captured.size() < packets.size());
+        const auto first = packets.size() - captured.size();
+        for (size_t i = 0; i < captured.size(); ++i)
+        {
+            REQUIRE(captured[i].second.SerializeAsString()
+                 == packets[first + i].SerializeAsString());
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    SECTION("Truncated")
+    {
+        const auto directory = ::makeCaptureDirectory("truncated");
+        PacketCaptureOptions options;
+        options.setDirectory(directory);
+        {
+        PacketCapture capture{options};
+        for (int i = 0; i < 10; ++i)
+        {
+            capture.append(packets[i], origin);
+        }
+        }
+        const auto file = PacketCapture::getFiles(directory).at(0);
+        std::filesystem::resize_file(file,
+                                     std::filesystem::file_size(file) - 10);
+        REQUIRE(::readAll({file}).size() == 9);
+
+        const auto notACapture = directory / "capture-999999999999.cap";
+        std::ofstream(notACapture) << "not a capture file";
+        REQUIRE_THROWS_AS(PacketCaptureReader {notACapture},
+                          std::runtime_error);
+        std::filesystem::remove_all(directory);
+    }
+}
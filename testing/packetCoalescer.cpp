@@ -0,0 +1,194 @@
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <google/protobuf/util/time_util.h>
+#include "uDataPacketImportProxy/packetCoalescer.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "uDataPacketImportAPI/v1/stream_identifier.pb.h"
+#include "uDataPacketImportAPI/v1/data_type.pb.h"
+#include "packetUtilities.hpp"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+/// Creates contiguous 10 sample packets at 40 Hz
+[[nodiscard]] std::vector<UDataPacketImportAPI::V1::Packet>
+    generateContiguousPackets(const int nPackets,
+                              const std::string &station = "CWU")
+{
+    constexpr double samplingRate{40};
+    constexpr int nSamples{10};
+    std::vector<UDataPacketImportAPI::V1::Packet> result;
+    int64_t startTime{1700000000000000};
+    int sample{0};
+    for (int i = 0; i < nPackets; ++i)
+    {
+        std::vector<int> data(nSamples);
+        for (auto &value : data)
+        {
+            value = sample;
+            sample = sample + 1;
+        }
+        UDataPacketImportAPI::V1::StreamIdentifier identifier;
+        identifier.set_network("UU");
+        identifier.set_station(station);
+        identifier.set_channel("HHZ");
+        identifier.set_location_code("01");
+        UDataPacketImportAPI::V1::Packet packet;
+        *packet.mutable_stream_identifier() = std::move(identifier);
+        *packet.mutable_start_time()
+            = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(
+                 startTime);
+        packet.set_sampling_rate(samplingRate);
+        packet.set_number_of_samples(nSamples);
+        packet.set_data_type(
+            UDataPacketImportAPI::V1::DataType::DATA_TYPE_INTEGER_32);
+        packet.set_data(::pack(data));
+        result.push_back(std::move(packet));
+        startTime = startTime
+                  + static_cast<int64_t> (1000000*nSamples/samplingRate);
+    }
+    return result;
+}
+
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketCoalescer", "[packetCoalescerOptions]")
+{
+    PacketCoalescerOptions options;
+    REQUIRE(options.getMaximumDuration() == std::chrono::seconds {2});
+    REQUIRE(options.getMaximumSizeInBytes() == 16384);
+    REQUIRE(options.getMaximumLinger() == std::chrono::milliseconds {250});
+    options.setMaximumDuration(std::chrono::milliseconds {1500});
+    options.setMaximumSizeInBytes(4096);
+    options.setMaximumLinger(std::chrono::milliseconds {100});
+    REQUIRE(options.getMaximumDuration() == std::chrono::milliseconds {1500});
+    REQUIRE(options.getMaximumSizeInBytes() == 4096);
+    REQUIRE(options.getMaximumLinger() == std::chrono::milliseconds {100});
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketCoalescer", "[packetCoalescer]")
+{
+    using Clock = PacketCoalescer::Clock;
+    PacketCoalescerOptions options;
+    options.setMaximumDuration(std::chrono::seconds {1});
+    options.setMaximumLinger(std::chrono::milliseconds {100});
+    auto packets = ::generateContiguousPackets(8);
+    const auto t0 = Clock::now();
+
+    SECTION("Merge up to maximum duration")
+    {
+        PacketCoalescer coalescer{options};
+        std::vector<UDataPacketImportAPI::V1::Packet> released;
+        for (auto packet : packets)
+        {
+            auto result = coalescer.insert(std::move(packet), t0);
+            for (auto &p : result){released.push_back(std::move(p.second));}
+        }
+        // Four 0.25 s packets make a 1 s packet
+        REQUIRE(released.size() == 2);
+        REQUIRE(coalescer.size() == 0);
+        for (int i = 0; i < 2; ++i)
+        {
+            REQUIRE(released.at(i).number_of_samples() == 40);
+            REQUIRE(released.at(i).start_time()
+                 == packets.at(4*i).start_time());
+            std::string expectedData;
+            for (int k = 0; k < 4; ++k)
+            {
+                expectedData = expectedData + packets.at(4*i + k).data();
+            }
+            REQUIRE(released.at(i).data() == expectedData);
+        }
+    }
+
+    SECTION("Linger and gaps")
+    {
+        PacketCoalescer coalescer{options};
+        auto packet = packets.at(0);
+        REQUIRE(coalescer.insert(std::move(packet), t0).empty());
+        packet = packets.at(1);
+        REQUIRE(coalescer.insert(std::move(packet), t0).empty());
+        // Gap - the pending packet is flushed
+        packet = packets.at(3);
+        auto released = coalescer.insert(std::move(packet), t0);
+        REQUIRE(released.size() == 1);
+        REQUIRE(released.at(0).second.number_of_samples() == 20);
+        REQUIRE(coalescer.size() == 1);
+        REQUIRE(coalescer.release(t0 + std::chrono::milliseconds {50}).empty());
+        released = coalescer.release(t0 + std::chrono::milliseconds {150});
+        REQUIRE(released.size() == 1);
+        REQUIRE(released.at(0).second.start_time()
+             == packets.at(3).start_time());
+        REQUIRE(coalescer.size() == 0);
+    }
+
+    SECTION("Simulated clock")
+    {
+        // A clock that starts at the epoch, e.g., in a simulation
+        PacketCoalescer coalescer{options};
+        const Clock::time_point epoch{};
+        auto packet = packets.at(0);
+        REQUIRE(coalescer.insert(std::move(packet), epoch).empty());
+        REQUIRE(coalescer.release(epoch + std::chrono::milliseconds {50}).empty());
+        auto released
+            = coalescer.release(epoch + std::chrono::milliseconds {150});
+        REQUIRE(released.size() == 1);
+        REQUIRE(coalescer.size() == 0);
+        // The coalescer also starts over at the epoch after a release all
+        packet = packets.at(1);
+        REQUIRE(coalescer.insert(std::move(packet), epoch).empty());
+        REQUIRE(coalescer.releaseAll().size() == 1);
+        packet = packets.at(2);
+        REQUIRE(coalescer.insert(std::move(packet), epoch).empty());
+        released = coalescer.release(epoch + std::chrono::milliseconds {150});
+        REQUIRE(released.size() == 1);
+        REQUIRE(released.at(0).second.start_time()
+             == packets.at(2).start_time());
+    }
+
+    SECTION("Other streams and text")
+    {
+        PacketCoalescer coalescer{options};
+        auto otherPackets = ::generateContiguousPackets(2, "FORK");
+        auto packet = packets.at(0);
+        REQUIRE(coalescer.insert(std::move(packet), t0).empty());
+        packet = otherPackets.at(0);
+        REQUIRE(coalescer.insert(std::move(packet), t0).empty());
+        REQUIRE(coalescer.size() == 2);
+        auto text = packets.at(1);
+        text.set_data_type(UDataPacketImportAPI::V1::DataType::DATA_TYPE_TEXT);
+        auto released = coalescer.insert(std::move(text), t0);
+        REQUIRE(released.size() == 2);
+        REQUIRE(released.at(0).second.start_time()
+             == packets.at(0).start_time());
+        REQUIRE(released.at(1).second.data_type()
+             == UDataPacketImportAPI::V1::DataType::DATA_TYPE_TEXT);
+        released = coalescer.releaseAll();
+        REQUIRE(released.size() == 1);
+        REQUIRE(released.at(0).second.stream_identifier().station()
+             == "FORK");
+    }
+
+    SECTION("Merged packets carry their lowest journal sequence number")
+    {
+        PacketCoalescer coalescer{options};
+        REQUIRE(!coalescer.getLowestJournalSequence());
+        auto packet = packets.at(0);
+        REQUIRE(coalescer.insert(std::move(packet), t0, 7).empty());
+        packet = packets.at(1);
+        REQUIRE(coalescer.insert(std::move(packet), t0, 5).empty());
+        packet = packets.at(2);
+        REQUIRE(coalescer.insert(std::move(packet), t0, 9).empty());
+        REQUIRE(coalescer.getLowestJournalSequence() == 5);
+        auto released = coalescer.releaseAll();
+        REQUIRE(released.size() == 1);
+        REQUIRE(released.at(0).first == 5);
+        REQUIRE(released.at(0).second.number_of_samples() == 30);
+        REQUIRE(!coalescer.getLowestJournalSequence());
+    }
+}
@@ -0,0 +1,176 @@
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include "uDataPacketImportProxy/packetJournal.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "packetUtilities.hpp"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+[[nodiscard]] std::filesystem::path makeJournalFile(const std::string &name)
+{
+    auto fileName
+        = std::filesystem::temp_directory_path()
+        / ("uDataPacketImportProxyJournalTest-" + name + ".jnl");
+    std::filesystem::remove(fileName);
+    return fileName;
+}
+
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketJournal", "[packetJournalOptions]")
+{
+    SECTION("Defaults")
+    {
+        const PacketJournalOptions options;
+        REQUIRE(!options.haveFileName());
+        REQUIRE(options.getCapacityInBytes() == 64*1024*1024);
+        REQUIRE(options.getSlotSizeInBytes() == 4096);
+        REQUIRE(options.getSynchronizationInterval() == 1024);
+        REQUIRE(options.getMaximumReplayWait() == std::chrono::seconds {10});
+    }
+    SECTION("Options")
+    {
+        const std::filesystem::path fileName{"/tmp/proxy.jnl"};
+        constexpr int64_t capacity{128*1024};
+        constexpr int slotSize{2048};
+        constexpr int interval{10};
+        constexpr std::chrono::milliseconds wait{250};
+        PacketJournalOptions options;
+        options.setFileName(fileName);
+        options.setCapacityInBytes(capacity);
+        options.setSlotSizeInBytes(slotSize);
+        options.setSynchronizationInterval(interval);
+        options.setMaximumReplayWait(wait);
+        REQUIRE(options.getFileName() == fileName);
+        REQUIRE(options.getCapacityInBytes() == capacity);
+        REQUIRE(options.getSlotSizeInBytes() == slotSize);
+        REQUIRE(options.getSynchronizationInterval() == interval);
+        REQUIRE(options.getMaximumReplayWait() == wait);
+        REQUIRE_THROWS(options.setSlotSizeInBytes(128));
+        REQUIRE_THROWS(options.setSlotSizeInBytes(1001));
+    }
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketJournal", "[packetJournal]")
+{
+    auto packets = ::generatePackets(40, "UU", "CWU", "HHZ", "01");
+    PacketJournalOptions options;
+    options.setCapacityInBytes(64*1024);
+    options.setSynchronizationInterval(4);
+
+    SECTION("Replay uncommitted packets")
+    {
+        auto fileName = ::makeJournalFile("replay");
+        options.setFileName(fileName);
+        {
+        PacketJournal journal{options};
+        REQUIRE(journal.takeUncommittedPackets().empty());
+        uint64_t previous{0};
+        for (int i = 0; i < 10; ++i)
+        {
+            auto sequence = journal.append(packets.at(i));
+            REQUIRE(sequence > previous);
+            previous = sequence;
+            if (i < 6){journal.commit(sequence);}
+        }
+        REQUIRE(journal.getCommittedSequence() == 6);
+        // Commits never move backwards
+        journal.commit(2);
+        REQUIRE(journal.getCommittedSequence() == 6);
+        }
+        {
+        PacketJournal journal{options};
+        REQUIRE(journal.getCommittedSequence() == 6);
+        REQUIRE(journal.getNextSequence() == 11);
+        auto uncommitted = journal.takeUncommittedPackets();
+        REQUIRE(uncommitted.size() == 4);
+        for (int i = 0; i < 4; ++i)
+        {
+            REQUIRE(uncommitted.at(i).first == static_cast<uint64_t> (7 + i));
+            REQUIRE(uncommitted.at(i).second.start_time()
+                 == packets.at(6 + i).start_time());
+            REQUIRE(uncommitted.at(i).second.data()
+                 == packets.at(6 + i).data());
+        }
+        REQUIRE(journal.takeUncommittedPackets().empty());
+        }
+        std::filesystem::remove(fileName);
+    }
+
+    SECTION("Wrap around")
+    {
+        auto fileName = ::makeJournalFile("wrap");
+        options.setFileName(fileName);
+        uint64_t lastSequence{0};
+        {
+        PacketJournal journal{options};
+        // Write enough to wrap the 16 slot ring several times
+        for (int k = 0; k < 20; ++k)
+        {
+            for (const auto &packet : packets)
+            {
+                lastSequence = journal.append(packet);
+                journal.commit(lastSequence);
+            }
+        }
+        lastSequence = journal.append(packets.back());
+        journal.synchronize();
+        }
+        {
+        PacketJournal journal{options};
+        REQUIRE(journal.getNextSequence() == lastSequence + 1);
+        auto uncommitted = journal.takeUncommittedPackets();
+        REQUIRE(uncommitted.size() == 1);
+        REQUIRE(uncommitted.at(0).first == lastSequence);
+        REQUIRE(uncommitted.at(0).second.start_time()
+             == packets.back().start_time());
+        }
+        std::filesystem::remove(fileName);
+    }
+
+    SECTION("Refuse to overwrite uncommitted packets")
+    {
+        auto fileName = ::makeJournalFile("overflow");
+        options.setFileName(fileName);
+        PacketJournal journal{options};
+        REQUIRE(journal.getNumberOfSlots() == 16);
+        uint64_t lastSequence{0};
+        bool overflowed{false};
+        for (int k = 0; k < 20 && !overflowed; ++k)
+        {
+            for (const auto &packet : packets)
+            {
+                try
+                {
+                    lastSequence = journal.append(packet);
+                }
+                catch (const std::runtime_error &)
+                {
+                    overflowed = true;
+                    break;
+                }
+            }
+        }
+        REQUIRE(overflowed);
+        REQUIRE(lastSequence == journal.getNumberOfSlots());
+        REQUIRE(journal.getNumberOfOverflows() == 1);
+        REQUIRE(journal.getNextSequence() == lastSequence + 1);
+        // Committing frees the ring
+        journal.commit(lastSequence);
+        REQUIRE(journal.append(packets.front()) == lastSequence + 1);
+        REQUIRE(journal.getNumberOfOverflows() == 1);
+        // A packet larger than a slot is never journaled
+        auto bigPacket = packets.front();
+        bigPacket.set_data(std::string(8192, 'x'));
+        REQUIRE_THROWS_AS(journal.append(bigPacket), std::invalid_argument);
+        std::filesystem::remove(fileName);
+    }
+}
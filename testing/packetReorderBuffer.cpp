@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <google/protobuf/util/time_util.h>
+#include "uDataPacketImportProxy/packetReorderBuffer.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "packetUtilities.hpp"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+[[nodiscard]] bool isSorted(
+    const std::vector<UDataPacketImportAPI::V1::Packet> &packets)
+{
+    return std::is_sorted(packets.begin(), packets.end(),
+                          [](const auto &lhs, const auto &rhs)
+                          {
+                              return lhs.start_time() < rhs.start_time();
+                          });
+}
+
+[[nodiscard]] bool isSorted(
+    const std::vector<std::pair<uint64_t, UDataPacketImportAPI::V1::Packet>> &packets)
+{
+    return std::is_sorted(packets.begin(), packets.end(),
+                          [](const auto &lhs, const auto &rhs)
+                          {
+                              return lhs.second.start_time()
+                                   < rhs.second.start_time();
+                          });
+}
+
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketReorderBuffer",
+          "[packetReorderBufferOptions]")
+{
+    PacketReorderBufferOptions options;
+    REQUIRE(options.getWindow() == std::chrono::milliseconds {500});
+    REQUIRE(options.getMaximumNumberOfPacketsPerStream() == 64);
+    options.setWindow(std::chrono::milliseconds {250});
+    options.setMaximumNumberOfPacketsPerStream(8);
+    REQUIRE(options.getWindow() == std::chrono::milliseconds {250});
+    REQUIRE(options.getMaximumNumberOfPacketsPerStream() == 8);
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketReorderBuffer",
+          "[packetReorderBuffer]")
+{
+    using Clock = PacketReorderBuffer::Clock;
+    constexpr std::chrono::milliseconds window{100};
+    PacketReorderBufferOptions options;
+    options.setWindow(window);
+    options.setMaximumNumberOfPacketsPerStream(16);
+    auto packets = ::generatePackets(12, "UU", "CWU", "HHZ", "01");
+    auto otherPackets = ::generatePackets(4, "UU", "FORK", "HHN", "01");
+
+    SECTION("Out of order packets are released in order")
+    {
+        PacketReorderBuffer buffer{options};
+        auto t0 = Clock::now();
+        std::vector<int> order{1, 0, 3, 2, 5, 4};
+        for (int i = 0; i < static_cast<int> (order.size()); ++i)
+        {
+            auto packet = packets.at(order.at(i));
+            auto now = t0 + std::chrono::milliseconds {i};
+            REQUIRE(buffer.insert(std::move(packet), now).empty());
+        }
+        auto otherPacket = otherPackets.at(0);
+        REQUIRE(buffer.insert(std::move(otherPacket), t0).empty());
+        REQUIRE(buffer.size() == 7);
+        // Nothing has expired
+        REQUIRE(buffer.release(t0 + window/2).empty());
+        // Everything has expired
+        auto released = buffer.release(t0 + 2*window);
+        REQUIRE(released.size() == 7);
+        REQUIRE(buffer.size() == 0);
+        std::vector<UDataPacketImportAPI::V1::Packet> hhz;
+        for (const auto &[sequence, packet] : released)
+        {
+            if (packet.stream_identifier().channel() == "HHZ")
+            {
+                hhz.push_back(packet);
+            }
+        }
+        REQUIRE(hhz.size() == 6);
+        REQUIRE(::isSorted(hhz));
+        REQUIRE(hhz.front().start_time() == packets.at(0).start_time());
+    }
+
+    SECTION("Partial release")
+    {
+        PacketReorderBuffer buffer{options};
+        auto t0 = Clock::now();
+        auto packet = packets.at(2);
+        REQUIRE(buffer.insert(std::move(packet), t0).empty());
+        packet = packets.at(0);
+        REQUIRE(buffer.insert(std::move(packet), t0 + window/2).empty());
+        packet = packets.at(4);
+        REQUIRE(buffer.insert(std::move(packet), t0 + window/2).empty());
+        // Packet 2 expired so packets 0 and 2 go out
+        auto released = buffer.release(t0 + window);
+        REQUIRE(released.size() == 2);
+        REQUIRE(released.at(0).second.start_time()
+             == packets.at(0).start_time());
+        REQUIRE(released.at(1).second.start_time()
+             == packets.at(2).start_time());
+        REQUIRE(buffer.size() == 1);
+        // A straggler that is too late passes straight through
+        packet = packets.at(1);
+        released = buffer.insert(std::move(packet), t0 + window);
+        REQUIRE(released.size() == 1);
+        // Packet 3 can still be reordered ahead of 4
+        packet = packets.at(3);
+        REQUIRE(buffer.insert(std::move(packet), t0 + window).empty());
+        released = buffer.release(t0 + 3*window);
+        REQUIRE(released.size() == 2);
+        REQUIRE(released.at(0).second.start_time()
+             == packets.at(3).start_time());
+        REQUIRE(released.at(1).second.start_time()
+             == packets.at(4).start_time());
+    }
+
+    SECTION("Simulated clock")
+    {
+        // A clock that starts at the epoch, e.g., in a simulation
+        PacketReorderBuffer buffer{options};
+        const Clock::time_point t0{};
+        auto packet = packets.at(1);
+        REQUIRE(buffer.insert(std::move(packet), t0).empty());
+        packet = packets.at(0);
+        REQUIRE(buffer.insert(std::move(packet), t0 + window/4).empty());
+        REQUIRE(buffer.release(t0 + window/2).empty());
+        auto released = buffer.release(t0 + window);
+        REQUIRE(released.size() == 2);
+        REQUIRE(::isSorted(released));
+        // The buffer also starts over at the epoch after a release all
+        packet = packets.at(2);
+        REQUIRE(buffer.insert(std::move(packet), t0 + 2*window).empty());
+        REQUIRE(buffer.releaseAll().size() == 1);
+        packet = packets.at(3);
+        REQUIRE(buffer.insert(std::move(packet), t0).empty());
+        REQUIRE(buffer.release(t0 + window).size() == 1);
+        REQUIRE(buffer.size() == 0);
+    }
+
+    SECTION("Bounded per stream")
+    {
+        options.setMaximumNumberOfPacketsPerStream(4);
+        PacketReorderBuffer buffer{options};
+        auto t0 = Clock::now();
+        int nReleased{0};
+        for (int i = static_cast<int> (packets.size()) - 1; i >= 0; --i)
+        {
+            auto packet = packets.at(i);
+            nReleased = nReleased
+               + static_cast<int> (buffer.insert(std::move(packet), t0).size());
+        }
+        REQUIRE(buffer.size() == 4);
+        REQUIRE(nReleased == static_cast<int> (packets.size()) - 4);
+        auto released = buffer.releaseAll();
+        REQUIRE(released.size() == 4);
+        REQUIRE(::isSorted(released));
+        REQUIRE(buffer.size() == 0);
+    }
+
+    SECTION("Journal sequence numbers travel with the packets")
+    {
+        PacketReorderBuffer buffer{options};
+        auto t0 = Clock::now();
+        REQUIRE(!buffer.getLowestJournalSequence());
+        std::vector<int> order{1, 0, 2};
+        for (int i = 0; i < static_cast<int> (order.size()); ++i)
+        {
+            auto packet = packets.at(order.at(i));
+            REQUIRE(buffer.insert(std::move(packet),
+                                  t0,
+                                  static_cast<uint64_t> (10 + i)).empty());
+        }
+        REQUIRE(buffer.getLowestJournalSequence() == 10);
+        auto released = buffer.releaseAll();
+        REQUIRE(released.size() == 3);
+        REQUIRE(released.at(0).first == 11);
+        REQUIRE(released.at(0).second.start_time()
+             == packets.at(0).start_time());
+        REQUIRE(released.at(1).first == 10);
+        REQUIRE(released.at(2).first == 12);
+        REQUIRE(!buffer.getLowestJournalSequence());
+    }
+}
@@ -0,0 +1,180 @@
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include "uDataPacketImportProxy/packetSpool.hpp"
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "packetUtilities.hpp"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+[[nodiscard]] std::filesystem::path makeSpoolDirectory(const std::string &name)
+{
+    auto directory
+        = std::filesystem::temp_directory_path()
+        / ("uDataPacketImportProxySpoolTest-" + name);
+    std::filesystem::remove_all(directory);
+    return directory;
+}
+
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketSpool", "[packetSpoolOptions]")
+{
+    SECTION("Defaults")
+    {
+        const PacketSpoolOptions options;
+        REQUIRE(!options.haveDirectory());
+        REQUIRE(options.getSegmentSizeInBytes() == 16*1024*1024);
+        REQUIRE(options.getMaximumSizeInBytes() == 1024*1024*1024);
+    }
+    SECTION("Options")
+    {
+        const std::filesystem::path directory{"/tmp/spool"};
+        constexpr int64_t segmentSize{4096};
+        constexpr int64_t maximumSize{65536};
+        PacketSpoolOptions options;
+        options.setDirectory(directory);
+        options.setSegmentSizeInBytes(segmentSize);
+        options.setMaximumSizeInBytes(maximumSize);
+        REQUIRE(options.getDirectory() == directory);
+        REQUIRE(options.getSegmentSizeInBytes() == segmentSize);
+        REQUIRE(options.getMaximumSizeInBytes() == maximumSize);
+    }
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketSpool", "[packetSpool]")
+{
+    auto packets = ::generatePackets(40, "UU", "CWU", "HHZ", "01");
+
+    SECTION("First in first out with rotation")
+    {
+        auto directory = ::makeSpoolDirectory("fifo");
+        PacketSpoolOptions options;
+        options.setDirectory(directory);
+        // Roughly two packets per segment
+        options.setSegmentSizeInBytes(2500);
+        {
+        PacketSpool spool{options};
+        REQUIRE(spool.empty());
+        REQUIRE(!spool.pop());
+        for (int i = 0; i < 20; ++i)
+        {
+            REQUIRE(spool.push(packets.at(i)));
+        }
+        REQUIRE(spool.getNumberOfPackets() == 20);
+        // Interleave reads and writes
+        for (int i = 0; i < 10; ++i)
+        {
+            auto packet = spool.pop();
+            REQUIRE(packet);
+            REQUIRE(packet->start_time() == packets.at(i).start_time());
+            REQUIRE(packet->data() == packets.at(i).data());
+        }
+        for (int i = 20; i < static_cast<int> (packets.size()); ++i)
+        {
+            REQUIRE(spool.push(packets.at(i)));
+        }
+        for (int i = 10; i < static_cast<int> (packets.size()); ++i)
+        {
+            auto packet = spool.pop();
+            REQUIRE(packet);
+            REQUIRE(packet->start_time() == packets.at(i).start_time());
+        }
+        REQUIRE(spool.empty());
+        REQUIRE(!spool.pop());
+        REQUIRE(spool.getSizeInBytes() == 0);
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    SECTION("Size cap")
+    {
+        auto directory = ::makeSpoolDirectory("cap");
+        PacketSpoolOptions options;
+        options.setDirectory(directory);
+        options.setSegmentSizeInBytes(2500);
+        options.setMaximumSizeInBytes(5000);
+        {
+        PacketSpool spool{options};
+        int nSpooled{0};
+        for (const auto &packet : packets)
+        {
+            if (spool.push(packet)){nSpooled = nSpooled + 1;}
+        }
+        REQUIRE(nSpooled > 0);
+        REQUIRE(nSpooled < static_cast<int> (packets.size()));
+        REQUIRE(spool.getSizeInBytes() <= 5000);
+        REQUIRE(spool.getNumberOfPackets() == nSpooled);
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    SECTION("Recovery")
+    {
+        auto directory = ::makeSpoolDirectory("recovery");
+        PacketSpoolOptions options;
+        options.setDirectory(directory);
+        options.setSegmentSizeInBytes(2500);
+        {
+        PacketSpool spool{options};
+        for (int i = 0; i < 10; ++i)
+        {
+            REQUIRE(spool.push(packets.at(i)));
+        }
+        auto packet = spool.pop();
+        REQUIRE(packet);
+        }
+        {
+        // The packet that was read is not replayed
+        PacketSpool spool{options};
+        REQUIRE(spool.getNumberOfPackets() == 9);
+        auto packet = spool.pop();
+        REQUIRE(packet);
+        REQUIRE(packet->stream_identifier().channel() == "HHZ");
+        REQUIRE(packet->start_time() == packets.at(1).start_time());
+        while (spool.pop()){}
+        REQUIRE(spool.empty());
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    SECTION("Recover a partially read segment")
+    {
+        auto directory = ::makeSpoolDirectory("partial");
+        PacketSpoolOptions options;
+        options.setDirectory(directory);
+        {
+        // Everything lands in the segment being written
+        PacketSpool spool{options};
+        for (int i = 0; i < 10; ++i)
+        {
+            REQUIRE(spool.push(packets.at(i)));
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            auto packet = spool.pop();
+            REQUIRE(packet);
+            REQUIRE(packet->start_time() == packets.at(i).start_time());
+        }
+        REQUIRE(spool.getNumberOfPackets() == 6);
+        }
+        {
+        PacketSpool spool{options};
+        REQUIRE(spool.getNumberOfPackets() == 6);
+        for (int i = 4; i < 10; ++i)
+        {
+            auto packet = spool.pop();
+            REQUIRE(packet);
+            REQUIRE(packet->start_time() == packets.at(i).start_time());
+        }
+        REQUIRE(spool.empty());
+        REQUIRE(!spool.pop());
+        }
+        std::filesystem::remove_all(directory);
+    }
+}
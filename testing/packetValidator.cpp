@@ -0,0 +1,127 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "uDataPacketImportAPI/v1/data_type.pb.h"
+#include "packetValidator.hpp"
+#include "packetUtilities.hpp"
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+template<typename T>
+[[nodiscard]] UDataPacketImportAPI::V1::Packet
+    createPacket(const std::vector<T> &data,
+                 const UDataPacketImportAPI::V1::DataType dataType)
+{
+    auto packet = ::generatePackets(1).at(0);
+    packet.set_data_type(dataType);
+    packet.set_number_of_samples(data.size());
+    packet.set_data(::pack(data));
+    return packet;
+}
+
+}
+
+TEST_CASE("UDataPacketImportProxy::PacketValidator", "[packetValidator]")
+{
+    SECTION("Data type sizes")
+    {
+        REQUIRE(getDataTypeSize(UDataPacketImportAPI::V1::DATA_TYPE_INTEGER_32) == 4);
+        REQUIRE(getDataTypeSize(UDataPacketImportAPI::V1::DATA_TYPE_FLOAT) == 4);
+        REQUIRE(getDataTypeSize(UDataPacketImportAPI::V1::DATA_TYPE_DOUBLE) == 8);
+        REQUIRE(getDataTypeSize(UDataPacketImportAPI::V1::DATA_TYPE_TEXT) == 1);
+        REQUIRE(getDataTypeSize(UDataPacketImportAPI::V1::DATA_TYPE_INTEGER_64) == 8);
+        REQUIRE(getDataTypeSize(UDataPacketImportAPI::V1::DATA_TYPE_UNKNOWN) == 0);
+    }
+
+    SECTION("Header")
+    {
+        auto packet = ::generatePackets(1).at(0);
+        REQUIRE(validatePacket(packet) == PacketValidationResult::Valid);
+        auto bad = packet;
+        bad.set_number_of_samples(0);
+        REQUIRE(validatePacket(bad) == PacketValidationResult::NoSamples);
+        bad = packet;
+        bad.set_data_type(UDataPacketImportAPI::V1::DATA_TYPE_UNKNOWN);
+        REQUIRE(validatePacket(bad) == PacketValidationResult::UnknownDataType);
+        bad = packet;
+        bad.set_sampling_rate(0);
+        REQUIRE(validatePacket(bad)
+             == PacketValidationResult::InvalidSamplingRate);
+        bad.set_sampling_rate(std::numeric_limits<double>::quiet_NaN());
+        REQUIRE(validatePacket(bad)
+             == PacketValidationResult::InvalidSamplingRate);
+    }
+
+    SECTION("Data length")
+    {
+        auto packet = ::generatePackets(1).at(0);
+        packet.set_number_of_samples(packet.number_of_samples() + 1);
+        REQUIRE(validatePacket(packet)
+             == PacketValidationResult::InconsistentDataLength);
+        packet.set_number_of_samples(packet.number_of_samples() - 1);
+        packet.set_data_type(UDataPacketImportAPI::V1::DATA_TYPE_DOUBLE);
+        REQUIRE(validatePacket(packet)
+             == PacketValidationResult::InconsistentDataLength);
+    }
+
+    SECTION("Non-finite values")
+    {
+        std::vector<float> floats(101, 1.5F);
+        auto packet
+            = ::createPacket(floats, UDataPacketImportAPI::V1::DATA_TYPE_FLOAT);
+        REQUIRE(validatePacket(packet) == PacketValidationResult::Valid);
+        floats.at(77) = std::numeric_limits<float>::quiet_NaN();
+        packet
+            = ::createPacket(floats, UDataPacketImportAPI::V1::DATA_TYPE_FLOAT);
+        REQUIRE(validatePacket(packet) == PacketValidationResult::NonFiniteValue);
+
+        std::vector<double> doubles(33, -2.5);
+        packet
+            = ::createPacket(doubles, UDataPacketImportAPI::V1::DATA_TYPE_DOUBLE);
+        REQUIRE(validatePacket(packet) == PacketValidationResult::Valid);
+        doubles.back() = -std::numeric_limits<double>::infinity();
+        packet
+            = ::createPacket(doubles, UDataPacketImportAPI::V1::DATA_TYPE_DOUBLE);
+        REQUIRE(validatePacket(packet) == PacketValidationResult::NonFiniteValue);
+        // Integers with the exponent bits set are perfectly fine
+        std::vector<int> integers(10, 0x7F800000);
+        packet
+            = ::createPacket(integers,
+                             UDataPacketImportAPI::V1::DATA_TYPE_INTEGER_32);
+        REQUIRE(validatePacket(packet) == PacketValidationResult::Valid);
+    }
+}
+
+// Run with ./unitTests "[benchmark]".  The validation should be a small
+// fraction of the cost of deserializing the packet from the wire.
+TEST_CASE("UDataPacketImportProxy::PacketValidator", "[.][benchmark]")
+{
+    std::vector<double> doubles(400);
+    for (int i = 0; i < static_cast<int> (doubles.size()); ++i)
+    {
+        doubles[i] = std::sin(0.01*i);
+    }
+    auto packet
+        = ::createPacket(doubles, UDataPacketImportAPI::V1::DATA_TYPE_DOUBLE);
+    auto serializedPacket = packet.SerializeAsString();
+
+    BENCHMARK("Deserialize")
+    {
+        UDataPacketImportAPI::V1::Packet workSpace;
+        return workSpace.ParseFromString(serializedPacket);
+    };
+
+    BENCHMARK("Validate")
+    {
+        return validatePacket(packet);
+    };
+}
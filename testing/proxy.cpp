@@ -22,6 +22,7 @@
 #include "uDataPacketImportProxy/proxyOptions.hpp"
 #include "uDataPacketImportProxy/proxy.hpp"
 #include "packetUtilities.hpp"
+#include "canaryProbe.hpp"
 import metrics;
 
 #define FRONTEND_BIND_HOST "0.0.0.0"
@@ -39,6 +40,7 @@ std::shared_ptr<spdlog::logger> proxyLogger{nullptr};
 
 int64_t expectedPacketsReceived{0};
 int64_t expectedPacketsSent{0};
+int numberOfFrontendServers{1};
 
 
 bool comparePackets(const std::vector<UDataPacketImportAPI::V1::Packet> &lhs,
@@ -95,6 +97,7 @@ void runProxy()
     feGRPCOptions.setPort(static_cast<uint16_t> (FRONTEND_PORT));
     UDataPacketImportProxy::FrontendOptions feOptions;
     feOptions.setGRPCOptions(feGRPCOptions);
+    feOptions.setNumberOfServers(numberOfFrontendServers);
 
     UDataPacketImportProxy::GRPCOptions beGRPCOptions;
     beGRPCOptions.setHost(BACKEND_BIND_HOST);
@@ -336,3 +339,96 @@ TEST_CASE("uDataPacketImportProxy::Proxy", "[streamSelector]")
 
 }
 
+TEST_CASE("uDataPacketImportProxy::Proxy", "[reusePort]")
+{
+    proxyLogger = spdlog::stdout_color_mt("proxyConsoleLogger4");
+    numberOfFrontendServers = 4;
+    // Each publisher opens its own connection so the kernel can hand them
+    // to different frontend servers
+    std::vector<std::vector<UDataPacketImportAPI::V1::Packet>> publisherPackets
+    {
+        ::generatePackets(5, "UU", "CWU", "HHZ", "01"),
+        ::generatePackets(5, "UU", "CWU", "HHN", "01"),
+        ::generatePackets(5, "UU", "CWU", "HHE", "01")
+    };
+    referencePackets.clear();
+    for (const auto &packets : publisherPackets)
+    {
+        referencePackets.insert(referencePackets.end(),
+                                packets.begin(), packets.end());
+    }
+    expectedPacketsReceived = referencePackets.size();
+    expectedPacketsSent = referencePackets.size();
+
+    auto proxyThread = std::thread(&runProxy);
+    std::this_thread::sleep_for(std::chrono::milliseconds {50});
+
+    auto subscriberThread = std::thread(&asyncSubscriber);
+    std::this_thread::sleep_for(std::chrono::milliseconds {10});
+
+    for (const auto &packets : publisherPackets)
+    {
+        auto publisherThread = std::thread(&asyncPacketPublisher, packets);
+        if (publisherThread.joinable()){publisherThread.join();}
+    }
+    if (proxyThread.joinable()){proxyThread.join();}
+    if (subscriberThread.joinable()){subscriberThread.join();}
+    numberOfFrontendServers = 1;
+    proxyLogger = nullptr;
+}
+
+TEST_CASE("uDataPacketImportProxy::Proxy", "[canary]")
+{
+    proxyLogger = spdlog::stdout_color_mt("proxyConsoleLogger3");
+
+    UDataPacketImportProxy::GRPCOptions feGRPCOptions;
+    feGRPCOptions.setHost(FRONTEND_BIND_HOST);
+    feGRPCOptions.setPort(static_cast<uint16_t> (FRONTEND_PORT));
+    UDataPacketImportProxy::FrontendOptions feOptions;
+    feOptions.setGRPCOptions(feGRPCOptions);
+
+    UDataPacketImportProxy::GRPCOptions beGRPCOptions;
+    beGRPCOptions.setHost(BACKEND_BIND_HOST);
+    beGRPCOptions.setPort(static_cast<uint16_t> (BACKEND_PORT));
+    UDataPacketImportProxy::BackendOptions beOptions;
+    beOptions.setGRPCOptions(beGRPCOptions);
+
+    UDataPacketImportProxy::ProxyOptions proxyOptions;
+    proxyOptions.setFrontendOptions(feOptions);
+    proxyOptions.setBackendOptions(beOptions);
+    UDataPacketImportProxy::Proxy proxy{proxyOptions, proxyLogger};
+    proxy.start();
+
+    CanaryProbeOptions probeOptions;
+    probeOptions.frontendAddress
+        = std::string {FRONTEND_HOST} + ":" + std::to_string(FRONTEND_PORT);
+    probeOptions.backendAddress
+        = std::string {BACKEND_HOST} + ":" + std::to_string(BACKEND_PORT);
+    probeOptions.interval = std::chrono::milliseconds {50};
+    probeOptions.lossTimeOut = std::chrono::milliseconds {1000};
+    probeOptions.startUpDelay = std::chrono::milliseconds {500};
+    CanaryProbe probe{probeOptions};
+    REQUIRE(probe.getStreamName() == "XX.CANRY.HHZ.00");
+    probe.start();
+    std::this_thread::sleep_for(std::chrono::seconds {3});
+    probe.stop();
+    proxy.stop();
+
+    auto statistics = probe.getStatistics();
+    auto latencies = probe.takeLatencies();
+    CHECK(statistics.packetsSent > 20);
+    // The last canary can still be in flight when the probe stops
+    CHECK(statistics.packetsReceived >= statistics.packetsSent - 1);
+    CHECK(statistics.packetsLost == 0);
+    CHECK(statistics.unexpectedPackets == 0);
+    CHECK(statistics.publisherErrors == 0);
+    CHECK(statistics.subscriberErrors == 0);
+    REQUIRE(static_cast<int64_t> (latencies.size())
+            == statistics.packetsReceived);
+    for (const auto &latency : latencies)
+    {
+        CHECK(latency.count() >= 0);
+        CHECK(latency < std::chrono::seconds {1});
+    }
+    proxyLogger = nullptr;
+}
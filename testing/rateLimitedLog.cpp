@@ -0,0 +1,53 @@
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <catch2/catch_test_macros.hpp>
+#include "rateLimitedLog.hpp"
+
+using namespace UDataPacketImportProxy;
+
+TEST_CASE("UDataPacketImportProxy::LogRateLimiter", "[rateLimitedLog]")
+{
+    SECTION("Invalid arguments")
+    {
+        REQUIRE_THROWS_AS(LogRateLimiter(0, 1), std::invalid_argument);
+        REQUIRE_THROWS_AS(LogRateLimiter(1, 0), std::invalid_argument);
+    }
+
+    SECTION("Burst then sustained rate")
+    {
+        constexpr int burst{3};
+        LogRateLimiter rateLimiter{10, burst};
+        auto now = std::chrono::steady_clock::now();
+        for (int i = 0; i < burst; ++i)
+        {
+            auto nSuppressed = rateLimiter.tryAcquire(now);
+            REQUIRE(nSuppressed);
+            REQUIRE(*nSuppressed == 0);
+        }
+        // Bucket is empty
+        for (int i = 0; i < 7; ++i)
+        {
+            REQUIRE(!rateLimiter.tryAcquire(now));
+        }
+        // Not quite a token
+        now = now + std::chrono::milliseconds {99};
+        REQUIRE(!rateLimiter.tryAcquire(now));
+        // One token is refilled every 100 ms
+        now = now + std::chrono::milliseconds {1};
+        auto nSuppressed = rateLimiter.tryAcquire(now);
+        REQUIRE(nSuppressed);
+        REQUIRE(*nSuppressed == 8);
+        REQUIRE(!rateLimiter.tryAcquire(now));
+        // A long quiet period refills the bucket but no more than the burst
+        now = now + std::chrono::seconds {60};
+        for (int i = 0; i < burst; ++i)
+        {
+            nSuppressed = rateLimiter.tryAcquire(now);
+            REQUIRE(nSuppressed);
+            REQUIRE(*nSuppressed == (i == 0 ? 1 : 0));
+        }
+        REQUIRE(!rateLimiter.tryAcquire(now));
+    }
+}
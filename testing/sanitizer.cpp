@@ -133,6 +133,7 @@ TEST_CASE("UDataPacketImportProxy::DuplicatePacketDetector", "[duplicateData]")
         options.setCircularBufferSize(circularBufferSize);
 
         DuplicatePacketDetector detector{options};
+        REQUIRE(detector.getNumberOfStreams() == 0);
         int cumulativeSamples{0}; 
         int nExamples = 2*circularBufferSize;
         for (int iPacket = 0; iPacket < nExamples; iPacket++)
@@ -151,6 +152,13 @@ TEST_CASE("UDataPacketImportProxy::DuplicatePacketDetector", "[duplicateData]")
                      packetStartTime.count());
             REQUIRE(detector.allow(packet));
         }
+        REQUIRE(detector.getNumberOfStreams() == 1);
+        auto otherPacket = packet;
+        otherPacket.mutable_stream_identifier()->set_channel("HHN");
+        REQUIRE(detector.allow(otherPacket));
+        REQUIRE(detector.getNumberOfStreams() == 2);
+        const auto copy = detector;
+        REQUIRE(copy.getNumberOfStreams() == 2);
     }   
 
     SECTION("Every other is a duplicate")
@@ -0,0 +1,538 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <google/protobuf/util/time_util.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/logger.h>
+#include <spdlog/sinks/null_sink.h>
+#include <catch2/catch_test_macros.hpp>
+#include "uDataPacketImportAPI/v1/packet.pb.h"
+#include "uDataPacketImportProxy/backendOptions.hpp"
+#include "uDataPacketImportProxy/duplicatePacketDetector.hpp"
+#include "packetPipeline.hpp"
+#include "pollBackoff.hpp"
+#include "subscriptionManager.hpp"
+#include "packetUtilities.hpp"
+import metrics;
+import getNow;
+
+// Drives the proxy's pipeline - the frontend's callback into the import
+// queue, the propagator, and the backend's subscriber queues and writers -
+// as a discrete-event simulation on a virtual clock.  The import queue and
+// propagator are the proxy's own PacketPipeline.  Hours of traffic run
+// in seconds and the same parameters always give the same latencies and
+// drops.
+
+using namespace UDataPacketImportProxy;
+
+namespace
+{
+
+struct SimulationParameters
+{
+    std::chrono::seconds duration{3600};
+    std::chrono::microseconds packetDuration{1000000};
+    int nStreams{10};
+    int nSamplesPerPacket{100};
+    /// Every stream goes quiet during the outage and then sends its
+    /// backlog this many times faster than real time.
+    std::chrono::seconds outageStart{0};
+    std::chrono::seconds outageDuration{0};
+    double backfillSpeedUp{10};
+    double duplicateFraction{0};
+    bool removeDuplicates{false};
+    int importQueueCapacity{8192};
+    int subscriberQueueCapacity{1024};
+    /// How long the propagator spends on each packet
+    std::chrono::microseconds propagationTime{20};
+    /// How long each subscriber's writer takes to put a packet on the wire
+    std::vector<std::chrono::microseconds> writeTimes{std::chrono::microseconds {100}};
+    uint32_t seed{86753};
+};
+
+struct SubscriberResult
+{
+    int64_t packetsDelivered{0};
+    int64_t packetsDropped{0};
+    std::chrono::microseconds medianLatency{0};
+    std::chrono::microseconds p99Latency{0};
+    std::chrono::microseconds maximumLatency{0};
+    bool operator==(const SubscriberResult &) const = default;
+};
+
+struct SimulationResult
+{
+    int64_t packetsPublished{0};
+    int64_t duplicatesPublished{0};
+    int64_t importQueueDrops{0};
+    int64_t duplicatesRejected{0};
+    std::vector<SubscriberResult> subscribers;
+    std::chrono::nanoseconds simulatedTime{0};
+    bool operator==(const SimulationResult &) const = default;
+};
+
+/// The propagator sleeps this long when the import queue is empty
+constexpr std::chrono::milliseconds propagatorIdleTime{15};
+
+class PipelineSimulation
+{
+public:
+    explicit PipelineSimulation(const ::SimulationParameters &parameters) :
+        mParameters(parameters),
+        mClock(std::make_shared<Utilities::VirtualClock> (mUTCStart)),
+        mLogger(std::make_shared<spdlog::logger>
+                ("simulation",
+                 std::make_shared<spdlog::sinks::null_sink_mt> ())),
+        mGenerator(parameters.seed)
+    {
+        if (mParameters.removeDuplicates)
+        {
+            mDetector = std::make_unique<DuplicatePacketDetector>
+                        (DuplicatePacketDetectorOptions {});
+        }
+        for (const auto &writeTime : mParameters.writeTimes)
+        {
+            mSubscribers.push_back(
+                Subscriber {std::make_unique<PacketStream>
+                            (mParameters.subscriberQueueCapacity,
+                             BackendOptions::SlowConsumerPolicy::DropOldest,
+                             nullptr,
+                             mLogger,
+                             mClock),
+                            PollBackoff {},
+                            writeTime,
+                            {},
+                            0,
+                            0});
+        }
+        mPipeline = std::make_unique<PacketPipeline>(
+            mParameters.importQueueCapacity,
+            PacketPipeline::Stages {mDetector.get()},
+            [this](UDataPacketImportAPI::V1::Packet &&packet,
+                   const std::chrono::steady_clock::time_point &ingestTime,
+                   const DeliveryReceipt *)
+            {
+                int nPacketsLost{0};
+                for (auto &subscriber : mSubscribers)
+                {
+                    const auto nDropped
+                        = subscriber.queue->enqueuePacket(packet,
+                                                          ingestTime,
+                                                          Tracing::Trace {});
+                    subscriber.packetsDropped
+                        = subscriber.packetsDropped + nDropped;
+                    nPacketsLost = nPacketsLost + nDropped;
+                }
+                return nPacketsLost;
+            },
+            mLogger,
+            mClock);
+        std::vector<int> data(mParameters.nSamplesPerPacket);
+        for (int i = 0; i < static_cast<int> (data.size()); ++i){data[i] = i;}
+        auto identifier = mPacketTemplate.mutable_stream_identifier();
+        identifier->set_network("XX");
+        identifier->set_station("SIM");
+        identifier->set_location_code("01");
+        mPacketTemplate.set_sampling_rate(
+            1.e6*mParameters.nSamplesPerPacket
+           /static_cast<double> (mParameters.packetDuration.count()));
+        mPacketTemplate.set_number_of_samples(mParameters.nSamplesPerPacket);
+        mPacketTemplate.set_data_type(
+            UDataPacketImportAPI::V1::DataType::DATA_TYPE_INTEGER_32);
+        mPacketTemplate.set_data(::pack(data));
+    }
+
+    [[nodiscard]] ::SimulationResult run()
+    {
+        // The streams' packets are staggered across the packet duration
+        mStreams.resize(static_cast<size_t> (mParameters.nStreams));
+        for (int i = 0; i < mParameters.nStreams; ++i)
+        {
+            mStreams[i].phase = mParameters.packetDuration*i
+                              /mParameters.nStreams;
+            schedule(getDataEndTime(i), EventType::Publish, i);
+        }
+        schedule(start(), EventType::Propagate, 0);
+        for (int i = 0; i < static_cast<int> (mSubscribers.size()); ++i)
+        {
+            schedule(start(), EventType::Write, i);
+        }
+
+        // N.B. The pipeline counts its drops in the process-wide metrics
+        auto &metrics = Metrics::MetricsSingleton::getInstance();
+        const auto importQueueDrops
+            = metrics.getDroppedPacketsCount(
+                 Metrics::DropReason::ImportOverflow);
+        const auto duplicatesRejected
+            = metrics.getDroppedPacketsCount(Metrics::DropReason::Duplicate);
+        const auto end = start() + mParameters.duration;
+        while (!mEvents.empty() && mEvents.top().time <= end)
+        {
+            const auto event = mEvents.top();
+            mEvents.pop();
+            mClock->advanceTo(event.time);
+            if (event.type == EventType::Publish)
+            {
+                publish(event.index);
+            }
+            else if (event.type == EventType::Propagate)
+            {
+                propagate();
+            }
+            else
+            {
+                write(event.index);
+            }
+        }
+
+        mResult.importQueueDrops
+            = metrics.getDroppedPacketsCount(
+                 Metrics::DropReason::ImportOverflow)
+            - importQueueDrops;
+        mResult.duplicatesRejected
+            = metrics.getDroppedPacketsCount(Metrics::DropReason::Duplicate)
+            - duplicatesRejected;
+        mResult.simulatedTime = mClock->getElapsedTime();
+        for (auto &subscriber : mSubscribers)
+        {
+            ::SubscriberResult result;
+            result.packetsDelivered = subscriber.packetsDelivered;
+            result.packetsDropped = subscriber.packetsDropped;
+            auto &latencies = subscriber.latencies;
+            if (!latencies.empty())
+            {
+                auto percentile = [&](const double p)
+                {
+                    const auto index
+                        = std::min(latencies.size() - 1,
+                                   static_cast<size_t>
+                                   (p/100*static_cast<double> (latencies.size())));
+                    std::nth_element(latencies.begin(),
+                                     latencies.begin() + index,
+                                     latencies.end());
+                    return std::chrono::microseconds {latencies[index]};
+                };
+                result.medianLatency = percentile(50);
+                result.p99Latency = percentile(99);
+                result.maximumLatency
+                    = std::chrono::microseconds
+                      {*std::max_element(latencies.begin(), latencies.end())};
+            }
+            mResult.subscribers.push_back(result);
+        }
+        return mResult;
+    }
+
+private:
+    enum class EventType
+    {
+        Publish,
+        Propagate,
+        Write
+    };
+
+    struct Event
+    {
+        std::chrono::steady_clock::time_point time;
+        int64_t order{0}; // Breaks ties in the order of scheduling
+        EventType type{EventType::Publish};
+        int index{0};
+        bool operator>(const Event &rhs) const noexcept
+        {
+            if (time == rhs.time){return order > rhs.order;}
+            return time > rhs.time;
+        }
+    };
+
+    struct Stream
+    {
+        std::chrono::microseconds phase{0};
+        int64_t nextSequence{0};
+    };
+
+    struct Subscriber
+    {
+        std::unique_ptr<PacketStream> queue;
+        PollBackoff backoff;
+        std::chrono::microseconds writeTime;
+        std::vector<int64_t> latencies; // Microseconds
+        int64_t packetsDelivered{0};
+        int64_t packetsDropped{0};
+    };
+
+    [[nodiscard]] std::chrono::steady_clock::time_point start() const
+    {
+        return std::chrono::steady_clock::time_point {};
+    }
+
+    void schedule(const std::chrono::steady_clock::time_point &time,
+                  const EventType type,
+                  const int index)
+    {
+        mEvents.push(Event {time, mOrder, type, index});
+        mOrder = mOrder + 1;
+    }
+
+    /// When the stream's next packet is complete and can be sent
+    [[nodiscard]] std::chrono::steady_clock::time_point
+        getDataEndTime(const int stream) const
+    {
+        const auto &state = mStreams[stream];
+        return start() + state.phase
+             + mParameters.packetDuration*(state.nextSequence + 1);
+    }
+
+    /// A datalogger sends its stream's next packet
+    void publish(const int stream)
+    {
+        const auto now = mClock->now();
+        const auto outageStart = start() + mParameters.outageStart;
+        const auto outageEnd = outageStart + mParameters.outageDuration;
+        if (now >= outageStart && now < outageEnd)
+        {
+            schedule(outageEnd, EventType::Publish, stream);
+            return;
+        }
+        auto &state = mStreams[stream];
+        auto packet = mPacketTemplate;
+        packet.mutable_stream_identifier()->set_channel(
+            "H" + std::to_string(stream));
+        const auto startTime
+            = std::chrono::duration_cast<std::chrono::microseconds>
+              (mUTCStart.time_since_epoch())
+            + state.phase + mParameters.packetDuration*state.nextSequence;
+        *packet.mutable_start_time()
+            = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(
+                 startTime.count());
+        state.nextSequence = state.nextSequence + 1;
+        mResult.packetsPublished = mResult.packetsPublished + 1;
+        if (mParameters.duplicateFraction > 0 &&
+            mUniform(mGenerator) < mParameters.duplicateFraction)
+        {
+            mResult.duplicatesPublished = mResult.duplicatesPublished + 1;
+            mPipeline->admit(UDataPacketImportAPI::V1::Packet {packet});
+        }
+        mPipeline->admit(std::move(packet));
+        // Send the backlog faster than real time
+        auto next = getDataEndTime(stream);
+        if (next < now)
+        {
+            next = now
+                 + std::chrono::duration_cast<std::chrono::microseconds>
+                   (mParameters.packetDuration/mParameters.backfillSpeedUp);
+        }
+        schedule(next, EventType::Publish, stream);
+    }
+
+    /// One pass of the proxy's propagator loop
+    void propagate()
+    {
+        const auto now = mClock->now();
+        if (mPipeline->step())
+        {
+            schedule(now + mParameters.propagationTime,
+                     EventType::Propagate,
+                     0);
+            return;
+        }
+        schedule(now + propagatorIdleTime, EventType::Propagate, 0);
+    }
+
+    /// One pass of a subscriber's write pump
+    void write(const int index)
+    {
+        auto &subscriber = mSubscribers[index];
+        const auto now = mClock->now();
+        auto packet = subscriber.queue->dequeuePacket();
+        if (!packet)
+        {
+            schedule(now + subscriber.backoff.next(), EventType::Write, index);
+            return;
+        }
+        subscriber.backoff.reset();
+        const auto delivered = now + subscriber.writeTime;
+        subscriber.latencies.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>
+            (delivered - packet->ingestTime).count());
+        subscriber.packetsDelivered = subscriber.packetsDelivered + 1;
+        schedule(delivered, EventType::Write, index);
+    }
+
+    ::SimulationParameters mParameters;
+    std::chrono::system_clock::time_point mUTCStart
+    {
+        std::chrono::sys_days {std::chrono::year {2026}/std::chrono::January/1}
+    };
+    std::shared_ptr<Utilities::VirtualClock> mClock{nullptr};
+    std::shared_ptr<spdlog::logger> mLogger{nullptr};
+    std::unique_ptr<DuplicatePacketDetector> mDetector{nullptr};
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> mEvents;
+    std::vector<Stream> mStreams;
+    std::vector<Subscriber> mSubscribers;
+    std::unique_ptr<PacketPipeline> mPipeline{nullptr};
+    UDataPacketImportAPI::V1::Packet mPacketTemplate;
+    ::SimulationResult mResult;
+    std::mt19937 mGenerator;
+    std::uniform_real_distribution<double> mUniform{0, 1};
+    int64_t mOrder{0};
+};
+
+[[nodiscard]] ::SimulationResult simulate(
+    const ::SimulationParameters &parameters)
+{
+    ::PipelineSimulation simulation{parameters};
+    return simulation.run();
+}
+
+}
+
+TEST_CASE("UDataPacketImportProxy::Simulation", "[virtualClock]")
+{
+    SECTION("Virtual clock")
+    {
+        const std::chrono::sys_days origin{std::chrono::year {2026}
+                                          /std::chrono::March/15};
+        Utilities::VirtualClock clock{origin};
+        REQUIRE(clock.getUTCNow() == origin);
+        REQUIRE(clock.now() == std::chrono::steady_clock::time_point {});
+        clock.sleepFor(std::chrono::hours {6});
+        REQUIRE(clock.getElapsedTime() == std::chrono::hours {6});
+        REQUIRE(clock.getUTCNow() == origin + std::chrono::hours {6});
+        // Going backwards is not allowed and advancing to the past is ignored
+        REQUIRE_THROWS_AS(clock.advance(std::chrono::seconds {-1}),
+                          std::invalid_argument);
+        clock.advanceTo(std::chrono::steady_clock::time_point {}
+                      + std::chrono::hours {1});
+        REQUIRE(clock.getElapsedTime() == std::chrono::hours {6});
+        clock.advanceTo(std::chrono::steady_clock::time_point {}
+                      + std::chrono::hours {7});
+        REQUIRE(clock.getElapsedTime() == std::chrono::hours {7});
+        REQUIRE(Utilities::getNow(clock)
+             == std::chrono::duration_cast<std::chrono::microseconds>
+                ((origin + std::chrono::hours {7}).time_since_epoch()));
+    }
+    SECTION("Poll backoff")
+    {
+        PollBackoff backoff{std::chrono::milliseconds {10},
+                            std::chrono::milliseconds {250}};
+        const std::vector<int> expected{10, 20, 40, 80, 160, 250, 250};
+        for (const auto &interval : expected)
+        {
+            REQUIRE(backoff.next().count() == interval);
+        }
+        backoff.reset();
+        REQUIRE(backoff.next().count() == 10);
+        REQUIRE_THROWS_AS(PollBackoff(std::chrono::milliseconds {0},
+                                      std::chrono::milliseconds {10}),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(PollBackoff(std::chrono::milliseconds {20},
+                                      std::chrono::milliseconds {10}),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("UDataPacketImportProxy::Simulation", "[simulation]")
+{
+    SECTION("Hours of steady traffic")
+    {
+        ::SimulationParameters parameters;
+        parameters.duration = std::chrono::hours {6};
+        const auto result = ::simulate(parameters);
+        REQUIRE(result.simulatedTime >= std::chrono::hours {6});
+        REQUIRE(result.packetsPublished
+             >= 6*3600*parameters.nStreams - parameters.nStreams);
+        REQUIRE(result.importQueueDrops == 0);
+        const auto &subscriber = result.subscribers.at(0);
+        REQUIRE(subscriber.packetsDropped == 0);
+        REQUIRE(subscriber.packetsDelivered
+             >= result.packetsPublished - parameters.nStreams);
+        // A packet waits at most for the idle propagator to wake and for the
+        // idle writer's longest poll interval
+        REQUIRE(subscriber.maximumLatency
+             <= propagatorIdleTime + std::chrono::milliseconds {250}
+              + parameters.propagationTime + parameters.writeTimes.at(0));
+        REQUIRE(subscriber.medianLatency <= subscriber.p99Latency);
+    }
+
+    SECTION("Slow subscriber")
+    {
+        // The slow subscriber can take 5 of the 10 packets/s
+        ::SimulationParameters parameters;
+        parameters.writeTimes = {std::chrono::microseconds {100},
+                                 std::chrono::microseconds {200000}};
+        const auto result = ::simulate(parameters);
+        const auto &fast = result.subscribers.at(0);
+        const auto &slow = result.subscribers.at(1);
+        REQUIRE(fast.packetsDropped == 0);
+        REQUIRE(slow.packetsDropped > 0);
+        REQUIRE(slow.packetsDelivered + slow.packetsDropped
+             <= result.packetsPublished);
+        REQUIRE(slow.packetsDelivered + slow.packetsDropped
+              + parameters.subscriberQueueCapacity + parameters.nStreams
+             >= result.packetsPublished);
+        // Once full, the slow subscriber only sees packets that survived
+        // a full queue's worth of arrivals - i.e., about 100 s old
+        REQUIRE(slow.medianLatency > std::chrono::seconds {60});
+        REQUIRE(fast.maximumLatency < std::chrono::seconds {1});
+    }
+
+    SECTION("Outage and backfill")
+    {
+        // A 10 minute outage is backfilled at 100 packets/s but the
+        // propagator only manages 50 packets/s so the import queue overflows
+        ::SimulationParameters parameters;
+        parameters.outageStart = std::chrono::seconds {600};
+        parameters.outageDuration = std::chrono::seconds {600};
+        parameters.importQueueCapacity = 1000;
+        parameters.propagationTime = std::chrono::milliseconds {20};
+        const auto result = ::simulate(parameters);
+        REQUIRE(result.importQueueDrops > 0);
+        const auto &subscriber = result.subscribers.at(0);
+        REQUIRE(subscriber.packetsDelivered + result.importQueueDrops
+             <= result.packetsPublished);
+        // The backlog is caught up well before the end of the hour
+        REQUIRE(subscriber.packetsDelivered + result.importQueueDrops
+             >= result.packetsPublished - parameters.nStreams);
+
+        // Without the backlog squeeze nothing is lost
+        parameters.importQueueCapacity = 8192;
+        const auto roomy = ::simulate(parameters);
+        REQUIRE(roomy.importQueueDrops == 0);
+    }
+
+    SECTION("Duplicates")
+    {
+        ::SimulationParameters parameters;
+        parameters.removeDuplicates = true;
+        parameters.duplicateFraction = 0.05;
+        const auto result = ::simulate(parameters);
+        REQUIRE(result.duplicatesPublished > 0);
+        REQUIRE(result.duplicatesRejected == result.duplicatesPublished);
+        REQUIRE(result.subscribers.at(0).packetsDropped == 0);
+    }
+
+    SECTION("Reproducible")
+    {
+        ::SimulationParameters parameters;
+        parameters.removeDuplicates = true;
+        parameters.duplicateFraction = 0.01;
+        parameters.outageStart = std::chrono::seconds {900};
+        parameters.outageDuration = std::chrono::seconds {300};
+        parameters.importQueueCapacity = 500;
+        parameters.propagationTime = std::chrono::milliseconds {15};
+        parameters.writeTimes = {std::chrono::microseconds {100},
+                                 std::chrono::microseconds {150000}};
+        const auto first = ::simulate(parameters);
+        const auto second = ::simulate(parameters);
+        REQUIRE(first == second);
+        REQUIRE(first.importQueueDrops > 0);
+        REQUIRE(first.subscribers.at(1).packetsDropped > 0);
+    }
+}
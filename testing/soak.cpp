@@ -0,0 +1,965 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <malloc.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <boost/program_options.hpp>
+#include <grpc/grpc.h>
+#include <grpcpp/grpcpp.h>
+#include <google/protobuf/util/time_util.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/logger.h>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include "uDataPacketImportAPI/v1/admin.pb.h"
+#include "uDataPacketImportAPI/v1/backend.grpc.pb.h"
+#include "uDataPacketImportAPI/v1/frontend.grpc.pb.h"
+#include "uDataPacketImportProxy/admin.hpp"
+#include "uDataPacketImportProxy/backendOptions.hpp"
+#include "uDataPacketImportProxy/duplicatePacketDetector.hpp"
+#include "uDataPacketImportProxy/frontendOptions.hpp"
+#include "uDataPacketImportProxy/grpcOptions.hpp"
+#include "uDataPacketImportProxy/proxy.hpp"
+#include "uDataPacketImportProxy/proxyOptions.hpp"
+#include "loadGeneratorCore.hpp"
+
+/// Runs a proxy for hours while publishers and subscribers connect, stream,
+/// and disconnect (cleanly and abruptly) over localhost.  The proxy runs in
+/// a child process so its resident set and allocator statistics are not
+/// polluted by the clients.  The child periodically reports its memory and
+/// queue depths and the parent adds the end-to-end latency percentiles
+/// measured by the subscribers.  After a warm-up the samples are checked
+/// for monotonic growth - e.g., a detector or metrics table that is never
+/// purged or a subscriber queue left behind by an RPC that never finished -
+/// and for drift in the latency percentiles.
+
+namespace
+{
+
+struct Options
+{
+    std::string outputFile{"soak.csv"};
+    std::chrono::seconds duration{4*3600};
+    std::chrono::seconds warmUp{600};
+    std::chrono::seconds sampleInterval{60};
+    std::chrono::seconds publisherLifetime{120};
+    std::chrono::seconds subscriberLifetime{300};
+    double samplingRate{100};
+    double packetDuration{1};
+    double trendThreshold{0.5};
+    double growthTolerance{0.1};
+    double driftTolerance{0.5};
+    double driftSlack{5}; // Milliseconds
+    int nPublishers{8};
+    int nStreamsPerPublisher{20};
+    int nSubscribers{4};
+    int queueCapacity{8192};
+    uint32_t seed{86753};
+    uint16_t frontendPort{50110};
+    uint16_t backendPort{50111};
+    bool removeDuplicates{false};
+};
+
+[[nodiscard]] std::optional<::Options>
+    parseCommandLine(int argc, char *argv[])
+{
+    ::Options options;
+    int64_t duration{options.duration.count()};
+    int64_t warmUp{options.warmUp.count()};
+    int64_t sampleInterval{options.sampleInterval.count()};
+    int64_t publisherLifetime{options.publisherLifetime.count()};
+    int64_t subscriberLifetime{options.subscriberLifetime.count()};
+    boost::program_options::options_description description(R"""(
+The uDataPacketImportSoak runs a uDataPacketImportProxy on localhost for a
+long time while publishers and subscribers come and go.  It samples the
+proxy's resident memory, allocator statistics, queue depths, and the
+end-to-end latency percentiles, writes the samples to a CSV file, and
+fails if, after the warm-up, a sample grows monotonically or the latency
+percentiles drift.
+
+Example usage:
+    uDataPacketImportSoak --duration 28800 --publishers 16 --subscribers 8
+
+Allowed options)""");
+    description.add_options()
+        ("help", "Produces this help message")
+        ("output", boost::program_options::value<std::string>
+                   (&options.outputFile)->default_value(options.outputFile),
+         "The CSV file to which the samples are written")
+        ("duration", boost::program_options::value<int64_t>
+                     (&duration)->default_value(duration),
+         "Seconds to run")
+        ("warm-up", boost::program_options::value<int64_t>
+                    (&warmUp)->default_value(warmUp),
+         "Seconds of samples to ignore while the proxy's caches fill")
+        ("sample-interval", boost::program_options::value<int64_t>
+                            (&sampleInterval)->default_value(sampleInterval),
+         "Seconds between samples")
+        ("publishers", boost::program_options::value<int>
+                       (&options.nPublishers)->default_value(options.nPublishers),
+         "The number of concurrently connected publishers")
+        ("streams", boost::program_options::value<int>
+                    (&options.nStreamsPerPublisher)->default_value(options.nStreamsPerPublisher),
+         "The number of streams each publisher carries")
+        ("subscribers", boost::program_options::value<int>
+                        (&options.nSubscribers)->default_value(options.nSubscribers),
+         "The number of concurrently connected subscribers")
+        ("publisher-lifetime", boost::program_options::value<int64_t>
+                               (&publisherLifetime)->default_value(publisherLifetime),
+         "Average seconds a publisher stays connected before reconnecting")
+        ("subscriber-lifetime", boost::program_options::value<int64_t>
+                                (&subscriberLifetime)->default_value(subscriberLifetime),
+         "Average seconds a subscriber stays connected before reconnecting")
+        ("sampling-rate", boost::program_options::value<double>
+                          (&options.samplingRate)->default_value(options.samplingRate),
+         "Each stream's sampling rate in Hz")
+        ("packet-duration", boost::program_options::value<double>
+                            (&options.packetDuration)->default_value(options.packetDuration),
+         "Seconds of data in each packet")
+        ("queue-capacity", boost::program_options::value<int>
+                           (&options.queueCapacity)->default_value(options.queueCapacity),
+         "The capacity of the import and subscriber queues")
+        ("deduplicate", boost::program_options::bool_switch
+                        (&options.removeDuplicates),
+         "Runs the duplicate packet detector")
+        ("trend-threshold", boost::program_options::value<double>
+                            (&options.trendThreshold)->default_value(options.trendThreshold),
+         "The Kendall tau in (0,1] above which a sample is trending upward")
+        ("growth-tolerance", boost::program_options::value<double>
+                             (&options.growthTolerance)->default_value(options.growthTolerance),
+         "The relative growth over the run a trending sample may have")
+        ("drift-tolerance", boost::program_options::value<double>
+                            (&options.driftTolerance)->default_value(options.driftTolerance),
+         "The relative increase a latency percentile may have")
+        ("drift-slack", boost::program_options::value<double>
+                        (&options.driftSlack)->default_value(options.driftSlack),
+         "Milliseconds a latency percentile may increase regardless of the tolerance")
+        ("frontend-port", boost::program_options::value<uint16_t>
+                          (&options.frontendPort)->default_value(options.frontendPort),
+         "The frontend's localhost port")
+        ("backend-port", boost::program_options::value<uint16_t>
+                         (&options.backendPort)->default_value(options.backendPort),
+         "The backend's localhost port")
+        ("seed", boost::program_options::value<uint32_t>
+                 (&options.seed)->default_value(options.seed),
+         "The random number generator seed");
+    boost::program_options::variables_map vm;
+    boost::program_options::store(
+        boost::program_options::parse_command_line(argc, argv, description),
+        vm);
+    boost::program_options::notify(vm);
+    if (vm.contains("help"))
+    {
+        std::cout << description << std::endl;
+        return std::nullopt;
+    }
+    if (sampleInterval < 1)
+    {
+        throw std::invalid_argument("Sample interval must be positive");
+    }
+    if (warmUp < 0){throw std::invalid_argument("Warm-up cannot be negative");}
+    if ((duration - warmUp)/sampleInterval < 8)
+    {
+        throw std::invalid_argument(
+            "Need at least 8 samples after the warm-up");
+    }
+    if (publisherLifetime < 1 || subscriberLifetime < 1)
+    {
+        throw std::invalid_argument("Lifetimes must be positive");
+    }
+    if (options.nPublishers < 1)
+    {
+        throw std::invalid_argument("Publishers must be positive");
+    }
+    if (options.nStreamsPerPublisher < 1 ||
+        options.nStreamsPerPublisher > 1000)
+    {
+        throw std::invalid_argument("Streams must be in range [1,1000]");
+    }
+    if (options.nSubscribers < 1)
+    {
+        throw std::invalid_argument("Subscribers must be positive");
+    }
+    if (!(options.samplingRate > 0))
+    {
+        throw std::invalid_argument("Sampling rate must be positive");
+    }
+    if (std::llround(options.samplingRate*options.packetDuration) < 1)
+    {
+        throw std::invalid_argument("Packets must have at least one sample");
+    }
+    if (options.queueCapacity < 1)
+    {
+        throw std::invalid_argument("Queue capacity must be positive");
+    }
+    if (!(options.trendThreshold > 0) || options.trendThreshold > 1)
+    {
+        throw std::invalid_argument("Trend threshold must be in (0,1]");
+    }
+    if (options.growthTolerance < 0 || options.driftTolerance < 0 ||
+        options.driftSlack < 0)
+    {
+        throw std::invalid_argument("Tolerances cannot be negative");
+    }
+    options.duration = std::chrono::seconds {duration};
+    options.warmUp = std::chrono::seconds {warmUp};
+    options.sampleInterval = std::chrono::seconds {sampleInterval};
+    options.publisherLifetime = std::chrono::seconds {publisherLifetime};
+    options.subscriberLifetime = std::chrono::seconds {subscriberLifetime};
+    return options;
+}
+
+///--------------------------------------------------------------------------///
+///                                  Proxy                                   ///
+///--------------------------------------------------------------------------///
+
+/// What the proxy process reports every sample interval.  This is written
+/// to a pipe in one piece.
+struct ProxySample
+{
+    double elapsed{0}; // Seconds since the proxy started
+    int64_t residentBytes{0};
+    int64_t allocatedBytes{0};
+    int64_t packetsReceived{0};
+    int64_t packetsSent{0};
+    int64_t packetsDropped{0};
+    int64_t importQueueDepth{0};
+    int64_t subscriberQueueDepth{0};
+    int64_t writerQueueDepth{0};
+    int64_t deduplicatedStreams{0};
+    int64_t trackedPublishers{0};
+    int64_t trackedSubscribers{0};
+    int32_t publishers{0};
+    int32_t subscribers{0};
+};
+
+[[nodiscard]] int64_t getResidentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    int64_t pages{0};
+    int64_t residentPages{0};
+    statm >> pages >> residentPages;
+    return residentPages*static_cast<int64_t> (::sysconf(_SC_PAGESIZE));
+}
+
+/// Bytes handed out by malloc in every arena including large, mmap'd
+/// allocations
+[[nodiscard]] int64_t getAllocatedBytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const auto information = ::mallinfo2();
+    return static_cast<int64_t> (information.uordblks + information.hblkhd);
+#else
+    return 0;
+#endif
+}
+
+[[nodiscard]] UDataPacketImportProxy::ProxyOptions
+    createProxyOptions(const ::Options &options)
+{
+    // N.B. Leave room for publishers and subscribers that are reconnecting
+    // before the proxy notices their predecessors are gone
+    UDataPacketImportProxy::GRPCOptions frontendGRPCOptions;
+    frontendGRPCOptions.setHost("localhost");
+    frontendGRPCOptions.setPort(options.frontendPort);
+    UDataPacketImportProxy::FrontendOptions frontendOptions;
+    frontendOptions.setGRPCOptions(frontendGRPCOptions);
+    frontendOptions.setMaximumNumberOfPublishers(2*options.nPublishers);
+
+    UDataPacketImportProxy::GRPCOptions backendGRPCOptions;
+    backendGRPCOptions.setHost("localhost");
+    backendGRPCOptions.setPort(options.backendPort);
+    UDataPacketImportProxy::BackendOptions backendOptions;
+    backendOptions.setGRPCOptions(backendGRPCOptions);
+    backendOptions.setMaximumNumberOfSubscribers(2*options.nSubscribers);
+    backendOptions.setQueueCapacity(options.queueCapacity);
+
+    UDataPacketImportProxy::ProxyOptions proxyOptions;
+    proxyOptions.setFrontendOptions(frontendOptions);
+    proxyOptions.setBackendOptions(backendOptions);
+    proxyOptions.setQueueCapacity(options.queueCapacity);
+    if (options.removeDuplicates)
+    {
+        proxyOptions.setDuplicatePacketDetectorOptions(
+            UDataPacketImportProxy::DuplicatePacketDetectorOptions {});
+    }
+    return proxyOptions;
+}
+
+[[nodiscard]] ::ProxySample sampleProxy(
+    const UDataPacketImportProxy::Proxy &proxy,
+    const std::chrono::steady_clock::time_point &startTime)
+{
+    ::ProxySample sample;
+    sample.elapsed
+        = std::chrono::duration<double>
+          (std::chrono::steady_clock::now() - startTime).count();
+    sample.residentBytes = ::getResidentBytes();
+    sample.allocatedBytes = ::getAllocatedBytes();
+    const auto state = UDataPacketImportProxy::makePipelineState(0);
+    sample.packetsReceived = state.packets_received();
+    sample.packetsSent = state.packets_sent();
+    for (const auto &drop : state.drops())
+    {
+        sample.packetsDropped += drop.packets_dropped();
+    }
+    for (const auto &queue : state.queues())
+    {
+        if (queue.name() == "import")
+        {
+            sample.importQueueDepth = queue.depth();
+        }
+        else if (queue.name() == "subscriber")
+        {
+            sample.subscriberQueueDepth = queue.depth();
+        }
+        else if (queue.name() == "writer")
+        {
+            sample.writerQueueDepth = queue.depth();
+        }
+    }
+    sample.deduplicatedStreams = state.number_of_deduplicated_streams();
+    sample.trackedPublishers = state.publishers_size();
+    sample.trackedSubscribers = state.subscribers_size();
+    sample.publishers = proxy.getNumberOfPublishers();
+    sample.subscribers = proxy.getNumberOfSubscribers();
+    return sample;
+}
+
+/// Runs the proxy in the child process.  A sample is written immediately,
+/// which tells the parent the proxy is up, and then every sample interval
+/// until the parent closes the control pipe.
+[[noreturn]] void runProxy(const ::Options &options,
+                           const int controlDescriptor,
+                           const int sampleDescriptor)
+{
+    ::signal(SIGPIPE, SIG_IGN);
+    int exitCode{EXIT_SUCCESS};
+    try
+    {
+        auto logger = spdlog::stderr_color_mt("soakProxy");
+        logger->set_level(spdlog::level::warn);
+        UDataPacketImportProxy::Proxy proxy{::createProxyOptions(options),
+                                            logger};
+        proxy.start();
+        const auto startTime = std::chrono::steady_clock::now();
+        auto nextSampleTime = startTime;
+        while (true)
+        {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= nextSampleTime)
+            {
+                const auto sample = ::sampleProxy(proxy, startTime);
+                if (::write(sampleDescriptor, &sample, sizeof(sample))
+                    != static_cast<ssize_t> (sizeof(sample)))
+                {
+                    break;
+                }
+                nextSampleTime = nextSampleTime + options.sampleInterval;
+                continue;
+            }
+            pollfd control{controlDescriptor, POLLIN, 0};
+            const auto timeOut
+                = std::chrono::ceil<std::chrono::milliseconds>
+                  (nextSampleTime - now).count();
+            if (::poll(&control, 1, static_cast<int> (timeOut)) > 0){break;}
+        }
+        proxy.stop();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Proxy failed with: " << e.what() << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+    ::close(sampleDescriptor);
+    ::_exit(exitCode);
+}
+
+///--------------------------------------------------------------------------///
+///                                 Clients                                  ///
+///--------------------------------------------------------------------------///
+
+/// The end-to-end latencies measured since the last sample
+class LatencyCollector
+{
+public:
+    void add(const double latency)
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        mLatencies.push_back(latency);
+    }
+    [[nodiscard]] std::vector<double> take()
+    {
+        std::vector<double> result;
+        const std::lock_guard<std::mutex> lock(mMutex);
+        std::swap(result, mLatencies);
+        return result;
+    }
+private:
+    std::mutex mMutex;
+    std::vector<double> mLatencies; // Milliseconds
+};
+
+struct ClientStatistics
+{
+    std::atomic<int64_t> connections{0};
+    std::atomic<int64_t> packets{0};
+    std::atomic<int64_t> failures{0};
+};
+
+[[nodiscard]] std::shared_ptr<grpc::Channel>
+    createChannel(const uint16_t port)
+{
+    grpc::ChannelArguments arguments;
+    arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    return grpc::CreateCustomChannel("localhost:" + std::to_string(port),
+                                     grpc::InsecureChannelCredentials(),
+                                     arguments);
+}
+
+/// A publisher slot.  Its streams are paced in real time and it reconnects
+/// after a random lifetime - half the time after finishing the RPC and
+/// half the time by canceling it.  The streams survive the reconnect so,
+/// as far as the proxy is concerned, the same station moved to a new
+/// connection.
+void publish(const ::Options &options,
+             const int slot,
+             const std::atomic<bool> *keepRunning,
+             ::ClientStatistics *statistics)
+{
+    std::mt19937 generator(options.seed + static_cast<uint32_t> (slot));
+    std::uniform_real_distribution<double> lifetimeScale(0.5, 1.5);
+    std::bernoulli_distribution cancel(0.5);
+
+    ::PacketGeneratorOptions generatorOptions;
+    generatorOptions.station = fmt::format("S{:04d}", slot);
+    generatorOptions.origin = std::chrono::system_clock::now();
+    generatorOptions.startTime = generatorOptions.origin;
+    generatorOptions.steadyStartTime = std::chrono::steady_clock::now();
+    generatorOptions.samplingRate = options.samplingRate;
+    generatorOptions.packetDuration = options.packetDuration;
+    generatorOptions.nStreams = options.nStreamsPerPublisher;
+    generatorOptions.seed = options.seed + static_cast<uint32_t> (slot);
+    ::PacketGenerator packetGenerator{generatorOptions};
+    // A packet whose write failed is sent again on the next connection
+    std::optional<UDataPacketImportAPI::V1::Packet> unsent;
+
+    auto channel = ::createChannel(options.frontendPort);
+    auto stub = UDataPacketImportAPI::V1::Frontend::NewStub(channel);
+    while (keepRunning->load())
+    {
+        const auto disconnectTime
+            = std::chrono::steady_clock::now()
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration>
+              (std::chrono::duration<double>
+                 (lifetimeScale(generator)
+                 *static_cast<double> (options.publisherLifetime.count())));
+        const bool abrupt = cancel(generator);
+        grpc::ClientContext context;
+        UDataPacketImportAPI::V1::PublishResponse response;
+        auto writer = stub->Publish(&context, &response);
+        statistics->connections.fetch_add(1);
+        bool broken{false};
+        while (keepRunning->load() &&
+               std::chrono::steady_clock::now() < disconnectTime)
+        {
+            if (!unsent)
+            {
+                const auto due = packetGenerator.pop();
+                std::this_thread::sleep_until(due.time);
+                unsent = packetGenerator.makePacket(due.stream, due.sequence);
+            }
+            if (!writer->Write(*unsent))
+            {
+                broken = true;
+                break;
+            }
+            unsent.reset();
+            statistics->packets.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (abrupt)
+        {
+            context.TryCancel();
+        }
+        else if (!broken)
+        {
+            writer->WritesDone();
+        }
+        auto status = writer->Finish();
+        if (broken || (!abrupt && !status.ok()))
+        {
+            statistics->failures.fetch_add(1);
+            std::this_thread::sleep_for(std::chrono::seconds {1});
+        }
+    }
+}
+
+/// A subscriber slot.  It measures the latency from the end of each packet
+/// to its arrival and reconnects after a random lifetime.
+class Subscriber
+{
+public:
+    void run(const ::Options &options,
+             const int slot,
+             const std::atomic<bool> *keepRunning,
+             ::LatencyCollector *latencies,
+             ::ClientStatistics *statistics)
+    {
+        std::mt19937 generator(options.seed + 10000
+                             + static_cast<uint32_t> (slot));
+        std::uniform_real_distribution<double> lifetimeScale(0.5, 1.5);
+        auto channel = ::createChannel(options.backendPort);
+        auto stub = UDataPacketImportAPI::V1::Backend::NewStub(channel);
+        const UDataPacketImportAPI::V1::SubscriptionRequest request;
+        while (keepRunning->load())
+        {
+            auto context = std::make_unique<grpc::ClientContext> ();
+            context->set_deadline(
+                std::chrono::system_clock::now()
+              + std::chrono::duration_cast<std::chrono::system_clock::duration>
+                (std::chrono::duration<double>
+                   (lifetimeScale(generator)
+                   *static_cast<double> (options.subscriberLifetime.count()))));
+            {
+            const std::lock_guard<std::mutex> lock(mMutex);
+            if (!keepRunning->load()){break;}
+            mContext = context.get();
+            }
+            statistics->connections.fetch_add(1);
+            auto reader = stub->Subscribe(context.get(), request);
+            UDataPacketImportAPI::V1::Packet packet;
+            while (reader->Read(&packet))
+            {
+                const auto now
+                    = std::chrono::duration_cast<std::chrono::microseconds>
+                      (std::chrono::system_clock::now().time_since_epoch());
+                const auto startTime
+                    = google::protobuf::util::TimeUtil::TimestampToMicroseconds(
+                         packet.start_time());
+                const auto endTime
+                    = static_cast<double> (startTime)
+                    + 1.e6*packet.number_of_samples()/packet.sampling_rate();
+                latencies->add((static_cast<double> (now.count()) - endTime)
+                              *1.e-3);
+                statistics->packets.fetch_add(1, std::memory_order_relaxed);
+            }
+            auto status = reader->Finish();
+            {
+            const std::lock_guard<std::mutex> lock(mMutex);
+            mContext = nullptr;
+            }
+            if (keepRunning->load() &&
+                status.error_code() != grpc::StatusCode::DEADLINE_EXCEEDED)
+            {
+                statistics->failures.fetch_add(1);
+                std::this_thread::sleep_for(std::chrono::seconds {1});
+            }
+        }
+    }
+    /// Ends the current subscription
+    void cancel()
+    {
+        const std::lock_guard<std::mutex> lock(mMutex);
+        if (mContext){mContext->TryCancel();}
+    }
+private:
+    std::mutex mMutex;
+    grpc::ClientContext *mContext{nullptr};
+};
+
+///--------------------------------------------------------------------------///
+///                                 Analysis                                 ///
+///--------------------------------------------------------------------------///
+
+struct Sample
+{
+    ::ProxySample proxy;
+    double p50{0};
+    double p99{0};
+    double p999{0};
+    int64_t nLatencies{0};
+};
+
+[[nodiscard]] double percentile(std::vector<double> *values, const double p)
+{
+    if (values->empty()){return 0;}
+    const auto index
+        = static_cast<size_t> (std::min<double>
+                               (values->size() - 1,
+                                std::floor(p/100*values->size())));
+    std::nth_element(values->begin(), values->begin() + index, values->end());
+    return (*values)[index];
+}
+
+[[nodiscard]] double median(std::vector<double> values)
+{
+    return ::percentile(&values, 50);
+}
+
+struct Trend
+{
+    double tau{0};    // Kendall's tau; 1 is strictly increasing
+    double growth{0}; // Theil-Sen growth over the run relative to the scale
+};
+
+/// Uses Kendall's tau to decide whether a sample keeps growing and the
+/// Theil-Sen slope to decide by how much.  Both are insensitive to the
+/// occasional outlier, e.g., a burst of reconnects.
+[[nodiscard]] ::Trend computeTrend(const std::vector<double> &times,
+                                   const std::vector<double> &values,
+                                   const double minimumScale)
+{
+    // Keep this quadratic algorithm cheap on very long runs
+    constexpr size_t maximumNumberOfPoints{500};
+    std::vector<size_t> indices;
+    const auto stride
+        = std::max<size_t> (1, (values.size() + maximumNumberOfPoints - 1)
+                              /maximumNumberOfPoints);
+    for (size_t i = 0; i < values.size(); i = i + stride)
+    {
+        indices.push_back(i);
+    }
+    ::Trend trend;
+    if (indices.size() < 2){return trend;}
+    int64_t concordance{0};
+    std::vector<double> slopes;
+    slopes.reserve(indices.size()*(indices.size() - 1)/2);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        for (size_t j = i + 1; j < indices.size(); ++j)
+        {
+            const auto difference = values[indices[j]] - values[indices[i]];
+            if (difference > 0){concordance = concordance + 1;}
+            if (difference < 0){concordance = concordance - 1;}
+            slopes.push_back(difference
+                           /(times[indices[j]] - times[indices[i]]));
+        }
+    }
+    trend.tau = static_cast<double> (concordance)
+              /static_cast<double> (slopes.size());
+    const auto scale = std::max(::median(values), minimumScale);
+    trend.growth = ::median(std::move(slopes))
+                  *(times.back() - times.front())/scale;
+    return trend;
+}
+
+/// @result True indicates the run passed.
+[[nodiscard]] bool analyze(const std::vector<::Sample> &samples,
+                           const ::Options &options)
+{
+    std::vector<::Sample> steady;
+    for (const auto &sample : samples)
+    {
+        if (sample.proxy.elapsed >= options.warmUp.count())
+        {
+            steady.push_back(sample);
+        }
+    }
+    if (steady.size() < 8)
+    {
+        std::cerr << "Only " << steady.size()
+                  << " samples after the warm-up; cannot analyze" << std::endl;
+        return false;
+    }
+    bool passed{true};
+    std::vector<double> times;
+    for (const auto &sample : steady){times.push_back(sample.proxy.elapsed);}
+
+    struct Series
+    {
+        std::string name;
+        double minimumScale;
+        std::function<double (const ::Sample &)> get;
+    };
+    const auto queueCapacity = static_cast<double> (options.queueCapacity);
+    const std::vector<Series> series
+    {
+        {"resident bytes", 1, [](const ::Sample &s)
+            {return static_cast<double> (s.proxy.residentBytes);}},
+        {"allocated bytes", 1, [](const ::Sample &s)
+            {return static_cast<double> (s.proxy.allocatedBytes);}},
+        {"import queue depth", queueCapacity, [](const ::Sample &s)
+            {return static_cast<double> (s.proxy.importQueueDepth);}},
+        {"subscriber queue depth", queueCapacity, [](const ::Sample &s)
+            {return static_cast<double> (s.proxy.subscriberQueueDepth);}},
+        {"writer queue depth", queueCapacity, [](const ::Sample &s)
+            {return static_cast<double> (s.proxy.writerQueueDepth);}},
+        {"deduplicated streams", 1, [](const ::Sample &s)
+            {return static_cast<double> (s.proxy.deduplicatedStreams);}},
+        {"tracked publishers", static_cast<double> (options.nPublishers),
+         [](const ::Sample &s)
+            {return static_cast<double> (s.proxy.trackedPublishers);}},
+        {"tracked subscribers", static_cast<double> (options.nSubscribers),
+         [](const ::Sample &s)
+            {return static_cast<double> (s.proxy.trackedSubscribers);}}
+    };
+    std::cout << "Growth after the warm-up:" << std::endl;
+    for (const auto &s : series)
+    {
+        std::vector<double> values;
+        for (const auto &sample : steady){values.push_back(s.get(sample));}
+        const auto trend = ::computeTrend(times, values, s.minimumScale);
+        const bool failed = trend.tau > options.trendThreshold
+                         && trend.growth > options.growthTolerance;
+        std::cout << fmt::format("  {:<24} tau {:+.2f}, growth {:+.1f}% {}",
+                                 s.name,
+                                 trend.tau,
+                                 100*trend.growth,
+                                 failed ? "FAIL" : "ok")
+                  << std::endl;
+        if (failed){passed = false;}
+    }
+
+    // Compare the latency percentiles at the start and the end of the run
+    const auto nThird = steady.size()/3;
+    std::cout << "Latency drift after the warm-up:" << std::endl;
+    for (const auto &[name, get] :
+         std::vector<std::pair<std::string,
+                               std::function<double (const ::Sample &)>>>
+         {
+             {"p50", [](const ::Sample &s){return s.p50;}},
+             {"p99", [](const ::Sample &s){return s.p99;}}
+         })
+    {
+        std::vector<double> first;
+        std::vector<double> last;
+        for (size_t i = 0; i < nThird; ++i)
+        {
+            first.push_back(get(steady[i]));
+            last.push_back(get(steady[steady.size() - nThird + i]));
+        }
+        const auto before = ::median(first);
+        const auto after = ::median(last);
+        const bool failed
+            = after > before*(1 + options.driftTolerance) + options.driftSlack;
+        std::cout << fmt::format("  {:<24} {:.3f} ms -> {:.3f} ms {}",
+                                 name, before, after,
+                                 failed ? "FAIL" : "ok")
+                  << std::endl;
+        if (failed){passed = false;}
+    }
+    return passed;
+}
+
+void writeHeader(std::ofstream &csv)
+{
+    csv << "elapsed_s,resident_bytes,allocated_bytes,packets_received,"
+        << "packets_sent,packets_dropped,import_queue_depth,"
+        << "subscriber_queue_depth,writer_queue_depth,deduplicated_streams,"
+        << "tracked_publishers,tracked_subscribers,publishers,subscribers,"
+        << "latencies,p50_ms,p99_ms,p999_ms" << std::endl;
+}
+
+void writeSample(std::ofstream &csv, const ::Sample &sample)
+{
+    const auto &proxy = sample.proxy;
+    csv << fmt::format("{:.3f},{},{},{},{},{},{},{},{},{},{},{},{},{},{},{:.3f},{:.3f},{:.3f}",
+                       proxy.elapsed,
+                       proxy.residentBytes,
+                       proxy.allocatedBytes,
+                       proxy.packetsReceived,
+                       proxy.packetsSent,
+                       proxy.packetsDropped,
+                       proxy.importQueueDepth,
+                       proxy.subscriberQueueDepth,
+                       proxy.writerQueueDepth,
+                       proxy.deduplicatedStreams,
+                       proxy.trackedPublishers,
+                       proxy.trackedSubscribers,
+                       proxy.publishers,
+                       proxy.subscribers,
+                       sample.nLatencies,
+                       sample.p50,
+                       sample.p99,
+                       sample.p999)
+        << std::endl;
+}
+
+/// Blocks until the proxy sends a sample.
+/// @result False indicates the proxy process is gone.
+[[nodiscard]] bool readSample(const int descriptor, ::ProxySample *sample)
+{
+    auto buffer = reinterpret_cast<char *> (sample);
+    size_t nRead{0};
+    while (nRead < sizeof(::ProxySample))
+    {
+        const auto n = ::read(descriptor, buffer + nRead,
+                              sizeof(::ProxySample) - nRead);
+        if (n < 0 && errno == EINTR){continue;}
+        if (n <= 0){return false;}
+        nRead = nRead + static_cast<size_t> (n);
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::optional<::Options> options;
+    try
+    {
+        options = ::parseCommandLine(argc, argv);
+        if (!options){return EXIT_SUCCESS;}
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::ofstream csv(options->outputFile);
+    if (!csv)
+    {
+        std::cerr << "Could not open " << options->outputFile << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Fork before this process creates any threads or gRPC state
+    std::array<int, 2> controlPipe{-1, -1};
+    std::array<int, 2> samplePipe{-1, -1};
+    if (::pipe(controlPipe.data()) != 0 || ::pipe(samplePipe.data()) != 0)
+    {
+        std::cerr << "Could not create pipes" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const auto proxyProcess = ::fork();
+    if (proxyProcess < 0)
+    {
+        std::cerr << "Could not fork the proxy" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (proxyProcess == 0)
+    {
+        ::close(controlPipe[1]);
+        ::close(samplePipe[0]);
+        ::runProxy(*options, controlPipe[0], samplePipe[1]);
+    }
+    ::close(controlPipe[0]);
+    ::close(samplePipe[1]);
+    auto stopProxy = [&]()
+    {
+        ::close(controlPipe[1]);
+        int status{0};
+        ::waitpid(proxyProcess, &status, 0);
+        ::close(samplePipe[0]);
+        return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+    };
+
+    ::ProxySample proxySample;
+    if (!::readSample(samplePipe[0], &proxySample))
+    {
+        std::cerr << "Proxy did not start" << std::endl;
+        static_cast<void> (stopProxy());
+        return EXIT_FAILURE;
+    }
+    std::cout << fmt::format("Soaking for {} s with {} publishers ({} streams each) and {} subscribers; samples go to {}",
+                             options->duration.count(),
+                             options->nPublishers,
+                             options->nStreamsPerPublisher,
+                             options->nSubscribers,
+                             options->outputFile)
+              << std::endl;
+
+    std::atomic<bool> keepRunning{true};
+    ::LatencyCollector latencies;
+    ::ClientStatistics publisherStatistics;
+    ::ClientStatistics subscriberStatistics;
+    std::vector<std::unique_ptr<::Subscriber>> subscribers;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options->nSubscribers; ++i)
+    {
+        subscribers.push_back(std::make_unique<::Subscriber> ());
+        threads.emplace_back(&::Subscriber::run,
+                             subscribers.back().get(),
+                             std::cref(*options),
+                             i,
+                             &keepRunning,
+                             &latencies,
+                             &subscriberStatistics);
+    }
+    for (int i = 0; i < options->nPublishers; ++i)
+    {
+        threads.emplace_back(&::publish,
+                             std::cref(*options),
+                             i,
+                             &keepRunning,
+                             &publisherStatistics);
+    }
+
+    ::writeHeader(csv);
+    std::vector<::Sample> samples;
+    bool proxyAlive{true};
+    while (proxySample.elapsed < options->duration.count())
+    {
+        if (!::readSample(samplePipe[0], &proxySample))
+        {
+            proxyAlive = false;
+            break;
+        }
+        ::Sample sample;
+        sample.proxy = proxySample;
+        auto intervalLatencies = latencies.take();
+        sample.nLatencies = static_cast<int64_t> (intervalLatencies.size());
+        sample.p50 = ::percentile(&intervalLatencies, 50);
+        sample.p99 = ::percentile(&intervalLatencies, 99);
+        sample.p999 = ::percentile(&intervalLatencies, 99.9);
+        ::writeSample(csv, sample);
+        std::cout << fmt::format("{:>8.0f} s: RSS {:.1f} MB, allocated {:.1f} MB, import queue {}, p50 {:.1f} ms, p99 {:.1f} ms",
+                                 sample.proxy.elapsed,
+                                 sample.proxy.residentBytes/1.e6,
+                                 sample.proxy.allocatedBytes/1.e6,
+                                 sample.proxy.importQueueDepth,
+                                 sample.p50,
+                                 sample.p99)
+                  << std::endl;
+        samples.push_back(std::move(sample));
+    }
+
+    keepRunning.store(false);
+    for (auto &subscriber : subscribers){subscriber->cancel();}
+    for (auto &thread : threads){thread.join();}
+    const auto proxyExited = stopProxy();
+
+    std::cout << fmt::format("Publishers: {} connections, {} packets, {} failures",
+                             publisherStatistics.connections.load(),
+                             publisherStatistics.packets.load(),
+                             publisherStatistics.failures.load())
+              << std::endl;
+    std::cout << fmt::format("Subscribers: {} connections, {} packets, {} failures",
+                             subscriberStatistics.connections.load(),
+                             subscriberStatistics.packets.load(),
+                             subscriberStatistics.failures.load())
+              << std::endl;
+    if (!proxyAlive || !proxyExited)
+    {
+        std::cerr << "The proxy process died" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!::analyze(samples, *options))
+    {
+        std::cerr << "Soak test failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Soak test passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <catch2/catch_test_macros.hpp>
+#include "tracing.hpp"
+
+namespace
+{
+/// Counts the packets sampled by a thread that has not read a packet yet
+[[nodiscard]] int countSampled(const int nPackets)
+{
+    int nSampled{0};
+    std::thread thread([&]()
+    {
+        for (int i = 0; i < nPackets; ++i)
+        {
+            const auto trace
+                = UDataPacketImportProxy::Tracing::Trace::sample("test");
+            if (trace){nSampled = nSampled + 1;}
+        }
+    });
+    thread.join();
+    return nSampled;
+}
+}
+
+TEST_CASE("UDataPacketImportProxy::Tracing", "[tracing]")
+{
+    namespace UTracing = UDataPacketImportProxy::Tracing;
+    REQUIRE_THROWS_AS(UTracing::setSamplingPeriod(-1), std::invalid_argument);
+
+    SECTION("Disabled")
+    {
+        UTracing::setSamplingPeriod(0);
+        REQUIRE(UTracing::getSamplingPeriod() == 0);
+        REQUIRE(::countSampled(1000) == 0);
+    }
+
+    SECTION("One in N")
+    {
+        // N.B. Without a collector the spans go to the no-op tracer
+        constexpr int64_t samplingPeriod{4};
+        UTracing::setSamplingPeriod(samplingPeriod);
+        REQUIRE(UTracing::getSamplingPeriod() == samplingPeriod);
+        REQUIRE(::countSampled(100) == 25);
+        REQUIRE(::countSampled(1) == 1);
+        UTracing::setSamplingPeriod(0);
+    }
+
+    SECTION("Scope")
+    {
+        UTracing::setSamplingPeriod(1);
+        std::thread thread([]()
+        {
+            REQUIRE_FALSE(UTracing::current());
+            const auto trace = UTracing::Trace::sample("test");
+            REQUIRE(trace.isSampled());
+            {
+                const UTracing::Scope scope{trace};
+                REQUIRE(UTracing::current());
+                {
+                    const UTracing::Trace emptyTrace;
+                    const UTracing::Scope innerScope{emptyTrace};
+                    REQUIRE_FALSE(UTracing::current());
+                    // Spans of an empty trace do nothing
+                    UTracing::Span span{UTracing::current(), "empty"};
+                    span.end();
+                }
+                REQUIRE(UTracing::current());
+                UTracing::Span span{UTracing::current(), "stage"};
+                UTracing::Span movedSpan{std::move(span)};
+                movedSpan.end();
+            }
+            REQUIRE_FALSE(UTracing::current());
+        });
+        thread.join();
+        UTracing::setSamplingPeriod(0);
+    }
+}
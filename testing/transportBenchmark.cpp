@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <boost/program_options.hpp>
+#include <grpc/grpc.h>
+#include <grpcpp/grpcpp.h>
+#include <google/protobuf/util/time_util.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/logger.h>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/sinks/null_sink.h>
+#include "uDataPacketImportAPI/v1/backend.grpc.pb.h"
+#include "uDataPacketImportAPI/v1/frontend.grpc.pb.h"
+#include "uDataPacketImportProxy/backendOptions.hpp"
+#include "uDataPacketImportProxy/duplicatePacketDetector.hpp"
+#include "uDataPacketImportProxy/frontendOptions.hpp"
+#include "uDataPacketImportProxy/grpcOptions.hpp"
+#include "uDataPacketImportProxy/proxy.hpp"
+#include "uDataPacketImportProxy/proxyOptions.hpp"
+#include "packetUtilities.hpp"
+
+/// Pushes packets through a proxy in this process as fast as possible over
+/// one of three transports to separate the cost of the proxy's pipeline
+/// from the cost of the network:
+///   tcp       - publishers and subscribers connect over localhost,
+///   inprocess - publishers and subscribers use in-process gRPC channels,
+///   callback  - publishers call the proxy directly, skipping gRPC and the
+///               frontend, and subscribers use in-process channels.
+/// Each transport can be run with each of the gRPC server presets.  The
+/// presets mostly matter for tcp since in-process channels skip HTTP/2.
+
+namespace
+{
+
+enum class Transport
+{
+    TCP,
+    InProcess,
+    Callback
+};
+
+[[nodiscard]] std::string toString(const Transport transport)
+{
+    if (transport == Transport::TCP){return "tcp";}
+    if (transport == Transport::InProcess){return "inprocess";}
+    return "callback";
+}
+
+using ServerPreset = UDataPacketImportProxy::GRPCOptions::ServerPreset;
+
+[[nodiscard]] std::string toString(const ServerPreset preset)
+{
+    if (preset == ServerPreset::ManySmallStreams){return "manySmallStreams";}
+    if (preset == ServerPreset::FewLargeStreams){return "fewLargeStreams";}
+    return "default";
+}
+
+struct Options
+{
+    std::vector<Transport> transports{Transport::TCP,
+                                      Transport::InProcess,
+                                      Transport::Callback};
+    std::vector<ServerPreset> presets{ServerPreset::Default};
+    std::chrono::seconds idleTimeOut{2};
+    int nPublishers{4};
+    int nSubscribers{1};
+    int nPacketsPerPublisher{50000};
+    int nStreamsPerPublisher{10};
+    int nSamplesPerPacket{100};
+    int queueCapacity{8192};
+    uint16_t frontendPort{50100};
+    uint16_t backendPort{50101};
+    bool removeDuplicates{false};
+};
+
+[[nodiscard]] std::optional<::Options>
+    parseCommandLine(int argc, char *argv[])
+{
+    ::Options options;
+    std::string transport{"all"};
+    std::string preset{"default"};
+    int64_t idleTimeOut{options.idleTimeOut.count()};
+    boost::program_options::options_description description(R"""(
+The uDataPacketImportTransportBenchmark runs a proxy in this process and
+measures how many packets/s it sustains when the publishers and subscribers
+reach it over localhost TCP, over in-process gRPC channels, or - for the
+publishers - by calling the proxy directly.
+
+Allowed options)""");
+    description.add_options()
+        ("help", "Produces this help message")
+        ("transport", boost::program_options::value<std::string>
+                      (&transport)->default_value(transport),
+         "One of tcp, inprocess, callback, or all")
+        ("preset", boost::program_options::value<std::string>
+                   (&preset)->default_value(preset),
+         "The gRPC server preset - one of default, manySmallStreams, fewLargeStreams, or all")
+        ("publishers", boost::program_options::value<int>
+                       (&options.nPublishers)->default_value(options.nPublishers),
+         "The number of publishing threads")
+        ("subscribers", boost::program_options::value<int>
+                        (&options.nSubscribers)->default_value(options.nSubscribers),
+         "The number of subscribers")
+        ("packets", boost::program_options::value<int>
+                    (&options.nPacketsPerPublisher)->default_value(options.nPacketsPerPublisher),
+         "The number of packets each publisher sends")
+        ("streams", boost::program_options::value<int>
+                    (&options.nStreamsPerPublisher)->default_value(options.nStreamsPerPublisher),
+         "The number of streams each publisher carries")
+        ("samples", boost::program_options::value<int>
+                    (&options.nSamplesPerPacket)->default_value(options.nSamplesPerPacket),
+         "The number of 32 bit integer samples in each packet")
+        ("queue-capacity", boost::program_options::value<int>
+                           (&options.queueCapacity)->default_value(options.queueCapacity),
+         "The capacity of the import and subscriber queues")
+        ("frontend-port", boost::program_options::value<uint16_t>
+                          (&options.frontendPort)->default_value(options.frontendPort),
+         "The frontend's localhost port")
+        ("backend-port", boost::program_options::value<uint16_t>
+                         (&options.backendPort)->default_value(options.backendPort),
+         "The backend's localhost port")
+        ("deduplicate", boost::program_options::bool_switch
+                        (&options.removeDuplicates),
+         "Runs the duplicate packet detector")
+        ("idle-timeout", boost::program_options::value<int64_t>
+                         (&idleTimeOut)->default_value(idleTimeOut),
+         "Seconds without a delivered packet after which the subscribers give up");
+    boost::program_options::variables_map vm;
+    boost::program_options::store(
+        boost::program_options::parse_command_line(argc, argv, description),
+        vm);
+    boost::program_options::notify(vm);
+    if (vm.contains("help"))
+    {
+        std::cout << description << std::endl;
+        return std::nullopt;
+    }
+    if (transport == "tcp")
+    {
+        options.transports = {Transport::TCP};
+    }
+    else if (transport == "inprocess")
+    {
+        options.transports = {Transport::InProcess};
+    }
+    else if (transport == "callback")
+    {
+        options.transports = {Transport::Callback};
+    }
+    else if (transport != "all")
+    {
+        throw std::invalid_argument("Unknown transport " + transport);
+    }
+    if (preset == "all")
+    {
+        options.presets = {ServerPreset::Default,
+                           ServerPreset::ManySmallStreams,
+                           ServerPreset::FewLargeStreams};
+    }
+    else if (preset == "manySmallStreams")
+    {
+        options.presets = {ServerPreset::ManySmallStreams};
+    }
+    else if (preset == "fewLargeStreams")
+    {
+        options.presets = {ServerPreset::FewLargeStreams};
+    }
+    else if (preset != "default")
+    {
+        throw std::invalid_argument("Unknown preset " + preset);
+    }
+    if (options.nPublishers < 1)
+    {
+        throw std::invalid_argument("Publishers must be positive");
+    }
+    if (options.nSubscribers < 0)
+    {
+        throw std::invalid_argument("Subscribers cannot be negative");
+    }
+    if (options.nPacketsPerPublisher < 1)
+    {
+        throw std::invalid_argument("Packets must be positive");
+    }
+    if (options.nStreamsPerPublisher < 1)
+    {
+        throw std::invalid_argument("Streams must be positive");
+    }
+    if (options.nSamplesPerPacket < 1)
+    {
+        throw std::invalid_argument("Samples must be positive");
+    }
+    if (options.queueCapacity < 1)
+    {
+        throw std::invalid_argument("Queue capacity must be positive");
+    }
+    if (idleTimeOut < 1)
+    {
+        throw std::invalid_argument("Idle timeout must be positive");
+    }
+    options.idleTimeOut = std::chrono::seconds {idleTimeOut};
+    return options;
+}
+
+/// The CPU time used by every thread in the process - i.e., the proxy's,
+/// the publishers', and the subscribers'
+[[nodiscard]] double getProcessCPUTime()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double> (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+         + static_cast<double> (usage.ru_utime.tv_usec
+                              + usage.ru_stime.tv_usec)*1.e-6;
+}
+
+[[nodiscard]] double toSeconds(const std::chrono::steady_clock::duration &duration)
+{
+    return std::chrono::duration<double> (duration).count();
+}
+
+/// Each publisher's packets are made before the clock starts.  The streams
+/// take turns and each stream's packets are contiguous so the duplicate
+/// detector, if enabled, passes all of them.
+[[nodiscard]] std::vector<UDataPacketImportAPI::V1::Packet>
+    createPackets(const int publisher, const ::Options &options)
+{
+    constexpr double samplingRate{100};
+    const auto packetDuration
+        = static_cast<int64_t> (1000000*options.nSamplesPerPacket/samplingRate);
+    const auto origin
+        = std::chrono::duration_cast<std::chrono::microseconds>
+          (std::chrono::system_clock::now().time_since_epoch()).count()
+        - packetDuration*(options.nPacketsPerPublisher
+                         /options.nStreamsPerPublisher + 1);
+    std::vector<int> data(options.nSamplesPerPacket);
+    for (int i = 0; i < static_cast<int> (data.size()); ++i){data[i] = i;}
+    UDataPacketImportAPI::V1::Packet packetTemplate;
+    auto identifier = packetTemplate.mutable_stream_identifier();
+    identifier->set_network("XX");
+    identifier->set_station(fmt::format("P{:04d}", publisher));
+    identifier->set_location_code("01");
+    packetTemplate.set_sampling_rate(samplingRate);
+    packetTemplate.set_number_of_samples(options.nSamplesPerPacket);
+    packetTemplate.set_data_type(
+        UDataPacketImportAPI::V1::DataType::DATA_TYPE_INTEGER_32);
+    packetTemplate.set_data(::pack(data));
+
+    std::vector<UDataPacketImportAPI::V1::Packet> packets;
+    packets.reserve(options.nPacketsPerPublisher);
+    for (int i = 0; i < options.nPacketsPerPublisher; ++i)
+    {
+        auto packet = packetTemplate;
+        const auto stream = i%options.nStreamsPerPublisher;
+        const auto sequence = i/options.nStreamsPerPublisher;
+        packet.mutable_stream_identifier()->set_channel(
+            fmt::format("{:03d}", stream));
+        *packet.mutable_start_time()
+            = google::protobuf::util::TimeUtil::MicrosecondsToTimestamp(
+                 origin + sequence*packetDuration);
+        packets.push_back(std::move(packet));
+    }
+    return packets;
+}
+
+[[nodiscard]] UDataPacketImportProxy::ProxyOptions
+    createProxyOptions(const ServerPreset preset, const ::Options &options)
+{
+    UDataPacketImportProxy::GRPCOptions frontendGRPCOptions;
+    frontendGRPCOptions.setHost("localhost");
+    frontendGRPCOptions.setPort(options.frontendPort);
+    frontendGRPCOptions.applyServerPreset(preset);
+    UDataPacketImportProxy::FrontendOptions frontendOptions;
+    frontendOptions.setGRPCOptions(frontendGRPCOptions);
+    frontendOptions.setMaximumNumberOfPublishers(
+        std::max(options.nPublishers, 1));
+
+    UDataPacketImportProxy::GRPCOptions backendGRPCOptions;
+    backendGRPCOptions.setHost("localhost");
+    backendGRPCOptions.setPort(options.backendPort);
+    backendGRPCOptions.applyServerPreset(preset);
+    UDataPacketImportProxy::BackendOptions backendOptions;
+    backendOptions.setGRPCOptions(backendGRPCOptions);
+    backendOptions.setMaximumNumberOfSubscribers(
+        std::max(options.nSubscribers, 1));
+    backendOptions.setQueueCapacity(options.queueCapacity);
+
+    UDataPacketImportProxy::ProxyOptions proxyOptions;
+    proxyOptions.setFrontendOptions(frontendOptions);
+    proxyOptions.setBackendOptions(backendOptions);
+    proxyOptions.setQueueCapacity(options.queueCapacity);
+    if (options.removeDuplicates)
+    {
+        proxyOptions.setDuplicatePacketDetectorOptions(
+            UDataPacketImportProxy::DuplicatePacketDetectorOptions {});
+    }
+    return proxyOptions;
+}
+
+[[nodiscard]] std::shared_ptr<grpc::Channel>
+    createChannel(const uint16_t port)
+{
+    grpc::ChannelArguments arguments;
+    arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    return grpc::CreateCustomChannel("localhost:" + std::to_string(port),
+                                     grpc::InsecureChannelCredentials(),
+                                     arguments);
+}
+
+void publish(std::vector<UDataPacketImportAPI::V1::Packet> &&packets,
+             const std::shared_ptr<grpc::Channel> &channel,
+             std::string *error)
+{
+    auto stub = UDataPacketImportAPI::V1::Frontend::NewStub(channel);
+    grpc::ClientContext context;
+    UDataPacketImportAPI::V1::PublishResponse response;
+    auto writer = stub->Publish(&context, &response);
+    for (const auto &packet : packets)
+    {
+        if (!writer->Write(packet))
+        {
+            *error = "Publisher's stream broke";
+            break;
+        }
+    }
+    writer->WritesDone();
+    auto status = writer->Finish();
+    if (!status.ok() && error->empty()){*error = status.error_message();}
+}
+
+void subscribe(const std::shared_ptr<grpc::Channel> &channel,
+               grpc::ClientContext *context,
+               std::atomic<int64_t> *packetsReceived,
+               std::atomic<int64_t> *lastReceiveTime)
+{
+    auto stub = UDataPacketImportAPI::V1::Backend::NewStub(channel);
+    const UDataPacketImportAPI::V1::SubscriptionRequest request;
+    auto reader = stub->Subscribe(context, request);
+    UDataPacketImportAPI::V1::Packet packet;
+    while (reader->Read(&packet))
+    {
+        packetsReceived->fetch_add(1, std::memory_order_relaxed);
+        lastReceiveTime->store(
+            std::chrono::steady_clock::now().time_since_epoch().count(),
+            std::memory_order_relaxed);
+    }
+    static_cast<void> (reader->Finish());
+}
+
+void run(const Transport transport,
+         const ServerPreset preset,
+         const ::Options &options)
+{
+    auto logger
+        = std::make_shared<spdlog::logger>
+          ("transportBenchmark",
+           std::make_shared<spdlog::sinks::null_sink_mt> ());
+    UDataPacketImportProxy::Proxy proxy{::createProxyOptions(preset, options),
+                                        logger};
+    proxy.start();
+
+    std::vector<std::vector<UDataPacketImportAPI::V1::Packet>> packets;
+    for (int i = 0; i < options.nPublishers; ++i)
+    {
+        packets.push_back(::createPackets(i, options));
+    }
+    const auto nPacketsSent
+        = static_cast<int64_t> (options.nPublishers)
+         *options.nPacketsPerPublisher;
+
+    // Subscribers
+    std::vector<std::unique_ptr<grpc::ClientContext>> contexts;
+    std::vector<std::atomic<int64_t>> packetsReceived(options.nSubscribers);
+    std::vector<std::atomic<int64_t>> lastReceiveTimes(options.nSubscribers);
+    std::vector<std::thread> subscriberThreads;
+    for (int i = 0; i < options.nSubscribers; ++i)
+    {
+        auto channel = transport == Transport::TCP ?
+                       ::createChannel(options.backendPort) :
+                       proxy.createBackendInProcessChannel();
+        contexts.push_back(std::make_unique<grpc::ClientContext> ());
+        subscriberThreads.emplace_back(&::subscribe,
+                                       channel,
+                                       contexts.back().get(),
+                                       &packetsReceived[i],
+                                       &lastReceiveTimes[i]);
+    }
+    const auto subscribeDeadline
+        = std::chrono::steady_clock::now() + std::chrono::seconds {5};
+    while (proxy.getNumberOfSubscribers() < options.nSubscribers &&
+           std::chrono::steady_clock::now() < subscribeDeadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds {5});
+    }
+
+    // Publishers
+    std::vector<std::string> errors(options.nPublishers);
+    std::vector<std::thread> publisherThreads;
+    const auto startCPUTime = ::getProcessCPUTime();
+    const auto startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.nPublishers; ++i)
+    {
+        if (transport == Transport::Callback)
+        {
+            publisherThreads.emplace_back([&proxy, &packets, i]()
+            {
+                for (auto &packet : packets[i])
+                {
+                    proxy.enqueuePacket(std::move(packet));
+                }
+            });
+        }
+        else
+        {
+            auto channel = transport == Transport::TCP ?
+                           ::createChannel(options.frontendPort) :
+                           proxy.createFrontendInProcessChannel();
+            publisherThreads.emplace_back(&::publish,
+                                          std::move(packets[i]),
+                                          channel,
+                                          &errors[i]);
+        }
+    }
+    for (auto &thread : publisherThreads){thread.join();}
+    const auto publishEndTime = std::chrono::steady_clock::now();
+
+    // Wait for the subscribers to get everything or to stop hearing anything
+    auto endTime = publishEndTime;
+    if (options.nSubscribers > 0)
+    {
+        while (true)
+        {
+            int64_t nReceived{0};
+            int64_t lastReceiveTime{0};
+            for (int i = 0; i < options.nSubscribers; ++i)
+            {
+                nReceived = nReceived + packetsReceived[i].load();
+                lastReceiveTime = std::max(lastReceiveTime,
+                                           lastReceiveTimes[i].load());
+            }
+            const auto now = std::chrono::steady_clock::now();
+            endTime
+                = std::chrono::steady_clock::time_point
+                  {std::chrono::steady_clock::duration {lastReceiveTime}};
+            if (nReceived >= nPacketsSent*options.nSubscribers){break;}
+            if (now - std::max(endTime, publishEndTime) > options.idleTimeOut)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds {1});
+        }
+        endTime = std::max(endTime, publishEndTime);
+    }
+    const auto cpuTime = ::getProcessCPUTime() - startCPUTime;
+
+    for (auto &context : contexts){context->TryCancel();}
+    proxy.stop();
+    for (auto &thread : subscriberThreads){thread.join();}
+
+    // Report
+    const auto publishTime = ::toSeconds(publishEndTime - startTime);
+    const auto elapsedTime = ::toSeconds(endTime - startTime);
+    std::cout << fmt::format("{} ({}): {} publishers, {} subscribers, {} packets",
+                             ::toString(transport),
+                             ::toString(preset),
+                             options.nPublishers,
+                             options.nSubscribers,
+                             nPacketsSent) << std::endl;
+    std::cout << fmt::format("  Ingest: {:.1f} packets/s over {:.3f} s",
+                             static_cast<double> (nPacketsSent)
+                            /std::max(publishTime, 1.e-9),
+                             publishTime) << std::endl;
+    int64_t nPacketsDelivered{0};
+    for (int i = 0; i < options.nSubscribers; ++i)
+    {
+        nPacketsDelivered = nPacketsDelivered + packetsReceived[i].load();
+        std::cout << fmt::format("  Subscriber {}: {} packets ({} lost)",
+                                 i,
+                                 packetsReceived[i].load(),
+                                 nPacketsSent - packetsReceived[i].load())
+                  << std::endl;
+    }
+    if (options.nSubscribers > 0)
+    {
+        std::cout << fmt::format("  Delivery: {:.1f} packets/s over {:.3f} s",
+                                 static_cast<double> (nPacketsDelivered)
+                                /std::max(elapsedTime, 1.e-9),
+                                 elapsedTime) << std::endl;
+    }
+    // The CPU time covers the publishers and subscribers too so this is a
+    // lower bound on what the proxy does per core
+    std::cout << fmt::format("  CPU: {:.3f} s; {:.1f} packets per CPU-second ({:.2f} cores busy)",
+                             cpuTime,
+                             static_cast<double> (nPacketsSent)
+                            /std::max(cpuTime, 1.e-9),
+                             cpuTime/std::max(elapsedTime, 1.e-9))
+              << std::endl;
+    for (int i = 0; i < options.nPublishers; ++i)
+    {
+        if (!errors[i].empty())
+        {
+            std::cerr << fmt::format("  Publisher {} failed: {}", i, errors[i])
+                      << std::endl;
+        }
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    ::Options options;
+    try
+    {
+        auto parsedOptions = ::parseCommandLine(argc, argv);
+        if (!parsedOptions){return EXIT_SUCCESS;}
+        options = *parsedOptions;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    try
+    {
+        for (const auto transport : options.transports)
+        {
+            for (const auto preset : options.presets)
+            {
+                ::run(transport, preset, options);
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}